@@ -19,8 +19,15 @@
 #include <wx/stdpaths.h>
 #include <wx/log.h>
 #include <wx/utils.h>
+#include <wx/datetime.h>
+#include <wx/progdlg.h>
+#include <wx/thread.h>
 #include <vector>
 #include <map>
+#include <deque>
+#include <algorithm>
+#include <signal.h>
+#include <sys/wait.h>
 #include "wx/taskbar.h"
 
 #include "encfsgui.h"
@@ -84,6 +91,10 @@ enum
     ID_Menu_New,
     ID_Menu_Existing,
     ID_Menu_Settings,
+    ID_Menu_ChangePassword,
+    ID_Menu_Discover,
+    ID_Menu_Import,
+    ID_Menu_Export,
     //Toolbar stuff
     ID_Toolbar_Create,
     ID_Toolbar_Existing,
@@ -113,17 +124,48 @@ enum
     ID_List_Menu_Edit,
     ID_List_Menu_Info,
     ID_List_Menu_Browse,
-    ID_List_Menu_ForceUnmountAll
+    ID_List_Menu_ForceUnmountAll,
+    ID_List_Menu_ChangePassword
 };
 
 // enum for return codes related with mount success
+// stages that run after the main window has been shown
+enum
+{
+    STARTUP_CONFIG,
+    STARTUP_MOUNTSTATE,
+    STARTUP_VOLUMECONFIGS,
+    STARTUP_VALIDATE,
+    STARTUP_AUTOMOUNT,
+    STARTUP_UPDATES,
+    STARTUP_DONE
+};
+
+static const char * STARTUP_STAGE_NAMES[] = { "Reading volume settings",
+                                              "Reading mount table",
+                                              "Reading volume configs",
+                                              "Validating volumes",
+                                              "Automount",
+                                              "Checking for updates" };
+
 enum
 {
     ID_MNT_OK,
     ID_MNT_PWDFAIL,
-    ID_MNT_OTHER
+    ID_MNT_OTHER,
+    // the max nr of mounted volumes was reached, and nothing could be unmounted
+    ID_MNT_NOROOM
 };
 
+// nr of attempts per volume at startup
+static const int AUTOMOUNT_MAX_TRIES = 5;
+static const int RESTORE_MAX_TRIES = 3;
+// nr of attempts when mounting by hand
+static const int MANUAL_MOUNT_MAX_TRIES = 5;
+
+// how long encfs gets to derive the key and mount the volume
+static const long MOUNT_START_TIMEOUT_MS = 120000;
+
 
 
 
@@ -133,11 +175,19 @@ enum
 std::vector<wxString> v_AllVolumes;
 // map of all volumes, using volume name as key
 std::map<wxString, DBEntry*> m_VolumeData;
+// both are only touched on the main thread
+// other threads use getVolumeSnapshot() instead
 //
 // -----------------------------------------------
 
 // keep ref to main form
 frmMain * g_frmMain;
+// QuitApp is tearing things down, the monitors must not be recreated
+bool g_shuttingDown = false;
+
+// the app is shutting down, background mounts that are still running must not report back
+static wxCriticalSection g_backgroundMountLock;
+static bool g_backgroundMountStopped = false;
 
 
 // ----------------------------------------------------------------------------
@@ -152,6 +202,10 @@ wxBEGIN_EVENT_TABLE(frmMain, wxFrame)
     EVT_MENU(ID_Menu_New, frmMain::OnNewFolder)
     EVT_MENU(ID_Menu_Existing, frmMain::OnAddExistingFolder)
     EVT_MENU(ID_Menu_Settings, frmMain::OnSettings)
+    EVT_MENU(ID_Menu_ChangePassword, frmMain::OnChangePassword)
+    EVT_MENU(ID_Menu_Discover, frmMain::OnDiscoverFolders)
+    EVT_MENU(ID_Menu_Import, frmMain::OnImportFolders)
+    EVT_MENU(ID_Menu_Export, frmMain::OnExportFolders)
     EVT_MENU(wxID_ANY, frmMain::OnToolLeftClick)
 wxEND_EVENT_TABLE()
 
@@ -163,6 +217,7 @@ wxBEGIN_EVENT_TABLE(mainListCtrl, wxListCtrl)
     EVT_LIST_ITEM_RIGHT_CLICK(ID_List_Ctrl, mainListCtrl::OnRightClick)
     EVT_MENU(wxID_ANY, mainListCtrl::OnPopupMenuClick)
     EVT_LIST_ITEM_ACTIVATED(ID_List_Ctrl, mainListCtrl::OnItemActivated)    // double-click/enter
+    EVT_DROP_FILES(mainListCtrl::OnDropFiles)
 wxEND_EVENT_TABLE()
 
 
@@ -188,6 +243,51 @@ wxIMPLEMENT_APP(encFSGuiApp);
 // 'Main program' equivalent: the program execution "starts" here
 // ----------------------------------------------------------------------------
 
+// make the current state of the volumes visible to the other threads
+// the path index & monitors only need to follow along when something changed
+static void publishVolumes()
+{
+    if (!publishVolumeSnapshot(v_AllVolumes, m_VolumeData))
+    {
+        return;
+    }
+    updateVolumePathIndex(v_AllVolumes, m_VolumeData);
+    if (g_shuttingDown)
+    {
+        return;
+    }
+    updateIdleMonitor(m_VolumeData);
+    updateActivityMonitor(m_VolumeData);
+    updateLazyMountWatches(m_VolumeData);
+    updateHealthProber(m_VolumeData);
+}
+
+
+// the folders of the loaded volumes, to work out the mount order
+static std::vector<VolumeRecord> getLoadedVolumeRecords()
+{
+    std::vector<VolumeRecord> records;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        VolumeRecord record;
+        record.m_volname = it->first;
+        record.m_enc_path = it->second->getEncPath();
+        record.m_mount_path = it->second->getMountPath();
+        records.push_back(record);
+    }
+    return records;
+}
+
+
+// the encfs path may have changed, update the encfs version in the statusbar
+static void onAppSettingsChanged(const AppSettings * WXUNUSED(settings))
+{
+    if (g_frmMain)
+    {
+        g_frmMain->RecreateStatusbar();
+    }
+}
+
 bool encFSGuiApp::OnInit()
 {
     // call the base class initialization method, currently it only parses a
@@ -199,13 +299,24 @@ bool encFSGuiApp::OnInit()
     g_selectedIndex = -1;
     g_selectedVolume = "";
 
+    // password changes write to encfsctl through a pipe,
+    // don't let a process that exits early take us down with it
+    signal(SIGPIPE, SIG_IGN);
+
+    // curl needs to be initialized before the update check thread uses it
+    initUpdateChecker();
+
     // this will be the default config file, that we can Get() when needed
     wxConfigBase *pConfig = wxConfigBase::Create();    
     wxConfigBase::Set(pConfig);
+    // read the settings once, hot paths use this copy instead of wxConfig
+    loadAppSettings();
+    // volumes are kept in SQLite if available, first run migrates the config file
+    openVolumeDB();
    
     // create the main application window
     wxSize frmMainSize;
-    frmMainSize.Set(920,340);
+    frmMainSize.Set(1000,340);
     long framestyle;
 
     framestyle = wxDEFAULT_FRAME_STYLE ^ wxRESIZE_BORDER | wxFRAME_EX_METAL;
@@ -219,19 +330,10 @@ bool encFSGuiApp::OnInit()
                                  framestyle );
 
     g_frmMain = frame;
+    addAppSettingsListener(onAppSettingsChanged);
 
     frame->EnableCloseButton(false);
 
-    pConfig->SetPath(wxT("/Config"));
-    bool checkupdates = pConfig->Read(wxT("checkupdates"), 0l);
-
-    // check for updates ?
-    if (checkupdates)
-    {
-        frame->CheckUpdates();
-    }
-
-
     wxInitAllImageHandlers();
     
     // success: wxApp::OnRun() will be called which will enter the main message
@@ -277,13 +379,16 @@ wxMenu *TaskBarIcon::CreatePopupMenu()
 
     wxMenu *volumesmenu = new wxMenu;
     int submenuid = 5555;
-    for (std::vector<wxString>::iterator it = v_AllVolumes.begin(); it != v_AllVolumes.end(); ++it)
+    // one consistent view of all volumes, even if the model changes meanwhile
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    const std::vector<wxString>& volumes = snapshot->getVolumeNames();
+    for (std::vector<wxString>::const_iterator it = volumes.begin(); it != volumes.end(); ++it)
     {
         wxString voltitle;
         wxString volname;
         bool isMounted;
         volname.Printf(wxT("%s"), *it);
-        DBEntry * thisvol = m_VolumeData[volname];
+        const DBEntry * thisvol = snapshot->getVolume(volname);
         isMounted = thisvol->getMountState();
         voltitle.Printf(wxT("Mount '%s'"), volname);
         volumesmenu->Append(submenuid, voltitle);
@@ -417,8 +522,11 @@ frmMain::frmMain(const wxString& title,
                  long style) : wxFrame(NULL, wxID_ANY, title, pos, size, style)
 {
     m_visible = true;
+    m_nrunhealthy = 0;
+    m_lastmountbatch = 0;
     wxStandardPathsBase& stdp = wxStandardPaths::Get();
     m_listCtrl = NULL;
+    m_taskBarIcon = NULL;
     m_datadir = stdp.GetUserDataDir();
 
     m_statusBar = CreateStatusBar(2, wxSB_SUNKEN);
@@ -436,6 +544,11 @@ frmMain::frmMain(const wxString& title,
     // create application-specific menu items
     fileMenu->Append(ID_Menu_New, "&Create a new EncFS folder\tF2","Create a new EncFS folder");
     fileMenu->Append(ID_Menu_Existing, "&Open existing EncFS folder\tF4","Open an existing encFS folder");
+    fileMenu->Append(ID_Menu_ChangePassword, "Change &password of EncFS folders\tF7","Change the password of one or more EncFS folders");
+    fileMenu->AppendSeparator();
+    fileMenu->Append(ID_Menu_Discover, "&Discover EncFS folders...","Search folders for EncFS folders that were not added yet");
+    fileMenu->Append(ID_Menu_Import, "&Import EncFS folders...","Add EncFS folders from a JSON Lines or CSV file");
+    fileMenu->Append(ID_Menu_Export, "&Export EncFS folders...","Save the EncFS folder definitions to a JSON Lines or CSV file");
     fileMenu->AppendSeparator();
     fileMenu->Append(ID_Menu_Settings, "&Settings\tF6","Edit global settings");
     fileMenu->Append(ID_Menu_Quit, "E&xit\tAlt-X", "Quit this program");
@@ -449,11 +562,33 @@ frmMain::frmMain(const wxString& title,
     SetMenuBar(menuBar);
 
 
+    m_startupwatch.Start();
+
     // update the StatusBar
     RecreateStatusbar();
 
+    // tray icon first, so the app is usable right away
+    m_taskBarIcon = new TaskBarIcon(wxTBI_DEFAULT_TYPE);
+    UpdateTrayBadge();
+
     // Populate vector & map with volume information
-    PopulateVolumes();
+    // use the snapshot of the previous run if there is one, otherwise
+    // only what's in the config, the rest gets filled in by the startup stages
+    m_loadedfromsnapshot = loadVolumeSnapshot(v_AllVolumes, m_VolumeData);
+    if (!m_loadedfromsnapshot)
+    {
+        LoadVolumesFromDB();
+    }
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (!it->second->getHealthState())
+        {
+            ++m_nrunhealthy;
+        }
+    }
+    publishVolumes();
+    UpdateVolumeCountStatus();
+    UpdateTrayBadge();
 
     m_rows = 1;
     // Create the toolbar
@@ -465,9 +600,6 @@ frmMain::frmMain(const wxString& title,
     wxBoxSizer* sizer = new wxBoxSizer(wxVERTICAL);
     m_panel->SetSizer(sizer);
 
-    // check if we need to mount volumes at startup
-    AutoMountVolumes();
-
     // next, create the actual list control and populate it
     //long flags = wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_ALIGN_LEFT | wxLC_SMALL_ICON | wxLC_HRULES;
     long flags = wxLC_REPORT | wxLC_SINGLE_SEL | wxLC_HRULES | wxLC_ALIGN_LEFT;
@@ -482,10 +614,10 @@ frmMain::frmMain(const wxString& title,
 
     m_listCtrl->LinkToolbar(GetToolBar());
     m_listCtrl->UpdateToolBarButtons();
+    // drop a file or folder on the list to find the volume it belongs to
+    m_listCtrl->DragAcceptFiles(true);
 
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    bool startasicon = pConfig->Read(wxT("startasicon"), 0l);
+    bool startasicon = getAppSettings()->getStartAsIcon();
 
     if (startasicon)
     {
@@ -496,15 +628,17 @@ frmMain::frmMain(const wxString& title,
         SetVisibleState(true);
     }
 
-    // finally, add the app icon
-    m_taskBarIcon = new TaskBarIcon(wxTBI_DEFAULT_TYPE);
-    m_taskBarIcon->SetIcon(wxICON(encfsgui_ico),
-                                 "EncFSGui"); 
-    
     #if defined(__WXOSX__) && wxOSX_USE_COCOA
         m_dockIcon = new TaskBarIcon(wxTBI_DOCK);
     #endif
 
+    m_startuptimings.Printf(wxT("Window shown: %ld ms%s\n"), m_startupwatch.Time(), m_loadedfromsnapshot ? " (from snapshot)" : "");
+    // the list covers the whole window, its first paint is when the user gets to see something
+    m_listCtrl->Bind(wxEVT_PAINT, &frmMain::OnFirstPaint, this);
+
+    // settings, mount state, volume configs, validation, automount & update check
+    CallAfter(&frmMain::RunStartupStage, (int)STARTUP_CONFIG);
+
 }
 
 
@@ -563,79 +697,386 @@ int frmMain::GetListCtrlIndex(wxString& volname)
 
 void frmMain::PopulateVolumes()
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    wxString mountbin = pConfig->Read(wxT("mountbin_path"), "/sbin/mount");
+    LoadVolumesFromDB();
+    UpdateMountStates();
+    UpdateVolumeConfigs([this]()
+    {
+        ValidateVolumes([this]()
+        {
+            saveVolumeSnapshot(v_AllVolumes, m_VolumeData);
+        });
+    });
+    UpdateVolumeCountStatus();
+}
 
-    // get info about already mounted volumes
-    wxArrayString mount_output;
-    mount_output = ArrRunCMDSync(mountbin);
+
+// read the volume definitions from the volume database, no file system access
+// mount state, health etc get filled in by the other stages
+void frmMain::LoadVolumesFromDB()
+{
+    // volumes that are no longer in the database get dropped
+    std::map<wxString, DBEntry*> previousVolumeData = m_VolumeData;
+    m_VolumeData.clear();
 
     v_AllVolumes.clear();
-    pConfig->SetPath(wxT("/Volumes"));
-    wxString volumename;
-    wxString allNames;
-    long dummy;
-    bool bCont = pConfig->GetFirstGroup(volumename, dummy);
-    while ( bCont ) { 
-        v_AllVolumes.push_back(volumename); 
-        bCont = pConfig->GetNextGroup(volumename, dummy);
-    }
+    std::vector<VolumeRecord> records;
+    loadVolumeRecords(records);
 
-    for (unsigned int i = 0; i < v_AllVolumes.size(); i++)
+    for (unsigned int i = 0; i < records.size(); i++)
     {
-        wxString currentPath;
-        wxString enc_path;
-        wxString mount_path;
-        bool automount;
-        bool alreadymounted;
-        bool preventautounmount;
-        bool pwsaved;
-        bool allowother;
-        bool mountaslocal;
-        wxString volumename = v_AllVolumes.at(i);
-        currentPath.Printf(wxT("/Volumes/%s"), volumename);
-        pConfig->SetPath(currentPath);
-        enc_path = pConfig->Read(wxT("enc_path"), "");
-        mount_path = pConfig->Read(wxT("mount_path"), "");
-        automount = pConfig->Read(wxT("automount"), 0l);
-        preventautounmount = pConfig->Read(wxT("preventautounmount"), 0l);
-        alreadymounted = IsVolumeSystemMounted(mount_path, mount_output);
-        pwsaved = pConfig->Read(wxT("passwordsaved"), 0l);
-        allowother = pConfig->Read(wxT("allowother"), 0l);
-        mountaslocal = pConfig->Read(wxT("mountaslocal"), 0l);
-        if (not enc_path.IsEmpty() && not mount_path.IsEmpty())
+        VolumeRecord& record = records.at(i);
+        wxString volumename = record.m_volname;
+        v_AllVolumes.push_back(volumename);
+        if (not record.m_enc_path.IsEmpty() && not record.m_mount_path.IsEmpty())
         {
             DBEntry* thisvolume = new DBEntry(volumename, 
-                                              enc_path, 
-                                              mount_path, 
-                                              automount, 
-                                              preventautounmount, 
-                                              pwsaved,
-                                              allowother,
-                                              mountaslocal);
-            thisvolume->setMountState(alreadymounted);
+                                              record.m_enc_path, 
+                                              record.m_mount_path, 
+                                              record.m_automount, 
+                                              record.m_preventautounmount, 
+                                              record.m_pwsaved,
+                                              record.m_allowother,
+                                              record.m_mountaslocal);
+            thisvolume->setIdleTimeout(record.m_idletimeout);
+            thisvolume->setLazyMount(record.m_lazymount);
+            // keep the last known state until the other stages have run
+            std::map<wxString, DBEntry*>::iterator previt = previousVolumeData.find(volumename);
+            if (previt != previousVolumeData.end())
+            {
+                DBEntry * previousvolume = previt->second;
+                thisvolume->setMountState(previousvolume->getMountState());
+                thisvolume->setHealth(previousvolume->getHealthState(), previousvolume->getHealthInfo());
+                thisvolume->setMountOwner(previousvolume->getMountPID(), previousvolume->getMountStartTime());
+            }
             // add to map
             m_VolumeData[volumename] = thisvolume;       
         }
     }
 
+    publishVolumes();
+
+    // snapshots hold copies, the old entries can go
+    for (std::map<wxString, DBEntry*>::iterator it = previousVolumeData.begin(); it != previousVolumeData.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+
+// get info about already mounted volumes
+// reads the mount table directly, instead of running mount
+void frmMain::UpdateMountStates()
+{
+    wxArrayString mount_output;
+    mount_output = getSystemMountTable();
+
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        DBEntry * thisvol = it->second;
+        bool mounted = IsVolumeSystemMounted(thisvol->getMountPath(), mount_output);
+        thisvol->setMountState(mounted);
+        if (!mounted)
+        {
+            thisvol->setMountOwner(0, 0);
+        }
+    }
+    publishVolumes();
+}
+
+
+// figure out which of the mounted volumes were mounted by us
+// the journal survives restarts & crashes, as long as the encfs process is still alive
+void frmMain::ReconcileMountJournal()
+{
+    std::map<wxString, MountJournalEntry> journal = readMountJournal();
+    std::map<wxString, MountJournalEntry> stillmounted;
+    std::map<long, wxArrayString> processes;
+    if (!journal.empty())
+    {
+        processes = getProcessArguments();
+    }
+
+    for (std::map<wxString, MountJournalEntry>::iterator it = journal.begin(); it != journal.end(); it++)
+    {
+        MountJournalEntry& entry = it->second;
+        std::map<wxString, DBEntry*>::iterator volit = m_VolumeData.find(entry.m_volname);
+        if (volit == m_VolumeData.end())
+        {
+            continue;
+        }
+        DBEntry * thisvol = volit->second;
+        if (!thisvol->getMountState() || thisvol->getMountPath() != entry.m_mount_path)
+        {
+            continue;
+        }
+        // make sure the pid hasn't been reused by something else
+        bool processalive = (entry.m_pid == 0);
+        std::map<long, wxArrayString>::iterator procit = processes.find(entry.m_pid);
+        if (procit != processes.end() && !procit->second.IsEmpty() && procit->second[0].EndsWith("encfs"))
+        {
+            processalive = true;
+        }
+        if (processalive)
+        {
+            thisvol->setMountOwner(entry.m_pid, entry.m_starttime);
+            stillmounted[entry.m_volname] = entry;
+        }
+    }
+
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (stillmounted.find(it->first) == stillmounted.end())
+        {
+            it->second->setMountOwner(0, 0);
+        }
+    }
+
+    publishVolumes();
+    compactMountJournal(stillmounted);
+}
+
+
+// read .encfs6.xml of all volumes, only the ones that changed get parsed again
+void frmMain::UpdateVolumeConfigs(std::function<void()> then)
+{
+    std::vector<wxString> enc_paths;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        enc_paths.push_back(it->second->getEncPath());
+    }
+    loadEncFSVolumeConfigs(enc_paths, [this, then]()
+    {
+        publishVolumes();
+        SyncList();
+        if (then)
+        {
+            then();
+        }
+    });
+}
+
+
+// make sure the folders are still there before we try to use them
+void frmMain::ValidateVolumes(std::function<void()> then)
+{
+    validateVolumes(m_VolumeData, [this, then](const std::vector<VolumeHealthResult>& results)
+    {
+        ApplyVolumeHealth(results);
+        if (then)
+        {
+            then();
+        }
+    });
+}
+
+
+// store the results of a validation run, and show them
+void frmMain::ApplyVolumeHealth(const std::vector<VolumeHealthResult>& results)
+{
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const VolumeHealthResult& result = results.at(i);
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(result.m_volname);
+        // removed or edited while the checks were running
+        if (it == m_VolumeData.end() ||
+            it->second->getEncPath() != result.m_enc_path ||
+            it->second->getMountPath() != result.m_mount_path)
+        {
+            continue;
+        }
+        it->second->setHealth(result.m_healthy, result.m_healthinfo);
+    }
+    m_nrunhealthy = 0;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (!it->second->getHealthState())
+        {
+            ++m_nrunhealthy;
+        }
+    }
+    publishVolumes();
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+    UpdateVolumeCountStatus();
+}
+
+
+void frmMain::UpdateVolumeCountStatus()
+{
     // %u = unsigned int
     int nr_vols;
     nr_vols = v_AllVolumes.size();
     wxString statustxt = wxString::Format(wxT("Nr of volumes : %d"), nr_vols);
+    if (m_nrunhealthy > 0)
+    {
+        statustxt << wxString::Format(wxT(" (%d need attention)"), m_nrunhealthy);
+    }
     SetStatusText(statustxt,0);
 }
 
+
+// startup runs in stages, so the window and tray icon can be shown first
+// each stage gets queued with CallAfter, giving the event loop a chance
+// to handle clicks and repaints in between
+void frmMain::RunStartupStage(int stage)
+{
+    if (stage >= STARTUP_DONE)
+    {
+        wxString statustxt;
+        statustxt.Printf(wxT("Startup done in %ld ms"), m_startupwatch.Time());
+        SetStatusText(statustxt, 0);
+        m_startuptimings << statustxt;
+        // next startup can render straight from the snapshot
+        saveVolumeSnapshot(v_AllVolumes, m_VolumeData);
+        // from now on, pick up changes other programs make to the config file
+        startConfigWatcher();
+        // and mount volumes whose encrypted folder shows up later
+        startArrivalWatcher();
+        // and mount lazy volumes when their mount point gets opened
+        startLazyMountWatcher(m_VolumeData);
+        // and clean up after encfs crashes
+        startReaper();
+        return;
+    }
+
+    wxString statustxt;
+    statustxt.Printf(wxT("%s..."), STARTUP_STAGE_NAMES[stage]);
+    SetStatusText(statustxt, 0);
+    m_statusBar->Update();
+
+    m_stagewatch.Start();
+    switch (stage)
+    {
+        case STARTUP_CONFIG:
+            // the snapshot could be out of date, the config is leading
+            if (m_loadedfromsnapshot)
+            {
+                LoadVolumesFromDB();
+            }
+            break;
+        case STARTUP_MOUNTSTATE:
+            UpdateMountStates();
+            // before the journal gets compacted, it may be all we have after a crash
+            m_lastsession = takeMountSession();
+            ReconcileMountJournal();
+            break;
+        case STARTUP_VOLUMECONFIGS:
+            UpdateVolumeConfigs([this, stage]()
+            {
+                FinishStartupStage(stage);
+            });
+            return;
+        case STARTUP_VALIDATE:
+            // shows mount state, configs & health in one go when the results are in
+            ValidateVolumes([this, stage]()
+            {
+                FinishStartupStage(stage);
+            });
+            return;
+        case STARTUP_AUTOMOUNT:
+            {
+                std::function<void()> then = [this, stage]()
+                {
+                    SyncList();
+                    FinishStartupStage(stage);
+                };
+                if (getAppSettings()->getRestoreSession())
+                {
+                    RestoreSession(then);
+                }
+                else
+                {
+                    AutoMountVolumes(then);
+                }
+            }
+            return;
+        case STARTUP_UPDATES:
+            {
+                bool checkupdates = getAppSettings()->getCheckUpdates();
+                if (checkupdates)
+                {
+                    CheckUpdates();
+                }
+            }
+            break;
+    }
+
+    FinishStartupStage(stage);
+}
+
+
+// time to first paint, only measured once
+void frmMain::OnFirstPaint(wxPaintEvent& event)
+{
+    event.Skip();
+    m_listCtrl->Unbind(wxEVT_PAINT, &frmMain::OnFirstPaint, this);
+    wxString timing;
+    timing.Printf(wxT("First paint: %ld ms\n"), m_startupwatch.Time());
+    m_startuptimings << timing;
+    wxLogDebug("%s", timing);
+}
+
+
+// log how long the stage took, and queue the next one
+void frmMain::FinishStartupStage(int stage)
+{
+    wxString timing;
+    timing.Printf(wxT("%s: %ld ms\n"), STARTUP_STAGE_NAMES[stage], m_stagewatch.Time());
+    m_startuptimings << timing;
+
+    if (stage == STARTUP_UPDATES)
+    {
+        UpdateVolumeCountStatus();
+    }
+    CallAfter(&frmMain::RunStartupStage, stage + 1);
+}
+
+
+// use the 'not ok' icon in the tray when one or more volumes failed validation
+void frmMain::UpdateTrayBadge()
+{
+    if (!m_taskBarIcon)
+    {
+        return;
+    }
+    if (m_nrunhealthy > 0)
+    {
+        wxString tooltip;
+        tooltip.Printf(wxT("EncFSGui - %d volume(s) need attention"), m_nrunhealthy);
+        m_taskBarIcon->SetIcon(wxIcon(ico_notok), tooltip);
+    }
+    else
+    {
+        m_taskBarIcon->SetIcon(wxICON(encfsgui_ico), "EncFSGui");
+    }
+}
+
 void frmMain::CheckUpdates()
 {
     CheckUpdates(false);
 }
 
+// runs in the background, OnUpdateCheckDone shows the result
+// manual checks (showIfNoUpdate) always go to the network
 void frmMain::CheckUpdates(bool showIfNoUpdate)
 {
-    wxString latestversion = getLatestVersion();     
-    if (!latestversion.IsEmpty() && latestversion.Find("error") == -1)
+    startUpdateCheck(showIfNoUpdate);
+}
+
+void frmMain::OnUpdateCheckDone(wxString latestversion, bool showIfNoUpdate)
+{
+    if (latestversion.IsEmpty())
+    {
+        if (showIfNoUpdate)
+        {
+            wxMessageBox("Unable to check for updates right now.\nPlease check your internet connection and try again later.",
+                         "Check for updates",
+                         wxOK | wxICON_ERROR,
+                         this);
+        }
+    }
+    else
     {
         // to do: implement proper version comparison check
         // ignore if you are running a newer version
@@ -674,30 +1115,43 @@ void frmMain::CheckUpdates(bool showIfNoUpdate)
 }
 
 
-bool unmountVolume(wxString& volumename)
+// run umount for a mount point - only uses system calls, safe on worker threads
+// returns true if the mount point is gone from the mount table
+static bool runUnmount(const wxString& mountvol)
 {
-    DBEntry *thisvol = m_VolumeData[volumename];
-    wxString mountvol = thisvol->getMountPath();
-    wxString umountbin;
-    wxString mountbin;
-    bool beenmounted;
-    mountbin = getMountBinPath();
-    umountbin = getUMountBinPath();
-    wxString cmd;
-    cmd.Printf(wxT("'%s' '%s'"), umountbin, mountvol);
+    wxArrayString args;
+    args.Add(getUMountBinPath());
+    args.Add(mountvol);
     wxString cmdoutput;
-    cmdoutput = StrRunCMDSync(cmd);
+    RunCMDArgvSync(args, wxEmptyString, cmdoutput);
     // get info about already mounted volumes
     wxArrayString mount_output;
-    mount_output = ArrRunCMDSync(mountbin);
-    wxString mountstr;
-    mountstr = arrStrTowxStr(mount_output);
-    
-    beenmounted = IsVolumeSystemMounted(mountvol, mount_output);
-    if (not beenmounted)
+    mount_output = getSystemMountTable();
+    return !IsVolumeSystemMounted(mountvol, mount_output);
+}
+
+
+// the volume is gone - reset stuff
+// main thread only
+static void setVolumeUnmounted(const wxString& volumename)
+{
+    DBEntry *thisvol = m_VolumeData[volumename];
+    thisvol->setMountState(false);
+    if (thisvol->getMountedByApp())
     {
-        // it's gone - reset stuff
-        thisvol->setMountState(false);
+        journalMountStopped(volumename);
+    }
+    thisvol->setMountOwner(0, 0);
+    publishVolumes();
+}
+
+
+bool unmountVolume(wxString& volumename)
+{
+    DBEntry *thisvol = m_VolumeData[volumename];
+    if (runUnmount(thisvol->getMountPath()))
+    {
+        setVolumeUnmounted(volumename);
         return true;    // unmount success
     }
     return false;
@@ -705,15 +1159,46 @@ bool unmountVolume(wxString& volumename)
 
 
 
+// true if another volume is still mounted inside the mount point of this one
+static bool hasMountedVolumesInside(const wxString& volumename)
+{
+    std::vector<VolumePathMatch> inside = findVolumesInsidePath(m_VolumeData[volumename]->getMountPath());
+    for (size_t i = 0; i < inside.size(); i++)
+    {
+        // a mounted volume keeps both its encrypted folder and its mount point busy
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(inside.at(i).m_volname);
+        if (it != m_VolumeData.end() && it->first != volumename && it->second->getMountState())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void AutoUnmountVolumes(bool forced)
 {
-    for (std::map<wxString, DBEntry*>::iterator it= m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    // unmount in the reverse mount order, nested volumes before the volume they live in
+    // volumes that are part of a cycle go first, they don't have a proper order anyway
+    wxArrayString cycle;
+    std::vector<wxArrayString> levels = getMountLevels(getLoadedVolumeRecords(), cycle);
+    levels.push_back(cycle);
+    for (size_t level = levels.size(); level > 0; level--)
     {
-        wxString volumename = it->first;
-        DBEntry * thisvol = it->second;
-        if (thisvol->getMountState() && (!thisvol->getPreventAutoUnmount() || forced)) 
+        const wxArrayString& volumes = levels.at(level - 1);
+        for (size_t i = 0; i < volumes.GetCount(); i++)
         {
-            unmountVolume(volumename);
+            wxString volumename = volumes[i];
+            DBEntry * thisvol = m_VolumeData[volumename];
+            if (thisvol->getMountState() && (!thisvol->getPreventAutoUnmount() || forced)) 
+            {
+                // encfs would refuse anyway (busy), a volume inside this one was left mounted
+                if (hasMountedVolumesInside(volumename))
+                {
+                    continue;
+                }
+                unmountVolume(volumename);
+            }
         }
     }
 }
@@ -726,12 +1211,11 @@ void AutoUnmountVolumes(bool forced)
 bool QuitApp(wxWindow * parent)
 {
     // do we need to dismount all ?
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
+    const AppSettings * settings = getAppSettings();
     bool autounmount;
     bool nopromptonquit;
-    autounmount = pConfig->Read(wxT("autounmount"), 0l);
-    nopromptonquit =  pConfig->Read(wxT("nopromptonquit"), 0l);
+    autounmount = settings->getAutoUnmount();
+    nopromptonquit = settings->getNoPromptOnQuit();
 
     wxString hdr;
     hdr.Printf(wxT("Are you sure you want to exit this program?\n"));
@@ -764,15 +1248,45 @@ bool QuitApp(wxWindow * parent)
     
     if (res == wxYES)
     {
-        delete wxConfigBase::Set((wxConfigBase *) NULL);
-        // true is to force the frame to close
+        // remember what is mounted now, before auto unmount kicks in
+        wxArrayString mounted;
+        for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+        {
+            if (it->second->getMountState())
+            {
+                mounted.Add(it->first);
+            }
+        }
+        saveMountSession(mounted);
+
+        g_shuttingDown = true;
+        {
+            wxCriticalSectionLocker lock(g_backgroundMountLock);
+            g_backgroundMountStopped = true;
+        }
+        // unmounting below makes encfs exit, that's not a crash
+        stopMountSupervision();
 
         // if autounmount, dismount volumes first
+        // while the volume db and the config are still there
         if (autounmount)
         {
             // do not force
             AutoUnmountVolumes(false);
         }
+
+        stopUpdateChecker();
+        stopTimedWorkers();
+        stopHealthProber();
+        stopReaper();
+        stopLazyMountWatcher();
+        stopArrivalWatcher();
+        stopIdleMonitor();
+        stopActivityMonitor();
+        closeVolumeDB();
+        stopConfigWatcher();
+        delete wxConfigBase::Set((wxConfigBase *) NULL);
+        // true is to force the frame to close
         return true;
     }
     return false;
@@ -801,6 +1315,12 @@ int frmMain::OnExit(wxCommandEvent& WXUNUSED(event))
 // destructor
 frmMain::~frmMain()
 {
+    // mounts still running don't report back after quitting
+    for (std::map<long, MountBatch*>::iterator it = m_mountbatches.begin(); it != m_mountbatches.end(); it++)
+    {
+        delete it->second;
+    }
+    m_mountbatches.clear();
     delete m_taskBarIcon;
     this->Destroy();
     Close(true);
@@ -823,10 +1343,22 @@ void frmMain::OnAbout(wxCommandEvent& WXUNUSED(event))
 
     wxString latestversion;
     wxString versionmessage;
-    latestversion = getLatestVersion();
+    latestversion = getCachedLatestVersion();
+    if (latestversion.IsEmpty())
+    {
+        latestversion = "unknown";
+    }
 
     wxStandardPathsBase& stdp = wxStandardPaths::Get();
 
+    ReaperStats reaperstats = getReaperStats();
+    wxString reaperinfo;
+    reaperinfo.Printf(wxT("%ld encfs process(es) without a mount (%ld stopped)\n%ld dead mount point(s) (%ld unmounted)"),
+                      reaperstats.m_orphans,
+                      reaperstats.m_orphanskilled,
+                      reaperstats.m_deadmounts,
+                      reaperstats.m_deadunmounted);
+
     wxMessageBox(wxString::Format
                  (
                     "EncFSGui - GUI Wrapper around encfs, for OSX\n"
@@ -838,13 +1370,19 @@ void frmMain::OnAbout(wxCommandEvent& WXUNUSED(event))
                     "You are running %s\n\n"
                     "EncFS used: %s\n"
                     "EncFS version: %s\n"
-                    "Config Folder: %s\n",
+                    "Config Folder: %s\n"
+                    "Volumes stored in: %s\n\n"
+                    "Startup timings:\n%s\n"
+                    "Cleaned up since startup:\n%s",
                     g_encfsguiversion,
                     latestversion,
                     wxGetOsDescription(),
                     msg,
                     getEncFSBinVersion(),
-                    stdp.GetConfigDir()
+                    stdp.GetConfigDir(),
+                    getVolumeDBName(),
+                    m_startuptimings,
+                    reaperinfo
                  ),
                  "About EncFSGui",
                  wxOK | wxICON_INFORMATION,
@@ -875,85 +1413,258 @@ void frmMain::OnBrowseFolder(wxCommandEvent& WXUNUSED(event))
     {
         DBEntry * thisvol = m_VolumeData[g_selectedVolume];
         wxString mountpath = thisvol->getMountPath();
-        BrowseFolder(mountpath);
+        if (CheckVolumeResponding(g_selectedVolume))
+        {
+            BrowseFolder(mountpath);
+        }
     }
 }
 
 
 
-// mount folder - generic routine
-int frmMain::mountFolder(wxString& volumename, wxString& pw)
+// run encfs for a volume - only uses system calls, safe on worker threads
+// encfs stays in the foreground, pid is the process that serves the volume
+static int runEncFSMount(const wxString& volumename, const wxString& encvol, const wxString& mountvol, bool allowother, bool mountaslocal, long idletimeout, const wxString& pw, long& pid)
 {
-    wxString mountvol;
-    wxString encvol;
-    bool allowother;
-    bool mountaslocal;
-    wxString buf;
-    
-    bool beenmounted;
-    DBEntry *thisvol = m_VolumeData[volumename];
-    mountvol = thisvol->getMountPath();
-    encvol = thisvol->getEncPath();
-    allowother = thisvol->getAllowOther();
-    mountaslocal = thisvol->getMountAsLocal();
-
-    // run encfs command
-    wxString cmd;
-    wxString cmdoutput;
-    wxString encfsbin = getEncFSBinPath();
-    wxString extra_osxfuse_opts = "";
+    // run encfs directly, the password goes to stdin
+    // no shell involved, so quotes in names & paths are fine
+    pid = -1;
+    wxArrayString args;
+    args.Add(getEncFSBinPath());
+    args.Add("-f");
+    args.Add("-v");
+    args.Add("-S");
     if (allowother)
     {
-        extra_osxfuse_opts << "-o allow_other ";
+        args.Add("-o");
+        args.Add("allow_other");
     }
     if (mountaslocal)
     {
-        extra_osxfuse_opts << "-o local ";
+        args.Add("-o");
+        args.Add("local");
     }
+    if (idletimeout > 0)
+    {
+        // encfs tracks the activity itself, and unmounts when idle
+        args.Add(wxString::Format(wxT("--idle=%ld"), idletimeout));
+    }
+#ifdef __WXOSX__
+    // volume name in Finder, only macFUSE knows this option
+    args.Add("-o");
+    args.Add("volname=" + volumename);
+#endif
+    args.Add(encvol);
+    args.Add(mountvol);
 
     // first, create mount point if necessary
-    cmd.Printf(wxT("mkdir -p '%s'"), mountvol);
-    cmdoutput = StrRunCMDSync(cmd);
-
-    // mount
-    cmd.Printf(wxT("sh -c \"echo '%s' | %s -v -S %s -o volname='%s' '%s' '%s'\""), pw, encfsbin, extra_osxfuse_opts, volumename, encvol, mountvol);
+    makeDirectories(mountvol, 0700);
 
-    cmdoutput = StrRunCMDSync(cmd);
-
-    // check if mount was successful
-    wxString errmsg;
-    errmsg = "Error decoding volume key, password incorrect";
+    // mount, the output of encfs goes to the log of the volume
+    wxFileOffset logstart;
+    wxString logfile = prepareMountLog(volumename, logstart);
+    long encfspid = SpawnCMDArgv(args, pw + "\n", logfile);
+    if (encfspid <= 0)
+    {
+        return ID_MNT_OTHER;
+    }
 
-    //wxLogDebug(wxT("----------------------------"));
-    //wxLogDebug(cmdoutput);
-    //wxLogDebug(wxT("----------------------------"));
-    if (cmdoutput.Find(errmsg) > -1)
+    // wait until the volume shows up, or encfs gives up
+    wxStopWatch sw;
+    while (true)
     {
-        return ID_MNT_PWDFAIL;
+        int status = 0;
+        if (waitpid((pid_t)encfspid, &status, WNOHANG) == (pid_t)encfspid)
+        {
+            wxString cmdoutput = readMountLog(logfile, logstart);
+            wxString errmsg;
+            errmsg = "Error decoding volume key, password incorrect";
+            if (cmdoutput.Find(errmsg) > -1)
+            {
+                return ID_MNT_PWDFAIL;
+            }
+            return ID_MNT_OTHER;
+        }
+        if (IsVolumeSystemMounted(mountvol, getSystemMountTable()))
+        {
+            pid = encfspid;
+            return ID_MNT_OK;
+        }
+        if (sw.Time() > MOUNT_START_TIMEOUT_MS)
+        {
+            kill((pid_t)encfspid, SIGTERM);
+            waitpid((pid_t)encfspid, &status, 0);
+            return ID_MNT_OTHER;
+        }
+        wxMilliSleep(100);
     }
+}
 
-    // check mount list, to be sure
-    wxString mountbin = getMountBinPath();
 
-    // get info about already mounted volumes
+// check if encfs really mounted the volume, and update the volume state
+// pid is the encfs process, it gets supervised from now on
+// main thread only
+static int finishMount(const wxString& volumename, long pid)
+{
+    DBEntry *thisvol = m_VolumeData[volumename];
+    wxString mountvol = thisvol->getMountPath();
+
+    // check mount list, to be sure
     wxArrayString mount_output;
-    mount_output = ArrRunCMDSync(mountbin);
-    wxString mountstr;
-    mountstr = arrStrTowxStr(mount_output);
-    
-    beenmounted = IsVolumeSystemMounted(mountvol, mount_output);
+    mount_output = getSystemMountTable();
+
+    bool beenmounted = IsVolumeSystemMounted(mountvol, mount_output);
     if (beenmounted)
     {
         thisvol->setMountState(true);
+        // remember we started this one, so we still know after a restart
+        thisvol->setMountOwner(pid, (long)wxGetUTCTime());
+        journalMountStarted(volumename, pid, mountvol);
+        superviseMountProcess(volumename, pid);
+        publishVolumes();
         return ID_MNT_OK;
     }
+    if (pid > 0)
+    {
+        // gone again already, don't leave encfs behind
+        kill((pid_t)pid, SIGTERM);
+        superviseMountProcess(volumename, pid);
+    }
     return ID_MNT_OTHER;
 }
 
 
+// volumes that can be unmounted to stay within the max nr of mounted volumes
+// shared by the mounts of one batch, the workers take them in order
+class MountEvictions
+{
+public:
+    MountEvictions()
+    {
+        m_nrplanned = 0;
+    }
+
+    // least recently used first: volume name & mount path
+    std::deque<std::pair<wxString, wxString> > m_candidates;
+    wxCriticalSection m_lock;
+    // nr of unmounts the mounts of the batch need, main thread only
+    size_t m_nrplanned;
+};
+
+
+// mounts one volume, so the volumes of one mount level can be mounted in parallel
+// unmounts the volumes it needs to make room for it first
+class MountWorkItem : public WorkItem
+{
+public:
+    MountWorkItem(DBEntry * thisvol, const wxString& volumename, const wxString& pw)
+    {
+        m_volumename = volumename;
+        m_encvol = thisvol->getEncPath();
+        m_mountvol = thisvol->getMountPath();
+        m_allowother = thisvol->getAllowOther();
+        m_mountaslocal = thisvol->getMountAsLocal();
+        m_idletimeout = thisvol->getIdleTimeout();
+        m_pw = pw;
+        m_result = ID_MNT_OTHER;
+        m_pid = -1;
+        m_nrevict = 0;
+    }
+
+    ~MountWorkItem()
+    {
+        // to do : clear out memory location directly
+        m_pw = "GoodLuckWithThat";
+    }
+
+    virtual void Run()
+    {
+        if (!EvictVolumes())
+        {
+            m_result = ID_MNT_NOROOM;
+            return;
+        }
+        m_result = runEncFSMount(m_volumename, m_encvol, m_mountvol, m_allowother, m_mountaslocal, m_idletimeout, m_pw, m_pid);
+    }
+
+    // volumes that refuse to unmount (files may be open) are skipped
+    bool EvictVolumes()
+    {
+        while (m_evicted.GetCount() < m_nrevict)
+        {
+            std::pair<wxString, wxString> victim;
+            {
+                wxCriticalSectionLocker lock(m_evictions->m_lock);
+                if (m_evictions->m_candidates.empty())
+                {
+                    return false;
+                }
+                victim = m_evictions->m_candidates.front();
+                m_evictions->m_candidates.pop_front();
+            }
+            if (runUnmount(victim.second))
+            {
+                m_evicted.Add(victim.first);
+            }
+        }
+        return true;
+    }
+
+    wxString m_volumename;
+    wxString m_encvol;
+    wxString m_mountvol;
+    bool m_allowother;
+    bool m_mountaslocal;
+    long m_idletimeout;
+    wxString m_pw;
+    int m_result;
+    long m_pid;
+    std::shared_ptr<MountEvictions> m_evictions;
+    size_t m_nrevict;
+    // unmounted to make room
+    wxArrayString m_evicted;
+};
+
+
+// mounts a volume without blocking the event loop
+class BackgroundMountThread : public wxThread
+{
+public:
+    BackgroundMountThread(MountWorkItem * item, long batch) : wxThread(wxTHREAD_DETACHED)
+    {
+        m_item = item;
+        m_batch = batch;
+    }
+
+    ~BackgroundMountThread()
+    {
+        delete m_item;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        m_item->Run();
+        MountResult result;
+        result.m_volname = m_item->m_volumename;
+        result.m_status = m_item->m_result;
+        result.m_pid = m_item->m_pid;
+        result.m_batch = m_batch;
+        result.m_evicted = m_item->m_evicted;
+        wxCriticalSectionLocker lock(g_backgroundMountLock);
+        if (g_frmMain && !g_backgroundMountStopped)
+        {
+            g_frmMain->CallAfter(&frmMain::OnBackgroundMountDone, result);
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    MountWorkItem * m_item;
+    long m_batch;
+};
+
 
 
-// unmount folder, generic routine
 bool frmMain::unmountVolumeAsk(wxString& volumename)
 {
     wxString msg;
@@ -965,17 +1676,49 @@ bool frmMain::unmountVolumeAsk(wxString& volumename)
     DBEntry *thisvol = m_VolumeData[volumename];
     mountvol = thisvol->getMountPath();
 
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    bool skippromptunmount = pConfig->Read(wxT("nopromptonunmount"), 0l);
+    // a regular unmount would hang just like everything else touching it
+    if (isVolumeHung(volumename))
+    {
+        CheckVolumeResponding(volumename);
+        return !thisvol->getMountState();
+    }
+
+    // other mounted volumes that live inside this one
+    wxString nestedvolumes;
+    std::vector<VolumePathMatch> inside = findVolumesInsidePath(mountvol);
+    for (size_t i = 0; i < inside.size(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(inside.at(i).m_volname);
+        if (inside.at(i).m_volname != volumename && it != m_VolumeData.end() && it->second->getMountState())
+        {
+            nestedvolumes << "- " << inside.at(i).m_volname << "\n";
+        }
+    }
+
+    bool skippromptunmount = getAppSettings()->getNoPromptOnUnmount();
+
+    std::vector<OpenFileHolder> holders;
+    if (nestedvolumes.IsEmpty())
+    {
+        // tell who keeps the volume busy, instead of letting umount fail
+        holders = findOpenFiles(mountvol);
+    }
 
-    if (skippromptunmount)
+    if (!holders.empty())
+    {
+        unmountok = UnmountBusyVolumeAsk(volumename, holders);
+    }
+    else if (skippromptunmount && nestedvolumes.IsEmpty())
     {
         unmountok = unmountVolume(volumename);
     }
     else
     {
         msg.Printf(wxT("Are you sure you want to unmount\n'%s' ?\n\nNote: make sure to close all open files\nbefore clicking 'Yes'."),mountvol);
+        if (!nestedvolumes.IsEmpty())
+        {
+            msg << "\n\nThese mounted volumes are stored inside it, and need to be unmounted first:\n" << nestedvolumes;
+        }
         title.Printf(wxT("Unmount '%s' ?"), volumename);
 
         wxMessageDialog * dlg = new wxMessageDialog(this, 
@@ -988,126 +1731,959 @@ bool frmMain::unmountVolumeAsk(wxString& volumename)
         }
         dlg->Destroy();
     }
+    if (unmountok)
+    {
+        // unmounted by hand, don't mount it again when the disk comes back
+        disarmDeferredMount(volumename);
+    }
     return unmountok; // unmount did not work, or not selected 
 }
 
 
 
 
-int frmMain::mountSelectedFolder(wxString& pw)
+// one line per open file, grouped per process
+static wxString formatOpenFiles(const std::vector<OpenFileHolder>& holders)
+{
+    static const size_t maxlines = 10;
+    wxArrayString lines;
+    for (size_t i = 0; i < holders.size() && i < maxlines; i++)
+    {
+        const OpenFileHolder& holder = holders.at(i);
+        wxString line;
+        line.Printf(wxT("- %s (pid %ld), %s: %s"), holder.m_name, holder.m_pid, holder.m_kind, holder.m_path);
+        lines.Add(line);
+    }
+    return formatLimitedList(lines, holders.size());
+}
+
+
+// processes still use the volume: show them, then wait for them to let go or force the unmount
+bool frmMain::UnmountBusyVolumeAsk(const wxString& volumename, std::vector<OpenFileHolder> holders)
+{
+    wxString mountvol = m_VolumeData[volumename]->getMountPath();
+    wxString volname = volumename;
+    while (true)
+    {
+        if (holders.empty())
+        {
+            if (unmountVolume(volname))
+            {
+                return true;
+            }
+            // busy again, or for a reason the scan can't see
+            holders = findOpenFiles(mountvol);
+            if (holders.empty())
+            {
+                return false;
+            }
+        }
+
+        wxString msg;
+        msg.Printf(wxT("'%s' is still in use:\n\n"), volumename);
+        msg << formatOpenFiles(holders);
+        msg << "\nWait until these files are closed, or force the unmount?\n\nForcing detaches the volume right away, the programs above get an error the next time they use these files.";
+        wxString title;
+        title.Printf(wxT("Unmount '%s' ?"), volumename);
+        wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                    msg, 
+                                                    title, 
+                                                    wxYES_NO|wxCANCEL|wxCENTRE|wxCANCEL_DEFAULT|wxICON_WARNING);
+        dlg->SetYesNoCancelLabels("Wait", "Force unmount", "Cancel");
+        int answer = dlg->ShowModal();
+        dlg->Destroy();
+        if (answer == wxID_NO)
+        {
+            // the list follows once it is detached
+            DetachVolume(volumename);
+            return false;
+        }
+        if (answer != wxID_YES)
+        {
+            return false;
+        }
+
+        // rescanning takes a few ms, so just poll
+        wxProgressDialog * progress = new wxProgressDialog(title,
+                                                           "Waiting for the open files to be closed...",
+                                                           100,
+                                                           this,
+                                                           wxPD_APP_MODAL|wxPD_AUTO_HIDE|wxPD_CAN_ABORT|wxPD_ELAPSED_TIME);
+        bool cancelled = false;
+        wxStopWatch sw;
+        while (!holders.empty() && !cancelled)
+        {
+            wxString status;
+            status.Printf(wxT("Waiting for %s (pid %ld) to close '%s'..."), holders.at(0).m_name, holders.at(0).m_pid, holders.at(0).m_path);
+            cancelled = !progress->Pulse(status);
+            wxMilliSleep(100);
+            if (sw.Time() >= 1000)
+            {
+                holders = findOpenFiles(mountvol);
+                sw.Start();
+            }
+        }
+        progress->Destroy();
+        if (cancelled)
+        {
+            return false;
+        }
+    }
+}
+
+
+// ask for the password, then mount the volume on a worker thread
+// the result comes back in OnVolumeMounted
+void frmMain::MountVolume(const wxString& volumename, const wxString& extratxt, int nrtries)
 {
-    wxString buf;   
+    std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+    if (it == m_VolumeData.end())
+    {
+        return;
+    }
+    DBEntry * thisvol = it->second;
+    wxString title;
+    title.Printf(wxT("Enter password for '%s'"), volumename);
+    wxString msg;
+    msg.Printf(wxT("%sPlease enter password to mount\n'%s'\nas\n'%s'"), extratxt, thisvol->getEncPath(), thisvol->getMountPath());
+    wxString pw;
+    // the saved password didn't work, trying it again won't help
+    if (thisvol->getPwSavedState() && nrtries == 0)
+    {
+        wxString keychainname = volumename;
+        pw = getKeychainPassword(keychainname);
+    }
+    else
+    {
+        pw = getPassWord(title, msg);
+    }
+    // no password = bail out
+    if (pw.IsEmpty())
+    {
+        return;
+    }
+    std::shared_ptr<MountEvictions> evictions;
+    size_t nrevict;
+    if (!MakeRoomForMount(volumename, 0, evictions, nrevict))
+    {
+        pw = "GoodLuckWithThat";
+        return;
+    }
+
     // update statustext
+    SetStatusText(wxString::Format(wxT("Mounting '%s'..."), volumename), 0);
+    wxString listname = volumename;
+    int index = GetListCtrlIndex(listname);
+    if (index > -1)
+    {
+        m_listCtrl->SetItem(index, 0, ".....");
+    }
+
+    std::vector<MountWorkItem*> items;
+    MountWorkItem * item = new MountWorkItem(thisvol, volumename, pw);
+    item->m_evictions = evictions;
+    item->m_nrevict = nrevict;
+    items.push_back(item);
+    // to do : instead of setting pw to a new value, clear out memory location directly
+    pw = "GoodLuckWithThat";
+    StartMountBatch(items, [this, nrtries](const std::vector<MountResult>& results)
+    {
+        OnVolumeMounted(results.at(0), nrtries + 1);
+    });
+}
+
+
+// main thread, a mount started by MountVolume is done
+void frmMain::OnVolumeMounted(const MountResult& result, int nrtries)
+{
+    wxString volumename = result.m_volname;
+    int mountstatus = result.m_status;
+    bool exists = (m_VolumeData.find(volumename) != m_VolumeData.end());
+    if (exists && mountstatus == ID_MNT_OK)
+    {
+        mountstatus = finishMount(volumename, result.m_pid);
+    }
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+    UpdateVolumeCountStatus();
+    if (!exists)
+    {
+        // removed while mounting
+        return;
+    }
+
+    DBEntry * thisvol = m_VolumeData[volumename];
+    if (mountstatus == ID_MNT_PWDFAIL)
+    {
+        if (nrtries < MANUAL_MOUNT_MAX_TRIES)
+        {
+            MountVolume(volumename, "** You have entered an invalid password **\n\n", nrtries);
+        }
+    }
+    else if (mountstatus == ID_MNT_OTHER)
+    {
+        wxString errormsg;
+        wxString errortitle;
+        errormsg.Printf(wxT("Unable to mount volume '%s'\nEncfs folder: %s\nMount path: %s"), volumename, thisvol->getEncPath(), thisvol->getMountPath());
+        errortitle.Printf(wxT("Error found while mounting '%s'"), volumename);
+        wxMessageDialog * dlg = new wxMessageDialog(this, errormsg, errortitle, wxOK|wxCENTRE|wxICON_ERROR);
+        dlg->ShowModal();
+        dlg->Destroy();
+    }
+}
+
+
+// volumes that couldn't be mounted because the encrypted folder isn't there (yet)
+// get mounted as soon as it shows up
+static void armMissingVolumes(const wxArrayString& volumes)
+{
+    wxArrayString missing;
+    for (size_t i = 0; i < volumes.GetCount(); i++)
+    {
+        // may have been removed while mounting the others
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumes[i]);
+        if (it != m_VolumeData.end() && !it->second->getMountState() && !it->second->getHealthState())
+        {
+            missing.Add(volumes[i]);
+        }
+    }
+    armDeferredMounts(missing);
+}
+
+
+void frmMain::AutoMountVolumes(std::function<void()> then)
+{
+    wxArrayString volumes;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (it->second->getAutoMount())
+        {
+            volumes.Add(it->first);
+        }
+    }
+    MountVolumesInOrder(volumes, AUTOMOUNT_MAX_TRIES, [volumes, then]()
+    {
+        armMissingVolumes(volumes);
+        if (then)
+        {
+            then();
+        }
+    });
+}
+
+
+void frmMain::RestoreSession(std::function<void()> then)
+{
+    // volumes can be removed or renamed since
+    wxArrayString volumes;
+    for (size_t i = 0; i < m_lastsession.GetCount(); i++)
+    {
+        if (m_VolumeData.find(m_lastsession[i]) != m_VolumeData.end())
+        {
+            volumes.Add(m_lastsession[i]);
+        }
+    }
+    m_lastsession.Clear();
+    MountVolumesInOrder(volumes, RESTORE_MAX_TRIES, [volumes, then]()
+    {
+        armMissingVolumes(volumes);
+        if (then)
+        {
+            then();
+        }
+    });
+}
+
+
+// the encrypted folder of an armed volume came or went
+void frmMain::CheckArmedVolumes()
+{
+    ValidateVolumes([this]()
+    {
+        MountArmedVolumes();
+    });
+}
+
+
+// the armed volumes were just validated
+void frmMain::MountArmedVolumes()
+{
+    wxArrayString armed = getArmedVolumes();
+    wxArrayString arrived;
+    bool unmountedsome = false;
+    for (size_t i = 0; i < armed.GetCount(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(armed[i]);
+        if (it == m_VolumeData.end())
+        {
+            continue;
+        }
+        wxString volumename = it->first;
+        DBEntry * thisvol = it->second;
+        if (thisvol->getMountState() && !thisvol->getHealthState())
+        {
+            // the disk is gone, don't leave a dead mount behind
+            // the volume stays armed, so it comes back with the disk
+            unmountVolume(volumename);
+            unmountedsome = true;
+        }
+        else if (!thisvol->getMountState() && thisvol->getHealthState())
+        {
+            arrived.Add(volumename);
+        }
+    }
+    if (!arrived.IsEmpty())
+    {
+        MountVolumesInOrder(arrived, AUTOMOUNT_MAX_TRIES, [this]()
+        {
+            ValidateVolumes();
+        });
+    }
+    else if (unmountedsome)
+    {
+        ValidateVolumes();
+    }
+}
+
+
+// progress of MountVolumesInOrder, handed from one level and round to the next
+class MountOrderRun
+{
+public:
+    std::vector<wxArrayString> m_levels;
+    wxArrayString m_cycle;
+    wxArrayString m_selected;
+    int m_maxtries;
+    std::function<void()> m_then;
+    size_t m_level;
+    // state of the current level
+    bool m_mountedsome;
+    std::map<wxString, wxString> m_extratxt;
+    std::map<wxString, int> m_nrtries;
+};
+
+
+// mount a set of volumes, nested volumes after the volume they live in
+// maxtries = nr of attempts per volume, then runs when all of them are done
+void frmMain::MountVolumesInOrder(const wxArrayString& selected, int maxtries, std::function<void()> then)
+{
+    // volumes can live inside other volumes, mount them level by level
+    // all volumes of one level get mounted at the same time
+    std::shared_ptr<MountOrderRun> run(new MountOrderRun());
+    run->m_levels = getMountLevels(getLoadedVolumeRecords(), run->m_cycle);
+    run->m_selected = selected;
+    run->m_maxtries = maxtries;
+    run->m_then = then;
+    run->m_level = 0;
+    MountVolumeLevel(run);
+}
+
+
+// mount the selected volumes of the current level, then move on to the next one
+void frmMain::MountVolumeLevel(std::shared_ptr<MountOrderRun> run)
+{
+    if (run->m_level < run->m_levels.size())
+    {
+        const wxArrayString& level = run->m_levels.at(run->m_level);
+        wxArrayString volumes;
+        for (size_t i = 0; i < level.GetCount(); i++)
+        {
+            wxString volumename = level[i];
+            // the levels can be older than the volume list, when waiting for a validation
+            std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+            if (it == m_VolumeData.end())
+            {
+                continue;
+            }
+            DBEntry * thisvol = it->second;
+            // don't ask for a password if the folders aren't there
+            if ((run->m_selected.Index(volumename) != wxNOT_FOUND) && (not thisvol->getMountState()) && (thisvol->getHealthState()) &&
+                m_mountingvolumes.Index(volumename) == wxNOT_FOUND)
+            {
+                volumes.Add(volumename);
+            }
+        }
+        run->m_mountedsome = false;
+        run->m_extratxt.clear();
+        run->m_nrtries.clear();
+        MountVolumeRound(run, volumes);
+        return;
+    }
+
+    // volumes that live inside each other can't be mounted automatically
+    wxString cyclevolumes;
+    for (size_t i = 0; i < run->m_cycle.GetCount(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(run->m_cycle[i]);
+        if (it == m_VolumeData.end())
+        {
+            continue;
+        }
+        if ((run->m_selected.Index(run->m_cycle[i]) != wxNOT_FOUND) && (not it->second->getMountState()))
+        {
+            cyclevolumes << "- " << run->m_cycle[i] << "\n";
+        }
+    }
+    if (!cyclevolumes.IsEmpty())
+    {
+        wxString errormsg;
+        errormsg << "The following volumes live inside each other, so they were not mounted automatically:\n\n" << cyclevolumes;
+        wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                    errormsg, 
+                                                    "Unable to auto-mount", 
+                                                    wxOK|wxCENTRE|wxICON_WARNING);
+        dlg->ShowModal();
+        dlg->Destroy();
+    }
+    if (run->m_then)
+    {
+        run->m_then();
+    }
+}
+
+
+// ask for the passwords of one round, and mount the volumes in the background
+// volumes with a wrong password get another round, until they run out of tries
+void frmMain::MountVolumeRound(std::shared_ptr<MountOrderRun> run, const wxArrayString& volumes)
+{
+    // ask for the passwords first, the dialogs need the main thread
+    std::vector<MountWorkItem*> items;
+    std::shared_ptr<MountEvictions> evictions;
+    for (size_t i = 0; i < volumes.GetCount(); i++)
+    {
+        wxString volumename = volumes[i];
+        // removed while a dialog was open
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+        if (it == m_VolumeData.end())
+        {
+            continue;
+        }
+        DBEntry * thisvol = it->second;
+        wxString title;
+        title.Printf(wxT("Automount '%s'"), volumename);
+        wxString msg;
+        msg.Printf(wxT("%sPlease enter password to auto-mount\n'%s'\nas\n'%s'"), run->m_extratxt[volumename], thisvol->getEncPath(), thisvol->getMountPath());
+        wxString pw;
+        // the saved password didn't work, trying it again won't help
+        if (thisvol->getPwSavedState() && run->m_nrtries[volumename] == 0)
+        {
+            pw = getKeychainPassword(volumename);
+        }
+        else
+        {
+            pw = getPassWord(title, msg);
+        }
+        // no password = bail out
+        // the volumes that are being mounted count as well
+        size_t nrevict;
+        if (!pw.IsEmpty() && MakeRoomForMount(volumename, items.size(), evictions, nrevict))
+        {
+            MountWorkItem * item = new MountWorkItem(thisvol, volumename, pw);
+            item->m_evictions = evictions;
+            item->m_nrevict = nrevict;
+            items.push_back(item);
+            run->m_nrtries[volumename]++;
+        }
+        // to do : instead of setting pw to a new value, clear out memory location directly 
+        pw = "GoodLuckWithThat";
+    }
+
+    if (!items.empty())
+    {
+        StartMountBatch(items, [this, run](const std::vector<MountResult>& results)
+        {
+            OnVolumeRoundMounted(run, results);
+        });
+        return;
+    }
+
+    // nested volumes only show up as healthy once their parent is mounted
+    run->m_level++;
+    if (run->m_mountedsome && run->m_level < run->m_levels.size())
+    {
+        ValidateVolumes([this, run]()
+        {
+            MountVolumeLevel(run);
+        });
+    }
+    else
+    {
+        MountVolumeLevel(run);
+    }
+}
+
+
+// main thread, all mounts of a round are done
+void frmMain::OnVolumeRoundMounted(std::shared_ptr<MountOrderRun> run, const std::vector<MountResult>& results)
+{
+    wxArrayString retry;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        wxString volumename = results.at(i).m_volname;
+        int mountstatus = results.at(i).m_status;
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+        if (it == m_VolumeData.end())
+        {
+            // removed while mounting
+            continue;
+        }
+        if (mountstatus == ID_MNT_OK)
+        {
+            mountstatus = finishMount(volumename, results.at(i).m_pid);
+        }
+
+        if (mountstatus == ID_MNT_PWDFAIL)
+        {
+            run->m_extratxt[volumename].Printf(wxT("** You have entered an invalid password **\n\n"));
+            if (run->m_nrtries[volumename] < run->m_maxtries)
+            {
+                retry.Add(volumename);
+            }
+        }
+        else if (mountstatus == ID_MNT_OK)
+        {
+            run->m_mountedsome = true;
+        }
+        else if (mountstatus == ID_MNT_OTHER)
+        {
+            // show message, don't try again
+            wxString errormsg;
+            wxString errortitle;
+            errormsg.Printf(wxT("Unable to mount volume '%s'\nEncfs folder: %s\nMount path: %s"), volumename, it->second->getEncPath(), it->second->getMountPath());
+            errortitle.Printf(wxT("Error found while mounting '%s'"), volumename);
+            wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                        errormsg, 
+                                                        errortitle, 
+                                                        wxOK|wxCENTRE|wxICON_ERROR);
+            dlg->ShowModal();
+            dlg->Destroy();
+        }
+    }
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+    MountVolumeRound(run, retry);
+}
+
+// encfs already unmounted them, only the state needs to follow
+void frmMain::OnVolumesIdleUnmounted(const wxArrayString& volumes)
+{
+    for (size_t i = 0; i < volumes.GetCount(); i++)
+    {
+        DBEntry * thisvol = m_VolumeData[volumes[i]];
+        thisvol->setMountState(false);
+        if (thisvol->getMountedByApp())
+        {
+            journalMountStopped(volumes[i]);
+        }
+        thisvol->setMountOwner(0, 0);
+        // don't let a disk event mount it right away again
+        disarmDeferredMount(volumes[i]);
+    }
+    publishVolumes();
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+}
+
+
+// detach a volume that is busy or stopped responding (umount -l / fusermount -uz)
+// the kernel drops it right away, encfs goes once nothing uses it anymore
+// umount runs on a worker, it can block on a hung mount just like anything else
+void frmMain::DetachVolume(const wxString& volumename)
+{
+    std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+    if (it == m_VolumeData.end() || !it->second->getMountState())
+    {
+        return;
+    }
+    if (m_detachingvolumes.Index(volumename) != wxNOT_FOUND)
+    {
+        return;
+    }
+    m_detachingvolumes.Add(volumename);
+    wxString mount_path = it->second->getMountPath();
     wxString msg;
-    msg.Printf(wxT("Mounting '%s'"), g_selectedVolume);
-    PushStatusText(msg,0);
+    msg.Printf(wxT("Detaching '%s'"), volumename);
+    PushStatusText(msg, 0);
+
+    detachDeadMount(mount_path, [this, volumename, mount_path](bool detached)
+    {
+        m_detachingvolumes.Remove(volumename);
+        PopStatusText(0);
+        // removed or unmounted in the meantime
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+        if (it == m_VolumeData.end() || !it->second->getMountState())
+        {
+            return;
+        }
+        if (!detached)
+        {
+            wxString msg;
+            msg.Printf(wxT("Unable to detach '%s'.\n\nIt is still mounted at '%s'."), volumename, mount_path);
+            wxMessageDialog * dlg = new wxMessageDialog(this, msg, "Unmount failed", wxOK|wxCENTRE|wxICON_ERROR);
+            dlg->ShowModal();
+            dlg->Destroy();
+            return;
+        }
+        wxArrayString detachedvolumes;
+        detachedvolumes.Add(volumename);
+        OnVolumesIdleUnmounted(detachedvolumes);
+    });
+}
 
-    buf.Printf(wxT("%s"), ".....");
-    m_listCtrl->SetItem(g_selectedIndex, 0, buf);
 
-    int mountstatus = mountFolder(g_selectedVolume, pw);
+// false if the volume stopped responding, after offering to detach it
+// keeps the ui thread away from mount points that would block it
+bool frmMain::CheckVolumeResponding(const wxString& volumename)
+{
+    if (!isVolumeHung(volumename))
+    {
+        return true;
+    }
+    wxString msg;
+    msg.Printf(wxT("'%s' is not responding.\n\nThe folder it is stored in may be on a network share or disk that is no longer reachable.\n\nDetach it now? Files that are still open in it will fail."), volumename);
+    wxString title;
+    title.Printf(wxT("'%s' is not responding"), volumename);
+    wxMessageDialog * dlg = new wxMessageDialog(this, msg, title, wxYES_NO|wxCENTRE|wxNO_DEFAULT|wxICON_WARNING);
+    if (dlg->ShowModal() == wxID_YES)
+    {
+        DetachVolume(volumename);
+    }
+    dlg->Destroy();
+    return false;
+}
 
+
+// same as picking 'Mount' from the tray menu
+void frmMain::RemountVolume(const wxString& volumename)
+{
+    std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+    if (it == m_VolumeData.end() || it->second->getMountState())
+    {
+        return;
+    }
+    wxString prevselectedvol = g_selectedVolume;
+    int prevselectedindex = g_selectedIndex;
+    g_selectedVolume = volumename;
+    g_selectedIndex = GetListCtrlIndex(g_selectedVolume);
+    wxCommandEvent event;
+    OnMount(event);
+    g_selectedVolume = prevselectedvol;
+    g_selectedIndex = prevselectedindex;
+}
+
+
+// mount a volume on a worker thread, for lazy mounts and remounts after a crash
+// the password comes from the keychain, so nothing gets asked
+// returns false if the mount could not be started
+bool frmMain::StartBackgroundMount(const wxString& volumename)
+{
+    std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+    if (it == m_VolumeData.end() || it->second->getMountState() || !it->second->getPwSavedState() ||
+        m_mountingvolumes.Index(volumename) != wxNOT_FOUND)
+    {
+        return false;
+    }
+    std::shared_ptr<MountEvictions> evictions;
+    size_t nrevict;
+    if (!MakeRoomForMount(volumename, 0, evictions, nrevict))
+    {
+        return false;
+    }
+    wxString keychainname = volumename;
+    wxString pw = getKeychainPassword(keychainname);
+    if (pw.IsEmpty())
+    {
+        return false;
+    }
+    MountWorkItem * item = new MountWorkItem(it->second, volumename, pw);
+    item->m_evictions = evictions;
+    item->m_nrevict = nrevict;
+    BackgroundMountThread * thread = new BackgroundMountThread(item, 0);
+    pw = "GoodLuckWithThat";
+    if (thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        return false;
+    }
+    m_mountingvolumes.Add(volumename);
+    SetStatusText(wxString::Format(wxT("Mounting '%s'..."), volumename), 0);
+    return true;
+}
+
+
+// the threads own the items, items is empty afterwards
+// nothing gets joined, each thread reports back through CallAfter
+void frmMain::StartMountBatch(std::vector<MountWorkItem*>& items, std::function<void(const std::vector<MountResult>&)> done)
+{
+    long batchid = ++m_lastmountbatch;
+    MountBatch * batch = new MountBatch();
+    batch->m_nrpending = items.size();
+    batch->m_done = done;
+    m_mountbatches[batchid] = batch;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        wxString volumename = items.at(i)->m_volumename;
+        m_mountingvolumes.Add(volumename);
+        BackgroundMountThread * thread = new BackgroundMountThread(items.at(i), batchid);
+        if (thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            // also deletes the item
+            delete thread;
+            // reported through the event loop, like the others
+            MountResult result;
+            result.m_volname = volumename;
+            result.m_status = ID_MNT_OTHER;
+            result.m_pid = -1;
+            result.m_batch = batchid;
+            CallAfter(&frmMain::OnBackgroundMountDone, result);
+        }
+    }
+    items.clear();
+}
+
+
+void frmMain::OnBackgroundMountDone(MountResult result)
+{
+    wxString volumename = result.m_volname;
+    int mountstatus = result.m_status;
+    if (m_mountingvolumes.Index(volumename) != wxNOT_FOUND)
+    {
+        m_mountingvolumes.Remove(volumename);
+    }
+    // unmounted to make room, the handlers below update the list
+    for (size_t i = 0; i < result.m_evicted.GetCount(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(result.m_evicted[i]);
+        if (it != m_VolumeData.end() && it->second->getMountState())
+        {
+            setVolumeUnmounted(it->first);
+        }
+    }
+    if (mountstatus == ID_MNT_NOROOM)
+    {
+        // some of the volumes refused to unmount after all
+        ShowNoRoomForMount(volumename);
+    }
+    if (result.m_batch != 0)
+    {
+        std::map<long, MountBatch*>::iterator it = m_mountbatches.find(result.m_batch);
+        if (it == m_mountbatches.end())
+        {
+            return;
+        }
+        MountBatch * batch = it->second;
+        batch->m_results.push_back(result);
+        if (batch->m_results.size() < batch->m_nrpending)
+        {
+            return;
+        }
+        m_mountbatches.erase(it);
+        batch->m_done(batch->m_results);
+        delete batch;
+        return;
+    }
+    bool lazy = isLazyMountPending(volumename);
+    if (m_VolumeData.find(volumename) == m_VolumeData.end())
+    {
+        // removed while mounting
+        if (lazy)
+        {
+            finishLazyMount(volumename, false);
+        }
+        finishCrashRemount(volumename, false);
+        return;
+    }
     if (mountstatus == ID_MNT_OK)
     {
-        buf.Printf(wxT("%s"), "YES");
-        wxColour itemColour = wxColour(*wxRED);
-        m_listCtrl->SetItemTextColour(g_selectedIndex, itemColour);
-        m_listCtrl->SetItem(g_selectedIndex, 0, buf);
-        SetToolBarButtonState(ID_Toolbar_Mount, false);
-        SetToolBarButtonState(ID_Toolbar_Unmount, true);
-        SetToolBarButtonState(ID_Toolbar_Browse, true);
-        SetToolBarButtonState(ID_Toolbar_Edit, true);   // limited edits allowed
+        mountstatus = finishMount(volumename, result.m_pid);
+    }
+    if (lazy)
+    {
+        finishLazyMount(volumename, mountstatus == ID_MNT_OK);
+    }
+    // failed remounts get retried later on
+    bool remount = finishCrashRemount(volumename, mountstatus == ID_MNT_OK);
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+    UpdateVolumeCountStatus();
+    if (mountstatus == ID_MNT_OK || mountstatus == ID_MNT_NOROOM || remount)
+    {
+        return;
+    }
+
+    wxString errormsg;
+    if (mountstatus == ID_MNT_PWDFAIL)
+    {
+        errormsg.Printf(wxT("Unable to mount '%s' on access.\n\nThe saved password is not correct."), volumename);
     }
     else
     {
-        buf.Printf(wxT("%s"), "NO");
-        wxColour itemColour = wxColour(*wxBLUE);
-        m_listCtrl->SetItemTextColour(g_selectedIndex, itemColour);
-        m_listCtrl->SetItem(g_selectedIndex, 0, buf);
-        SetToolBarButtonState(ID_Toolbar_Unmount, false);
-        SetToolBarButtonState(ID_Toolbar_Mount, true);
-        SetToolBarButtonState(ID_Toolbar_Browse, false);
-        SetToolBarButtonState(ID_Toolbar_Edit, true);
+        errormsg.Printf(wxT("Unable to mount '%s' on access.\nEncfs folder: %s\nMount path: %s"), volumename, m_VolumeData[volumename]->getEncPath(), m_VolumeData[volumename]->getMountPath());
+    }
+    wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                errormsg, 
+                                                "Unable to mount on access", 
+                                                wxOK|wxCENTRE|wxICON_WARNING);
+    dlg->ShowModal();
+    dlg->Destroy();
+}
+
+
+// encfs went away: unmounted (idle timeout, or by hand outside the app) or crashed
+void frmMain::OnMountProcessExited(MountProcessExit exitinfo)
+{
+    long uptime = 0;
+    if (!endMountSupervision(exitinfo, uptime))
+    {
+        return;
+    }
+    std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(exitinfo.m_volname);
+    if (it == m_VolumeData.end() || !it->second->getMountState())
+    {
+        // we unmounted it ourselves
+        return;
+    }
+    wxString volumename = it->first;
+    DBEntry * thisvol = it->second;
+    bool crashed = !(WIFEXITED(exitinfo.m_status) && WEXITSTATUS(exitinfo.m_status) == 0);
+    if (!crashed)
+    {
+        wxArrayString volumes;
+        volumes.Add(volumename);
+        OnVolumesIdleUnmounted(volumes);
+        if (thisvol->getIdleTimeout() > 0)
+        {
+            showIdleUnmountNotification(volumename, thisvol->getIdleTimeout());
+        }
+        return;
+    }
+
+    // a dead encfs leaves a mount behind that only returns errors
+    wxArrayString mount_output = getSystemMountTable();
+    if (IsVolumeSystemMounted(thisvol->getMountPath(), mount_output))
+    {
+        // nobody waits for the result, the reaper catches it if this fails
+        detachDeadMount(thisvol->getMountPath(), std::function<void(bool)>());
+    }
+    thisvol->setMountState(false);
+    if (thisvol->getMountedByApp())
+    {
+        journalMountStopped(volumename);
+    }
+    thisvol->setMountOwner(0, 0);
+    publishVolumes();
+    m_listCtrl->UpdateToolBarButtons();
+    SyncList();
+    UpdateTrayBadge();
+    UpdateVolumeCountStatus();
+
+    if (thisvol->getPwSavedState())
+    {
+        scheduleCrashRemount(volumename, uptime);
+    }
+    else
+    {
+        wxString errormsg;
+        errormsg.Printf(wxT("encfs stopped unexpectedly for '%s'.\nPlease mount it again."), volumename);
+        wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                    errormsg, 
+                                                    "Volume stopped", 
+                                                    wxOK|wxCENTRE|wxICON_WARNING);
+        dlg->ShowModal();
+        dlg->Destroy();
+    }
+}
+
+
+// true if there is room to mount one more volume, next to the pending ones
+// nrevict is the nr of least recently used volumes the mount has to unmount first,
+// the unmounts run on the mount thread, taking volumes from evictions
+// evictions is shared by the mounts of one batch, and gets created when needed
+bool frmMain::MakeRoomForMount(const wxString& volumename, size_t pending, std::shared_ptr<MountEvictions>& evictions, size_t& nrevict)
+{
+    nrevict = 0;
+    long maxmounted = getAppSettings()->getMaxMounted();
+    if (maxmounted <= 0)
+    {
+        return true;
+    }
+    size_t nrmounted = 0;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (it->second->getMountState() && it->first != volumename)
+        {
+            nrmounted++;
+        }
     }
-    PopStatusText(0);
-    return mountstatus;
-}
-
+    // the unmounts planned for the other mounts of the batch count as done
+    long nrplanned = evictions ? (long)evictions->m_nrplanned : 0;
+    long needed = (long)nrmounted - nrplanned + (long)pending + 1 - maxmounted;
+    if (needed <= 0)
+    {
+        return true;
+    }
+    nrevict = (size_t)needed;
 
-void frmMain::AutoMountVolumes()
-{
-    // iterate over volumes
-    for (std::map<wxString, DBEntry*>::iterator it= m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    if (!evictions)
     {
-        wxString volumename = it->first;
-        DBEntry * thisvol = it->second;
-        wxString mountvol = thisvol->getMountPath();
-        wxString encvol = thisvol->getEncPath();
-        wxString title;
-        title.Printf(wxT("Automount '%s'"), volumename);
-        if ((not thisvol->getMountState()) && (thisvol->getAutoMount()) )
+        // least recently used first, skip the ones we are not allowed or able to unmount
+        evictions.reset(new MountEvictions());
+        wxArrayString candidates = getMountedVolumesByLastUse();
+        for (size_t i = 0; i < candidates.GetCount(); i++)
         {
-            bool trymount = true;
-            int nrtries = 0;
-            wxString extratxt = "";
-            while (trymount && nrtries < 5)
+            std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(candidates[i]);
+            if (it == m_VolumeData.end() || it->first == volumename || !it->second->getMountState() ||
+                it->second->getPreventAutoUnmount() || hasMountedVolumesInside(it->first) ||
+                m_detachingvolumes.Index(it->first) != wxNOT_FOUND)
             {
-                wxString msg;
-                msg.Printf(wxT("%sPlease enter password to auto-mount\n'%s'\nas\n'%s'"), extratxt, encvol, mountvol);
-                wxString pw;
-                if (thisvol->getPwSavedState())
-                {
-                    pw = getKeychainPassword(volumename);
-                }
-                else
-                {
-                    pw = getPassWord(title, msg);
-                }
-                 
-                
-                if (!pw.IsEmpty())
-                {
-                     // try mount
-                    int mountstatus = mountFolder(volumename, pw);
-                    // to do : instead of setting pw to a new value, clear out memory location directly 
-                    pw = "GoodLuckWithThat";
-
-                    if (mountstatus == ID_MNT_PWDFAIL)
-                    {
-                        extratxt.Printf(wxT("** You have entered an invalid password **\n\n"));
-                    }
-                    else if (mountstatus == ID_MNT_OK)
-                    {
-                        trymount = false;
-                    }
-                    else if (mountstatus == ID_MNT_OTHER)
-                    {
-                        // show message and then break
-                        wxString errormsg;
-                        wxString errortitle;
-                        errormsg.Printf(wxT("Unable to mount volume '%s'\nEncfs folder: %s\nMount path: %s"), volumename, encvol, mountvol);
-                        errortitle.Printf(wxT("Error found while mounting '%s'"), volumename);
-                        wxMessageDialog * dlg = new wxMessageDialog(this, 
-                                                                    errormsg, 
-                                                                    errortitle, 
-                                                                    wxOK|wxCENTRE|wxICON_ERROR);
-                        dlg->ShowModal();
-                        dlg->Destroy();
-                        trymount = false;
-                    }   
-                }
-                else
-                {
-                    // bail out
-                    trymount = false;
-                }
-                nrtries++;
-            }            
+                continue;
+            }
+            evictions->m_candidates.push_back(std::make_pair(it->first, it->second->getMountPath()));
+        }
+    }
+    // the volume we want to mount lives inside these
+    wxString mountkey = m_VolumeData[volumename]->getMountPath() + "/";
+    wxString enckey = m_VolumeData[volumename]->getEncPath() + "/";
+    std::deque<std::pair<wxString, wxString> >::iterator it = evictions->m_candidates.begin();
+    while (it != evictions->m_candidates.end())
+    {
+        wxString candidatekey = it->second + "/";
+        if (mountkey.StartsWith(candidatekey) || enckey.StartsWith(candidatekey))
+        {
+            it = evictions->m_candidates.erase(it);
+            continue;
         }
+        it++;
+    }
+
+    if (evictions->m_nrplanned + nrevict > evictions->m_candidates.size())
+    {
+        nrevict = 0;
+        ShowNoRoomForMount(volumename);
+        return false;
     }
-    // mount when needed
+    evictions->m_nrplanned += nrevict;
+    return true;
+}
+
+
+void frmMain::ShowNoRoomForMount(const wxString& volumename)
+{
+    wxString errormsg;
+    errormsg.Printf(wxT("Unable to mount '%s'.\n\nThe maximum of %ld mounted volumes has been reached, and none of the mounted volumes can be unmounted right now."), volumename, getAppSettings()->getMaxMounted());
+    wxMessageDialog * dlg = new wxMessageDialog(this, 
+                                                errormsg, 
+                                                "Too many mounted volumes", 
+                                                wxOK|wxCENTRE|wxICON_WARNING);
+    dlg->ShowModal();
+    dlg->Destroy();
 }
 
+
 void frmMain::OnForceUnMountAll(wxCommandEvent& WXUNUSED(event))
 {
     wxString msg;
@@ -1116,9 +2692,7 @@ void frmMain::OnForceUnMountAll(wxCommandEvent& WXUNUSED(event))
     int nrmounted = 0;
     unmountok = false;
 
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    bool skippromptunmount = pConfig->Read(wxT("nopromptonunmount"), 0l);
+    bool skippromptunmount = getAppSettings()->getNoPromptOnUnmount();
 
 
     // count how many volumes are mounted
@@ -1193,13 +2767,39 @@ void frmMain::OnInfo(wxCommandEvent& WXUNUSED(event))
     // get full encfpath for this volume
     DBEntry * thisvol = m_VolumeData[g_selectedVolume];
     wxString encvol = thisvol->getEncPath();
-    wxArrayString volinfo = getEncFSVolumeInfo(encvol);
-    wxString msg = arrStrTowxStr(volinfo);
+    // parsed config, comes from cache unless .encfs6.xml has changed
+    EncFSVolumeConfig volcfg;
+    getEncFSVolumeConfig(encvol, volcfg);
     wxString title;
     title.Printf(wxT("EncFS information for '%s'"), g_selectedVolume);
     wxString msgbody;
-    msgbody.Printf(wxT("Encrypted path: '%s'\n\n"), encvol);
-    msgbody << msg;
+    msgbody.Printf(wxT("Encrypted path: '%s'\n"), encvol);
+    if (thisvol->getMountedByApp())
+    {
+        wxDateTime since((time_t)thisvol->getMountStartTime());
+        wxString mountinfo;
+        mountinfo.Printf(wxT("Mounted by EncFSGui (pid %ld) since %s\n"), thisvol->getMountPID(), since.Format());
+        msgbody << mountinfo;
+    }
+    else if (thisvol->getMountState())
+    {
+        msgbody << "Mounted outside of EncFSGui\n";
+    }
+    msgbody << "\n";
+    msgbody << volcfg.getDescription();
+
+    // key derivation cost, to make slow-to-mount volumes obvious
+    if (volcfg.m_valid)
+    {
+        long unlocktime = getKDFUnlockTime(volcfg.m_kdfiterations, volcfg.m_keysize);
+        wxString kdfinfo;
+        kdfinfo.Printf(wxT("\n\nPredicted unlock time on this machine: ~%ld ms"), unlocktime);
+        msgbody << kdfinfo;
+        if (unlocktime > 1000)
+        {
+            msgbody << "\n** This volume is slow to mount on this machine **";
+        }
+    }
     
     wxMessageDialog * dlg = new wxMessageDialog(this, msgbody, title, wxOK|wxCENTRE|wxICON_INFORMATION);
     dlg->ShowModal();
@@ -1209,63 +2809,12 @@ void frmMain::OnInfo(wxCommandEvent& WXUNUSED(event))
 
 void frmMain::OnMount(wxCommandEvent& WXUNUSED(event))
 {
-    wxString msg;
-    wxString extratxt = "";
-    wxString mountvol;
-    wxString encvol;
-    wxString title;
-    title.Printf(wxT("Enter password for '%s'"), g_selectedVolume);
-    DBEntry * thisvol = m_VolumeData[g_selectedVolume];
-    mountvol = thisvol->getMountPath();
-    encvol = thisvol->getEncPath();
-    bool trymount = true;
-    int nrtries = 0;
-    while (trymount && nrtries < 5)
+    if (isLazyMountPending(g_selectedVolume) || m_mountingvolumes.Index(g_selectedVolume) != wxNOT_FOUND)
     {
-        msg.Printf(wxT("%sPlease enter password to mount\n'%s'\nas\n'%s'"), extratxt, encvol,mountvol);
-        wxString pw;
-        if (thisvol->getPwSavedState())
-        {
-            pw = getKeychainPassword(g_selectedVolume);
-        }
-        else
-        {
-            pw = getPassWord(title, msg);   
-        }
-
-        if (!pw.IsEmpty())
-        {
-            // try mount
-            int successmount = mountSelectedFolder(pw);
-            
-            pw = "GoodLuckWithThat";
-            if (successmount == ID_MNT_PWDFAIL)
-            {
-                extratxt.Printf(wxT("** You have entered an invalid password **\n\n"));
-            }
-            else if (successmount == ID_MNT_OK)
-            {
-                trymount = false;
-            }
-            else if (successmount == ID_MNT_OTHER)
-            {
-                wxString errormsg;
-                wxString errortitle;
-                errormsg.Printf(wxT("Unable to mount volume '%s'\nEncfs folder: %s\nMount path: %s"), g_selectedVolume, thisvol->getEncPath(), thisvol->getMountPath());
-                errortitle.Printf(wxT("Error found while mounting '%s'"), g_selectedVolume);
-                wxMessageDialog * dlg = new wxMessageDialog(this, errormsg, errortitle, wxOK|wxCENTRE|wxICON_ERROR);
-                dlg->ShowModal();
-                dlg->Destroy();
-                trymount = false;
-            }
-        }
-        else
-        {
-            // bail out
-            trymount = false;
-        }
-        nrtries++;
+        // already being mounted in the background
+        return;
     }
+    MountVolume(g_selectedVolume, wxEmptyString, 0);
 }
 
 
@@ -1314,12 +2863,8 @@ void frmMain::OnRemoveFolder(wxCommandEvent& WXUNUSED(event))
                                                 wxYES_NO|wxCENTRE|wxNO_DEFAULT|wxICON_QUESTION);
     if (dlg->ShowModal() == wxID_YES)
     {
-        // simply remove from config file by removing the config group
-        wxConfigBase *pConfig = wxConfigBase::Get();
-        wxString configgroup;
-        configgroup.Printf(wxT("/Volumes/%s"), g_selectedVolume);
-        pConfig->DeleteGroup(configgroup);
-        deleted = true;
+        // simply remove from the volume database
+        deleted = removeVolumeRecord(g_selectedVolume);
     }
     dlg->Destroy();
     if (deleted)
@@ -1329,6 +2874,32 @@ void frmMain::OnRemoveFolder(wxCommandEvent& WXUNUSED(event))
 }
 
 
+void frmMain::OnChangePassword(wxCommandEvent& WXUNUSED(event))
+{
+    changeVolumePasswords(this, g_selectedVolume, m_VolumeData);
+    RefreshAll();
+}
+
+void frmMain::OnDiscoverFolders(wxCommandEvent& WXUNUSED(event))
+{
+    SetVisibleState(true);
+    discoverVolumes(this);
+    RefreshAll();
+}
+
+void frmMain::OnImportFolders(wxCommandEvent& WXUNUSED(event))
+{
+    SetVisibleState(true);
+    importVolumes(this);
+    RefreshAll();
+}
+
+void frmMain::OnExportFolders(wxCommandEvent& WXUNUSED(event))
+{
+    SetVisibleState(true);
+    exportVolumes(this);
+}
+
 void frmMain::OnSettings(wxCommandEvent& WXUNUSED(event))
 {
     if (!m_visible)
@@ -1656,6 +3227,21 @@ void frmMain::FillListWithVolumes()
     columnHeader = "Automount";
     m_listCtrl->AppendColumn(columnHeader);
 
+    columnHeader = "Cipher";
+    m_listCtrl->AppendColumn(columnHeader);
+
+    columnHeader = "Block size";
+    m_listCtrl->AppendColumn(columnHeader);
+
+    columnHeader = "Health";
+    m_listCtrl->AppendColumn(columnHeader);
+
+    columnHeader = "Last used";
+    m_listCtrl->AppendColumn(columnHeader);
+
+    columnHeader = "Response";
+    m_listCtrl->AppendColumn(columnHeader);
+
 
     // change Column width
     // Mounted
@@ -1663,11 +3249,21 @@ void frmMain::FillListWithVolumes()
     // Volume Name
     m_listCtrl->SetColumnWidth(1,120);
     // EncryptedFolder
-    m_listCtrl->SetColumnWidth(2,320);
+    m_listCtrl->SetColumnWidth(2,220);
     // Mounted At
-    m_listCtrl->SetColumnWidth(3,300);
+    m_listCtrl->SetColumnWidth(3,200);
     // Automount
     m_listCtrl->SetColumnWidth(4,70);
+    // Cipher
+    m_listCtrl->SetColumnWidth(5,80);
+    // Block size
+    m_listCtrl->SetColumnWidth(6,70);
+    // Health
+    m_listCtrl->SetColumnWidth(7,150);
+    // Last used
+    m_listCtrl->SetColumnWidth(8,110);
+    // Response
+    m_listCtrl->SetColumnWidth(9,110);
 
 
     
@@ -1676,148 +3272,316 @@ void frmMain::FillListWithVolumes()
 
     for (unsigned int rowindex = 0; rowindex < v_AllVolumes.size(); rowindex++)
     {
-        wxString buf;
         wxString volumename;
 
         volumename = v_AllVolumes.at(rowindex);
         DBEntry * thisvol;
         thisvol = m_VolumeData[volumename];
 
-        bool isMounted;
-        isMounted = thisvol->getMountState();
+        InsertListRow(rowindex, thisvol);
+    }
+
+    m_listCtrl->Show();
+}
 
-        wxColour itemColour;
-        // column[0]
 
-        if (isMounted)
-        {
-            buf.Printf(wxT("%s"), "YES");
-            itemColour = wxColour(*wxRED);
-        }
-        else
-        {  
-            buf.Printf(wxT("%s"), "NO"); 
-            itemColour = wxColour(*wxBLUE);
-        }
+void frmMain::InsertListRow(long rowindex, DBEntry * thisvol)
+{
+    wxFont font = this->GetFont();
+    font.MakeSmaller();
+
+    wxArrayString rowtext = GetListRowText(thisvol);
+
+    long rid = m_listCtrl->InsertItem(rowindex, rowtext[0], 0);
+    m_listCtrl->SetItemData(rid, rowindex);
+    m_listCtrl->SetItemFont(rid, font);
+    m_listCtrl->SetItemTextColour(rid, GetListRowColour(thisvol));
+
+    for (size_t col = 1; col < rowtext.GetCount(); col++)
+    {
+        m_listCtrl->SetItem(rid, col, rowtext[col]);
+    }
+}
+
+
+// text for all columns of a volume in the list
+wxArrayString frmMain::GetListRowText(DBEntry * thisvol)
+{
+    wxArrayString rowtext;
+    wxString buf;
+
+    // column[0]
+    if (thisvol->getMountState())
+    {
+        buf.Printf(wxT("%s"), "YES");
+    }
+    else
+    {
+        buf.Printf(wxT("%s"), "NO");
+    }
+    rowtext.Add(buf);
 
-        long rid = m_listCtrl->InsertItem(rowindex, buf, 0);
-        m_listCtrl->SetItemData(rid, rowindex);
-        m_listCtrl->SetItemFont(rid, font);
-        m_listCtrl->SetItemTextColour(rid, itemColour);
+    // column[1]
+    buf.Printf(wxT("%s"), thisvol->getVolName());
+    rowtext.Add(buf);
 
+    // column[2]
+    buf.Printf(wxT("%s"), thisvol->getEncPath());
+    rowtext.Add(buf);
+
+    // column[3]
+    buf.Printf(wxT("%s"), thisvol->getMountPath());
+    rowtext.Add(buf);
+
+    // column[4]
+    if (thisvol->getAutoMount())
+    {
+        buf.Printf(wxT("YES"));
+    }
+    else
+    {
+        buf.Printf(wxT("NO"));
+    }
+    rowtext.Add(buf);
 
-        // column[1]
-        buf.Printf(wxT("%s"), volumename);
-        m_listCtrl->SetItem(rid, 1, buf);
+    // column[5] & column[6], from the cached .encfs6.xml config
+    // don't parse here, the list gets filled before the configs are loaded at startup
+    EncFSVolumeConfig volcfg;
+    getCachedEncFSVolumeConfig(thisvol->getEncPath(), volcfg);
+    rowtext.Add(volcfg.getCipherDisplayName());
+    if (volcfg.m_valid)
+    {
+        buf.Printf(wxT("%ld"), volcfg.m_blocksize);
+    }
+    else
+    {
+        buf.Printf(wxT("?"));
+    }
+    rowtext.Add(buf);
 
-        // column[2]
-        buf.Printf(wxT("%s"), thisvol->getEncPath());
-        m_listCtrl->SetItem(rid, 2, buf);
+    // column[7]
+    buf.Printf(wxT("%s"), thisvol->getHealthInfo());
+    rowtext.Add(buf);
 
-        // column[3]
-        buf.Printf(wxT("%s"), thisvol->getMountPath());
-        m_listCtrl->SetItem(rid, 3, buf);
+    // column[8]
+    long lastused = getVolumeLastUsed(thisvol->getVolName());
+    if (lastused > 0)
+    {
+        buf = wxDateTime((time_t)lastused).Format(wxT("%Y-%m-%d %H:%M"));
+    }
+    else
+    {
+        buf = "";
+    }
+    rowtext.Add(buf);
 
-        // column[4]
-        if (thisvol->getAutoMount())
+    // column[9], from the last probe of the mounted volume
+    long latency;
+    int probehealth = getVolumeProbeHealth(thisvol->getVolName(), latency);
+    buf = "";
+    if (thisvol->getMountState())
+    {
+        if (probehealth == VOLUME_PROBE_HUNG)
         {
-            buf.Printf(wxT("YES"));
+            buf.Printf(wxT("NOT RESPONDING"));
         }
-        else
+        else if (probehealth == VOLUME_PROBE_DEGRADED)
+        {
+            buf.Printf(wxT("slow (%ld ms)"), latency);
+        }
+        else if (probehealth == VOLUME_PROBE_OK)
         {
-            buf.Printf(wxT("NO"));
+            buf.Printf(wxT("%ld ms"), latency);
         }
-        m_listCtrl->SetItem(rid, 4, buf);
     }
+    rowtext.Add(buf);
 
-    m_listCtrl->Show();
+    return rowtext;
 }
 
 
-void frmMain::RefreshAll()
+wxColour frmMain::GetListRowColour(DBEntry * thisvol)
 {
-    PopulateVolumes();
-    m_listCtrl->UpdateToolBarButtons();
-    RecreateList();
-    RecreateStatusbar();
+    if (thisvol->getMountState())
+    {
+        return wxColour(*wxRED);
+    }
+    return wxColour(*wxBLUE);
 }
 
 
-
-// ----------------------------------------------------------------------------
-// CDBEntry member functions
-// ----------------------------------------------------------------------------
-
-// DBENtry constructor
-DBEntry::DBEntry(wxString volname, 
-                 wxString enc_path, 
-                 wxString mount_path, 
-                 bool automount, 
-                 bool preventautounmount, 
-                 bool pwsaved,
-                 bool allowother,
-                 bool mountaslocal)
+// bring the list in line with the volume data, only touching cells that changed
+// falls back to rebuilding the list when volumes were added, removed or reordered
+void frmMain::SyncList()
 {
-    m_automount = automount;
-    m_volname = volname;
-    m_enc_path = enc_path;
-    m_mount_path = mount_path;
-    m_preventautounmount = preventautounmount;
-    m_pwsaved = pwsaved;
-    m_allowother = allowother;
-    m_mountaslocal = mountaslocal;
-}
+    if (m_listCtrl->GetColumnCount() == 0)
+    {
+        RecreateList();
+        return;
+    }
 
+    // rows are in the same order as v_AllVolumes,
+    // so added & removed volumes can be patched in place
+    std::map<wxString, bool> volumenames;
+    for (unsigned int i = 0; i < v_AllVolumes.size(); i++)
+    {
+        volumenames[v_AllVolumes.at(i)] = true;
+    }
+    for (unsigned int rowindex = 0; rowindex < v_AllVolumes.size(); rowindex++)
+    {
+        wxString volumename = v_AllVolumes.at(rowindex);
+        // drop rows of volumes that are gone
+        while (rowindex < (unsigned int)m_listCtrl->GetItemCount() &&
+               volumenames.find(m_listCtrl->GetItemText(rowindex, 1)) == volumenames.end())
+        {
+            m_listCtrl->DeleteItem(rowindex);
+        }
+        if (rowindex >= (unsigned int)m_listCtrl->GetItemCount() ||
+            m_listCtrl->GetItemText(rowindex, 1) != volumename)
+        {
+            InsertListRow(rowindex, m_VolumeData[volumename]);
+        }
+    }
+    while (m_listCtrl->GetItemCount() > (int)v_AllVolumes.size())
+    {
+        m_listCtrl->DeleteItem(m_listCtrl->GetItemCount() - 1);
+    }
 
-void DBEntry::setMountState(bool newstate)
-{
-    m_mountstate = newstate;
+    for (unsigned int rowindex = 0; rowindex < v_AllVolumes.size(); rowindex++)
+    {
+        DBEntry * thisvol = m_VolumeData[v_AllVolumes.at(rowindex)];
+        wxArrayString rowtext = GetListRowText(thisvol);
+        for (size_t col = 0; col < rowtext.GetCount(); col++)
+        {
+            if (m_listCtrl->GetItemText(rowindex, col) != rowtext[col])
+            {
+                m_listCtrl->SetItem(rowindex, col, rowtext[col]);
+            }
+        }
+        wxColour itemColour = GetListRowColour(thisvol);
+        if (m_listCtrl->GetItemTextColour(rowindex) != itemColour)
+        {
+            m_listCtrl->SetItemTextColour(rowindex, itemColour);
+        }
+    }
 }
 
-bool DBEntry::getMountState()
-{
-    return m_mountstate;
-}
 
-bool DBEntry::getPreventAutoUnmount()
+// apply changes made to the volume definitions by another program
+// only the volumes that changed get reloaded & validated
+// mounted volumes are left alone, their new definition gets picked up by the next refresh
+void frmMain::ApplyVolumeChanges(const VolumeChangeSet& changes)
 {
-    return m_preventautounmount;
-}
+    std::map<wxString, DBEntry*> changedvolumes;
 
-bool DBEntry::getPwSavedState()
-{
-    return m_pwsaved;
-}
+    for (size_t i = 0; i < changes.m_removed.size(); i++)
+    {
+        wxString volumename = changes.m_removed.at(i);
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(volumename);
+        if (it != m_VolumeData.end())
+        {
+            // removing a mounted volume does not unmount it
+            delete it->second;
+            m_VolumeData.erase(it);
+        }
+        std::vector<wxString>::iterator vit = std::find(v_AllVolumes.begin(), v_AllVolumes.end(), volumename);
+        if (vit != v_AllVolumes.end())
+        {
+            v_AllVolumes.erase(vit);
+        }
+    }
 
-wxString DBEntry::getEncPath()
-{
-    return m_enc_path;
-}
+    std::vector<VolumeRecord> records = changes.m_added;
+    records.insert(records.end(), changes.m_modified.begin(), changes.m_modified.end());
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        VolumeRecord& record = records.at(i);
+        if (record.m_enc_path.IsEmpty() || record.m_mount_path.IsEmpty())
+        {
+            continue;
+        }
+        DBEntry * previousvolume = NULL;
+        std::map<wxString, DBEntry*>::iterator it = m_VolumeData.find(record.m_volname);
+        if (it != m_VolumeData.end())
+        {
+            previousvolume = it->second;
+            if (previousvolume->getMountState())
+            {
+                continue;
+            }
+        }
+        DBEntry * thisvolume = new DBEntry(record.m_volname,
+                                           record.m_enc_path,
+                                           record.m_mount_path,
+                                           record.m_automount,
+                                           record.m_preventautounmount,
+                                           record.m_pwsaved,
+                                           record.m_allowother,
+                                           record.m_mountaslocal);
+        thisvolume->setIdleTimeout(record.m_idletimeout);
+        thisvolume->setLazyMount(record.m_lazymount);
+        if (previousvolume)
+        {
+            thisvolume->setMountOwner(previousvolume->getMountPID(), previousvolume->getMountStartTime());
+            thisvolume->setHealth(previousvolume->getHealthState(), previousvolume->getHealthInfo());
+            delete previousvolume;
+        }
+        else
+        {
+            thisvolume->setHealth(true, "Checking...");
+            // keep the same order as the volume database
+            std::vector<wxString>::iterator vit = v_AllVolumes.begin();
+            while (vit != v_AllVolumes.end() && vit->CmpNoCase(record.m_volname) < 0)
+            {
+                ++vit;
+            }
+            v_AllVolumes.insert(vit, record.m_volname);
+        }
+        m_VolumeData[record.m_volname] = thisvolume;
+        changedvolumes[record.m_volname] = thisvolume;
+        // parse the .encfs6.xml of this volume only
+        EncFSVolumeConfig volcfg;
+        getEncFSVolumeConfig(record.m_enc_path, volcfg);
+    }
 
-bool DBEntry::getAutoMount()
-{
-    return m_automount;
-}
+    // the health of the changed volumes follows when the checks are done
+    validateVolumes(changedvolumes, [this](const std::vector<VolumeHealthResult>& results)
+    {
+        ApplyVolumeHealth(results);
+        saveVolumeSnapshot(v_AllVolumes, m_VolumeData);
+    });
+    publishVolumes();
+    m_nrunhealthy = 0;
+    for (std::map<wxString, DBEntry*>::iterator it = m_VolumeData.begin(); it != m_VolumeData.end(); it++)
+    {
+        if (!it->second->getHealthState())
+        {
+            ++m_nrunhealthy;
+        }
+    }
 
-wxString DBEntry::getMountPath()
-{
-    return m_mount_path;
+    SyncList();
+    // the selected row may have moved or gone
+    int selectedindex = GetListCtrlIndex(g_selectedVolume);
+    if (selectedindex != g_selectedIndex)
+    {
+        m_listCtrl->SetSelectedIndex(selectedindex);
+    }
+    m_listCtrl->UpdateToolBarButtons();
+    UpdateVolumeCountStatus();
+    UpdateTrayBadge();
+    saveVolumeSnapshot(v_AllVolumes, m_VolumeData);
 }
 
-wxString DBEntry::getVolName()
-{
-    return m_volname;
-}
 
-bool DBEntry::getAllowOther()
+void frmMain::RefreshAll()
 {
-    return m_allowother;
+    PopulateVolumes();
+    m_listCtrl->UpdateToolBarButtons();
+    RecreateList();
+    UpdateTrayBadge();
 }
 
-bool DBEntry::getMountAsLocal()
-{
-    return m_mountaslocal;
-}
 
 
 // ----------------------------------------------------------------------------
@@ -1899,6 +3663,10 @@ void mainListCtrl::OnPopupMenuClick(wxCommandEvent& event)
     {
         g_frmMain->OnForceUnMountAll(event);
     }    
+    else if (event.GetId() == ID_List_Menu_ChangePassword)
+    {
+        g_frmMain->OnChangePassword(event);
+    }
 }
 
 void mainListCtrl::OnRightClick(wxListEvent& event)
@@ -1928,6 +3696,8 @@ void mainListCtrl::OnRightClick(wxListEvent& event)
         menu->Append(ID_List_Menu_Edit, msg);
         msg.Printf(wxT("Show info about '%s'"), g_selectedVolume);
         menu->Append(ID_List_Menu_Info, msg);
+        msg.Printf(wxT("Change password of '%s'"), g_selectedVolume);
+        menu->Append(ID_List_Menu_ChangePassword, msg);
         menu->AppendSeparator();
     }
 
@@ -1957,6 +3727,39 @@ void mainListCtrl::OnItemDeSelected(wxListEvent& WXUNUSED(event))
     }
 }
 
+// select the volume that owns the dropped file or folder
+void mainListCtrl::OnDropFiles(wxDropFilesEvent& event)
+{
+    if (event.GetNumberOfFiles() < 1)
+    {
+        return;
+    }
+    wxString droppedpath = event.GetFiles()[0];
+    wxString statustxt;
+    VolumePathMatch match;
+    if (findVolumeByPath(droppedpath, match))
+    {
+        for (int i = 0; i < GetItemCount(); ++i)
+        {
+            if (GetItemText(i, 1) == match.m_volname)
+            {
+                SetItemState(i, wxLIST_STATE_SELECTED|wxLIST_STATE_FOCUSED, wxLIST_STATE_SELECTED|wxLIST_STATE_FOCUSED);
+                EnsureVisible(i);
+                break;
+            }
+        }
+        statustxt.Printf(wxT("'%s' is in the %s of volume %s"),
+                         droppedpath,
+                         match.m_ismountpath ? "mount point" : "encrypted folder",
+                         match.m_volname);
+    }
+    else
+    {
+        statustxt.Printf(wxT("'%s' is not part of any volume"), droppedpath);
+    }
+    m_statusBar->SetStatusText(statustxt, 0);
+}
+
 void mainListCtrl::OnItemActivated(wxListEvent& WXUNUSED(event))
 {
     if (g_selectedIndex > -1)
@@ -1967,7 +3770,10 @@ void mainListCtrl::OnItemActivated(wxListEvent& WXUNUSED(event))
         {
             // open
             wxString mountpath = thisvol->getMountPath();
-            BrowseFolder(mountpath);
+            if (g_frmMain->CheckVolumeResponding(g_selectedVolume))
+            {
+                BrowseFolder(mountpath);
+            }
         }
         else
         {
@@ -20,8 +20,27 @@
 
 #include <wx/taskbar.h>
 
+#include <wx/stopwatch.h>
+
 #include <map>
+#include <set>
+#include <vector>
+#include <memory>
+#include <functional>
+
+class wxProgressDialog;
+class wxCheckListBox;
+class wxSpinCtrl;
 
+class MountResult;
+class MountBatch;
+class MountEvictions;
+class MountOrderRun;
+class MountWorkItem;
+class MountProcessExit;
+class OpenFileHolder;
+class VolumeChangeSet;
+class VolumeHealthResult;
 
 
 
@@ -70,23 +89,41 @@ public:
             bool mountaslocal);
 
     void setMountState(bool);
-    bool getMountState();
-    bool getPwSavedState();
-    wxString getEncPath();
-    bool getAutoMount();
-    wxString getMountPath();
-    wxString getVolName();
-    bool getPreventAutoUnmount();
-    bool getAllowOther();
-    bool getMountAsLocal();
+    bool getMountState() const;
+    bool getPwSavedState() const;
+    wxString getEncPath() const;
+    bool getAutoMount() const;
+    wxString getMountPath() const;
+    wxString getVolName() const;
+    bool getPreventAutoUnmount() const;
+    bool getAllowOther() const;
+    bool getMountAsLocal() const;
+    void setIdleTimeout(long);
+    long getIdleTimeout() const;
+    void setLazyMount(bool);
+    bool getLazyMount() const;
+    void setMountOwner(long, long);
+    long getMountPID() const;
+    long getMountStartTime() const;
+    bool getMountedByApp() const;
+    void setHealth(bool, wxString);
+    bool getHealthState() const;
+    wxString getHealthInfo() const;
+    bool isSameAs(const DBEntry&) const;
 
 private:
     bool m_mountstate;
+    bool m_healthy;
+    wxString m_healthinfo;
+    long m_mountpid;
+    long m_mountstarttime;
     bool m_automount;
     bool m_preventautounmount;
     bool m_pwsaved;
     bool m_allowother;
     bool m_mountaslocal;
+    long m_idletimeout;
+    bool m_lazymount;
     wxString m_volname;
     wxString m_enc_path;
     wxString m_mount_path;
@@ -111,6 +148,7 @@ public:
     void OnItemDeSelected(wxListEvent& event);
     void OnItemActivated(wxListEvent& event);
     void OnRightClick(wxListEvent& event);
+    void OnDropFiles(wxDropFilesEvent& event);
     void OnPopupMenuClick(wxCommandEvent& event);
     void SetSelectedIndex(int);
     void LinkToolbar(wxToolBarBase*);
@@ -157,12 +195,20 @@ public:
     void OnForceUnMountAll(wxCommandEvent& event);
     void OnInfo(wxCommandEvent& event);
     void OnRemoveFolder(wxCommandEvent& event);
+    void OnChangePassword(wxCommandEvent& event);
+    void OnDiscoverFolders(wxCommandEvent& event);
+    void OnImportFolders(wxCommandEvent& event);
+    void OnExportFolders(wxCommandEvent& event);
 
     // generic routine
     bool unmountVolumeAsk(wxString& volumename);   // ask for confirmation
+    bool UnmountBusyVolumeAsk(const wxString&, std::vector<OpenFileHolder>);
     // function that does actual unmount is not a member function
 
-    int mountFolder(wxString& volumename, wxString& pw);
+    // ask for the password, then mount the volume on a worker thread
+    // extra text & nr of tries carry over from an attempt with a wrong password
+    void MountVolume(const wxString&, const wxString&, int);
+    void OnVolumeMounted(const MountResult&, int);
 
     // override default OnExit handler (so we can run code when user clicks close button on frame)
     virtual int OnExit(wxCommandEvent& event);
@@ -171,10 +217,49 @@ public:
     void OnToolLeftClick(wxCommandEvent& event);
 
     // auto mount routine
-    void AutoMountVolumes();
+    void AutoMountVolumes(std::function<void()> then = std::function<void()>());
+    // remount the volumes that were mounted at the end of the previous session
+    void RestoreSession(std::function<void()> then = std::function<void()>());
+    void MountVolumesInOrder(const wxArrayString&, int, std::function<void()> then = std::function<void()>());
+    void MountVolumeLevel(std::shared_ptr<MountOrderRun>);
+    void MountVolumeRound(std::shared_ptr<MountOrderRun>, const wxArrayString&);
+    void OnVolumeRoundMounted(std::shared_ptr<MountOrderRun>, const std::vector<MountResult>&);
+    // mount or unmount armed volumes when their encrypted folder comes or goes
+    void CheckArmedVolumes();
+    void MountArmedVolumes();
+    // encfs unmounted these volumes after their idle timeout
+    void OnVolumesIdleUnmounted(const wxArrayString&);
+    void RemountVolume(const wxString&);
+    // stay within the max nr of mounted volumes, by unmounting the least recently used ones
+    bool MakeRoomForMount(const wxString&, size_t, std::shared_ptr<MountEvictions>&, size_t&);
+    void ShowNoRoomForMount(const wxString&);
+    // mount a volume on a worker thread with its saved password (lazy mounts, remounts after a crash)
+    bool StartBackgroundMount(const wxString&);
+    // mount on worker threads, then runs once all of them are done
+    void StartMountBatch(std::vector<MountWorkItem*>&, std::function<void(const std::vector<MountResult>&)>);
+    void OnBackgroundMountDone(MountResult);
+    // a supervised encfs process exited
+    void OnMountProcessExited(MountProcessExit);
+    // lazy unmount of a volume that is busy or stopped responding, in the background
+    void DetachVolume(const wxString&);
+    bool CheckVolumeResponding(const wxString&);
     // FYI -  auto unmount routine is not a member function
 
     void PopulateVolumes();
+    void LoadVolumesFromDB();
+    void UpdateMountStates();
+    void ReconcileMountJournal();
+    // the configs get read in the background, then runs once they are in
+    void UpdateVolumeConfigs(std::function<void()> then = std::function<void()>());
+    // the checks run in the background, then runs once the results are in
+    void ValidateVolumes(std::function<void()> then = std::function<void()>());
+    void ApplyVolumeHealth(const std::vector<VolumeHealthResult>&);
+    void UpdateVolumeCountStatus();
+    void RunStartupStage(int);
+    void FinishStartupStage(int);
+    void OnFirstPaint(wxPaintEvent&);
+    void SyncList();
+    void ApplyVolumeChanges(const VolumeChangeSet&);
     void PopulateToolbar(wxToolBarBase* toolBar);
     void CreateToolbar();  
     void RecreateStatusbar(); 
@@ -184,14 +269,28 @@ public:
     void DoSize();
     void CheckUpdates();
     void CheckUpdates(bool);
+    void OnUpdateCheckDone(wxString, bool);
 
     int GetListCtrlIndex(wxString&);
 
     bool GetVisibleState();
     void SetVisibleState(bool);
+    void UpdateTrayBadge();
 
 private:
     bool m_visible;
+    int m_nrunhealthy;
+    wxStopWatch m_startupwatch;
+    wxStopWatch m_stagewatch;
+    wxString m_startuptimings;
+    bool m_loadedfromsnapshot;
+    wxArrayString m_lastsession;
+    // detaches still running on a worker
+    wxArrayString m_detachingvolumes;
+    // mounts still running on a worker
+    wxArrayString m_mountingvolumes;
+    std::map<long, MountBatch*> m_mountbatches;
+    long m_lastmountbatch;
     wxString m_datadir;
     // toolbar stuff
     size_t              m_rows;             // 1
@@ -201,13 +300,15 @@ private:
     wxStatusBar* m_statusBar;
 
     // private member functions
-    int mountSelectedFolder(wxString& pw);
     wxString getPassWord(wxString&, wxString&);
 
     // list stuff
     void RecreateList();
     // fill the control with items
     void FillListWithVolumes();
+    void InsertListRow(long, DBEntry *);
+    wxArrayString GetListRowText(DBEntry *);
+    wxColour GetListRowColour(DBEntry *);
     
     // ListView stuff
     mainListCtrl *m_listCtrl;
@@ -240,6 +341,8 @@ public:
     void SaveSettings(wxCommandEvent &event);
     void SetEncFSProfileSelection(wxCommandEvent &event);
     void ApplyEncFSProfileSelection(int);
+    void SetKeyDerivationSelection(wxCommandEvent &event);
+    void SetKeySizeSelection(wxCommandEvent &event);
 private:
     wxTextCtrl * m_source_field;
     wxTextCtrl * m_destination_field;
@@ -260,9 +363,13 @@ private:
     wxComboBox * m_combo_cipher_blocksize;
     wxComboBox * m_combo_filename_enc;
     std::map<wxString, wxString> m_encodingcaps;
-    //wxComboBox * m_combo_keyderivation;
+    wxComboBox * m_combo_keyderivation;
+    wxStaticText * m_kdf_info;
+    wxRadioBox * m_radio_profile;
     wxDECLARE_EVENT_TABLE();
     void SetEncfsOptionsState(bool);
+    void ApplyParanoiaSettings();
+    void UpdateKDFInfo();
     bool createEncFSFolder();
 };
 
@@ -327,6 +434,8 @@ private:
     wxCheckBox * m_chkbx_save_password;
     wxCheckBox * m_chkbx_allow_other;
     wxCheckBox * m_chkbx_mount_as_local;
+    wxSpinCtrl * m_idletimeout_field;
+    wxCheckBox * m_chkbx_lazymount;
     wxButton * m_selectdst_button;
     std::map<wxString, DBEntry*> m_editVolumeData;
     bool m_mounted;
@@ -336,17 +445,514 @@ private:
 
 
 
+// frmPasswordDialog - change the password of one or more encfs folders
+
+
+class frmPasswordDialog : public wxDialog
+{
+public:
+    frmPasswordDialog(wxWindow *parent,
+                      const wxString& title,
+                      const wxPoint& pos,
+                      const wxSize& size,
+                      long style,
+                      wxString selectedvolume,
+                      std::map<wxString, DBEntry*> volumedata);
+    void Create();
+    void ChangePasswords(wxCommandEvent &event);
+private:
+    wxString m_selectedvolume;
+    wxCheckListBox * m_volumes_list;
+    wxTextCtrl * m_oldpass;
+    wxTextCtrl * m_pass1;
+    wxTextCtrl * m_pass2;
+    wxCheckBox * m_chkbx_use_keychain;
+    std::map<wxString, DBEntry*> m_passwordVolumeData;
+    wxDECLARE_EVENT_TABLE();
+};
+
+
+
+// EncFSVolumeConfig - settings from the .encfs6.xml file of a volume
+
+
+class EncFSVolumeConfig
+{
+public:
+    // ctor
+    EncFSVolumeConfig();
+
+    wxString getCipherDisplayName();
+    wxString getNameEncodingDisplayName();
+    wxString getDescription();
+
+    bool m_valid;
+    long m_version;
+    wxString m_creator;
+    wxString m_cipheralg;
+    long m_cipheralgmajor;
+    wxString m_namealg;
+    long m_keysize;
+    long m_blocksize;
+    bool m_uniqueiv;
+    bool m_chainednameiv;
+    bool m_externalivchaining;
+    long m_blockmacbytes;
+    long m_blockmacrandbytes;
+    bool m_allowholes;
+    long m_saltlen;
+    long m_kdfiterations;
+    long m_desiredkdfduration;
+};
+
+
+
+// WorkItem - a unit of work that can run on a worker thread
+
+
+class WorkItem
+{
+public:
+    virtual ~WorkItem() {}
+    virtual void Run() = 0;
+};
+
+// what became of a work item with a deadline
+enum WorkItemResult
+{
+    WORKITEM_DONE = 0,
+    WORKITEM_TIMEOUT,
+    // all workers were stuck, so it never ran
+    WORKITEM_NOT_RUN
+};
+
+typedef std::function<void(std::vector<WorkItem*>&, const std::vector<int>&)> WorkItemsDoneFunc;
+
+
+
+// MountJournalEntry - a mount started by this app
+
+
+class MountJournalEntry
+{
+public:
+    // ctor
+    MountJournalEntry();
+
+    wxString m_volname;
+    wxString m_mount_path;
+    long m_pid;
+    long m_starttime;
+};
+
+
+
+// MountResult - outcome of a mount that ran on a worker thread
+
+
+class MountResult
+{
+public:
+    wxString m_volname;
+    int m_status;
+    // the encfs process, it keeps running while the volume is mounted
+    long m_pid;
+    // the batch it belongs to, 0 for mounts on access and remounts after a crash
+    long m_batch;
+    // volumes that were unmounted to make room
+    wxArrayString m_evicted;
+};
+
+
+
+// MountBatch - mounts started together, reported together
+
+
+class MountBatch
+{
+public:
+    size_t m_nrpending;
+    std::vector<MountResult> m_results;
+    std::function<void(const std::vector<MountResult>&)> m_done;
+};
+
+
+
+// MountProcessExit - a supervised encfs process went away
+
+
+class MountProcessExit
+{
+public:
+    wxString m_volname;
+    long m_pid;
+    // as returned by waitpid
+    int m_status;
+};
+
+
+
+// ReaperStats - what the reaper found & fixed since the app started
+
+
+class ReaperStats
+{
+public:
+    // encfs processes without a mount
+    long m_orphans;
+    long m_orphanskilled;
+    // mount points without an encfs process
+    long m_deadmounts;
+    long m_deadunmounted;
+};
+
+
+
+// VolumeProbeHealth - how a mounted volume answered its last probe
+
+
+enum VolumeProbeHealth
+{
+    VOLUME_PROBE_UNKNOWN = 0,
+    VOLUME_PROBE_OK,
+    // answered, but slowly
+    VOLUME_PROBE_DEGRADED,
+    // didn't answer within the timeout
+    VOLUME_PROBE_HUNG
+};
+
+
+
+// OpenFileHolder - a process that keeps a volume busy
+
+
+class OpenFileHolder
+{
+public:
+    long m_pid;
+    wxString m_name;
+    // "open", "cwd", "root" or "mapped"
+    wxString m_kind;
+    wxString m_path;
+};
+
+
+
+// AppSettings - read-only copy of the global settings (/Config)
+// a new copy gets published when the settings are saved,
+// so it can be read from any thread without touching wxConfig
+
+
+class AppSettings
+{
+public:
+    // ctor
+    AppSettings(wxConfigBase *, long);
+
+    // strings are returned as a copy, wxString caches conversions internally
+    wxString getEncFSBinPath() const;
+    wxString getEncFSCTLBinPath() const;
+    wxString getMountBinPath() const;
+    wxString getUMountBinPath() const;
+    wxString getUpdateURL() const;
+    bool getStartAtLogin() const;
+    bool getStartAsIcon() const;
+    bool getAutoUnmount() const;
+    bool getNoPromptOnQuit() const;
+    bool getNoPromptOnUnmount() const;
+    bool getCheckUpdates() const;
+    bool getRestoreSession() const;
+    long getMaxMounted() const;
+    bool getKillOrphans() const;
+    long getGeneration() const;
+
+private:
+    wxString m_encfsbinpath;
+    wxString m_mountbinpath;
+    wxString m_umountbinpath;
+    wxString m_updateurl;
+    bool m_startatlogin;
+    bool m_startasicon;
+    bool m_autounmount;
+    bool m_nopromptonquit;
+    bool m_nopromptonunmount;
+    bool m_checkupdates;
+    bool m_restoresession;
+    long m_maxmounted;
+    bool m_killorphans;
+    long m_generation;
+};
+
+typedef void (*AppSettingsListener)(const AppSettings *);
+
+
+
+// VolumeRecord - stored definition of a volume, as kept in the volume database
+
+
+class VolumeRecord
+{
+public:
+    // ctor
+    VolumeRecord();
+
+    wxString m_volname;
+    wxString m_enc_path;
+    wxString m_mount_path;
+    bool m_automount;
+    bool m_preventautounmount;
+    bool m_pwsaved;
+    bool m_allowother;
+    bool m_mountaslocal;
+    // minutes, 0 = never unmount when idle
+    long m_idletimeout;
+    // mount on first access instead of at startup
+    bool m_lazymount;
+};
+
+
+
+// VolumeChangeSet - differences between two versions of the volume definitions
+
+
+class VolumeChangeSet
+{
+public:
+    bool IsEmpty() const
+    {
+        return (m_added.empty() && m_modified.empty() && m_removed.empty());
+    }
+
+    std::vector<VolumeRecord> m_added;
+    std::vector<VolumeRecord> m_modified;
+    std::vector<wxString> m_removed;
+};
+
+
+
+// VolumeSnapshot - read-only copy of the volume list & state
+// a new one gets published by the main thread after each change,
+// any thread can hold on to one without locking
+// entries that didn't change are shared with the previous snapshot
+
+class VolumeSnapshot;
+typedef std::shared_ptr<const VolumeSnapshot> VolumeSnapshotPtr;
+typedef std::shared_ptr<const DBEntry> DBEntryPtr;
+
+class VolumeSnapshot
+{
+public:
+    // ctor
+    VolumeSnapshot(const std::vector<wxString>&, const std::map<wxString, DBEntry*>&, long, const VolumeSnapshot * previous = NULL);
+
+    const std::vector<wxString>& getVolumeNames() const;
+    // NULL if the volume is not in this snapshot
+    const DBEntry * getVolume(const wxString&) const;
+    long getVersion() const;
+    // number of entries copied from the live model, the others came from the previous snapshot
+    size_t getNrCopied() const;
+
+private:
+    std::vector<wxString> m_volumes;
+    std::map<wxString, DBEntryPtr> m_volumedata;
+    long m_version;
+    size_t m_nrcopied;
+};
+
+
+
+// VolumePathMatch - an enc or mount path of a volume, as found in the path index
+
+
+class VolumePathMatch
+{
+public:
+    wxString m_volname;
+    wxString m_path;
+    bool m_ismountpath;
+};
+
+
+
+// VolumeHealthResult - outcome of checking the folders of a volume
+// the paths are the ones that were checked, the volume may have changed since
+
+
+class VolumeHealthResult
+{
+public:
+    wxString m_volname;
+    wxString m_enc_path;
+    wxString m_mount_path;
+    bool m_healthy;
+    wxString m_healthinfo;
+};
+
+typedef std::function<void(const std::vector<VolumeHealthResult>&)> VolumeHealthFunc;
+
+
+
 // ----------------------------------------------------------------------------
 // function declarations
 // ----------------------------------------------------------------------------
 
+// encfsgui_activity.cpp
+void updateActivityMonitor(const std::map<wxString, DBEntry*>&);
+void stopActivityMonitor();
+long getVolumeLastUsed(const wxString&);
+wxArrayString getMountedVolumesByLastUse();
+
+// encfsgui_appsettings.cpp
+void loadAppSettings();
+const AppSettings * getAppSettings();
+void addAppSettingsListener(AppSettingsListener);
+
 // encfsgui_add.cpp
 void createNewEncFSFolder(wxWindow *);
 void openExistingEncFSFolder(wxWindow *);
 
+// encfsgui_arrival.cpp
+void startArrivalWatcher();
+void stopArrivalWatcher();
+void armDeferredMounts(const wxArrayString&);
+void disarmDeferredMount(const wxString&);
+wxArrayString getArmedVolumes();
+
+// encfsgui_discover.cpp
+void discoverVolumes(wxWindow *);
+
 // encfsgui_edit.cpp
 void editExistingEncFSFolder(wxWindow *, wxString&, std::map<wxString, DBEntry*>);
 
+// encfsgui_fs.cpp
+bool isDirectory(const wxString&);
+bool isDirectoryEmpty(const wxString&);
+bool makeDirectories(const wxString&, int);
+bool setPermissions(const wxString&, int);
+bool openWithDefaultApp(const wxString&);
+
+// encfsgui_idle.cpp
+void updateIdleMonitor(const std::map<wxString, DBEntry*>&);
+void stopIdleMonitor();
+void showIdleUnmountNotification(const wxString&, long);
+
+// encfsgui_import.cpp
+void importVolumes(wxWindow *);
+void exportVolumes(wxWindow *);
+
+// encfsgui_lazymount.cpp
+void startLazyMountWatcher(const std::map<wxString, DBEntry*>&);
+void stopLazyMountWatcher();
+void updateLazyMountWatches(const std::map<wxString, DBEntry*>&);
+bool isLazyMountPending(const wxString&);
+void finishLazyMount(const wxString&, bool);
+
+// encfsgui_mountorder.cpp
+std::vector<wxArrayString> getMountLevels(const std::vector<VolumeRecord>&, wxArrayString&);
+wxString getMountCycleInfo(const wxString&, const wxString&, const wxString&);
+
+// encfsgui_openfiles.cpp
+std::vector<OpenFileHolder> findOpenFiles(const wxString&);
+
+// encfsgui_passwd.cpp
+void changeVolumePasswords(wxWindow *, wxString&, std::map<wxString, DBEntry*>);
+
+// encfsgui_pathindex.cpp
+void updateVolumePathIndex(const std::vector<wxString>&, const std::map<wxString, DBEntry*>&);
+bool findVolumeByPath(const wxString&, VolumePathMatch&);
+std::vector<VolumePathMatch> findVolumesInsidePath(const wxString&);
+wxString getVolumePathOverlap(const wxString&, const wxString&, const wxString&);
+
+// encfsgui_prober.cpp
+void updateHealthProber(const std::map<wxString, DBEntry*>&);
+void stopHealthProber();
+int getVolumeProbeHealth(const wxString&, long&);
+bool isVolumeHung(const wxString&);
+
+// encfsgui_reaper.cpp
+bool unmountDeadMount(const wxString&);
+void detachDeadMount(const wxString&, std::function<void(bool)>);
+void startReaper();
+void stopReaper();
+ReaperStats getReaperStats();
+
+// encfsgui_snapshot.cpp
+wxString getDataFilePath(const wxString&);
+bool writeDataFileAtomic(const wxString&, const wxString&);
+bool readDataFile(const wxString&, wxString&);
+bool saveVolumeSnapshot(std::vector<wxString>&, std::map<wxString, DBEntry*>&);
+bool loadVolumeSnapshot(std::vector<wxString>&, std::map<wxString, DBEntry*>&);
+void journalMountStarted(const wxString&, long, const wxString&);
+void journalMountStopped(const wxString&);
+std::map<wxString, MountJournalEntry> readMountJournal();
+bool compactMountJournal(std::map<wxString, MountJournalEntry>&);
+bool saveMountSession(const wxArrayString&);
+wxArrayString takeMountSession();
+
+// encfsgui_supervisor.cpp
+wxString prepareMountLog(const wxString&, wxFileOffset&);
+wxString readMountLog(const wxString&, wxFileOffset);
+void superviseMountProcess(const wxString&, long);
+bool endMountSupervision(const MountProcessExit&, long&);
+std::set<long> getSupervisedProcesses();
+long scheduleCrashRemount(const wxString&, long);
+bool finishCrashRemount(const wxString&, bool);
+void stopMountSupervision();
+
+// encfsgui_system.cpp
+wxArrayString getSystemMountTable();
+std::map<long, wxArrayString> getProcessArguments();
+bool isProcessAlive(long);
+long findEncFSProcess(const wxString&);
+long long getProcessCPUTime(long);
+
+// encfsgui_update.cpp
+void initUpdateChecker();
+bool startUpdateCheck(bool);
+void stopUpdateChecker();
+wxString getCachedLatestVersion();
+
+// encfsgui_validate.cpp
+bool checkVolumeFolders(const wxString&, const wxString&, bool, wxString&);
+void validateVolumes(const std::map<wxString, DBEntry*>&, VolumeHealthFunc);
+
+// encfsgui_volinfo.cpp
+bool getEncFSVolumeConfig(const wxString&, EncFSVolumeConfig&);
+bool getCachedEncFSVolumeConfig(const wxString&, EncFSVolumeConfig&);
+void loadEncFSVolumeConfigs(const std::vector<wxString>&, std::function<void()>);
+
+// encfsgui_volumedb.cpp
+void openVolumeDB();
+void closeVolumeDB();
+wxString getVolumeDBName();
+bool isVolumeDBConfigFile();
+bool readConfigVolumeRecords(wxConfigBase *, std::vector<VolumeRecord>&);
+bool loadVolumeRecords(std::vector<VolumeRecord>&);
+bool getVolumeRecord(const wxString&, VolumeRecord&);
+bool saveVolumeRecord(const VolumeRecord&);
+bool removeVolumeRecord(const wxString&);
+bool doesVolumeExist(wxString&);
+wxString findVolumeByMountPath(const wxString&);
+bool renameVolume(wxString&, wxString&);
+bool beginVolumeBatch();
+bool commitVolumeBatch();
+void rollbackVolumeBatch();
+
+// encfsgui_volumemodel.cpp
+bool publishVolumeSnapshot(const std::vector<wxString>&, const std::map<wxString, DBEntry*>&);
+VolumeSnapshotPtr getVolumeSnapshot();
+
+// encfsgui_watch.cpp
+void startConfigWatcher();
+void stopConfigWatcher();
+void checkConfigFile();
+bool flushConfig();
+
+// encfsgui_workers.cpp
+void RunWorkItemsParallel(std::vector<WorkItem*>&, unsigned int, wxProgressDialog * progress = NULL);
+void RunWorkItemsWithTimeout(std::vector<WorkItem*>&, long, WorkItemsDoneFunc);
+void stopTimedWorkers();
+
 // encfsgui_helpers.cpp
 bool isEncFSBinInstalled();
 wxString getEncFSBinPath();
@@ -354,24 +960,30 @@ wxString getEncFSCTLBinPath();
 wxString getMountBinPath();
 wxString getUMountBinPath();
 void ShowMsg(wxString);
+wxString sanitizeVolumeName(const wxString&);
+wxString formatLimitedList(const wxArrayString&, size_t);
+bool confirmVolumePathOverlap(wxWindow *, const wxString&, const wxString&, const wxString&);
+void showVolumeNotification(const wxString&, const wxString&, const wxString& actionlabel = wxEmptyString, std::function<void()> action = std::function<void()>(), bool clickruns = false);
 wxString getEncFSBinVersion();
-void renameVolume(wxString&, wxString&);
 
 wxString StrRunCMDSync(wxString&);
 wxArrayString ArrRunCMDSync(wxString&);
 wxArrayString ArrRunCMDASync(wxString&);
 wxString arrStrTowxStr(wxArrayString&);
+int RunCMDArgvSync(const wxArrayString&, const wxString&, wxString&);
+long SpawnCMDArgv(const wxArrayString&, const wxString&, const wxString&);
 
 bool IsVolumeSystemMounted(wxString, wxArrayString);
 void BrowseFolder(wxString&);
 wxString getKeychainPassword(wxString&);
-bool doesVolumeExist(wxString&);
-wxArrayString getEncFSVolumeInfo(wxString&);
+bool setKeychainPassword(const wxString&, const wxString&);
 std::map<wxString, wxString> getEncodingCapabilities();
 wxString getExpectScriptContents(bool);
-wxString getChangePasswordScriptContents(wxString&);
+wxString getParanoiaExpectScriptContents();
+long getPBKDF2Rate();
+long getKDFUnlockTime(long, long);
+long getKDFIterationsForDuration(long, long);
 wxString getLaunchAgentContents();
-wxString getLatestVersion();
 bool IsLatestVersionNewer(const wxString&, wxString&);
 
 //encfsgui_settings.cpp
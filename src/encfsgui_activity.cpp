@@ -0,0 +1,264 @@
+/*
+    encFSGui - encfsgui_activity.cpp
+    source file contains code to keep track of
+    when each mounted volume was last used
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/hashmap.h>
+#include <wx/timer.h>
+#include <list>
+#include <map>
+
+#include "encfsgui.h"
+
+
+// main window, shows the last used times
+extern frmMain * g_frmMain;
+// set by QuitApp, from then on nothing gets started again
+extern bool g_shuttingDown;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// how often the encfs processes get sampled
+static const int ACTIVITY_SAMPLE_INTERVAL_MS = 30000;
+
+enum
+{
+    ID_TIMER_ACTIVITY_SAMPLE = 1
+};
+
+
+// ----------------------------------------------------------------------------
+// VolumeLRU - mounted volumes, most recently used first
+// a use moves a volume to the front, O(1)
+// ----------------------------------------------------------------------------
+
+typedef std::list<wxString> VolumeLRUList;
+WX_DECLARE_STRING_HASH_MAP(VolumeLRUList::iterator, VolumeLRUPositions);
+WX_DECLARE_STRING_HASH_MAP(long, VolumeLastUsedTimes);
+WX_DECLARE_STRING_HASH_MAP(long long, VolumeCPUTimes);
+
+class VolumeLRU
+{
+public:
+    void Touch(const wxString& volname, long now)
+    {
+        VolumeLRUPositions::iterator it = m_positions.find(volname);
+        if (it != m_positions.end())
+        {
+            m_order.splice(m_order.begin(), m_order, it->second);
+        }
+        else
+        {
+            m_order.push_front(volname);
+            m_positions[volname] = m_order.begin();
+        }
+        m_lastused[volname] = now;
+    }
+
+    // the last used time is kept, it's still shown in the list
+    void Remove(const wxString& volname)
+    {
+        VolumeLRUPositions::iterator it = m_positions.find(volname);
+        if (it != m_positions.end())
+        {
+            m_order.erase(it->second);
+            m_positions.erase(it);
+        }
+    }
+
+    bool Contains(const wxString& volname) const
+    {
+        return (m_positions.find(volname) != m_positions.end());
+    }
+
+    long GetLastUsed(const wxString& volname) const
+    {
+        VolumeLastUsedTimes::const_iterator it = m_lastused.find(volname);
+        return (it == m_lastused.end()) ? 0 : it->second;
+    }
+
+    // least recently used first
+    wxArrayString GetOrder() const
+    {
+        wxArrayString volumes;
+        for (VolumeLRUList::const_reverse_iterator it = m_order.rbegin(); it != m_order.rend(); it++)
+        {
+            volumes.Add(*it);
+        }
+        return volumes;
+    }
+
+private:
+    VolumeLRUList m_order;
+    VolumeLRUPositions m_positions;
+    VolumeLastUsedTimes m_lastused;
+};
+
+
+// ----------------------------------------------------------------------------
+// ActivityMonitor - samples the cpu time of the encfs processes,
+// a volume counts as used when its encfs process did some work
+// ----------------------------------------------------------------------------
+
+class ActivityMonitor : public wxEvtHandler
+{
+public:
+    ActivityMonitor();
+    virtual ~ActivityMonitor();
+    void Update(const std::map<wxString, DBEntry*>& volumedata);
+
+    VolumeLRU m_lru;
+
+private:
+    void OnSampleTimer(wxTimerEvent& event);
+
+    wxTimer m_sampletimer;
+    // volume name -> encfs pid, of the mounted volumes
+    std::map<wxString, long> m_pids;
+    VolumeCPUTimes m_cputimes;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(ActivityMonitor, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_ACTIVITY_SAMPLE, ActivityMonitor::OnSampleTimer)
+wxEND_EVENT_TABLE()
+
+
+ActivityMonitor::ActivityMonitor() : m_sampletimer(this, ID_TIMER_ACTIVITY_SAMPLE)
+{
+}
+
+
+ActivityMonitor::~ActivityMonitor()
+{
+    m_sampletimer.Stop();
+}
+
+
+// follow mounts & unmounts, mounting a volume counts as using it
+void ActivityMonitor::Update(const std::map<wxString, DBEntry*>& volumedata)
+{
+    long now = (long)wxGetUTCTime();
+    m_pids.clear();
+    for (std::map<wxString, DBEntry*>::const_iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        if (!it->second->getMountState())
+        {
+            if (m_lru.Contains(it->first))
+            {
+                m_lru.Remove(it->first);
+                m_cputimes.erase(it->first);
+            }
+            continue;
+        }
+        if (!m_lru.Contains(it->first))
+        {
+            m_lru.Touch(it->first, now);
+            m_cputimes.erase(it->first);
+        }
+        if (it->second->getMountPID() > 0)
+        {
+            m_pids[it->first] = it->second->getMountPID();
+        }
+    }
+
+    if (!m_pids.empty() && !m_sampletimer.IsRunning())
+    {
+        m_sampletimer.Start(ACTIVITY_SAMPLE_INTERVAL_MS);
+    }
+    else if (m_pids.empty() && m_sampletimer.IsRunning())
+    {
+        m_sampletimer.Stop();
+    }
+}
+
+
+void ActivityMonitor::OnSampleTimer(wxTimerEvent& WXUNUSED(event))
+{
+    long now = (long)wxGetUTCTime();
+    bool changed = false;
+    for (std::map<wxString, long>::iterator it = m_pids.begin(); it != m_pids.end(); it++)
+    {
+        long long cputime = getProcessCPUTime(it->second);
+        if (cputime < 0)
+        {
+            continue;
+        }
+        VolumeCPUTimes::iterator previous = m_cputimes.find(it->first);
+        if (previous != m_cputimes.end() && previous->second != cputime)
+        {
+            m_lru.Touch(it->first, now);
+            changed = true;
+        }
+        m_cputimes[it->first] = cputime;
+    }
+    if (changed && g_frmMain)
+    {
+        g_frmMain->SyncList();
+    }
+}
+
+
+static ActivityMonitor * g_activityMonitor = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// main thread only
+// ----------------------------------------------------------------------------
+
+void updateActivityMonitor(const std::map<wxString, DBEntry*>& volumedata)
+{
+    if (g_shuttingDown)
+    {
+        return;
+    }
+    if (!g_activityMonitor)
+    {
+        g_activityMonitor = new ActivityMonitor();
+    }
+    g_activityMonitor->Update(volumedata);
+}
+
+
+void stopActivityMonitor()
+{
+    delete g_activityMonitor;
+    g_activityMonitor = NULL;
+}
+
+
+// utc time the volume was last used, 0 = not since the app started
+long getVolumeLastUsed(const wxString& volname)
+{
+    if (!g_activityMonitor)
+    {
+        return 0;
+    }
+    return g_activityMonitor->m_lru.GetLastUsed(volname);
+}
+
+
+// the mounted volumes, least recently used first
+wxArrayString getMountedVolumesByLastUse()
+{
+    if (!g_activityMonitor)
+    {
+        return wxArrayString();
+    }
+    return g_activityMonitor->m_lru.GetOrder();
+}
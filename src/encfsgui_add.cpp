@@ -38,9 +38,16 @@ enum
     ID_ENCFSPROFILE_BALANCED,
     ID_ENCFSPROFILE_PERFORMANCE,
     ID_ENCFSPROFILE_SECURE,
-    ID_ENCFSPROFILE_CUSTOM
+    ID_ENCFSPROFILE_CUSTOM,
+    ID_COMBO_KEYDERIVATION,
+    ID_COMBO_KEYSIZE
 };
 
+// key derivation durations (ms) used by encfs
+// expert mode always uses 500 ms, paranoia mode uses 3000 ms
+static const wxString KDF_DURATION_STANDARD = "500";
+static const wxString KDF_DURATION_PARANOIA = "3000";
+
 
 
 // ----------------------------------------------------------------------------
@@ -52,6 +59,8 @@ wxBEGIN_EVENT_TABLE(frmAddDialog, wxDialog)
     EVT_BUTTON(ID_BTN_CHOOSE_DESTINATION,  frmAddDialog::ChooseDestinationFolder)
     EVT_BUTTON(wxID_APPLY, frmAddDialog::SaveSettings)
     EVT_RADIOBOX(ID_RADIO_PROFILE, frmAddDialog::SetEncFSProfileSelection)
+    EVT_COMBOBOX(ID_COMBO_KEYDERIVATION, frmAddDialog::SetKeyDerivationSelection)
+    EVT_COMBOBOX(ID_COMBO_KEYSIZE, frmAddDialog::SetKeySizeSelection)
 wxEND_EVENT_TABLE()
 
 // ----------------------------------------------------------------------------
@@ -79,6 +88,8 @@ frmAddDialog::frmAddDialog(wxWindow *parent,
 {
     // get capabilities for this system
     m_encodingcaps = getEncodingCapabilities();
+    // measure key derivation speed, so we can predict unlock times
+    getPBKDF2Rate();
 }
 
 // event functions
@@ -105,10 +116,32 @@ void frmAddDialog::SetEncFSProfileSelection(wxCommandEvent& event)
         selectedProfile = ID_ENCFSPROFILE_CUSTOM;
     }
 
+    // profiles are applied in expert mode
+    m_combo_keyderivation->SetValue(KDF_DURATION_STANDARD);
     ApplyEncFSProfileSelection(selectedProfile);
 }
 
 
+void frmAddDialog::SetKeyDerivationSelection(wxCommandEvent& WXUNUSED(event))
+{
+    if (m_combo_keyderivation->GetValue() == KDF_DURATION_PARANOIA)
+    {
+        ApplyParanoiaSettings();
+    }
+    else
+    {
+        // go back to the settings of the selected profile
+        ApplyEncFSProfileSelection(ID_ENCFSPROFILE_BALANCED + m_radio_profile->GetSelection());
+    }
+}
+
+
+void frmAddDialog::SetKeySizeSelection(wxCommandEvent& WXUNUSED(event))
+{
+    UpdateKDFInfo();
+}
+
+
 // member functions
 
 void frmAddDialog::SetEncfsOptionsState(bool enabledstate)
@@ -119,7 +152,6 @@ void frmAddDialog::SetEncfsOptionsState(bool enabledstate)
         m_combo_cipher_keysize->Disable();
         m_combo_cipher_blocksize->Disable();
         m_combo_filename_enc->Disable();
-        //m_combo_keyderivation->Disable();
         m_chkbx_perfile_iv->Disable();
         m_chkbx_block_mac_headers->Disable();
         m_chkbx_iv_chaining->Disable();
@@ -131,7 +163,6 @@ void frmAddDialog::SetEncfsOptionsState(bool enabledstate)
         m_combo_cipher_keysize->Enable();
         m_combo_cipher_blocksize->Enable();
         m_combo_filename_enc->Enable();
-        //m_combo_keyderivation->Enable();
         m_chkbx_perfile_iv->Enable();
         m_chkbx_block_mac_headers->Enable();
         m_chkbx_iv_chaining->Enable();
@@ -192,7 +223,6 @@ void frmAddDialog::ApplyEncFSProfileSelection(int SelectedProfile)
         m_combo_cipher_blocksize->SetValue("1024");
         m_combo_cipher_keysize->SetValue("192");
         m_combo_filename_enc->SetValue("Null");
-        //m_combo_keyderivation->SetValue("500");
         m_chkbx_block_mac_headers->SetValue(false);
         m_chkbx_perfile_iv->SetValue(false);
         m_chkbx_iv_chaining->SetValue(false);
@@ -203,6 +233,44 @@ void frmAddDialog::ApplyEncFSProfileSelection(int SelectedProfile)
     {
         SetEncfsOptionsState(true);
     }
+    UpdateKDFInfo();
+}
+
+
+// encfs paranoia mode does not ask for any options, show what it will use
+void frmAddDialog::ApplyParanoiaSettings()
+{
+    m_combo_cipher_algo->SetValue("AES");
+    m_combo_cipher_blocksize->SetValue("1024");
+    m_combo_cipher_keysize->SetValue("256");
+    if (m_encodingcaps.count("Block") > 0)
+    {
+        m_combo_filename_enc->SetValue("Block");
+    }
+    m_chkbx_block_mac_headers->SetValue(true);
+    m_chkbx_perfile_iv->SetValue(true);
+    m_chkbx_iv_chaining->SetValue(true);
+    m_chkbx_filename_to_iv_header_chaining->SetValue(true);
+    SetEncfsOptionsState(false);
+    UpdateKDFInfo();
+}
+
+
+// show how many PBKDF2 iterations encfs will pick on this machine,
+// and how long it will take to unlock the volume
+void frmAddDialog::UpdateKDFInfo()
+{
+    long duration = 500;
+    long keysize = 192;
+    m_combo_keyderivation->GetValue().ToLong(&duration);
+    m_combo_cipher_keysize->GetValue().ToLong(&keysize);
+
+    long iterations = getKDFIterationsForDuration(duration, keysize);
+    long unlocktime = getKDFUnlockTime(iterations, keysize);
+
+    wxString info;
+    info.Printf(wxT("~%ld PBKDF2 iterations, predicted unlock time on this machine: ~%ld ms"), iterations, unlocktime);
+    m_kdf_info->SetLabel(info);
 }
 
 
@@ -245,8 +313,8 @@ void frmAddDialog::Create()
     wxSizer * const sizerEncFS = new wxStaticBoxSizer(wxVERTICAL, this, "EncFS options");
     // 4 profiles
     // 1. Balanced    2. Performance    3. Security   4. Custom
-    wxRadioBox * encProfiles = new wxRadioBox(this, ID_RADIO_PROFILE, "EncFS profile", wxDefaultPosition, wxDefaultSize, arrProfilechoices, 0, wxRA_SPECIFY_COLS);
-    sizerEncFS->Add(encProfiles);
+    m_radio_profile = new wxRadioBox(this, ID_RADIO_PROFILE, "EncFS profile", wxDefaultPosition, wxDefaultSize, arrProfilechoices, 0, wxRA_SPECIFY_COLS);
+    sizerEncFS->Add(m_radio_profile);
     sizerEncFS->AddSpacer(10);
 
     wxSizer * const sizerEncFS_row1 = new wxBoxSizer(wxHORIZONTAL);
@@ -267,6 +335,9 @@ void frmAddDialog::Create()
         arrBlockSizes.Add(thissize);
     }
     wxArrayString arrFilenameEnc;
+    wxArrayString arrKeyDerivation;
+    arrKeyDerivation.Add(KDF_DURATION_STANDARD);
+    arrKeyDerivation.Add(KDF_DURATION_PARANOIA);
 
     for (std::map<wxString, wxString>::iterator it= m_encodingcaps.begin(); it != m_encodingcaps.end(); it++)
     {
@@ -279,7 +350,7 @@ void frmAddDialog::Create()
     m_combo_cipher_algo = new wxComboBox(this, wxID_ANY, arrAlgos[0], wxDefaultPosition, wxDefaultSize, arrAlgos, wxCB_READONLY);
     sizerEncFS_row1->Add(m_combo_cipher_algo,wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
     sizerEncFS_row1->Add(new wxStaticText(this, wxID_ANY, "Keysize:"));
-    m_combo_cipher_keysize = new wxComboBox(this, wxID_ANY, arrKeySizes[0], wxDefaultPosition, wxDefaultSize, arrKeySizes, wxCB_READONLY);
+    m_combo_cipher_keysize = new wxComboBox(this, ID_COMBO_KEYSIZE, arrKeySizes[0], wxDefaultPosition, wxDefaultSize, arrKeySizes, wxCB_READONLY);
     sizerEncFS_row1->Add(m_combo_cipher_keysize,wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
     sizerEncFS_row1->Add(new wxStaticText(this, wxID_ANY, "Blocksize"));
     m_combo_cipher_blocksize = new wxComboBox(this, wxID_ANY, arrBlockSizes[0], wxDefaultPosition, wxDefaultSize, arrBlockSizes, wxCB_READONLY);
@@ -291,8 +362,15 @@ void frmAddDialog::Create()
     sizerEncFS_row2->Add(new wxStaticText(this, wxID_ANY, "Filename encoding:"));
     m_combo_filename_enc = new wxComboBox(this, wxID_ANY, arrFilenameEnc[0], wxDefaultPosition, wxDefaultSize, arrFilenameEnc, wxCB_READONLY);
     sizerEncFS_row2->Add(m_combo_filename_enc,wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
+    sizerEncFS_row2->Add(new wxStaticText(this, wxID_ANY, "Key derivation (ms):"));
+    m_combo_keyderivation = new wxComboBox(this, ID_COMBO_KEYDERIVATION, KDF_DURATION_STANDARD, wxDefaultPosition, wxDefaultSize, arrKeyDerivation, wxCB_READONLY);
+    sizerEncFS_row2->Add(m_combo_keyderivation,wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
     sizerEncFS->Add(sizerEncFS_row2);
 
+    // unlock time prediction, based on the PBKDF2 speed of this machine
+    m_kdf_info = new wxStaticText(this, wxID_ANY, wxEmptyString);
+    sizerEncFS->Add(m_kdf_info, wxSizerFlags().Border(wxBOTTOM, 5));
+
     // row 3 : HMAC & IV settings
     wxSizer * const sizerEncFS_row3 = new wxBoxSizer(wxHORIZONTAL);
     m_chkbx_block_mac_headers  = new wxCheckBox(this, wxID_ANY, "Per-block HMAC");
@@ -436,7 +514,14 @@ bool frmAddDialog::createEncFSFolder()
 
     wxString selectedfilenameencoding = m_combo_filename_enc->GetValue();
     filenameencodingchoice = m_encodingcaps[selectedfilenameencoding];
-    scriptcontents = getExpectScriptContents(false);
+    if (m_combo_keyderivation->GetValue() == KDF_DURATION_PARANOIA)
+    {
+        scriptcontents = getParanoiaExpectScriptContents();
+    }
+    else
+    {
+        scriptcontents = getExpectScriptContents(false);
+    }
     // replace keywords with actual values
     scriptcontents.Replace("$ENCFSBIN", encfsbin);
     scriptcontents.Replace("$ENCPATH", enc_path);
@@ -551,10 +636,7 @@ void frmAddDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     wxString newvolumename = m_volumename_field->GetValue();
 
     // sanitize the name
-    newvolumename.Replace("/","");
-    newvolumename.Replace(" ","");
-    newvolumename.Replace("'","");
-    newvolumename.Replace('"',"");
+    newvolumename = sanitizeVolumeName(newvolumename);
     m_volumename_field->SetValue(newvolumename);
 
     //1. is volume name unique?
@@ -586,7 +668,7 @@ void frmAddDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         else
         {
             // the new encrypted folder location must be empty
-            if (dir->HasFiles() && dir->HasSubDirs())
+            if (!isDirectoryEmpty(srcfolder))
             {
                 src_folder_ok = false;
                 errormsg << "- New encrypted folder is not empty\n";
@@ -610,7 +692,7 @@ void frmAddDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }
         else
         {
-            if (dir->HasFiles() && dir->HasSubDirs())
+            if (!isDirectoryEmpty(dstfolder))
             {
                 dst_folder_ok = false;
                 errormsg << "- Destination mount point is not empty\n";
@@ -623,6 +705,17 @@ void frmAddDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }
     }
 
+    // a mount point can only be used by one volume
+    if (dst_folder_ok)
+    {
+        wxString othervolume = findVolumeByMountPath(dstfolder);
+        if (!othervolume.IsEmpty())
+        {
+            dst_folder_ok = false;
+            errormsg << "- Destination mount point is already used by volume '" << othervolume << "'\n";
+        }
+    }
+
     //4. password ok ?
     if (!m_pass1->IsEmpty())
     {
@@ -650,30 +743,28 @@ void frmAddDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     }
     else
     {
+        if (!confirmVolumePathOverlap(this, srcfolder, dstfolder, wxEmptyString))
+        {
+            return;
+        }
         // change ownership on folders
-        wxString changeowner;
-        wxString outp;
-        changeowner.Printf(wxT("chmod 700 '%s'"), srcfolder);
-        outp = StrRunCMDSync(changeowner);
-        changeowner.Printf(wxT("chmod 700 '%s'"), dstfolder);
-        outp = StrRunCMDSync(changeowner);
+        setPermissions(srcfolder, 0700);
+        setPermissions(dstfolder, 0700);
         // create the new volume
         bool createdok = createEncFSFolder();
         if (createdok)
         {
             // next, save new volume
-            wxString config_volname;
-            wxConfigBase *pConfig = wxConfigBase::Get();
-            config_volname.Printf(wxT("/Volumes/%s"), newvolumename);
-            pConfig->SetPath(config_volname);
-            pConfig->Write(wxT("enc_path"), srcfolder);
-            pConfig->Write(wxT("mount_path"), dstfolder);
-            pConfig->Write(wxT("automount"), m_chkbx_automount->GetValue());
-            pConfig->Write(wxT("preventautounmount"), m_chkbx_prevent_autounmount->GetValue());
-            pConfig->Write(wxT("passwordsaved"), m_chkbx_save_password->GetValue());
-            pConfig->Write(wxT("allowother"),m_chkbx_allow_other->GetValue());
-            pConfig->Write(wxT("mountaslocal"),m_chkbx_mount_as_local->GetValue());            
-            pConfig->Flush();
+            VolumeRecord record;
+            record.m_volname = newvolumename;
+            record.m_enc_path = srcfolder;
+            record.m_mount_path = dstfolder;
+            record.m_automount = m_chkbx_automount->GetValue();
+            record.m_preventautounmount = m_chkbx_prevent_autounmount->GetValue();
+            record.m_pwsaved = m_chkbx_save_password->GetValue();
+            record.m_allowother = m_chkbx_allow_other->GetValue();
+            record.m_mountaslocal = m_chkbx_mount_as_local->GetValue();
+            saveVolumeRecord(record);
             // save password in KeyChain, if needed
             if (m_chkbx_save_password->GetValue())
             {
@@ -765,10 +856,7 @@ void frmOpenDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     wxString newvolumename = m_volumename_field->GetValue();
 
     // sanitize the name
-    newvolumename.Replace("/","");
-    newvolumename.Replace(" ","");
-    newvolumename.Replace("'","");
-    newvolumename.Replace('"',"");
+    newvolumename = sanitizeVolumeName(newvolumename);
     m_volumename_field->SetValue(newvolumename);
 
     //1. is volume name unique?
@@ -815,7 +903,7 @@ void frmOpenDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }
         else
         {
-            if (dir->HasFiles() && dir->HasSubDirs())
+            if (!isDirectoryEmpty(dstfolder))
             {
                 dst_folder_ok = false;
                 errormsg << "- Destination mount point is not empty\n";
@@ -828,6 +916,17 @@ void frmOpenDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }
     }
 
+    // a mount point can only be used by one volume
+    if (dst_folder_ok)
+    {
+        wxString othervolume = findVolumeByMountPath(dstfolder);
+        if (!othervolume.IsEmpty())
+        {
+            dst_folder_ok = false;
+            errormsg << "- Destination mount point is already used by volume '" << othervolume << "'\n";
+        }
+    }
+
     //4. save password ?
     if (m_chkbx_save_password->GetValue())
     {
@@ -862,19 +961,21 @@ void frmOpenDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     }
     else
     {
+        if (!confirmVolumePathOverlap(this, srcfolder, dstfolder, wxEmptyString))
+        {
+            return;
+        }
         // save new volume
-        wxString config_volname;
-        wxConfigBase *pConfig = wxConfigBase::Get();
-        config_volname.Printf(wxT("/Volumes/%s"), newvolumename);
-        pConfig->SetPath(config_volname);
-        pConfig->Write(wxT("enc_path"), srcfolder);
-        pConfig->Write(wxT("mount_path"), dstfolder);
-        pConfig->Write(wxT("automount"), m_chkbx_automount->GetValue());
-        pConfig->Write(wxT("preventautounmount"), m_chkbx_prevent_autounmount->GetValue());
-        pConfig->Write(wxT("passwordsaved"), m_chkbx_save_password->GetValue());
-        pConfig->Write(wxT("allowother"),m_chkbx_allow_other->GetValue());
-        pConfig->Write(wxT("mountaslocal"),m_chkbx_mount_as_local->GetValue());        
-        pConfig->Flush();
+        VolumeRecord record;
+        record.m_volname = newvolumename;
+        record.m_enc_path = srcfolder;
+        record.m_mount_path = dstfolder;
+        record.m_automount = m_chkbx_automount->GetValue();
+        record.m_preventautounmount = m_chkbx_prevent_autounmount->GetValue();
+        record.m_pwsaved = m_chkbx_save_password->GetValue();
+        record.m_allowother = m_chkbx_allow_other->GetValue();
+        record.m_mountaslocal = m_chkbx_mount_as_local->GetValue();
+        saveVolumeRecord(record);
         // save password in KeyChain, if needed
         if (m_chkbx_save_password->GetValue())
         {
@@ -981,7 +1082,7 @@ void frmOpenDialog::Create()
 void createNewEncFSFolder(wxWindow *parent)
 {
     wxSize frmAddSize;
-    frmAddSize.Set(600,700);
+    frmAddSize.Set(600,730);
     long framestyle;
     framestyle = wxDEFAULT_FRAME_STYLE | wxFRAME_EX_METAL;
 
@@ -0,0 +1,176 @@
+/*
+    encFSGui - encfsgui_appsettings.cpp
+    source file contains code to keep a read-only
+    copy of the app settings in memory
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+#include <atomic>
+#include <vector>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// AppSettings
+// ----------------------------------------------------------------------------
+
+// current settings, swapped as a whole when the settings are saved
+static std::atomic<const AppSettings*> g_appSettings(NULL);
+// old copies are kept, another thread may still be reading them
+// settings don't change often, so this never grows much
+static std::vector<const AppSettings*> g_retiredAppSettings;
+static std::vector<AppSettingsListener> g_appSettingsListeners;
+
+
+// read all settings from /Config at once
+AppSettings::AppSettings(wxConfigBase * pConfig, long generation)
+{
+    // the caller may be in the middle of another group
+    wxString oldpath = pConfig->GetPath();
+    pConfig->SetPath(wxT("/Config"));
+    m_encfsbinpath = pConfig->Read(wxT("encfsbinpath"), "/usr/local/bin/encfs");
+    m_mountbinpath = pConfig->Read(wxT("mountbinpath"), "/sbin/mount");
+    m_umountbinpath = pConfig->Read(wxT("umountbinpath"), "/sbin/umount");
+    m_updateurl = pConfig->Read(wxT("updateurl"), "");
+    // 0l = disabled by default
+    // 1l = enabled by default
+    m_startatlogin = (pConfig->Read(wxT("startatlogin"), 0l) != 0);
+    m_startasicon = (pConfig->Read(wxT("startasicon"), 0l) != 0);
+    m_autounmount = (pConfig->Read(wxT("autounmount"), 0l) != 0);
+    m_nopromptonquit = (pConfig->Read(wxT("nopromptonquit"), 0l) != 0);
+    m_nopromptonunmount = (pConfig->Read(wxT("nopromptonunmount"), 0l) != 0);
+    m_checkupdates = (pConfig->Read(wxT("checkupdates"), 0l) != 0);
+    m_restoresession = (pConfig->Read(wxT("restoresession"), 0l) != 0);
+    m_maxmounted = pConfig->Read(wxT("maxmounted"), 0l);
+    m_killorphans = (pConfig->Read(wxT("killorphans"), 0l) != 0);
+    m_generation = generation;
+    pConfig->SetPath(oldpath);
+}
+
+wxString AppSettings::getEncFSBinPath() const
+{
+    return m_encfsbinpath;
+}
+
+wxString AppSettings::getEncFSCTLBinPath() const
+{
+    return m_encfsbinpath + "ctl";
+}
+
+wxString AppSettings::getMountBinPath() const
+{
+    return m_mountbinpath;
+}
+
+wxString AppSettings::getUMountBinPath() const
+{
+    return m_umountbinpath;
+}
+
+// empty = use the default url
+wxString AppSettings::getUpdateURL() const
+{
+    return m_updateurl;
+}
+
+bool AppSettings::getStartAtLogin() const
+{
+    return m_startatlogin;
+}
+
+bool AppSettings::getStartAsIcon() const
+{
+    return m_startasicon;
+}
+
+bool AppSettings::getAutoUnmount() const
+{
+    return m_autounmount;
+}
+
+bool AppSettings::getNoPromptOnQuit() const
+{
+    return m_nopromptonquit;
+}
+
+bool AppSettings::getNoPromptOnUnmount() const
+{
+    return m_nopromptonunmount;
+}
+
+bool AppSettings::getCheckUpdates() const
+{
+    return m_checkupdates;
+}
+
+// remount the previous session at startup, instead of the automount volumes
+bool AppSettings::getRestoreSession() const
+{
+    return m_restoresession;
+}
+
+// 0 = no limit
+long AppSettings::getMaxMounted() const
+{
+    return m_maxmounted;
+}
+
+// let the reaper stop orphaned encfs processes, instead of only reporting them
+bool AppSettings::getKillOrphans() const
+{
+    return m_killorphans;
+}
+
+// increases each time the settings are saved
+long AppSettings::getGeneration() const
+{
+    return m_generation;
+}
+
+
+// (re)load the settings from wxConfig and publish them
+// main thread only, wxConfig is not thread safe
+void loadAppSettings()
+{
+    const AppSettings * oldsettings = g_appSettings.load();
+    long generation = oldsettings ? oldsettings->getGeneration() + 1 : 1;
+    const AppSettings * newsettings = new AppSettings(wxConfigBase::Get(), generation);
+    g_appSettings.store(newsettings);
+
+    if (oldsettings)
+    {
+        g_retiredAppSettings.push_back(oldsettings);
+        for (size_t i = 0; i < g_appSettingsListeners.size(); i++)
+        {
+            g_appSettingsListeners.at(i)(newsettings);
+        }
+    }
+}
+
+
+// get the current settings, safe to call from any thread
+// don't hold on to the pointer, get a fresh one for each action
+// OnInit loads the settings before anything can ask for them
+const AppSettings * getAppSettings()
+{
+    const AppSettings * settings = g_appSettings.load();
+    wxASSERT_MSG(settings, "app settings used before they were loaded");
+    return settings;
+}
+
+
+// get notified on the main thread, each time new settings are published
+void addAppSettingsListener(AppSettingsListener listener)
+{
+    g_appSettingsListeners.push_back(listener);
+}
@@ -0,0 +1,409 @@
+/*
+    encFSGui - encfsgui_arrival.cpp
+    source file contains code to mount volumes later on,
+    when their encrypted folder shows up after startup
+    (usb disks, network shares, sync folders)
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/filename.h>
+#include <wx/fswatcher.h>
+#include <wx/thread.h>
+#include <wx/timer.h>
+#include <vector>
+#include <map>
+#include <set>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "encfsgui.h"
+
+
+// main window, does the actual mounting
+extern frmMain * g_frmMain;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// a disk that shows up produces a burst of events,
+// wait for things to settle down before looking
+static const int ARRIVAL_SETTLE_DELAY_MS = 1000;
+
+enum
+{
+    ID_TIMER_ARRIVAL_SETTLE = 1
+};
+
+
+// volumes waiting for their encrypted folder, or mounted after it showed up
+// main thread only
+static std::set<wxString> g_armedVolumes;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+// the folder to watch for a volume: the encrypted folder itself if it's there
+// (waiting for the config file), or the nearest parent folder that exists
+static wxString getArrivalWatchFolder(const wxString& enc_path)
+{
+    wxFileName folder = wxFileName::DirName(enc_path);
+    while (!folder.DirExists() && folder.GetDirCount() > 0)
+    {
+        folder.RemoveLastDir();
+    }
+    return folder.GetPath();
+}
+
+
+class ArrivalWatcher;
+
+
+#ifndef __WXOSX__
+
+// ----------------------------------------------------------------------------
+// MountTableThread - waits for changes to the mount table
+// the kernel flags /proc/self/mountinfo with POLLPRI on each mount & unmount
+// ----------------------------------------------------------------------------
+
+class MountTableThread : public wxThread
+{
+public:
+    MountTableThread(ArrivalWatcher * owner) : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_owner = owner;
+        // close-on-exec right away, so mount & encfs children don't inherit them
+        m_mountinfofd = open("/proc/self/mountinfo", O_RDONLY | O_CLOEXEC);
+        m_stoppipe[0] = -1;
+        m_stoppipe[1] = -1;
+        if (pipe2(m_stoppipe, O_CLOEXEC) != 0)
+        {
+            m_stoppipe[0] = -1;
+            m_stoppipe[1] = -1;
+        }
+    }
+
+    ~MountTableThread()
+    {
+        if (m_mountinfofd >= 0)
+        {
+            close(m_mountinfofd);
+        }
+        if (m_stoppipe[0] >= 0)
+        {
+            close(m_stoppipe[0]);
+            close(m_stoppipe[1]);
+        }
+    }
+
+    bool CanRun() const
+    {
+        return (m_mountinfofd >= 0 && m_stoppipe[0] >= 0);
+    }
+
+    // wake up the thread, so it can be joined
+    void Stop()
+    {
+        char c = 0;
+        if (write(m_stoppipe[1], &c, 1) < 0)
+        {
+            // nothing else we can do, the thread stays blocked in poll
+        }
+    }
+
+protected:
+    virtual ExitCode Entry();
+
+private:
+    ArrivalWatcher * m_owner;
+    int m_mountinfofd;
+    int m_stoppipe[2];
+};
+
+#endif
+
+
+// ----------------------------------------------------------------------------
+// ArrivalWatcher - watches the folders the armed volumes are waiting on
+// and the mount table, no polling
+// ----------------------------------------------------------------------------
+
+class ArrivalWatcher : public wxEvtHandler
+{
+public:
+    ArrivalWatcher();
+    virtual ~ArrivalWatcher();
+    bool Start();
+    void UpdateWatches();
+    void OnMountTableChanged();
+
+private:
+    void OnFileSystemEvent(wxFileSystemWatcherEvent& event);
+    void OnSettleTimer(wxTimerEvent& event);
+
+    wxFileSystemWatcher * m_watcher;
+    wxTimer m_settletimer;
+    std::set<wxString> m_watched;
+    bool m_checking;
+    bool m_recheck;
+#ifndef __WXOSX__
+    MountTableThread * m_mounttablethread;
+#endif
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(ArrivalWatcher, wxEvtHandler)
+    EVT_FSWATCHER(wxID_ANY, ArrivalWatcher::OnFileSystemEvent)
+    EVT_TIMER(ID_TIMER_ARRIVAL_SETTLE, ArrivalWatcher::OnSettleTimer)
+wxEND_EVENT_TABLE()
+
+
+ArrivalWatcher::ArrivalWatcher() : m_settletimer(this, ID_TIMER_ARRIVAL_SETTLE)
+{
+    m_watcher = NULL;
+    m_checking = false;
+    m_recheck = false;
+#ifndef __WXOSX__
+    m_mounttablethread = NULL;
+#endif
+}
+
+
+ArrivalWatcher::~ArrivalWatcher()
+{
+#ifndef __WXOSX__
+    if (m_mounttablethread)
+    {
+        m_mounttablethread->Stop();
+        m_mounttablethread->Wait();
+        delete m_mounttablethread;
+    }
+#endif
+    m_settletimer.Stop();
+    delete m_watcher;
+}
+
+
+// needs a running event loop
+bool ArrivalWatcher::Start()
+{
+    m_watcher = new wxFileSystemWatcher();
+    m_watcher->SetOwner(this);
+#ifdef __WXOSX__
+    // external disks & network shares show up here
+    m_watcher->Add(wxFileName::DirName("/Volumes"), wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME);
+#else
+    m_mounttablethread = new MountTableThread(this);
+    if (!m_mounttablethread->CanRun() || m_mounttablethread->Run() != wxTHREAD_NO_ERROR)
+    {
+        // folder events still get picked up
+        delete m_mounttablethread;
+        m_mounttablethread = NULL;
+    }
+#endif
+    UpdateWatches();
+    return true;
+}
+
+
+// watch the folders the armed volumes depend on, and nothing else
+void ArrivalWatcher::UpdateWatches()
+{
+    std::set<wxString> folders;
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    for (std::set<wxString>::iterator it = g_armedVolumes.begin(); it != g_armedVolumes.end(); it++)
+    {
+        const DBEntry * thisvol = snapshot->getVolume(*it);
+        if (!thisvol)
+        {
+            continue;
+        }
+        if (thisvol->getMountState())
+        {
+            // notice when the encrypted folder goes away
+            wxFileName enc = wxFileName::DirName(thisvol->getEncPath());
+            enc.RemoveLastDir();
+            folders.insert(enc.GetPath());
+        }
+        else
+        {
+            folders.insert(getArrivalWatchFolder(thisvol->getEncPath()));
+        }
+    }
+
+    for (std::set<wxString>::iterator it = m_watched.begin(); it != m_watched.end(); it++)
+    {
+        if (folders.find(*it) == folders.end())
+        {
+            m_watcher->Remove(wxFileName::DirName(*it));
+        }
+    }
+    std::set<wxString> watched;
+    for (std::set<wxString>::iterator it = folders.begin(); it != folders.end(); it++)
+    {
+        if (m_watched.find(*it) != m_watched.end() ||
+            m_watcher->Add(wxFileName::DirName(*it), wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME))
+        {
+            watched.insert(*it);
+        }
+    }
+    m_watched = watched;
+}
+
+
+void ArrivalWatcher::OnFileSystemEvent(wxFileSystemWatcherEvent& event)
+{
+    if (event.GetChangeType() & (wxFSW_EVENT_WARNING | wxFSW_EVENT_ERROR))
+    {
+        return;
+    }
+    // restart the delay on each event
+    m_settletimer.StartOnce(ARRIVAL_SETTLE_DELAY_MS);
+}
+
+
+// a disk got mounted or unmounted
+void ArrivalWatcher::OnMountTableChanged()
+{
+    m_settletimer.StartOnce(ARRIVAL_SETTLE_DELAY_MS);
+}
+
+
+void ArrivalWatcher::OnSettleTimer(wxTimerEvent& WXUNUSED(event))
+{
+    if (m_checking)
+    {
+        // mounting shows dialogs, which run the event loop
+        m_recheck = true;
+        return;
+    }
+    if (g_armedVolumes.empty())
+    {
+        return;
+    }
+    m_checking = true;
+    do
+    {
+        m_recheck = false;
+        if (g_frmMain)
+        {
+            g_frmMain->CheckArmedVolumes();
+        }
+        UpdateWatches();
+    }
+    while (m_recheck);
+    m_checking = false;
+}
+
+
+#ifndef __WXOSX__
+
+wxThread::ExitCode MountTableThread::Entry()
+{
+    while (true)
+    {
+        struct pollfd fds[2];
+        fds[0].fd = m_mountinfofd;
+        fds[0].events = POLLPRI;
+        fds[0].revents = 0;
+        fds[1].fd = m_stoppipe[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0)
+        {
+            continue;
+        }
+        if (fds[1].revents != 0)
+        {
+            break;
+        }
+        if (fds[0].revents & (POLLPRI | POLLERR))
+        {
+            // the flag stays up until the file gets read again
+            char buf[4096];
+            lseek(m_mountinfofd, 0, SEEK_SET);
+            while (read(m_mountinfofd, buf, sizeof(buf)) > 0)
+            {
+            }
+            m_owner->CallAfter(&ArrivalWatcher::OnMountTableChanged);
+        }
+    }
+    return (ExitCode)0;
+}
+
+#endif
+
+
+static ArrivalWatcher * g_arrivalWatcher = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// main thread only
+// ----------------------------------------------------------------------------
+
+void startArrivalWatcher()
+{
+    if (g_arrivalWatcher)
+    {
+        return;
+    }
+    g_arrivalWatcher = new ArrivalWatcher();
+    g_arrivalWatcher->Start();
+}
+
+
+void stopArrivalWatcher()
+{
+    delete g_arrivalWatcher;
+    g_arrivalWatcher = NULL;
+}
+
+
+// mount these volumes as soon as their encrypted folder shows up
+void armDeferredMounts(const wxArrayString& volumes)
+{
+    for (size_t i = 0; i < volumes.GetCount(); i++)
+    {
+        g_armedVolumes.insert(volumes[i]);
+    }
+    if (g_arrivalWatcher)
+    {
+        g_arrivalWatcher->UpdateWatches();
+    }
+}
+
+
+// the user took over (e.g. unmounted the volume by hand)
+void disarmDeferredMount(const wxString& volname)
+{
+    if (g_armedVolumes.erase(volname) > 0 && g_arrivalWatcher)
+    {
+        g_arrivalWatcher->UpdateWatches();
+    }
+}
+
+
+wxArrayString getArmedVolumes()
+{
+    wxArrayString volumes;
+    for (std::set<wxString>::iterator it = g_armedVolumes.begin(); it != g_armedVolumes.end(); it++)
+    {
+        volumes.Add(*it);
+    }
+    return volumes;
+}
@@ -0,0 +1,688 @@
+/*
+    encFSGui - encfsgui_discover.cpp
+    source file contains code to search folder trees
+    for encfs volumes that are not registered yet
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+#include <wx/progdlg.h>
+#include <wx/choicdlg.h>
+#include <wx/textdlg.h>
+#include <wx/filename.h>
+#include <wx/tokenzr.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the walk is bound by the disk, a few threads are enough to keep it busy
+static const unsigned int DISCOVER_NR_THREADS = 4;
+// max nr of folders read per second, so a spinning disk doesn't get hammered
+static const long DISCOVER_MAX_DIRS_PER_SEC = 1000;
+// only the first errors are shown
+static const size_t DISCOVER_MAX_REPORTED_ERRORS = 20;
+
+// never worth walking into
+static const char * DISCOVER_SKIP_DIRS[] = { "/dev",
+                                             "/proc",
+                                             "/sys",
+                                             "/private/var/vm",
+                                             "/System" };
+
+
+// ----------------------------------------------------------------------------
+// DiscoverRateLimiter - hands out folder reads at a fixed rate
+// ----------------------------------------------------------------------------
+
+class DiscoverRateLimiter
+{
+public:
+    DiscoverRateLimiter(long maxpersec)
+    {
+        m_interval = std::chrono::microseconds(1000000 / maxpersec);
+        m_next = std::chrono::steady_clock::now();
+    }
+
+    // wait for the next free slot
+    void Acquire()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point slot;
+        {
+            wxCriticalSectionLocker lock(m_lock);
+            // unused slots don't pile up
+            if (m_next < now)
+            {
+                m_next = now;
+            }
+            slot = m_next;
+            m_next += m_interval;
+        }
+        if (slot > now)
+        {
+            wxMicroSleep(std::chrono::duration_cast<std::chrono::microseconds>(slot - now).count());
+        }
+    }
+
+private:
+    wxCriticalSection m_lock;
+    std::chrono::microseconds m_interval;
+    std::chrono::steady_clock::time_point m_next;
+};
+
+
+// ----------------------------------------------------------------------------
+// DiscoverScan - state shared by the walker threads
+// each thread has its own queue of folders, and takes work from the
+// other queues when it runs out
+// paths are kept as file system bytes, they only become wxStrings at the end
+// the walk stays on the device of the root it started from
+// ----------------------------------------------------------------------------
+
+// open folder, closed when the last of its queued subfolders is read
+class DiscoverFd
+{
+public:
+    DiscoverFd(int fd)
+    {
+        m_fd = fd;
+    }
+
+    ~DiscoverFd()
+    {
+        close(m_fd);
+    }
+
+    int m_fd;
+};
+
+
+class DiscoverDir
+{
+public:
+    // the folder is opened relative to its parent, roots have no parent
+    std::shared_ptr<DiscoverFd> m_parent;
+    std::string m_name;
+    std::string m_path;
+    dev_t m_rootdev;
+};
+
+
+class DiscoverQueue
+{
+public:
+    std::deque<DiscoverDir> m_dirs;
+    wxCriticalSection m_lock;
+};
+
+
+class DiscoverScan
+{
+public:
+    DiscoverScan(unsigned int nrqueues) : m_ratelimiter(DISCOVER_MAX_DIRS_PER_SEC)
+    {
+        for (unsigned int i = 0; i < nrqueues; i++)
+        {
+            m_queues.push_back(new DiscoverQueue());
+        }
+        m_pending = 0;
+        m_dirsscanned = 0;
+        m_entriesscanned = 0;
+        m_nrfound = 0;
+        m_cancelled = false;
+    }
+
+    ~DiscoverScan()
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            delete m_queues.at(i);
+        }
+    }
+
+    void Push(unsigned int queue, const std::shared_ptr<DiscoverFd>& parent, const std::string& name, const std::string& path, dev_t rootdev)
+    {
+        if (m_skip.find(path) != m_skip.end())
+        {
+            return;
+        }
+        DiscoverDir dir;
+        dir.m_parent = parent;
+        dir.m_name = name;
+        dir.m_path = path;
+        dir.m_rootdev = rootdev;
+        // counted before it's queued, so the count can't hit 0 while work is left
+        ++m_pending;
+        wxCriticalSectionLocker lock(m_queues.at(queue)->m_lock);
+        m_queues.at(queue)->m_dirs.push_back(dir);
+    }
+
+    // own queue: newest first, keeps the walk depth first and the queues short
+    // other queues: oldest first, those are the biggest subtrees
+    bool Pop(unsigned int queue, DiscoverDir& dir)
+    {
+        for (size_t i = 0; i < m_queues.size(); i++)
+        {
+            DiscoverQueue * q = m_queues.at((queue + i) % m_queues.size());
+            wxCriticalSectionLocker lock(q->m_lock);
+            if (q->m_dirs.empty())
+            {
+                continue;
+            }
+            if (i == 0)
+            {
+                dir = q->m_dirs.back();
+                q->m_dirs.pop_back();
+            }
+            else
+            {
+                dir = q->m_dirs.front();
+                q->m_dirs.pop_front();
+            }
+            return true;
+        }
+        return false;
+    }
+
+    void AddHit(const std::string& path)
+    {
+        wxCriticalSectionLocker lock(m_hitlock);
+        m_hits.push_back(path);
+        ++m_nrfound;
+    }
+
+    bool IsDone() const
+    {
+        return (m_cancelled || m_pending == 0);
+    }
+
+    // set up before the threads start, read-only afterwards
+    std::set<std::string> m_skip;
+    std::set<std::string> m_registered;
+
+    std::vector<DiscoverQueue*> m_queues;
+    DiscoverRateLimiter m_ratelimiter;
+    std::atomic<long> m_pending;
+    std::atomic<long> m_dirsscanned;
+    std::atomic<long> m_entriesscanned;
+    std::atomic<long> m_nrfound;
+    std::atomic<bool> m_cancelled;
+
+    wxCriticalSection m_hitlock;
+    std::vector<std::string> m_hits;
+};
+
+
+// ----------------------------------------------------------------------------
+// DiscoverThread - walks folders until there are none left
+// ----------------------------------------------------------------------------
+
+class DiscoverThread : public wxThread
+{
+public:
+    DiscoverThread(DiscoverScan * scan, unsigned int queue) : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_scan = scan;
+        m_queue = queue;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        while (!m_scan->m_cancelled)
+        {
+            DiscoverDir dir;
+            if (m_scan->Pop(m_queue, dir))
+            {
+                m_scan->m_ratelimiter.Acquire();
+                ScanDir(dir);
+                --m_scan->m_pending;
+            }
+            else if (m_scan->m_pending == 0)
+            {
+                break;
+            }
+            else
+            {
+                // other threads are still reading, they may find more work
+                wxMilliSleep(1);
+            }
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    void ScanDir(const DiscoverDir& thisdir)
+    {
+        const std::string& path = thisdir.m_path;
+        int dirfd;
+        if (thisdir.m_parent)
+        {
+            dirfd = openat(thisdir.m_parent->m_fd, thisdir.m_name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+        else
+        {
+            dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        }
+        if (dirfd < 0)
+        {
+            return;
+        }
+        // subfolders were checked before they got queued, this catches roots
+        // and folders that got replaced in the mean time
+        struct stat dirst;
+        if (fstat(dirfd, &dirst) != 0 || dirst.st_dev != thisdir.m_rootdev)
+        {
+            close(dirfd);
+            return;
+        }
+        // readdir gets its own fd, this one stays open for the subfolders
+        int readfd = dup(dirfd);
+        DIR * dir = (readfd < 0) ? NULL : fdopendir(readfd);
+        if (!dir)
+        {
+            if (readfd >= 0)
+            {
+                close(readfd);
+            }
+            close(dirfd);
+            return;
+        }
+        std::shared_ptr<DiscoverFd> parent(new DiscoverFd(dirfd));
+        ++m_scan->m_dirsscanned;
+
+        std::vector<std::string> subdirs;
+        bool isvolume = false;
+        struct dirent * entry;
+        while (!m_scan->m_cancelled && (entry = readdir(dir)) != NULL)
+        {
+            const char * name = entry->d_name;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            {
+                continue;
+            }
+            ++m_scan->m_entriesscanned;
+            if (strcmp(name, ".encfs6.xml") == 0 || strcmp(name, ".encfs5") == 0)
+            {
+                isvolume = true;
+                continue;
+            }
+            // symlinks are never followed, they could loop
+            if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)
+            {
+                continue;
+            }
+            // another disk or a network share mounted inside the root is
+            // never opened, an automount or a stalled server would hang the walk
+            struct stat st;
+            if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode) && st.st_dev == thisdir.m_rootdev)
+            {
+                subdirs.push_back(name);
+            }
+        }
+        closedir(dir);
+
+        if (isvolume)
+        {
+            // the rest of the folder is encrypted data, no need to look further
+            if (m_scan->m_registered.find(path) == m_scan->m_registered.end())
+            {
+                m_scan->AddHit(path);
+            }
+            return;
+        }
+        for (size_t i = 0; i < subdirs.size(); i++)
+        {
+            const std::string& name = subdirs.at(i);
+            m_scan->Push(m_queue, parent, name, (path == "/") ? path + name : path + "/" + name, thisdir.m_rootdev);
+        }
+    }
+
+    DiscoverScan * m_scan;
+    unsigned int m_queue;
+};
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static std::string toFileSystemPath(const wxString& path)
+{
+    wxString normalized = path;
+    while (normalized.Length() > 1 && normalized.EndsWith("/"))
+    {
+        normalized.RemoveLast();
+    }
+    return std::string(normalized.fn_str());
+}
+
+
+static wxString fromFileSystemPath(const std::string& path)
+{
+    return wxString(path.c_str(), *wxConvFileName);
+}
+
+
+// the disks mounted where external drives show up, one per line
+// each one needs to be a root of its own, the walk doesn't leave the device it starts on
+static wxString getDriveRoots()
+{
+#ifdef __WXOSX__
+    static const char * driveparents[] = { "/Volumes/" };
+#else
+    static const char * driveparents[] = { "/media/", "/mnt/" };
+#endif
+    wxString driveroots;
+    wxArrayString mounttable = getSystemMountTable();
+    for (size_t i = 0; i < mounttable.GetCount(); i++)
+    {
+        // "<device> on <mount point> (<fs type>)"
+        const wxString& line = mounttable[i];
+        int on = line.Find(" on ");
+        int type = line.Find(" (", true);
+        if (on == wxNOT_FOUND || type == wxNOT_FOUND || type < on)
+        {
+            continue;
+        }
+        wxString mountpoint = line.Mid(on + 4, type - on - 4);
+        // mounted volumes are never searched
+        if (line.Left(on).StartsWith("encfs") || line.Mid(type).Contains("encfs"))
+        {
+            continue;
+        }
+        for (size_t p = 0; p < sizeof(driveparents) / sizeof(driveparents[0]); p++)
+        {
+            if (mountpoint.StartsWith(driveparents[p]))
+            {
+                driveroots << "\n" << mountpoint;
+                break;
+            }
+        }
+    }
+    return driveroots;
+}
+
+
+static void showDiscoverMessage(wxWindow * parent, const wxString& msg, const wxString& title, long icon)
+{
+    wxMessageDialog * dlg = new wxMessageDialog(parent, msg, title, wxOK|wxCENTRE|icon);
+    dlg->ShowModal();
+    dlg->Destroy();
+}
+
+
+// walk the roots, returns the folders of the unregistered volumes found
+// returns false if the user cancelled
+static bool findUnregisteredVolumes(wxWindow * parent, wxArrayString& roots, wxArrayString& found)
+{
+    DiscoverScan scan(DISCOVER_NR_THREADS);
+
+    // no need to look at registered volumes, or inside mounted ones
+    std::vector<VolumeRecord> records;
+    loadVolumeRecords(records);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        scan.m_registered.insert(toFileSystemPath(records.at(i).m_enc_path));
+        scan.m_skip.insert(toFileSystemPath(records.at(i).m_mount_path));
+    }
+    for (size_t i = 0; i < sizeof(DISCOVER_SKIP_DIRS) / sizeof(DISCOVER_SKIP_DIRS[0]); i++)
+    {
+        scan.m_skip.insert(DISCOVER_SKIP_DIRS[i]);
+    }
+    for (size_t i = 0; i < roots.GetCount(); i++)
+    {
+        std::string root = toFileSystemPath(roots[i]);
+        struct stat rootst;
+        if (stat(root.c_str(), &rootst) == 0)
+        {
+            scan.Push(i % DISCOVER_NR_THREADS, std::shared_ptr<DiscoverFd>(), root, root, rootst.st_dev);
+        }
+    }
+
+    std::vector<DiscoverThread*> threads;
+    for (unsigned int i = 0; i < DISCOVER_NR_THREADS; i++)
+    {
+        DiscoverThread * thread = new DiscoverThread(&scan, i);
+        if (thread->Run() == wxTHREAD_NO_ERROR)
+        {
+            threads.push_back(thread);
+        }
+        else
+        {
+            delete thread;
+        }
+    }
+    if (threads.empty())
+    {
+        showDiscoverMessage(parent, "Unable to start the search", "Discover EncFS folders", wxICON_ERROR);
+        return false;
+    }
+
+    // the walk runs on the threads, the dialog keeps the app responsive
+    wxProgressDialog * progress = new wxProgressDialog("Discover EncFS folders",
+                                                       "Searching for EncFS folders...",
+                                                       100,
+                                                       parent,
+                                                       wxPD_APP_MODAL|wxPD_AUTO_HIDE|wxPD_CAN_ABORT|wxPD_ELAPSED_TIME);
+    while (!scan.IsDone())
+    {
+        wxString msg;
+        msg.Printf(wxT("Searched %ld folders (%ld entries), found %ld new EncFS folders..."),
+                   (long)scan.m_dirsscanned, (long)scan.m_entriesscanned, (long)scan.m_nrfound);
+        if (!progress->Pulse(msg))
+        {
+            scan.m_cancelled = true;
+        }
+        wxMilliSleep(100);
+    }
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->Wait();
+        delete threads[i];
+    }
+    progress->Destroy();
+
+    if (scan.m_cancelled)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < scan.m_hits.size(); i++)
+    {
+        found.Add(fromFileSystemPath(scan.m_hits.at(i)));
+    }
+    found.Sort();
+    return true;
+}
+
+
+// name for a new volume, based on the name of the encrypted folder
+static wxString getDiscoveredVolumeName(const wxString& enc_path, std::set<wxString>& names)
+{
+    // sanitize the name, same as the dialogs do
+    wxString basename = sanitizeVolumeName(wxFileName(enc_path).GetFullName());
+    // no hidden names
+    while (basename.StartsWith("."))
+    {
+        basename.Remove(0, 1);
+    }
+    if (basename.IsEmpty())
+    {
+        basename = "volume";
+    }
+    wxString volname = basename;
+    for (int i = 2; names.find(volname) != names.end() || doesVolumeExist(volname); i++)
+    {
+        volname.Printf(wxT("%s_%d"), basename, i);
+    }
+    names.insert(volname);
+    return volname;
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// search folder trees for encfs volumes, and register the ones the user picks
+void discoverVolumes(wxWindow * parent)
+{
+    // default roots: the home folder & the external drives
+    wxString defaultroots = wxGetHomeDir();
+    defaultroots << getDriveRoots();
+    wxTextEntryDialog rootsDialog(parent,
+                                  "Folders to search, one per line.\nDisks mounted inside these folders are not searched, add them separately.",
+                                  "Discover EncFS folders",
+                                  defaultroots,
+                                  wxOK|wxCANCEL|wxCENTRE|wxTE_MULTILINE);
+    if (rootsDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    wxArrayString roots;
+    wxArrayString lines = wxStringTokenize(rootsDialog.GetValue(), "\n", wxTOKEN_STRTOK);
+    for (size_t i = 0; i < lines.GetCount(); i++)
+    {
+        wxString root = lines[i].Trim().Trim(false);
+        if (!root.IsEmpty() && wxDirExists(root))
+        {
+            roots.Add(root);
+        }
+    }
+    if (roots.IsEmpty())
+    {
+        showDiscoverMessage(parent, "None of the folders exist", "Discover EncFS folders", wxICON_ERROR);
+        return;
+    }
+
+    wxArrayString found;
+    if (!findUnregisteredVolumes(parent, roots, found))
+    {
+        return;
+    }
+    if (found.IsEmpty())
+    {
+        showDiscoverMessage(parent, "No new EncFS folders found", "Discover EncFS folders", wxICON_INFORMATION);
+        return;
+    }
+
+    // let the user pick, all of them are selected by default
+    wxMultiChoiceDialog choiceDialog(parent,
+                                     "Select the EncFS folders to add:",
+                                     "Discover EncFS folders",
+                                     found);
+    wxArrayInt selections;
+    for (size_t i = 0; i < found.GetCount(); i++)
+    {
+        selections.Add(i);
+    }
+    choiceDialog.SetSelections(selections);
+    if (choiceDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    selections = choiceDialog.GetSelections();
+    if (selections.IsEmpty())
+    {
+        return;
+    }
+
+    // each volume gets its own mount point, inside one folder
+    wxDirDialog mountDirDialog(parent,
+                               "Select the folder to create the mount points in",
+                               wxGetHomeDir(),
+                               wxDD_DEFAULT_STYLE);
+    if (mountDirDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    wxString mountbase = mountDirDialog.GetPath();
+
+    std::set<wxString> names;
+    wxArrayString errors;
+    long nrerrors = 0;
+    long nradded = 0;
+    beginVolumeBatch();
+    for (size_t i = 0; i < selections.GetCount(); i++)
+    {
+        wxString enc_path = found[selections[i]];
+        VolumeRecord record;
+        record.m_volname = getDiscoveredVolumeName(enc_path, names);
+        record.m_enc_path = enc_path;
+        record.m_mount_path.Printf(wxT("%s/%s"), mountbase, record.m_volname);
+        record.m_automount = false;
+        record.m_preventautounmount = false;
+        record.m_pwsaved = false;
+        record.m_allowother = false;
+        record.m_mountaslocal = false;
+
+        wxString error;
+        wxString othervolume = findVolumeByMountPath(record.m_mount_path);
+        if (!othervolume.IsEmpty())
+        {
+            error.Printf(wxT("mount point already used by volume '%s'"), othervolume);
+        }
+        else if (!wxDirExists(record.m_mount_path) && !makeDirectories(record.m_mount_path, 0700))
+        {
+            error = "unable to create the mount point";
+        }
+        else if (!checkVolumeFolders(record.m_enc_path, record.m_mount_path, false, error))
+        {
+            // error is set
+        }
+        else if (!saveVolumeRecord(record))
+        {
+            error = "unable to save volume";
+        }
+        else
+        {
+            ++nradded;
+            continue;
+        }
+        ++nrerrors;
+        if (errors.GetCount() < DISCOVER_MAX_REPORTED_ERRORS)
+        {
+            errors.Add(enc_path + ": " + error);
+        }
+    }
+    bool saved = commitVolumeBatch();
+
+    wxString msg;
+    if (!saved && nradded > 0)
+    {
+        showDiscoverMessage(parent, "The volumes could not be saved, nothing was added.", "Discover EncFS folders", wxICON_ERROR);
+        return;
+    }
+    msg.Printf(wxT("Added %ld of %lu EncFS folders."), nradded, (unsigned long)selections.GetCount());
+    if (nrerrors > 0)
+    {
+        msg << "\n\n" << formatLimitedList(errors, (size_t)nrerrors);
+    }
+    showDiscoverMessage(parent, msg, "Discover EncFS folders", (nrerrors == 0) ? wxICON_INFORMATION : wxICON_WARNING);
+}
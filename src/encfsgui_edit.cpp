@@ -20,6 +20,7 @@
 #include <wx/file.h>
 #include <wx/time.h>
 #include <wx/stdpaths.h>
+#include <wx/spinctrl.h>
 #include <vector>
 #include <map>
 
@@ -62,10 +63,21 @@ frmEditDialog::frmEditDialog(wxWindow *parent,
 }
 
 
+// update the passwordsaved flag of a volume in the volume database
+static void setVolumePasswordSaved(const wxString& volname, bool pwsaved)
+{
+    VolumeRecord record;
+    if (getVolumeRecord(volname, record))
+    {
+        record.m_pwsaved = pwsaved;
+        saveVolumeRecord(record);
+    }
+}
+
+
 void frmEditDialog::Create()
 {
 
-    wxString config_volname;
     wxString srcfolder;
     wxString dstfolder;
     bool automount;
@@ -73,17 +85,20 @@ void frmEditDialog::Create()
     bool savedpassword;
     bool allow_other;
     bool mount_as_local;
-
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    config_volname.Printf(wxT("/Volumes/%s"), m_volumename);
-    pConfig->SetPath(config_volname);
-    srcfolder = pConfig->Read(wxT("enc_path"));
-    dstfolder = pConfig->Read(wxT("mount_path"));
-    automount = pConfig->ReadBool(wxT("automount"), 0l);
-    prevent_autounmount = pConfig->ReadBool(wxT("preventautounmount"),0l);
-    allow_other = pConfig->ReadBool(wxT("allowother"),0l);
-    mount_as_local = pConfig->ReadBool(wxT("mountaslocal"),0l);
-    savedpassword = pConfig->ReadBool(wxT("passwordsaved"),0l);
+    long idletimeout;
+    bool lazymount;
+
+    VolumeRecord record;
+    getVolumeRecord(m_volumename, record);
+    srcfolder = record.m_enc_path;
+    dstfolder = record.m_mount_path;
+    automount = record.m_automount;
+    prevent_autounmount = record.m_preventautounmount;
+    allow_other = record.m_allowother;
+    mount_as_local = record.m_mountaslocal;
+    idletimeout = record.m_idletimeout;
+    lazymount = record.m_lazymount;
+    savedpassword = record.m_pwsaved;
     m_pwsaved = savedpassword;
 
     wxSizer * const sizerMaster = new wxBoxSizer(wxVERTICAL);
@@ -153,6 +168,22 @@ void frmEditDialog::Create()
     m_chkbx_mount_as_local->SetValue(mount_as_local);
     sizerMount->Add(m_chkbx_mount_as_local);
 
+    // idle timeout, applies from the next mount
+    wxSizer * const sizerIdle = new wxBoxSizer(wxHORIZONTAL);
+    sizerIdle->Add(new wxStaticText(this, wxID_ANY, "Unmount after this many minutes without activity (0 = never):"));
+    m_idletimeout_field = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(80,22), wxSP_ARROW_KEYS, 0, 10080, (int)idletimeout);
+    sizerIdle->Add(m_idletimeout_field, wxSizerFlags().Border(wxLEFT, 5));
+    sizerMount->Add(sizerIdle, wxSizerFlags().Border(wxTOP, 5));
+
+    // lazy mount, only works with a saved password
+    m_chkbx_lazymount  = new wxCheckBox(this, wxID_ANY, "Mount in the background when the mount point is first opened (needs a saved password)");
+    m_chkbx_lazymount->SetValue(lazymount);
+#ifdef __WXOSX__
+    // no way to see a folder being opened
+    m_chkbx_lazymount->Disable();
+#endif
+    sizerMount->Add(m_chkbx_lazymount, wxSizerFlags().Border(wxTOP, 5));
+
     sizerMaster->Add(sizerVolume, wxSizerFlags(1).Expand().Border());
     sizerMaster->Add(sizerPassword, wxSizerFlags(1).Expand().Border());
     sizerMaster->Add(sizerMount, wxSizerFlags(1).Expand().Border());
@@ -239,10 +270,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     wxString newvolname = m_volumename_field->GetValue();
 
     //sanitize the volume name
-    newvolname.Replace("/","");
-    newvolname.Replace(" ","");
-    newvolname.Replace("'","");
-    newvolname.Replace('"',"");
+    newvolname = sanitizeVolumeName(newvolname);
     m_volumename_field->SetValue(newvolname);
 
     if (!(m_volumename == newvolname))
@@ -274,7 +302,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
             }
             else
             {
-                if (dir->HasFiles() && dir->HasSubDirs())
+                if (!isDirectoryEmpty(dstfolder))
                 {
                     dst_folder_ok = false;
                     errormsg << "- Destination mount point is not empty\n";
@@ -288,6 +316,14 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }    
     }
     
+    // a mount point can only be used by one volume
+    wxString othervolume = findVolumeByMountPath(m_destination_field->GetValue());
+    if (!othervolume.IsEmpty() && othervolume != m_volumename)
+    {
+        errormsg << "- Destination mount point is already used by volume '" << othervolume << "'\n";
+        dst_folder_ok = false;
+    }
+
     if (!volname_ok || !dst_folder_ok)
     {
         wxString title;
@@ -298,13 +334,27 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
     }
     else
     {
+        wxString encfolder = m_editVolumeData[m_volumename]->getEncPath();
+        if (!confirmVolumePathOverlap(this, encfolder, m_destination_field->GetValue(), m_volumename))
+        {
+            return;
+        }
         // execute actions
+        // rename & option changes get saved together
+        beginVolumeBatch();
         if (renameneeded)
         {
             // rename volumne name in config
             // no need to update map, will be repopulated anyway
             wxString oldvolname = m_volumename;
-            renameVolume(m_volumename, newvolname);
+            if (!renameVolume(m_volumename, newvolname))
+            {
+                rollbackVolumeBatch();
+                wxMessageDialog * dlg = new wxMessageDialog(this, "Unable to rename the volume", "Oops", wxOK|wxCENTRE|wxICON_ERROR);
+                dlg->ShowModal();
+                dlg->Destroy();
+                return;
+            }
             // rename password entry in Keychain if pw was saved
             if (m_pwsaved)
             {
@@ -326,17 +376,19 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         }
 
         // update destination mount point and mount options
-        wxConfigBase *pConfig = wxConfigBase::Get();
-        wxString config_volname;
-        config_volname.Printf(wxT("/Volumes/%s"), m_volumename);
-        pConfig->SetPath(config_volname);
-        wxString mount_path = m_destination_field->GetValue();
-        pConfig->Write(wxT("mount_path"), mount_path );
-        pConfig->Write(wxT("automount"), m_chkbx_automount->GetValue());
-        pConfig->Write(wxT("preventautounmount"),m_chkbx_prevent_autounmount->GetValue());
-        pConfig->Write(wxT("allowother"),m_chkbx_allow_other->GetValue());
-        pConfig->Write(wxT("mountaslocal"),m_chkbx_mount_as_local->GetValue());
-        pConfig->Flush();
+        VolumeRecord record;
+        if (getVolumeRecord(m_volumename, record))
+        {
+            record.m_mount_path = m_destination_field->GetValue();
+            record.m_automount = m_chkbx_automount->GetValue();
+            record.m_preventautounmount = m_chkbx_prevent_autounmount->GetValue();
+            record.m_allowother = m_chkbx_allow_other->GetValue();
+            record.m_mountaslocal = m_chkbx_mount_as_local->GetValue();
+            record.m_idletimeout = m_idletimeout_field->GetValue();
+            record.m_lazymount = m_chkbx_lazymount->GetValue();
+            saveVolumeRecord(record);
+        }
+        commitVolumeBatch();
 
         bool okToClose = true;
         // password updates needed ?
@@ -359,9 +411,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
                 wxString pwaddoutput;
                 cmd.Printf(wxT("sh -c \"security delete-generic-password -U -a 'EncFSGUI_%s' -s 'EncFSGUI_%s' login.keychain\""), newvolname, newvolname);
                 pwaddoutput = StrRunCMDSync(cmd);
-                pConfig->SetPath(config_volname);
-                pConfig->Write(wxT("passwordsaved"), false);
-                pConfig->Flush();
+                setVolumePasswordSaved(m_volumename, false);
                 okToClose = true;
             }
         }
@@ -385,9 +435,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
                     cmd.Printf(wxT("sh -c \"security add-generic-password -U -a 'EncFSGUI_%s' -s 'EncFSGUI_%s' -w '%s' login.keychain\""), newvolname, newvolname, pw);
                     pw = "";
                     pwaddoutput = StrRunCMDSync(cmd);
-                    pConfig->SetPath(config_volname);
-                    pConfig->Write(wxT("passwordsaved"), true);
-                    pConfig->Flush();
+                    setVolumePasswordSaved(m_volumename, true);
                     okToClose = true;
                 }
             }
@@ -412,9 +460,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
                     cmd.Printf(wxT("sh -c \"security add-generic-password -U -a 'EncFSGUI_%s' -s 'EncFSGUI_%s' -w '%s' login.keychain\""), newvolname, newvolname, pw);
                     pw = "";
                     pwaddoutput = StrRunCMDSync(cmd);
-                    pConfig->SetPath(config_volname);
-                    pConfig->Write(wxT("passwordsaved"), true);
-                    pConfig->Flush();
+                    setVolumePasswordSaved(m_volumename, true);
                     okToClose = true;
                 }
             }
@@ -436,7 +482,7 @@ void frmEditDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
 void editExistingEncFSFolder(wxWindow *parent, wxString& selectedvolume, std::map<wxString, DBEntry*> volumedata)
 {
     wxSize frmEditSize;
-    frmEditSize.Set(600,540);
+    frmEditSize.Set(600,595);
     long framestyle;
     framestyle = wxDEFAULT_FRAME_STYLE | wxFRAME_EX_METAL;
 
@@ -0,0 +1,107 @@
+/*
+    encFSGui - encfsgui_fs.cpp
+    source file contains file system helpers that use
+    system calls directly, instead of running mkdir, chmod & co
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/utils.h>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <string.h>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// except for openWithDefaultApp, these only do system calls
+// so they are safe to use from worker threads
+// ----------------------------------------------------------------------------
+
+bool isDirectory(const wxString& path)
+{
+    struct stat st;
+    return (stat(path.fn_str(), &st) == 0 && S_ISDIR(st.st_mode));
+}
+
+
+// a mount point should not contain anything, except for Finder leftovers
+// stops at the first entry, so this is fast on big folders as well
+bool isDirectoryEmpty(const wxString& path)
+{
+    DIR * dir = opendir(path.fn_str());
+    if (!dir)
+    {
+        return false;
+    }
+    bool empty = true;
+    struct dirent * entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") != 0 &&
+            strcmp(entry->d_name, "..") != 0 &&
+            strcmp(entry->d_name, ".DS_Store") != 0)
+        {
+            empty = false;
+            break;
+        }
+    }
+    closedir(dir);
+    return empty;
+}
+
+
+// create a folder and its missing parents (mkdir -p)
+// folders that get created get the given mode, existing ones are left alone
+bool makeDirectories(const wxString& path, int mode)
+{
+    std::string fspath(path.fn_str());
+    if (fspath.empty())
+    {
+        return false;
+    }
+    size_t pos = 0;
+    while (pos != std::string::npos)
+    {
+        pos = fspath.find('/', pos + 1);
+        std::string part = fspath.substr(0, pos);
+        if (mkdir(part.c_str(), (mode_t)mode) != 0 && errno != EEXIST)
+        {
+            // some systems report EACCES for existing folders we can't write to
+            struct stat st;
+            if (stat(part.c_str(), &st) != 0 || !S_ISDIR(st.st_mode))
+            {
+                return false;
+            }
+        }
+    }
+    return isDirectory(path);
+}
+
+
+bool setPermissions(const wxString& path, int mode)
+{
+    return (chmod(path.fn_str(), (mode_t)mode) == 0);
+}
+
+
+// open a file or folder with the default app, e.g. a folder in Finder
+// uses Launch Services on OSX, xdg-open elsewhere, never through a shell
+// main thread only
+bool openWithDefaultApp(const wxString& path)
+{
+    return wxLaunchDefaultApplication(path);
+}
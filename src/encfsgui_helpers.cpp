@@ -22,16 +22,21 @@
 #include <wx/stdpaths.h> 
 #include <wx/dir.h>
 #include <wx/tokenzr.h>
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+#include <wx/notifmsg.h>
 #include <map>
+#include <vector>
+#include <string>
 
 #include <fstream>
 
-#include <curl/curl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/wait.h>
 
-//
-// globals
-//
-wxString g_latestversion;
+#include <openssl/evp.h>
 
 // ----------------------------------------------------------------------------
 // helper functions
@@ -43,36 +48,138 @@ void ShowMsg(wxString msg)
 }
 
 
+// strip the characters volume names can't have, the dialogs, discover and import all use this
+wxString sanitizeVolumeName(const wxString& volname)
+{
+    wxString sanitized = volname;
+    sanitized.Replace("/","");
+    sanitized.Replace(" ","");
+    sanitized.Replace("'","");
+    sanitized.Replace('"',"");
+    return sanitized;
+}
+
+
+// one line per entry, and '... and N more' if only the first ones of nrtotal are given
+wxString formatLimitedList(const wxArrayString& lines, size_t nrtotal)
+{
+    wxString text;
+    for (size_t i = 0; i < lines.GetCount(); i++)
+    {
+        text << lines[i] << "\n";
+    }
+    if (nrtotal > lines.GetCount())
+    {
+        text << wxString::Format(wxT("... and %lu more\n"), (unsigned long)(nrtotal - lines.GetCount()));
+    }
+    return text;
+}
+
+
+// warn about overlapping paths, returns true if there are none or the user wants to continue anyway
+bool confirmVolumePathOverlap(wxWindow * parent, const wxString& enc_path, const wxString& mount_path, const wxString& ignorevolume)
+{
+    wxString overlaps = getVolumePathOverlap(enc_path, mount_path, ignorevolume);
+    if (overlaps.IsEmpty())
+    {
+        return true;
+    }
+    wxString msg;
+    msg << "The folders of this volume overlap with other volumes:\n\n" << overlaps << "\nAre you sure you want to continue ?";
+    wxMessageDialog * dlg = new wxMessageDialog(parent, msg, "Overlapping folders", wxYES_NO|wxCENTRE|wxNO_DEFAULT|wxICON_WARNING);
+    bool confirmed = (dlg->ShowModal() == wxID_YES);
+    dlg->Destroy();
+    return confirmed;
+}
+
+
+// a notification has one action at most
+static const int ID_NOTIFY_ACTION = 1;
+
+// a system notification about a volume, deletes itself once it is handled or dismissed
+class VolumeNotification : public wxNotificationMessage
+{
+public:
+    VolumeNotification(const wxString& title, const wxString& msg, const wxString& actionlabel, std::function<void()> action, bool clickruns)
+    {
+        m_action = action;
+        m_clickruns = clickruns;
+        SetTitle(title);
+        SetMessage(msg);
+        if (!actionlabel.IsEmpty())
+        {
+            AddAction(ID_NOTIFY_ACTION, actionlabel);
+        }
+    }
+
+private:
+    void OnAction(wxCommandEvent& WXUNUSED(event))
+    {
+        Done(true);
+    }
+
+    void OnClick(wxCommandEvent& WXUNUSED(event))
+    {
+        Done(m_clickruns);
+    }
+
+    void OnDismissed(wxCommandEvent& WXUNUSED(event))
+    {
+        Done(false);
+    }
+
+    void Done(bool runaction)
+    {
+        if (runaction && m_action)
+        {
+            m_action();
+        }
+        wxTheApp->ScheduleForDestruction(this);
+    }
+
+    std::function<void()> m_action;
+    bool m_clickruns;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(VolumeNotification, wxNotificationMessage)
+    EVT_NOTIFICATION_MESSAGE_ACTION(wxID_ANY, VolumeNotification::OnAction)
+    EVT_NOTIFICATION_MESSAGE_CLICK(wxID_ANY, VolumeNotification::OnClick)
+    EVT_NOTIFICATION_MESSAGE_DISMISSED(wxID_ANY, VolumeNotification::OnDismissed)
+wxEND_EVENT_TABLE()
+
+
+// show a notification, action runs on the main thread when actionlabel gets picked
+// (or the notification gets clicked, if clickruns is set)
+void showVolumeNotification(const wxString& title, const wxString& msg, const wxString& actionlabel, std::function<void()> action, bool clickruns)
+{
+    VolumeNotification * notification = new VolumeNotification(title, msg, actionlabel, action, clickruns);
+    notification->Show();
+}
+
+
 // get full path to encfs from config
 // or resort to default value if config does not exist (yet)
 // and save to config
 wxString getEncFSBinPath()
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    return pConfig->Read(wxT("encfsbinpath"), "/usr/local/bin/encfs");
+    return getAppSettings()->getEncFSBinPath();
 }
 
 wxString getEncFSCTLBinPath()
 {
-    wxString returnval;
-    returnval = getEncFSBinPath();
-    returnval << "ctl";
-    return returnval;
+    return getAppSettings()->getEncFSCTLBinPath();
 }
 
 wxString getMountBinPath()
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    return pConfig->Read(wxT("mountbinpath"), "/sbin/mount");
+    return getAppSettings()->getMountBinPath();
 }
 
 wxString getUMountBinPath()
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    return pConfig->Read(wxT("umountbinpath"), "/sbin/umount");
+    return getAppSettings()->getUMountBinPath();
 }
 
 
@@ -130,12 +237,42 @@ wxString arrStrTowxStr(wxArrayString & input)
 }
 
 
+// pipes must not leak into children forked by other threads at the same time,
+// otherwise we never see EOF on them
+// on Linux pipe2 marks them close-on-exec right away, OSX has no pipe2, so there
+// nothing may fork between pipe() and fcntl(), wxExecute included
+static wxCriticalSection g_forkLock;
+
+
+// hold while forking, only needed where pipes can't be created close-on-exec
+class ForkGuard
+{
+public:
+    ForkGuard()
+    {
+#ifdef __WXOSX__
+        g_forkLock.Enter();
+#endif
+    }
+
+    ~ForkGuard()
+    {
+#ifdef __WXOSX__
+        g_forkLock.Leave();
+#endif
+    }
+};
+
+
 // run a command (sync) and return output
 wxString StrRunCMDSync(wxString & cmd)
 {
     wxExecuteEnv env;
     wxArrayString output, errors;
-    wxExecute(cmd, output, errors, 0, &env);
+    {
+        ForkGuard guard;
+        wxExecute(cmd, output, errors, 0, &env);
+    }
     wxString returnvalue = "";
     
     // command line output may end up in errors
@@ -164,7 +301,10 @@ wxArrayString ArrRunCMDASync(wxString & cmd)
 {
     wxExecuteEnv env;
     wxArrayString output;
-    wxExecute(cmd, output, wxEXEC_ASYNC, &env);
+    {
+        ForkGuard guard;
+        wxExecute(cmd, output, wxEXEC_ASYNC, &env);
+    }
     return output;
 }
 
@@ -173,7 +313,10 @@ wxArrayString ArrRunCMDSync(wxString & cmd)
 {
     wxExecuteEnv env;
     wxArrayString output, errors;
-    wxExecute(cmd, output, errors, 0, &env);
+    {
+        ForkGuard guard;
+        wxExecute(cmd, output, errors, 0, &env);
+    }
     // command line output may end up in errors
     // depending on the exit code of the called app
     // so this is not necessarily a problem
@@ -186,6 +329,241 @@ wxArrayString ArrRunCMDSync(wxString & cmd)
 }
 
 
+// run a command directly (no shell, so no quoting issues), feed input to stdin
+// stdout and stderr are captured in output
+// returns the exit code, or -1 if the command could not be started
+// unlike wxExecute, this can be called from worker threads
+int RunCMDArgvSync(const wxArrayString& args, const wxString& input, wxString& output)
+{
+    output = "";
+    if (args.IsEmpty())
+    {
+        return -1;
+    }
+
+    // prepare everything the child needs before forking
+    std::vector<wxCharBuffer> argbuffers;
+    for (size_t n = 0; n < args.GetCount(); n++)
+    {
+        argbuffers.push_back(wxCharBuffer(args[n].utf8_str()));
+    }
+    std::vector<char*> argv;
+    for (size_t n = 0; n < argbuffers.size(); n++)
+    {
+        argv.push_back(argbuffers[n].data());
+    }
+    argv.push_back(NULL);
+    wxCharBuffer inputbuffer(input.utf8_str());
+
+    int inpipe[2];
+    int outpipe[2];
+    pid_t pid;
+    {
+        ForkGuard guard;
+#ifdef __WXOSX__
+        if (pipe(inpipe) != 0)
+        {
+            return -1;
+        }
+        if (pipe(outpipe) != 0)
+        {
+            close(inpipe[0]);
+            close(inpipe[1]);
+            return -1;
+        }
+        fcntl(inpipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(inpipe[1], F_SETFD, FD_CLOEXEC);
+        fcntl(outpipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(outpipe[1], F_SETFD, FD_CLOEXEC);
+#else
+        if (pipe2(inpipe, O_CLOEXEC) != 0)
+        {
+            return -1;
+        }
+        if (pipe2(outpipe, O_CLOEXEC) != 0)
+        {
+            close(inpipe[0]);
+            close(inpipe[1]);
+            return -1;
+        }
+#endif
+
+        pid = fork();
+    }
+    if (pid < 0)
+    {
+        close(inpipe[0]);
+        close(inpipe[1]);
+        close(outpipe[0]);
+        close(outpipe[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        // child
+        dup2(inpipe[0], STDIN_FILENO);
+        dup2(outpipe[1], STDOUT_FILENO);
+        dup2(outpipe[1], STDERR_FILENO);
+        close(inpipe[0]);
+        close(inpipe[1]);
+        close(outpipe[0]);
+        close(outpipe[1]);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+
+    // parent
+    close(inpipe[0]);
+    close(outpipe[1]);
+
+    const char * inputdata = inputbuffer.data();
+    size_t inputlen = strlen(inputdata);
+    while (inputlen > 0)
+    {
+        ssize_t written = write(inpipe[1], inputdata, inputlen);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            break;
+        }
+        inputdata += written;
+        inputlen -= written;
+    }
+    close(inpipe[1]);
+
+    std::string rawoutput;
+    char readbuffer[4096];
+    ssize_t nrread;
+    while ((nrread = read(outpipe[0], readbuffer, sizeof(readbuffer))) != 0)
+    {
+        if (nrread < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        rawoutput.append(readbuffer, nrread);
+    }
+    close(outpipe[0]);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+
+    output = wxString::FromUTF8(rawoutput.c_str());
+    output.Trim();
+    if (WIFEXITED(status))
+    {
+        return WEXITSTATUS(status);
+    }
+    return -1;
+}
+
+
+// start a long running command, feed input to stdin and close it
+// stdout and stderr are appended to logfile
+// the child runs in its own session, so it outlives the app
+// returns the pid, the caller has to reap it, or -1 if the command could not be started
+// unlike wxExecute, this can be called from worker threads
+long SpawnCMDArgv(const wxArrayString& args, const wxString& input, const wxString& logfile)
+{
+    if (args.IsEmpty())
+    {
+        return -1;
+    }
+
+    std::vector<wxCharBuffer> argbuffers;
+    for (size_t n = 0; n < args.GetCount(); n++)
+    {
+        argbuffers.push_back(wxCharBuffer(args[n].utf8_str()));
+    }
+    std::vector<char*> argv;
+    for (size_t n = 0; n < argbuffers.size(); n++)
+    {
+        argv.push_back(argbuffers[n].data());
+    }
+    argv.push_back(NULL);
+    wxCharBuffer inputbuffer(input.utf8_str());
+
+    int inpipe[2];
+    int logfd;
+    pid_t pid;
+    {
+        wxCriticalSectionLocker lock(g_forkLock);
+        logfd = open(logfile.fn_str(), O_WRONLY | O_CREAT | O_APPEND, 0600);
+        if (logfd < 0)
+        {
+            return -1;
+        }
+        if (pipe(inpipe) != 0)
+        {
+            close(logfd);
+            return -1;
+        }
+        fcntl(logfd, F_SETFD, FD_CLOEXEC);
+        fcntl(inpipe[0], F_SETFD, FD_CLOEXEC);
+        fcntl(inpipe[1], F_SETFD, FD_CLOEXEC);
+
+        pid = fork();
+    }
+    if (pid < 0)
+    {
+        close(logfd);
+        close(inpipe[0]);
+        close(inpipe[1]);
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        // child
+        setsid();
+        dup2(inpipe[0], STDIN_FILENO);
+        dup2(logfd, STDOUT_FILENO);
+        dup2(logfd, STDERR_FILENO);
+        close(inpipe[0]);
+        close(inpipe[1]);
+        close(logfd);
+        execv(argv[0], &argv[0]);
+        _exit(127);
+    }
+
+    // parent
+    close(inpipe[0]);
+    close(logfd);
+
+    const char * inputdata = inputbuffer.data();
+    size_t inputlen = strlen(inputdata);
+    while (inputlen > 0)
+    {
+        ssize_t written = write(inpipe[1], inputdata, inputlen);
+        if (written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (written <= 0)
+        {
+            break;
+        }
+        inputdata += written;
+        inputlen -= written;
+    }
+    close(inpipe[1]);
+    return (long)pid;
+}
+
+
 // Get EncFS Version by running encfs --version
 wxString getEncFSBinVersion()
 {
@@ -234,11 +612,7 @@ bool IsVolumeSystemMounted(wxString volpath, wxArrayString mountinfo)
 
 void BrowseFolder(wxString & mountpath)
 {
-    wxString cmd;
-    cmd.Printf(wxT("open '%s'"), mountpath);
-    //wxLogDebug(cmd);
-    wxExecuteEnv env;
-    wxExecute(cmd, wxEXEC_ASYNC, NULL, &env);
+    openWithDefaultApp(mountpath);
 }
 
 wxString getKeychainPassword(wxString & volumename)
@@ -252,32 +626,88 @@ wxString getKeychainPassword(wxString & volumename)
     return output;
 }
 
-bool doesVolumeExist(wxString & volumename)
+// store the password of a volume in Keychain
+// runs security directly, so this is safe to use from worker threads
+bool setKeychainPassword(const wxString& volumename, const wxString& pw)
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Volumes"));
-    wxString thisvolumename;
-    long dummy;
-    bool bCont = pConfig->GetFirstGroup(thisvolumename, dummy);
-    while ( bCont ) { 
-        if (thisvolumename == volumename)
+    wxString fullname;
+    fullname.Printf(wxT("EncFSGUI_%s"), volumename);
+    wxArrayString args;
+    args.Add("/usr/bin/security");
+    args.Add("add-generic-password");
+    args.Add("-U");
+    args.Add("-a");
+    args.Add(fullname);
+    args.Add("-s");
+    args.Add(fullname);
+    args.Add("-w");
+    args.Add(pw);
+    args.Add("login.keychain");
+    wxString output;
+    return (RunCMDArgvSync(args, wxEmptyString, output) == 0);
+}
+
+// measure how many PBKDF2-HMAC-SHA1 blocks this machine can derive per second
+// encfs uses the same primitive to turn the password into the user key
+// the measurement is done once and cached for the lifetime of the app
+long getPBKDF2Rate()
+{
+    static long pbkdf2rate = 0;
+    if (pbkdf2rate > 0)
+    {
+        return pbkdf2rate;
+    }
+
+    const char * calibrationpw = "EncFSGuiCalibration";
+    unsigned char salt[20] = {0};
+    unsigned char key[20];      // 1 SHA1 block
+    long iterations = 1000;
+    wxStopWatch sw;
+
+    // keep doubling the workload until a run takes long enough to be measured reliably
+    while (pbkdf2rate == 0)
+    {
+        sw.Start();
+        PKCS5_PBKDF2_HMAC_SHA1(calibrationpw, strlen(calibrationpw), salt, sizeof(salt), iterations, sizeof(key), key);
+        long elapsed = sw.Time();
+        if (elapsed >= 100 || iterations > 100000000)
         {
-            return true;
+            if (elapsed < 1)
+            {
+                elapsed = 1;
+            }
+            pbkdf2rate = (long)((double)iterations * 1000.0 / (double)elapsed);
+        }
+        else
+        {
+            iterations *= 2;
         }
-        bCont = pConfig->GetNextGroup(thisvolumename, dummy);
     }
-    return false;
+    return pbkdf2rate;
 }
 
-wxArrayString getEncFSVolumeInfo(wxString& encfs_volume)
+
+// encfs derives keysize + 16 bytes (IV) of key material, one SHA1 block = 20 bytes
+long getPBKDF2BlocksForKeySize(long keysize)
 {
-    wxString cmd;
-    wxString encfsctlbin = getEncFSCTLBinPath();
-    wxArrayString cmdoutput;
+    long keymaterial = (keysize / 8) + 16;
+    return (keymaterial + 19) / 20;
+}
+
+
+// predicted time (in ms) needed to derive the key of a volume on this machine
+long getKDFUnlockTime(long kdfiterations, long keysize)
+{
+    double work = (double)kdfiterations * (double)getPBKDF2BlocksForKeySize(keysize);
+    return (long)(work * 1000.0 / (double)getPBKDF2Rate());
+}
 
-    cmd.Printf(wxT("sh -c \"'%s' '%s'\""), encfsctlbin, encfs_volume);
-    cmdoutput = ArrRunCMDSync(cmd);
-    return cmdoutput;
+
+// number of iterations encfs will pick on this machine for a given key derivation duration (ms)
+long getKDFIterationsForDuration(long duration, long keysize)
+{
+    double work = (double)getPBKDF2Rate() * (double)duration / 1000.0;
+    return (long)(work / (double)getPBKDF2BlocksForKeySize(keysize));
 }
 
 wxString getExpectScriptContents(bool insertbreak)
@@ -401,46 +831,62 @@ wxString getExpectScriptContents(bool insertbreak)
     newline.Printf(wxT("expect \"\\n\"\n"));
     scriptcontents << newline;    
     
-    newline.Printf(wxT("sleep x\n"));  
+    newline.Printf(wxT("sleep x\n"));
     scriptcontents << newline;
 
     return scriptcontents;
 }
 
-wxString getChangePasswordScriptContents(wxString & enc_path)
+// paranoia mode has fixed cipher settings, but uses a 3 second key derivation
+wxString getParanoiaExpectScriptContents()
 {
-    wxString scriptcontents;
     wxString newline;
-    wxString encfsctlbin = getEncFSCTLBinPath();
+    wxString scriptcontents;
 
     newline.Printf(wxT("#!/usr/bin/env expect\n"));
     scriptcontents << newline;
 
-    newline.Printf(wxT("set oldpw [lindex $argv 0]\n"));
+    newline.Printf(wxT("set passwd [lindex $argv 0]\n"));
     scriptcontents << newline;
 
-    newline.Printf(wxT("set newpw [lindex $argv 1]\n"));
+    newline.Printf(wxT("set timeout 20\n"));
     scriptcontents << newline;
 
-    newline.Printf(wxT("spawn '%s' autopasswd '%s'\n"), encfsctlbin, enc_path);
+    // launch encfs
+    newline.Printf(wxT("spawn \"$ENCFSBIN\" -v \"$ENCPATH\" \"$MOUNTPATH\"\n"));
     scriptcontents << newline;
 
-    newline.Printf(wxT("expect \"Enter current Encfs password\"\n"));
+    // activate paranoia mode
+    newline.Printf(wxT("expect \"Please choose from one of the following options:\"\n"));
     scriptcontents << newline;
-    
-    newline.Printf(wxT("send \"$oldpw\r\"\n"));
+    newline.Printf(wxT("expect \"?>\"\n"));
+    scriptcontents << newline;
+    newline.Printf(wxT("send \"p\\n\"\n"));
     scriptcontents << newline;
 
-    newline.Printf(wxT("expect \"Enter new Encfs password\"\n"));
+    // password
+    newline.Printf(wxT("expect \"New Encfs Password: \"\n"));
     scriptcontents << newline;
-    
-    newline.Printf(wxT("send \"$newpw\r\"\n"));
+    newline.Printf(wxT("send \"$passwd\\n\"\n"));
+    scriptcontents << newline;
+
+    newline.Printf(wxT("expect \"Verify Encfs Password: \"\n"));
+    scriptcontents << newline;
+    newline.Printf(wxT("send \"$passwd\\n\"\n"));
+    scriptcontents << newline;
+
+    newline.Printf(wxT("puts \"\\nDone.\\n\"\n"));
+    scriptcontents << newline;
+
+    newline.Printf(wxT("expect \"\\n\"\n"));
+    scriptcontents << newline;
+
+    newline.Printf(wxT("sleep x\n"));
     scriptcontents << newline;
 
     return scriptcontents;
 }
 
-
 wxString getLaunchAgentContents()
 {
     const wxString scriptcontents =
@@ -638,6 +1084,8 @@ std::map<wxString, wxString> getEncodingCapabilities()
     } 
 
     // save/rewrite config
+    // wxExecute runs the event loop, the config watcher may have replaced the config object
+    pConfig = wxConfigBase::Get();
     pConfig->SetPath(wxT("/FilenameEncoding"));
     for (std::map<wxString, wxString>::iterator it= encodingcaps.begin(); it != encodingcaps.end(); it++)
     {
@@ -645,96 +1093,11 @@ std::map<wxString, wxString> getEncodingCapabilities()
         wxString encodingval = it->second;
         pConfig->Write(encodingname, encodingval);
     }
-    pConfig->Flush();
+    flushConfig();
     return encodingcaps;
 }
 
 
-void renameVolume(wxString& oldname, wxString& newname)
-{
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    wxString currentvol;
-    wxString newvol;
-    currentvol.Printf(wxT("/Volumes/%s"), oldname);
-    newvol.Printf(wxT("/Volumes/%s"), newname);
-    pConfig->SetPath(currentvol);
-    // get current values
-    wxString enc_path = pConfig->Read(wxT("enc_path"), "");
-    wxString mount_path = pConfig->Read(wxT("mount_path"), "");
-    bool automount = pConfig->ReadBool(wxT("automount"), 0l);
-    bool preventautounmount = pConfig->ReadBool(wxT("preventautounmount"), 0l);
-    bool passwordsaved = pConfig->ReadBool(wxT("passwordsaved"), 0l);
-    bool allowother = pConfig->ReadBool(wxT("allowother"), 0l);
-    bool mountaslocal = pConfig->ReadBool(wxT("mountaslocal"), 0l);
-    // delete old group
-    pConfig->DeleteGroup(currentvol);
-    // create a new one
-    pConfig->SetPath(newvol);
-    pConfig->Write("enc_path", enc_path);
-    pConfig->Write("mount_path", mount_path);
-    pConfig->Write("automount", automount);
-    pConfig->Write("preventautounmount", preventautounmount);
-    pConfig->Write("passwordsaved", passwordsaved);
-    pConfig->Write(wxT("allowother"),allowother);
-    pConfig->Write(wxT("mountaslocal"),mountaslocal);            
-    
-    pConfig->Flush();
-}
-
-
-
-// callback function to get curl content
-static size_t getHTTPContent(void* ptr, size_t size, size_t nmemb)
-{
-    size_t data_size = size * nmemb;
-    g_latestversion.Append((char *)ptr, data_size);
-    return data_size;
-}
-
-
-wxString getLatestVersion()
-{
-    g_latestversion = "";
-    wxString contentbuffer;
-    CURL *pCurlHandle;
-    CURLcode res;
-    curl_global_init(CURL_GLOBAL_DEFAULT);
-
-    pCurlHandle = curl_easy_init();
-    if(pCurlHandle)
-    {
-        curl_easy_setopt(pCurlHandle, CURLOPT_URL, "https://github.com/corelan/EncFSGui/raw/master/release/version.txt");
-        // force SSL peer verification
-        curl_easy_setopt(pCurlHandle, CURLOPT_SSL_VERIFYPEER, 1L);
-        // force hostname verification
-        curl_easy_setopt(pCurlHandle, CURLOPT_SSL_VERIFYHOST, 1L);
-        // no progress meter
-        curl_easy_setopt(pCurlHandle, CURLOPT_NOPROGRESS, 1L);
-        // there might be a redirect
-        curl_easy_setopt(pCurlHandle, CURLOPT_FOLLOWLOCATION, 1L);
-        // go get the data
-        curl_easy_setopt(pCurlHandle, CURLOPT_WRITEFUNCTION, getHTTPContent);
-
-
-        res = curl_easy_perform(pCurlHandle);
-        /* Check for errors */ 
-        if(res != CURLE_OK)
-        {
-            wxString msg;
-            msg.Printf(wxT("curl_easy_perform() failed: %s"), curl_easy_strerror(res));
-            wxLogDebug(msg);
-        }
-        curl_easy_cleanup(pCurlHandle);
-    }
-    curl_global_cleanup();
-
-    g_latestversion.Replace(" ","");
-    g_latestversion.Replace("\r","");
-    g_latestversion.Replace("\n","");
-
-    return g_latestversion;
-}
-
 
 std::map<wxString, long> VersionTokenizerToVersionMap(wxStringTokenizer tokenizer)
 {
@@ -0,0 +1,171 @@
+/*
+    encFSGui - encfsgui_idle.cpp
+    source file contains code to notice volumes that
+    encfs unmounted because nobody used them for a while
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/timer.h>
+#include <vector>
+#include <map>
+
+#include "encfsgui.h"
+
+
+// main window, keeps the volume state
+extern frmMain * g_frmMain;
+// set by QuitApp, from then on nothing gets started again
+extern bool g_shuttingDown;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// encfs does the activity tracking, the app only needs to notice the unmount
+// the timeout is in minutes, so once a minute is plenty
+static const int IDLE_CHECK_INTERVAL_MS = 60000;
+
+enum
+{
+    ID_TIMER_IDLE_CHECK = 1
+};
+
+
+// ----------------------------------------------------------------------------
+// IdleMonitor - only runs while volumes with an idle timeout are mounted
+// ----------------------------------------------------------------------------
+
+class IdleMonitor : public wxEvtHandler
+{
+public:
+    IdleMonitor();
+    virtual ~IdleMonitor();
+    void Update(const std::map<wxString, DBEntry*>& volumedata);
+
+private:
+    void OnCheckTimer(wxTimerEvent& event);
+
+    wxTimer m_checktimer;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(IdleMonitor, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_IDLE_CHECK, IdleMonitor::OnCheckTimer)
+wxEND_EVENT_TABLE()
+
+
+IdleMonitor::IdleMonitor() : m_checktimer(this, ID_TIMER_IDLE_CHECK)
+{
+}
+
+
+IdleMonitor::~IdleMonitor()
+{
+    m_checktimer.Stop();
+}
+
+
+void IdleMonitor::Update(const std::map<wxString, DBEntry*>& volumedata)
+{
+    bool needed = false;
+    for (std::map<wxString, DBEntry*>::const_iterator it = volumedata.begin(); it != volumedata.end() && !needed; it++)
+    {
+        needed = (it->second->getMountState() && it->second->getIdleTimeout() > 0);
+    }
+    if (needed && !m_checktimer.IsRunning())
+    {
+        m_checktimer.Start(IDLE_CHECK_INTERVAL_MS);
+    }
+    else if (!needed && m_checktimer.IsRunning())
+    {
+        m_checktimer.Stop();
+    }
+}
+
+
+// the mount table is read without touching the volumes themselves,
+// a stat on the mount point would count as activity
+void IdleMonitor::OnCheckTimer(wxTimerEvent& WXUNUSED(event))
+{
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    wxArrayString mounttable = getSystemMountTable();
+    wxArrayString unmounted;
+    std::vector<long> timeouts;
+    const std::vector<wxString>& volumes = snapshot->getVolumeNames();
+    for (size_t i = 0; i < volumes.size(); i++)
+    {
+        const DBEntry * thisvol = snapshot->getVolume(volumes.at(i));
+        if (thisvol && thisvol->getMountState() && thisvol->getIdleTimeout() > 0 &&
+            !IsVolumeSystemMounted(thisvol->getMountPath(), mounttable))
+        {
+            unmounted.Add(volumes.at(i));
+            timeouts.push_back(thisvol->getIdleTimeout());
+        }
+    }
+    if (unmounted.IsEmpty() || !g_frmMain)
+    {
+        return;
+    }
+
+    // updates the volumes, which calls Update() again
+    g_frmMain->OnVolumesIdleUnmounted(unmounted);
+    for (size_t i = 0; i < unmounted.GetCount(); i++)
+    {
+        showIdleUnmountNotification(unmounted[i], timeouts.at(i));
+    }
+}
+
+
+static IdleMonitor * g_idleMonitor = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// main thread only
+// ----------------------------------------------------------------------------
+
+// start or stop checking, depending on what is mounted
+void updateIdleMonitor(const std::map<wxString, DBEntry*>& volumedata)
+{
+    if (g_shuttingDown)
+    {
+        return;
+    }
+    if (!g_idleMonitor)
+    {
+        g_idleMonitor = new IdleMonitor();
+    }
+    g_idleMonitor->Update(volumedata);
+}
+
+
+void stopIdleMonitor()
+{
+    delete g_idleMonitor;
+    g_idleMonitor = NULL;
+}
+
+
+// tells the user a volume was unmounted, clicking it (or 'Mount again') mounts it again
+void showIdleUnmountNotification(const wxString& volname, long idletimeout)
+{
+    wxString msg;
+    msg.Printf(wxT("'%s' was unmounted after %ld minutes without activity."), volname, idletimeout);
+    showVolumeNotification("Volume unmounted", msg, "Mount again", [volname]()
+    {
+        if (g_frmMain)
+        {
+            g_frmMain->RemountVolume(volname);
+        }
+    }, true);
+}
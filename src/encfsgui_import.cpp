@@ -0,0 +1,964 @@
+/*
+    encFSGui - encfsgui_import.cpp
+    source file contains code to import & export
+    volume definitions as JSON Lines or CSV files
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/ffile.h>
+#include <wx/filedlg.h>
+#include <wx/filename.h>
+#include <wx/progdlg.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const wxString IMPORT_WILDCARD = "JSON Lines (*.jsonl)|*.jsonl;*.ndjson;*.json|CSV (*.csv)|*.csv";
+
+// the file is read in blocks, and the records are validated & saved in chunks,
+// so a big file never sits in memory as a whole
+static const size_t IMPORT_READ_SIZE = 65536;
+static const size_t IMPORT_CHUNK_SIZE = 256;
+// the checks mostly wait for the disk, so use a few more threads than cpus
+static const unsigned int MAX_IMPORT_THREADS = 8;
+// a quoted CSV field can span lines, but not forever
+static const size_t IMPORT_MAX_RECORD_LENGTH = 65536;
+// only the first errors are shown
+static const size_t IMPORT_MAX_REPORTED_ERRORS = 20;
+
+// field names, same as the keys in the config file
+// passwords are never exported, so there is no passwordsaved field
+static const char * IMPORT_FIELDS[] = { "name",
+                                        "enc_path",
+                                        "mount_path",
+                                        "automount",
+                                        "preventautounmount",
+                                        "allowother",
+                                        "mountaslocal",
+                                        "idletimeout",
+                                        "lazymount" };
+static const size_t IMPORT_NR_FIELDS = sizeof(IMPORT_FIELDS) / sizeof(IMPORT_FIELDS[0]);
+
+
+// ----------------------------------------------------------------------------
+// ImportLineReader - returns the lines of a file, one at a time
+// ----------------------------------------------------------------------------
+
+class ImportLineReader
+{
+public:
+    ImportLineReader(wxFFile * file)
+    {
+        m_file = file;
+        m_pos = 0;
+        m_eof = false;
+        m_lineno = 0;
+        m_block.resize(IMPORT_READ_SIZE);
+    }
+
+    // returns false at the end of the file
+    // valid is false if the line is not UTF-8
+    bool ReadLine(wxString& line, bool& valid)
+    {
+        while (true)
+        {
+            size_t eol = m_buffer.find('\n', m_pos);
+            if (eol != std::string::npos)
+            {
+                valid = SetLine(line, m_buffer.substr(m_pos, eol - m_pos));
+                m_pos = eol + 1;
+                return true;
+            }
+            if (m_eof)
+            {
+                if (m_pos >= m_buffer.size())
+                {
+                    return false;
+                }
+                // last line without a newline
+                valid = SetLine(line, m_buffer.substr(m_pos));
+                m_pos = m_buffer.size();
+                return true;
+            }
+            // keep the partial line, drop the lines that were returned already
+            m_buffer.erase(0, m_pos);
+            m_pos = 0;
+            size_t nread = m_file->Read(&m_block[0], m_block.size());
+            if (nread == 0)
+            {
+                m_eof = true;
+            }
+            else
+            {
+                m_buffer.append(&m_block[0], nread);
+            }
+        }
+    }
+
+    long GetLineNr() const
+    {
+        return m_lineno;
+    }
+
+private:
+    bool SetLine(wxString& line, std::string rawline)
+    {
+        ++m_lineno;
+        if (!rawline.empty() && rawline[rawline.size() - 1] == '\r')
+        {
+            rawline.erase(rawline.size() - 1);
+        }
+        // skip the UTF-8 byte order mark some editors put in front
+        if (m_lineno == 1 && rawline.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        {
+            rawline.erase(0, 3);
+        }
+        line = wxString::FromUTF8(rawline.c_str(), rawline.size());
+        return (rawline.empty() || !line.IsEmpty());
+    }
+
+    wxFFile * m_file;
+    std::vector<char> m_block;
+    std::string m_buffer;
+    size_t m_pos;
+    bool m_eof;
+    long m_lineno;
+};
+
+
+// ----------------------------------------------------------------------------
+// JSON Lines - one flat object per line
+// ----------------------------------------------------------------------------
+
+static void skipJSONSpaces(const wxString& text, size_t& i)
+{
+    while (i < text.Length() && (text[i] == ' ' || text[i] == '\t'))
+    {
+        ++i;
+    }
+}
+
+
+static bool parseJSONHex(const wxString& text, size_t i, unsigned long& code)
+{
+    if (i + 4 > text.Length())
+    {
+        return false;
+    }
+    return text.Mid(i, 4).ToULong(&code, 16);
+}
+
+
+// text[i] is the opening quote, i ends up after the closing quote
+static bool parseJSONString(const wxString& text, size_t& i, wxString& value)
+{
+    value.Clear();
+    ++i;
+    while (i < text.Length())
+    {
+        wxUniChar c = text[i];
+        if (c == '"')
+        {
+            ++i;
+            return true;
+        }
+        if (c != '\\')
+        {
+            value << c;
+            ++i;
+            continue;
+        }
+        if (++i >= text.Length())
+        {
+            return false;
+        }
+        c = text[i++];
+        if (c == '"' || c == '\\' || c == '/')
+        {
+            value << c;
+        }
+        else if (c == 'b')
+        {
+            value << '\b';
+        }
+        else if (c == 'f')
+        {
+            value << '\f';
+        }
+        else if (c == 'n')
+        {
+            value << '\n';
+        }
+        else if (c == 'r')
+        {
+            value << '\r';
+        }
+        else if (c == 't')
+        {
+            value << '\t';
+        }
+        else if (c == 'u')
+        {
+            unsigned long code;
+            if (!parseJSONHex(text, i, code))
+            {
+                return false;
+            }
+            i += 4;
+            // characters outside the BMP come as a surrogate pair
+            unsigned long lowcode;
+            if (code >= 0xD800 && code <= 0xDBFF &&
+                text.Mid(i, 2) == "\\u" &&
+                parseJSONHex(text, i + 2, lowcode) &&
+                lowcode >= 0xDC00 && lowcode <= 0xDFFF)
+            {
+                code = 0x10000 + ((code - 0xD800) << 10) + (lowcode - 0xDC00);
+                i += 6;
+            }
+            value << wxUniChar(code);
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return false;
+}
+
+
+// parse a flat object with string, bool, number or null values
+// bools are returned as "true" or "false", null as an empty string
+static bool parseJSONLine(const wxString& line, std::map<wxString, wxString>& fields, wxString& error)
+{
+    size_t i = 0;
+    skipJSONSpaces(line, i);
+    if (i >= line.Length() || line[i] != '{')
+    {
+        error = "not a JSON object";
+        return false;
+    }
+    ++i;
+    skipJSONSpaces(line, i);
+    if (i < line.Length() && line[i] == '}')
+    {
+        ++i;
+    }
+    else
+    {
+        while (true)
+        {
+            wxString key;
+            wxString value;
+            skipJSONSpaces(line, i);
+            if (i >= line.Length() || line[i] != '"' || !parseJSONString(line, i, key))
+            {
+                error = "invalid field name";
+                return false;
+            }
+            skipJSONSpaces(line, i);
+            if (i >= line.Length() || line[i] != ':')
+            {
+                error.Printf(wxT("missing ':' after '%s'"), key);
+                return false;
+            }
+            ++i;
+            skipJSONSpaces(line, i);
+            if (i >= line.Length())
+            {
+                error.Printf(wxT("missing value for '%s'"), key);
+                return false;
+            }
+            if (line[i] == '"')
+            {
+                if (!parseJSONString(line, i, value))
+                {
+                    error.Printf(wxT("invalid string value for '%s'"), key);
+                    return false;
+                }
+            }
+            else if (line[i] == '{' || line[i] == '[')
+            {
+                error.Printf(wxT("nested value for '%s' is not supported"), key);
+                return false;
+            }
+            else
+            {
+                // true, false, null or a number
+                size_t start = i;
+                while (i < line.Length() && line[i] != ',' && line[i] != '}' && line[i] != ' ' && line[i] != '\t')
+                {
+                    ++i;
+                }
+                value = line.Mid(start, i - start);
+                if (value == "null")
+                {
+                    value.Clear();
+                }
+                else if (value != "true" && value != "false" && !value.IsNumber())
+                {
+                    error.Printf(wxT("invalid value for '%s'"), key);
+                    return false;
+                }
+            }
+            fields[key] = value;
+            skipJSONSpaces(line, i);
+            if (i < line.Length() && line[i] == ',')
+            {
+                ++i;
+                continue;
+            }
+            if (i < line.Length() && line[i] == '}')
+            {
+                ++i;
+                break;
+            }
+            error = "missing ',' or '}'";
+            return false;
+        }
+    }
+    skipJSONSpaces(line, i);
+    if (i < line.Length())
+    {
+        error = "unexpected text after the object";
+        return false;
+    }
+    return true;
+}
+
+
+static wxString escapeJSONString(const wxString& value)
+{
+    wxString escaped;
+    for (size_t i = 0; i < value.Length(); i++)
+    {
+        wxUniChar c = value[i];
+        if (c == '"' || c == '\\')
+        {
+            escaped << '\\' << c;
+        }
+        else if (c == '\n')
+        {
+            escaped << "\\n";
+        }
+        else if (c == '\r')
+        {
+            escaped << "\\r";
+        }
+        else if (c == '\t')
+        {
+            escaped << "\\t";
+        }
+        else if (c.GetValue() < 0x20)
+        {
+            wxString code;
+            code.Printf(wxT("\\u%04x"), (unsigned int)c.GetValue());
+            escaped << code;
+        }
+        else
+        {
+            escaped << c;
+        }
+    }
+    return escaped;
+}
+
+
+// ----------------------------------------------------------------------------
+// CSV - header line with the field names, one record per line
+// ----------------------------------------------------------------------------
+
+// split a CSV record
+// returns false if a quoted field continues on the next line
+static bool splitCSVRecord(const wxString& text, wxArrayString& fields)
+{
+    fields.Clear();
+    wxString field;
+    bool quoted = false;
+    for (size_t i = 0; i < text.Length(); i++)
+    {
+        wxUniChar c = text[i];
+        if (quoted)
+        {
+            if (c == '"')
+            {
+                if (i + 1 < text.Length() && text[i + 1] == '"')
+                {
+                    field << '"';
+                    ++i;
+                }
+                else
+                {
+                    quoted = false;
+                }
+            }
+            else
+            {
+                field << c;
+            }
+        }
+        else if (c == '"')
+        {
+            quoted = true;
+        }
+        else if (c == ',')
+        {
+            fields.Add(field);
+            field.Clear();
+        }
+        else
+        {
+            field << c;
+        }
+    }
+    fields.Add(field);
+    return !quoted;
+}
+
+
+static wxString escapeCSVField(const wxString& value)
+{
+    if (value.find_first_of(",\"\r\n") == wxString::npos)
+    {
+        return value;
+    }
+    wxString escaped = value;
+    escaped.Replace("\"", "\"\"");
+    return "\"" + escaped + "\"";
+}
+
+
+// ----------------------------------------------------------------------------
+// records
+// ----------------------------------------------------------------------------
+
+static bool getImportFlag(std::map<wxString, wxString>& fields, const wxString& key, bool& flag, wxString& error)
+{
+    wxString value = fields[key].Lower().Trim().Trim(false);
+    if (value.IsEmpty() || value == "false" || value == "0" || value == "no")
+    {
+        flag = false;
+    }
+    else if (value == "true" || value == "1" || value == "yes")
+    {
+        flag = true;
+    }
+    else
+    {
+        error.Printf(wxT("invalid value '%s' for '%s'"), fields[key], key);
+        return false;
+    }
+    return true;
+}
+
+
+// minutes, empty = 0 = never
+static bool getImportMinutes(std::map<wxString, wxString>& fields, const wxString& key, long& minutes, wxString& error)
+{
+    wxString value = fields[key].Trim().Trim(false);
+    minutes = 0;
+    if (!value.IsEmpty() && (!value.ToLong(&minutes) || minutes < 0))
+    {
+        error.Printf(wxT("invalid value '%s' for '%s'"), fields[key], key);
+        return false;
+    }
+    return true;
+}
+
+
+static wxString normalizeMountPath(const wxString& mount_path)
+{
+    wxString normalized = mount_path;
+    while (normalized.Length() > 1 && normalized.EndsWith("/"))
+    {
+        normalized.RemoveLast();
+    }
+    return normalized;
+}
+
+
+// turn the fields of one line into a volume record
+static bool getImportRecord(std::map<wxString, wxString>& fields, VolumeRecord& record, wxString& error)
+{
+    // sanitize the name, same as the dialogs do
+    wxString volname = sanitizeVolumeName(fields["name"]);
+    if (volname.IsEmpty())
+    {
+        error = "missing volume name";
+        return false;
+    }
+    if (!fields["enc_path"].StartsWith("/"))
+    {
+        error = "enc_path must be a full path";
+        return false;
+    }
+    if (!fields["mount_path"].StartsWith("/"))
+    {
+        error = "mount_path must be a full path";
+        return false;
+    }
+    record.m_volname = volname;
+    record.m_enc_path = fields["enc_path"];
+    record.m_mount_path = normalizeMountPath(fields["mount_path"]);
+    // there is no password to go with it
+    record.m_pwsaved = false;
+    return (getImportFlag(fields, "automount", record.m_automount, error) &&
+            getImportFlag(fields, "preventautounmount", record.m_preventautounmount, error) &&
+            getImportFlag(fields, "allowother", record.m_allowother, error) &&
+            getImportFlag(fields, "mountaslocal", record.m_mountaslocal, error) &&
+            getImportMinutes(fields, "idletimeout", record.m_idletimeout, error) &&
+            getImportFlag(fields, "lazymount", record.m_lazymount, error));
+}
+
+
+// ----------------------------------------------------------------------------
+// ImportItem - a record waiting to be saved
+// Run() checks the folders, it runs on a worker thread
+// ----------------------------------------------------------------------------
+
+class ImportItem : public WorkItem
+{
+public:
+    long m_lineno;
+    VolumeRecord m_record;
+    bool m_valid;
+    wxString m_info;
+
+    virtual void Run() wxOVERRIDE
+    {
+        m_valid = checkVolumeFolders(m_record.m_enc_path, m_record.m_mount_path, false, m_info);
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// VolumeImporter - validates & saves records, one chunk at a time
+// ----------------------------------------------------------------------------
+
+class VolumeImporter
+{
+public:
+    VolumeImporter(wxFFile * file, wxProgressDialog * progress)
+    {
+        m_file = file;
+        m_progress = progress;
+        m_filesize = file->Length();
+        m_nrrecords = 0;
+        m_nrimported = 0;
+        m_nrerrors = 0;
+
+        // names & mount points already in use
+        std::vector<VolumeRecord> records;
+        loadVolumeRecords(records);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            m_names.insert(records.at(i).m_volname);
+            m_mountpaths.insert(normalizeMountPath(records.at(i).m_mount_path));
+        }
+    }
+
+    ~VolumeImporter()
+    {
+        for (size_t i = 0; i < m_pending.size(); i++)
+        {
+            delete m_pending.at(i);
+        }
+    }
+
+    void AddError(long lineno, const wxString& error)
+    {
+        ++m_nrerrors;
+        if (m_errors.GetCount() < IMPORT_MAX_REPORTED_ERRORS)
+        {
+            wxString msg;
+            msg.Printf(wxT("line %ld: %s"), lineno, error);
+            m_errors.Add(msg);
+        }
+    }
+
+    void AddFields(long lineno, std::map<wxString, wxString>& fields)
+    {
+        ++m_nrrecords;
+        ImportItem * item = new ImportItem();
+        item->m_lineno = lineno;
+        item->m_valid = false;
+        wxString error;
+        if (!getImportRecord(fields, item->m_record, error))
+        {
+            AddError(lineno, error);
+            delete item;
+            return;
+        }
+        m_pending.push_back(item);
+        if (m_pending.size() >= IMPORT_CHUNK_SIZE)
+        {
+            Flush();
+        }
+    }
+
+    // validate the pending records in parallel, then save the good ones in file order
+    void Flush()
+    {
+        std::vector<WorkItem*> items(m_pending.begin(), m_pending.end());
+        RunWorkItemsParallel(items, MAX_IMPORT_THREADS);
+
+        for (size_t i = 0; i < m_pending.size(); i++)
+        {
+            ImportItem * item = m_pending.at(i);
+            VolumeRecord& record = item->m_record;
+            if (!item->m_valid)
+            {
+                AddError(item->m_lineno, item->m_info);
+            }
+            else if (m_names.find(record.m_volname) != m_names.end())
+            {
+                AddError(item->m_lineno, "volume name '" + record.m_volname + "' is already used");
+            }
+            else if (m_mountpaths.find(record.m_mount_path) != m_mountpaths.end())
+            {
+                AddError(item->m_lineno, "mount point '" + record.m_mount_path + "' is already used");
+            }
+            else if (!saveVolumeRecord(record))
+            {
+                AddError(item->m_lineno, "unable to save volume");
+            }
+            else
+            {
+                m_names.insert(record.m_volname);
+                m_mountpaths.insert(record.m_mount_path);
+                ++m_nrimported;
+            }
+            delete item;
+        }
+        m_pending.clear();
+
+        if (m_progress && m_filesize > 0)
+        {
+            m_progress->Update((int)(m_file->Tell() * 100 / m_filesize));
+        }
+    }
+
+    long m_nrrecords;
+    long m_nrimported;
+    long m_nrerrors;
+    wxArrayString m_errors;
+
+private:
+    wxFFile * m_file;
+    wxProgressDialog * m_progress;
+    wxFileOffset m_filesize;
+    std::set<wxString> m_names;
+    std::set<wxString> m_mountpaths;
+    std::vector<ImportItem*> m_pending;
+};
+
+
+static void importJSONLines(ImportLineReader& reader, VolumeImporter& importer)
+{
+    wxString line;
+    bool valid;
+    while (reader.ReadLine(line, valid))
+    {
+        if (!valid)
+        {
+            importer.AddError(reader.GetLineNr(), "not valid UTF-8");
+            continue;
+        }
+        if (line.Trim().IsEmpty())
+        {
+            continue;
+        }
+        std::map<wxString, wxString> fields;
+        wxString error;
+        if (!parseJSONLine(line, fields, error))
+        {
+            ++importer.m_nrrecords;
+            importer.AddError(reader.GetLineNr(), error);
+            continue;
+        }
+        importer.AddFields(reader.GetLineNr(), fields);
+    }
+}
+
+
+static void importCSV(ImportLineReader& reader, VolumeImporter& importer)
+{
+    wxArrayString columns;
+    wxString line;
+    bool valid;
+    while (reader.ReadLine(line, valid))
+    {
+        long lineno = reader.GetLineNr();
+        if (!valid)
+        {
+            importer.AddError(lineno, "not valid UTF-8");
+            continue;
+        }
+        if (line.IsEmpty())
+        {
+            continue;
+        }
+
+        // a quoted field may continue on the next lines
+        wxArrayString values;
+        wxString text = line;
+        bool complete = splitCSVRecord(text, values);
+        while (!complete && text.Length() < IMPORT_MAX_RECORD_LENGTH && reader.ReadLine(line, valid) && valid)
+        {
+            text << "\n" << line;
+            complete = splitCSVRecord(text, values);
+        }
+        if (!complete)
+        {
+            ++importer.m_nrrecords;
+            importer.AddError(lineno, "unterminated quoted field");
+            continue;
+        }
+
+        // the first line holds the field names
+        if (columns.IsEmpty())
+        {
+            for (size_t i = 0; i < values.GetCount(); i++)
+            {
+                columns.Add(values[i].Trim().Trim(false).Lower());
+            }
+            if (columns.Index("name") == wxNOT_FOUND ||
+                columns.Index("enc_path") == wxNOT_FOUND ||
+                columns.Index("mount_path") == wxNOT_FOUND)
+            {
+                importer.AddError(lineno, "header must contain name, enc_path and mount_path");
+                return;
+            }
+            continue;
+        }
+
+        if (values.GetCount() != columns.GetCount())
+        {
+            ++importer.m_nrrecords;
+            wxString error;
+            error.Printf(wxT("expected %lu fields, found %lu"), (unsigned long)columns.GetCount(), (unsigned long)values.GetCount());
+            importer.AddError(lineno, error);
+            continue;
+        }
+        std::map<wxString, wxString> fields;
+        for (size_t i = 0; i < columns.GetCount(); i++)
+        {
+            fields[columns[i]] = values[i];
+        }
+        importer.AddFields(lineno, fields);
+    }
+}
+
+
+static bool isCSVFile(const wxString& filepath)
+{
+    return (wxFileName(filepath).GetExt().Lower() == "csv");
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// import volume definitions from a JSON Lines or CSV file
+// bad lines get reported and skipped, all good ones are saved in one batch
+void importVolumes(wxWindow * parent)
+{
+    wxFileDialog openFileDialog(parent,
+                                "Import EncFS folders",
+                                wxEmptyString,
+                                wxEmptyString,
+                                IMPORT_WILDCARD,
+                                wxFD_OPEN|wxFD_FILE_MUST_EXIST);
+    if (openFileDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    wxString filepath = openFileDialog.GetPath();
+
+    wxFFile file(filepath, "rb");
+    if (!file.IsOpened())
+    {
+        wxString errormsg;
+        errormsg.Printf(wxT("Unable to open '%s'"), filepath);
+        wxMessageDialog * dlg = new wxMessageDialog(parent, errormsg, "Import failed", wxOK|wxCENTRE|wxICON_ERROR);
+        dlg->ShowModal();
+        dlg->Destroy();
+        return;
+    }
+
+    wxProgressDialog * progress = new wxProgressDialog("Importing EncFS folders",
+                                                       "Checking & saving volumes...",
+                                                       100,
+                                                       parent,
+                                                       wxPD_APP_MODAL|wxPD_AUTO_HIDE);
+    bool saved;
+    long nrrecords;
+    long nrimported;
+    long nrerrors;
+    wxArrayString errors;
+    {
+        ImportLineReader reader(&file);
+        VolumeImporter importer(&file, progress);
+        beginVolumeBatch();
+        if (isCSVFile(filepath))
+        {
+            importCSV(reader, importer);
+        }
+        else
+        {
+            importJSONLines(reader, importer);
+        }
+        importer.Flush();
+        if (file.Error())
+        {
+            importer.AddError(reader.GetLineNr() + 1, "read error, the rest of the file was skipped");
+        }
+        saved = commitVolumeBatch();
+        nrrecords = importer.m_nrrecords;
+        nrimported = importer.m_nrimported;
+        nrerrors = importer.m_nrerrors;
+        errors = importer.m_errors;
+    }
+    progress->Destroy();
+
+    wxString title;
+    wxString msg;
+    long style = wxOK|wxCENTRE;
+    if (!saved && nrimported > 0)
+    {
+        title = "Import failed";
+        msg = "The imported volumes could not be saved, nothing was imported.";
+        style |= wxICON_ERROR;
+    }
+    else
+    {
+        title = (nrerrors == 0) ? "Import done" : "Import done, with errors";
+        msg.Printf(wxT("Imported %ld of %ld volumes."), nrimported, nrrecords);
+        style |= (nrerrors == 0) ? wxICON_INFORMATION : wxICON_WARNING;
+    }
+    if (nrerrors > 0)
+    {
+        msg << "\n\n" << formatLimitedList(errors, (size_t)nrerrors);
+    }
+    wxMessageDialog * dlg = new wxMessageDialog(parent, msg, title, style);
+    dlg->ShowModal();
+    dlg->Destroy();
+}
+
+
+// export all volume definitions to a JSON Lines or CSV file
+// passwords are not exported
+void exportVolumes(wxWindow * parent)
+{
+    std::vector<VolumeRecord> records;
+    loadVolumeRecords(records);
+    if (records.empty())
+    {
+        wxMessageDialog * dlg = new wxMessageDialog(parent, "There are no volumes to export", "Export", wxOK|wxCENTRE|wxICON_INFORMATION);
+        dlg->ShowModal();
+        dlg->Destroy();
+        return;
+    }
+
+    wxFileDialog saveFileDialog(parent,
+                                "Export EncFS folders",
+                                wxEmptyString,
+                                "encfsgui_volumes.jsonl",
+                                IMPORT_WILDCARD,
+                                wxFD_SAVE|wxFD_OVERWRITE_PROMPT);
+    if (saveFileDialog.ShowModal() != wxID_OK)
+    {
+        return;
+    }
+    wxString filepath = saveFileDialog.GetPath();
+    bool csv = isCSVFile(filepath);
+    if (wxFileName(filepath).GetExt().IsEmpty())
+    {
+        csv = (saveFileDialog.GetFilterIndex() == 1);
+        filepath << (csv ? ".csv" : ".jsonl");
+    }
+
+    // write line by line to a temp file, and rename it when done
+    wxString tmpfilepath = filepath + ".tmp";
+    wxFFile file(tmpfilepath, "w");
+    bool written = file.IsOpened();
+    if (written && csv)
+    {
+        wxString header;
+        for (size_t i = 0; i < IMPORT_NR_FIELDS; i++)
+        {
+            header << (i > 0 ? "," : "") << IMPORT_FIELDS[i];
+        }
+        written = file.Write(header + "\n", wxConvUTF8);
+    }
+    for (size_t i = 0; written && i < records.size(); i++)
+    {
+        VolumeRecord& record = records.at(i);
+        wxString line;
+        if (csv)
+        {
+            line.Printf(wxT("%s,%s,%s,%d,%d,%d,%d,%ld,%d\n"),
+                        escapeCSVField(record.m_volname),
+                        escapeCSVField(record.m_enc_path),
+                        escapeCSVField(record.m_mount_path),
+                        record.m_automount ? 1 : 0,
+                        record.m_preventautounmount ? 1 : 0,
+                        record.m_allowother ? 1 : 0,
+                        record.m_mountaslocal ? 1 : 0,
+                        record.m_idletimeout,
+                        record.m_lazymount ? 1 : 0);
+        }
+        else
+        {
+            line.Printf(wxT("{\"name\":\"%s\",\"enc_path\":\"%s\",\"mount_path\":\"%s\",\"automount\":%s,\"preventautounmount\":%s,\"allowother\":%s,\"mountaslocal\":%s,\"idletimeout\":%ld,\"lazymount\":%s}\n"),
+                        escapeJSONString(record.m_volname),
+                        escapeJSONString(record.m_enc_path),
+                        escapeJSONString(record.m_mount_path),
+                        record.m_automount ? "true" : "false",
+                        record.m_preventautounmount ? "true" : "false",
+                        record.m_allowother ? "true" : "false",
+                        record.m_mountaslocal ? "true" : "false",
+                        record.m_idletimeout,
+                        record.m_lazymount ? "true" : "false");
+        }
+        written = file.Write(line, wxConvUTF8);
+    }
+    if (file.IsOpened())
+    {
+        written = file.Close() && written;
+    }
+    if (written)
+    {
+        written = wxRenameFile(tmpfilepath, filepath, true);
+    }
+
+    wxString msg;
+    if (written)
+    {
+        msg.Printf(wxT("Exported %lu volumes to '%s'"), (unsigned long)records.size(), filepath);
+    }
+    else
+    {
+        wxRemoveFile(tmpfilepath);
+        msg.Printf(wxT("Unable to write '%s'"), filepath);
+    }
+    wxMessageDialog * dlg = new wxMessageDialog(parent, msg, "Export", wxOK|wxCENTRE|(written ? wxICON_INFORMATION : wxICON_ERROR));
+    dlg->ShowModal();
+    dlg->Destroy();
+}
@@ -0,0 +1,220 @@
+/*
+    encFSGui - encfsgui_lazymount.cpp
+    source file contains code to mount volumes on demand,
+    the first time somebody opens their (empty) mount point
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/filename.h>
+#include <wx/fswatcher.h>
+#include <map>
+#include <set>
+
+#include "encfsgui.h"
+
+
+// main window, does the actual mounting
+extern frmMain * g_frmMain;
+// set by QuitApp, from then on nothing gets started again
+extern bool g_shuttingDown;
+
+
+// volumes being mounted in the background right now
+// main thread only
+static std::set<wxString> g_pendingLazyMounts;
+// volumes that failed to mount in the background,
+// left alone until the user mounts them by hand
+static std::set<wxString> g_failedLazyMounts;
+
+
+// ----------------------------------------------------------------------------
+// LazyMountWatcher - watches the empty mount points of the lazy volumes
+// listing the folder (ls, a file manager, a shell completing the path)
+// shows up as an access event
+// ----------------------------------------------------------------------------
+
+class LazyMountWatcher : public wxEvtHandler
+{
+public:
+    LazyMountWatcher();
+    virtual ~LazyMountWatcher();
+    bool Start();
+    void Update(const std::map<wxString, DBEntry*>& volumedata);
+
+private:
+    void OnFileSystemEvent(wxFileSystemWatcherEvent& event);
+
+    wxFileSystemWatcher * m_watcher;
+    // mount path -> volume name, of the watched mount points
+    std::map<wxString, wxString> m_watched;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(LazyMountWatcher, wxEvtHandler)
+    EVT_FSWATCHER(wxID_ANY, LazyMountWatcher::OnFileSystemEvent)
+wxEND_EVENT_TABLE()
+
+
+LazyMountWatcher::LazyMountWatcher()
+{
+    m_watcher = NULL;
+}
+
+
+LazyMountWatcher::~LazyMountWatcher()
+{
+    delete m_watcher;
+}
+
+
+// needs a running event loop
+bool LazyMountWatcher::Start()
+{
+#ifdef __WXOSX__
+    // FSEvents doesn't report reads, nothing to trigger on
+    return false;
+#else
+    m_watcher = new wxFileSystemWatcher();
+    m_watcher->SetOwner(this);
+    return true;
+#endif
+}
+
+
+// watch the mount points of the lazy volumes that can be mounted without asking anything
+void LazyMountWatcher::Update(const std::map<wxString, DBEntry*>& volumedata)
+{
+    std::map<wxString, wxString> mountpaths;
+    for (std::map<wxString, DBEntry*>::const_iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        const DBEntry * thisvol = it->second;
+        if (thisvol->getMountState())
+        {
+            // mounted by hand, try again next time
+            g_failedLazyMounts.erase(it->first);
+            continue;
+        }
+        if (!thisvol->getLazyMount() || !thisvol->getPwSavedState() || !thisvol->getHealthState() ||
+            g_pendingLazyMounts.find(it->first) != g_pendingLazyMounts.end() ||
+            g_failedLazyMounts.find(it->first) != g_failedLazyMounts.end())
+        {
+            continue;
+        }
+        mountpaths[wxFileName::DirName(thisvol->getMountPath()).GetPath()] = it->first;
+    }
+
+    for (std::map<wxString, wxString>::iterator it = m_watched.begin(); it != m_watched.end(); it++)
+    {
+        if (mountpaths.find(it->first) == mountpaths.end())
+        {
+            m_watcher->Remove(wxFileName::DirName(it->first));
+        }
+    }
+    std::map<wxString, wxString> watched;
+    for (std::map<wxString, wxString>::iterator it = mountpaths.begin(); it != mountpaths.end(); it++)
+    {
+        if (m_watched.find(it->first) != m_watched.end() ||
+            m_watcher->Add(wxFileName::DirName(it->first), wxFSW_EVENT_ACCESS))
+        {
+            watched[it->first] = it->second;
+        }
+    }
+    m_watched = watched;
+}
+
+
+void LazyMountWatcher::OnFileSystemEvent(wxFileSystemWatcherEvent& event)
+{
+    if (!(event.GetChangeType() & wxFSW_EVENT_ACCESS))
+    {
+        return;
+    }
+    // the event is about the mount point itself, or something in it
+    wxFileName path = event.GetPath();
+    std::map<wxString, wxString>::iterator it = m_watched.find(path.GetPath());
+    if (it == m_watched.end())
+    {
+        it = m_watched.find(wxFileName::DirName(path.GetFullPath()).GetPath());
+    }
+    if (it == m_watched.end())
+    {
+        return;
+    }
+    wxString volname = it->second;
+    // one mount per access burst, the watch comes back when the volume gets unmounted again
+    m_watcher->Remove(wxFileName::DirName(it->first));
+    m_watched.erase(it);
+    g_pendingLazyMounts.insert(volname);
+    if (!g_frmMain || !g_frmMain->StartBackgroundMount(volname))
+    {
+        finishLazyMount(volname, false);
+    }
+}
+
+
+static LazyMountWatcher * g_lazyMountWatcher = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// main thread only
+// ----------------------------------------------------------------------------
+
+void startLazyMountWatcher(const std::map<wxString, DBEntry*>& volumedata)
+{
+    if (g_lazyMountWatcher)
+    {
+        return;
+    }
+    g_lazyMountWatcher = new LazyMountWatcher();
+    if (!g_lazyMountWatcher->Start())
+    {
+        delete g_lazyMountWatcher;
+        g_lazyMountWatcher = NULL;
+        return;
+    }
+    g_lazyMountWatcher->Update(volumedata);
+}
+
+
+void stopLazyMountWatcher()
+{
+    delete g_lazyMountWatcher;
+    g_lazyMountWatcher = NULL;
+}
+
+
+// follow mounts & unmounts, an unmounted lazy volume gets watched again
+void updateLazyMountWatches(const std::map<wxString, DBEntry*>& volumedata)
+{
+    if (g_lazyMountWatcher && !g_shuttingDown)
+    {
+        g_lazyMountWatcher->Update(volumedata);
+    }
+}
+
+
+bool isLazyMountPending(const wxString& volname)
+{
+    return (g_pendingLazyMounts.find(volname) != g_pendingLazyMounts.end());
+}
+
+
+// the background mount is done, call before updating the volume state
+void finishLazyMount(const wxString& volname, bool mounted)
+{
+    g_pendingLazyMounts.erase(volname);
+    if (!mounted)
+    {
+        g_failedLazyMounts.insert(volname);
+    }
+}
@@ -0,0 +1,223 @@
+/*
+    encFSGui - encfsgui_mountorder.cpp
+    source file contains code to figure out the order
+    to mount volumes in, when volumes live inside other volumes
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <map>
+#include <set>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static wxString getFolderKey(const wxString& path)
+{
+    wxString key = path;
+    while (key.EndsWith("/"))
+    {
+        key.RemoveLast();
+    }
+    key << "/";
+    return key;
+}
+
+
+// mount point -> the volumes mounted there, in the order of records
+typedef std::map<wxString, std::vector<wxString> > MountPointIndex;
+
+static MountPointIndex getMountPointIndex(const std::vector<VolumeRecord>& records)
+{
+    MountPointIndex mountpoints;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        mountpoints[getFolderKey(records.at(i).m_mount_path)].push_back(records.at(i).m_volname);
+    }
+    return mountpoints;
+}
+
+
+// the volume whose mount point holds path, the deepest one if there are several
+// returns an empty string if path is not inside a mount point
+// walks up the parent folders, so the cost depends on the depth of path, not on the number of volumes
+static wxString findContainingVolume(const MountPointIndex& mountpoints, const wxString& volname, const wxString& path)
+{
+    wxString key = getFolderKey(path);
+    while (!key.IsEmpty())
+    {
+        MountPointIndex::const_iterator it = mountpoints.find(key);
+        if (it != mountpoints.end())
+        {
+            for (size_t i = 0; i < it->second.size(); i++)
+            {
+                if (it->second.at(i) != volname)
+                {
+                    return it->second.at(i);
+                }
+            }
+        }
+        // parent folder, keeps the trailing '/'
+        key.RemoveLast();
+        int slash = key.Find('/', true);
+        if (slash == wxNOT_FOUND)
+        {
+            break;
+        }
+        key.Truncate(slash + 1);
+    }
+    return wxEmptyString;
+}
+
+
+// volume -> the volumes that must be mounted before it
+// a volume depends on another one when its encrypted folder or its
+// mount point is inside the mount point of the other one
+static std::map<wxString, std::set<wxString> > getMountDependencies(const std::vector<VolumeRecord>& records)
+{
+    // not the path index: getMountCycleInfo checks records that aren't saved yet
+    MountPointIndex mountpoints = getMountPointIndex(records);
+    std::map<wxString, std::set<wxString> > dependencies;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const VolumeRecord& record = records.at(i);
+        std::set<wxString>& parents = dependencies[record.m_volname];
+        wxString encparent = findContainingVolume(mountpoints, record.m_volname, record.m_enc_path);
+        if (!encparent.IsEmpty())
+        {
+            parents.insert(encparent);
+        }
+        wxString mountparent = findContainingVolume(mountpoints, record.m_volname, record.m_mount_path);
+        if (!mountparent.IsEmpty())
+        {
+            parents.insert(mountparent);
+        }
+    }
+    return dependencies;
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// sort the volumes in levels: level 0 doesn't depend on anything,
+// level n only depends on volumes in lower levels
+// the volumes of one level can be mounted at the same time
+// volumes that depend on each other (directly or not) end up in cycle
+std::vector<wxArrayString> getMountLevels(const std::vector<VolumeRecord>& records, wxArrayString& cycle)
+{
+    std::map<wxString, std::set<wxString> > dependencies = getMountDependencies(records);
+
+    // Kahn's algorithm, one level at a time
+    std::map<wxString, size_t> nrparents;
+    std::map<wxString, std::vector<wxString> > children;
+    for (std::map<wxString, std::set<wxString> >::iterator it = dependencies.begin(); it != dependencies.end(); it++)
+    {
+        nrparents[it->first] = it->second.size();
+        for (std::set<wxString>::iterator parent = it->second.begin(); parent != it->second.end(); parent++)
+        {
+            children[*parent].push_back(it->first);
+        }
+    }
+
+    std::vector<wxArrayString> levels;
+    wxArrayString current;
+    for (std::map<wxString, size_t>::iterator it = nrparents.begin(); it != nrparents.end(); it++)
+    {
+        if (it->second == 0)
+        {
+            current.Add(it->first);
+        }
+    }
+    size_t nrplaced = 0;
+    while (!current.IsEmpty())
+    {
+        levels.push_back(current);
+        nrplaced += current.GetCount();
+        wxArrayString next;
+        for (size_t i = 0; i < current.GetCount(); i++)
+        {
+            std::vector<wxString>& dependents = children[current[i]];
+            for (size_t d = 0; d < dependents.size(); d++)
+            {
+                if (--nrparents[dependents.at(d)] == 0)
+                {
+                    next.Add(dependents.at(d));
+                }
+            }
+        }
+        next.Sort();
+        current = next;
+    }
+
+    // whatever didn't get placed is part of, or depends on, a cycle
+    cycle.Clear();
+    if (nrplaced < nrparents.size())
+    {
+        for (std::map<wxString, size_t>::iterator it = nrparents.begin(); it != nrparents.end(); it++)
+        {
+            if (it->second > 0)
+            {
+                cycle.Add(it->first);
+            }
+        }
+    }
+    return levels;
+}
+
+
+// check if saving a volume with these folders would create a cycle
+// ignorevolume is the volume being edited, or empty for a new one
+// returns a description of the problem, or an empty string
+wxString getMountCycleInfo(const wxString& enc_path, const wxString& mount_path, const wxString& ignorevolume)
+{
+    std::vector<VolumeRecord> records;
+    loadVolumeRecords(records);
+    // volume names never contain spaces, so this can't clash with a real one
+    wxString volname = ignorevolume.IsEmpty() ? wxString("(new volume)") : ignorevolume;
+    VolumeRecord candidate;
+    candidate.m_volname = volname;
+    candidate.m_enc_path = enc_path;
+    candidate.m_mount_path = mount_path;
+    bool replaced = false;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records.at(i).m_volname == ignorevolume)
+        {
+            records.at(i) = candidate;
+            replaced = true;
+        }
+    }
+    if (!replaced)
+    {
+        records.push_back(candidate);
+    }
+
+    wxArrayString cycle;
+    getMountLevels(records, cycle);
+    if (cycle.Index(volname) == wxNOT_FOUND)
+    {
+        return wxEmptyString;
+    }
+    wxString info;
+    info << "- these volumes would live inside each other, so none of them can be mounted: ";
+    for (size_t i = 0; i < cycle.GetCount(); i++)
+    {
+        info << (i > 0 ? ", " : "") << "'" << cycle[i] << "'";
+    }
+    info << "\n";
+    return info;
+}
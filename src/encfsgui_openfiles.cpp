@@ -0,0 +1,356 @@
+/*
+    encFSGui - encfsgui_openfiles.cpp
+    source file contains code to find the processes
+    that keep a volume busy, without spawning lsof or fuser
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <string>
+#include <set>
+
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef __WXOSX__
+    #include <libproc.h>
+    #include <sys/proc_info.h>
+#else
+    #include <dirent.h>
+    #include <stdio.h>
+    #include <stdlib.h>
+    #include <string.h>
+#endif
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// pids per work item, big enough to keep the thread overhead down
+static const size_t OPENFILES_PIDS_PER_ITEM = 128;
+// one process can have thousands of files open under the volume, a few are enough to show
+static const size_t OPENFILES_MAX_PER_PROCESS = 5;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// only use system calls, these run on worker threads
+// nothing here touches the volume itself, so a hung volume can be scanned too
+// ----------------------------------------------------------------------------
+
+// path is the mount point, or something inside it
+static bool isPathInside(const std::string& path, const std::string& mount_path)
+{
+    if (path.compare(0, mount_path.size(), mount_path) != 0)
+    {
+        return false;
+    }
+    return (path.size() == mount_path.size() || path[mount_path.size()] == '/');
+}
+
+
+#ifdef __WXOSX__
+
+static std::vector<long> getAllPIDs()
+{
+    std::vector<long> allpids;
+    int nrpids = proc_listallpids(NULL, 0);
+    if (nrpids <= 0)
+    {
+        return allpids;
+    }
+    // leave some room for processes started in the meantime
+    std::vector<pid_t> pids(nrpids + 64);
+    nrpids = proc_listallpids(&pids[0], pids.size() * sizeof(pid_t));
+    for (int i = 0; i < nrpids; i++)
+    {
+        allpids.push_back((long)pids[i]);
+    }
+    return allpids;
+}
+
+
+static wxString getProcessName(long pid)
+{
+    char name[2 * MAXCOMLEN + 1];
+    if (proc_name((int)pid, name, sizeof(name)) <= 0)
+    {
+        return wxEmptyString;
+    }
+    return wxString::FromUTF8(name);
+}
+
+
+// mapped files aren't listed, libproc only has them per memory region
+static void scanProcess(long pid, const std::string& mount_path, std::vector<OpenFileHolder>& found)
+{
+    std::vector<std::pair<wxString, std::string> > hits;
+
+    struct proc_vnodepathinfo vnodeinfo;
+    if (proc_pidinfo((int)pid, PROC_PIDVNODEPATHINFO, 0, &vnodeinfo, sizeof(vnodeinfo)) == (int)sizeof(vnodeinfo) &&
+        isPathInside(vnodeinfo.pvi_cdir.vip_path, mount_path))
+    {
+        hits.push_back(std::make_pair(wxString("cwd"), std::string(vnodeinfo.pvi_cdir.vip_path)));
+    }
+
+    int size = proc_pidinfo((int)pid, PROC_PIDLISTFDS, 0, NULL, 0);
+    if (size > 0)
+    {
+        std::vector<struct proc_fdinfo> fds(size / sizeof(struct proc_fdinfo) + 16);
+        size = proc_pidinfo((int)pid, PROC_PIDLISTFDS, 0, &fds[0], fds.size() * sizeof(struct proc_fdinfo));
+        int nrfds = (size > 0) ? size / sizeof(struct proc_fdinfo) : 0;
+        for (int i = 0; i < nrfds && hits.size() < OPENFILES_MAX_PER_PROCESS; i++)
+        {
+            if (fds[i].proc_fdtype != PROX_FDTYPE_VNODE)
+            {
+                continue;
+            }
+            struct vnode_fdinfowithpath fdinfo;
+            if (proc_pidfdinfo((int)pid, fds[i].proc_fd, PROC_PIDFDVNODEPATHINFO, &fdinfo, sizeof(fdinfo)) == (int)sizeof(fdinfo) &&
+                isPathInside(fdinfo.pvip.vip_path, mount_path))
+            {
+                hits.push_back(std::make_pair(wxString("open"), std::string(fdinfo.pvip.vip_path)));
+            }
+        }
+    }
+
+    if (hits.empty())
+    {
+        return;
+    }
+    wxString name = getProcessName(pid);
+    for (size_t i = 0; i < hits.size(); i++)
+    {
+        OpenFileHolder holder;
+        holder.m_pid = pid;
+        holder.m_name = name;
+        holder.m_kind = hits.at(i).first;
+        holder.m_path = wxString::FromUTF8(hits.at(i).second.c_str());
+        found.push_back(holder);
+    }
+}
+
+#else
+
+static std::vector<long> getAllPIDs()
+{
+    std::vector<long> allpids;
+    DIR * procdir = opendir("/proc");
+    if (!procdir)
+    {
+        return allpids;
+    }
+    struct dirent * entry;
+    while ((entry = readdir(procdir)) != NULL)
+    {
+        char * end;
+        long pid = strtol(entry->d_name, &end, 10);
+        if (*end == '\0' && pid > 0)
+        {
+            allpids.push_back(pid);
+        }
+    }
+    closedir(procdir);
+    return allpids;
+}
+
+
+// readlink only reads the link, it never follows it into the volume
+static bool readLink(const std::string& link, std::string& target)
+{
+    char buffer[4096];
+    ssize_t len = readlink(link.c_str(), buffer, sizeof(buffer) - 1);
+    if (len <= 0)
+    {
+        return false;
+    }
+    target.assign(buffer, len);
+    return true;
+}
+
+
+static wxString getProcessName(long pid)
+{
+    char commfile[64];
+    snprintf(commfile, sizeof(commfile), "/proc/%ld/comm", pid);
+    FILE * comm = fopen(commfile, "r");
+    if (!comm)
+    {
+        return wxEmptyString;
+    }
+    char name[256] = "";
+    if (!fgets(name, sizeof(name), comm))
+    {
+        name[0] = '\0';
+    }
+    fclose(comm);
+    name[strcspn(name, "\n")] = '\0';
+    return wxString::FromUTF8(name);
+}
+
+
+// processes of other users can't be read, unless running as root
+static void scanProcess(long pid, const std::string& mount_path, std::vector<OpenFileHolder>& found)
+{
+    char procdir[64];
+    snprintf(procdir, sizeof(procdir), "/proc/%ld", pid);
+    std::string base(procdir);
+    std::vector<std::pair<wxString, std::string> > hits;
+    std::string target;
+
+    if (readLink(base + "/cwd", target) && isPathInside(target, mount_path))
+    {
+        hits.push_back(std::make_pair(wxString("cwd"), target));
+    }
+    if (readLink(base + "/root", target) && target != "/" && isPathInside(target, mount_path))
+    {
+        hits.push_back(std::make_pair(wxString("root"), target));
+    }
+
+    std::string fdpath = base + "/fd";
+    DIR * fddir = opendir(fdpath.c_str());
+    if (fddir)
+    {
+        struct dirent * entry;
+        while ((entry = readdir(fddir)) != NULL && hits.size() < OPENFILES_MAX_PER_PROCESS)
+        {
+            if (entry->d_name[0] == '.')
+            {
+                continue;
+            }
+            if (readLink(fdpath + "/" + entry->d_name, target) && isPathInside(target, mount_path))
+            {
+                hits.push_back(std::make_pair(wxString("open"), target));
+            }
+        }
+        closedir(fddir);
+    }
+
+    // mapped files (libraries, mmap'ed data), the path is the last field
+    FILE * maps = fopen((base + "/maps").c_str(), "r");
+    if (maps)
+    {
+        std::set<std::string> mapped;
+        char line[4096 + 128];
+        while (fgets(line, sizeof(line), maps) && hits.size() < OPENFILES_MAX_PER_PROCESS)
+        {
+            char * path = strchr(line, '/');
+            if (!path)
+            {
+                continue;
+            }
+            path[strcspn(path, "\n")] = '\0';
+            std::string mappedpath(path);
+            // a file is mapped in several regions
+            if (isPathInside(mappedpath, mount_path) && mapped.insert(mappedpath).second)
+            {
+                hits.push_back(std::make_pair(wxString("mapped"), mappedpath));
+            }
+        }
+        fclose(maps);
+    }
+
+    if (hits.empty())
+    {
+        return;
+    }
+    wxString name = getProcessName(pid);
+    for (size_t i = 0; i < hits.size(); i++)
+    {
+        OpenFileHolder holder;
+        holder.m_pid = pid;
+        holder.m_name = name;
+        holder.m_kind = hits.at(i).first;
+        holder.m_path = wxString::FromUTF8(hits.at(i).second.c_str());
+        found.push_back(holder);
+    }
+}
+
+#endif
+
+
+// ----------------------------------------------------------------------------
+// OpenFilesWorkItem - scans a batch of processes
+// ----------------------------------------------------------------------------
+
+class OpenFilesWorkItem : public WorkItem
+{
+public:
+    OpenFilesWorkItem(const std::string& mount_path) : m_mount_path(mount_path)
+    {
+    }
+
+    virtual void Run() wxOVERRIDE
+    {
+        for (size_t i = 0; i < m_pids.size(); i++)
+        {
+            scanProcess(m_pids.at(i), m_mount_path, m_found);
+        }
+    }
+
+    std::vector<long> m_pids;
+    std::vector<OpenFileHolder> m_found;
+
+private:
+    std::string m_mount_path;
+};
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// the processes that have a file open, a working directory or a mapped file under the mount path
+// at most a few entries per process
+std::vector<OpenFileHolder> findOpenFiles(const wxString& mount_path)
+{
+    std::vector<OpenFileHolder> found;
+    std::string mountpath(mount_path.utf8_str());
+    while (mountpath.size() > 1 && mountpath[mountpath.size() - 1] == '/')
+    {
+        mountpath.erase(mountpath.size() - 1);
+    }
+    if (mountpath.empty() || mountpath == "/")
+    {
+        return found;
+    }
+
+    std::vector<long> pids = getAllPIDs();
+    long ownpid = (long)getpid();
+    std::vector<WorkItem*> items;
+    OpenFilesWorkItem * item = NULL;
+    for (size_t i = 0; i < pids.size(); i++)
+    {
+        if (pids.at(i) == ownpid)
+        {
+            // the scan itself has /proc folders open, nothing on the volume
+            continue;
+        }
+        if (!item || item->m_pids.size() >= OPENFILES_PIDS_PER_ITEM)
+        {
+            item = new OpenFilesWorkItem(mountpath);
+            items.push_back(item);
+        }
+        item->m_pids.push_back(pids.at(i));
+    }
+
+    RunWorkItemsParallel(items, 0);
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        OpenFilesWorkItem * doneitem = (OpenFilesWorkItem *)items.at(i);
+        found.insert(found.end(), doneitem->m_found.begin(), doneitem->m_found.end());
+        delete doneitem;
+    }
+    return found;
+}
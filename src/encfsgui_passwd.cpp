@@ -0,0 +1,439 @@
+/*
+    encFSGui - encfsgui_passwd.cpp
+    This file contains code to change the password
+    of one or more encfs folders at once
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+#include <wx/checklst.h>
+#include <wx/filename.h>
+#include <wx/file.h>
+#include <wx/datetime.h>
+#include <wx/progdlg.h>
+#include <wx/stdpaths.h>
+#include <vector>
+#include <map>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// nr of encfsctl processes to run at the same time
+// each one spends most of its time in PBKDF2, 0 means one per cpu
+static const unsigned int MAX_PASSWORD_THREADS = 0;
+
+
+// event table
+wxBEGIN_EVENT_TABLE(frmPasswordDialog, wxDialog)
+    EVT_BUTTON(wxID_APPLY, frmPasswordDialog::ChangePasswords)
+wxEND_EVENT_TABLE()
+
+
+// ----------------------------------------------------------------------------
+// PasswordChangeItem - change the password of a single volume
+// runs on a worker thread, so it must not touch wxConfig or the GUI
+// ----------------------------------------------------------------------------
+
+class PasswordChangeItem : public WorkItem
+{
+public:
+    wxString m_volname;
+    wxString m_enc_path;
+    wxString m_encfsctlbin;
+    wxString m_backupfile;
+    wxString m_oldpw;
+    wxString m_newpw;
+    bool m_pwsaved;
+    bool m_changed;
+    wxString m_result;
+
+    virtual void Run() wxOVERRIDE;
+    wxString getConfigFile();
+    bool restoreConfigFile();
+};
+
+
+// compare 2 files byte by byte
+static bool areFilesIdentical(const wxString& file1, const wxString& file2)
+{
+    wxFile f1(file1);
+    wxFile f2(file2);
+    if (!f1.IsOpened() || !f2.IsOpened())
+    {
+        return false;
+    }
+    wxFileOffset len = f1.Length();
+    if (len != f2.Length())
+    {
+        return false;
+    }
+    wxMemoryBuffer buf1(len);
+    wxMemoryBuffer buf2(len);
+    if (f1.Read(buf1.GetWriteBuf(len), len) != len || f2.Read(buf2.GetWriteBuf(len), len) != len)
+    {
+        return false;
+    }
+    return (memcmp(buf1.GetData(), buf2.GetData(), len) == 0);
+}
+
+
+wxString PasswordChangeItem::getConfigFile()
+{
+    wxString configfile;
+    configfile.Printf(wxT("%s/.encfs6.xml"), m_enc_path);
+    return configfile;
+}
+
+
+void PasswordChangeItem::Run()
+{
+    m_changed = false;
+    wxString configfile = getConfigFile();
+
+    // 1. make a backup of the volume config, and make sure it is identical
+    if (!wxCopyFile(configfile, m_backupfile) || !areFilesIdentical(configfile, m_backupfile))
+    {
+        m_result = "unable to make a verified backup of .encfs6.xml";
+        return;
+    }
+
+    // 2. encfsctl autopasswd reads the current and the new password from stdin
+    wxArrayString args;
+    args.Add(m_encfsctlbin);
+    args.Add("autopasswd");
+    args.Add(m_enc_path);
+    wxString input;
+    input << m_oldpw << "\n" << m_newpw << "\n";
+    wxString output;
+    int exitcode = RunCMDArgvSync(args, input, output);
+    input = "";
+
+    if (exitcode == 0)
+    {
+        m_changed = true;
+        m_result = "password changed";
+        return;
+    }
+
+    if (output.Find("Invalid password") > -1)
+    {
+        m_result = "current password is incorrect";
+    }
+    else
+    {
+        m_result.Printf(wxT("encfsctl failed (%d): %s"), exitcode, output.AfterLast('\n'));
+    }
+
+    // make sure a failed attempt leaves the original config behind
+    if (!areFilesIdentical(configfile, m_backupfile) && !restoreConfigFile())
+    {
+        wxString restoreinfo;
+        restoreinfo.Printf(wxT(", and .encfs6.xml could not be restored, the backup is in %s"), m_backupfile);
+        m_result << restoreinfo;
+    }
+}
+
+
+// put the backup back, returns false if the config is not identical to the backup afterwards
+bool PasswordChangeItem::restoreConfigFile()
+{
+    wxString configfile = getConfigFile();
+    return (wxCopyFile(m_backupfile, configfile) && areFilesIdentical(configfile, m_backupfile));
+}
+
+
+// ----------------------------------------------------------------------------
+// frmPasswordDialog
+// ----------------------------------------------------------------------------
+
+// constructor
+frmPasswordDialog::frmPasswordDialog(wxWindow *parent,
+                                     const wxString& title,
+                                     const wxPoint &pos,
+                                     const wxSize &size,
+                                     long style,
+                                     wxString selectedvolume,
+                                     std::map<wxString, DBEntry*> volumedata) :  wxDialog(parent, wxID_ANY, title, pos, size, style)
+{
+    m_selectedvolume = selectedvolume;
+    m_passwordVolumeData = volumedata;
+}
+
+
+void frmPasswordDialog::Create()
+{
+    wxSizer * const sizerMaster = new wxBoxSizer(wxVERTICAL);
+
+    // volumes
+    wxSizer * const sizerVolumes = new wxStaticBoxSizer(wxVERTICAL, this, "Volumes");
+    sizerVolumes->Add(new wxStaticText(this, wxID_ANY, "Select the volumes that share the password you want to change:"));
+    wxArrayString arrVolumes;
+    for (std::map<wxString, DBEntry*>::iterator it = m_passwordVolumeData.begin(); it != m_passwordVolumeData.end(); it++)
+    {
+        arrVolumes.Add(it->first);
+    }
+    m_volumes_list = new wxCheckListBox(this, wxID_ANY, wxDefaultPosition, wxSize(470,200), arrVolumes);
+    for (unsigned int i = 0; i < arrVolumes.GetCount(); i++)
+    {
+        if (arrVolumes[i] == m_selectedvolume)
+        {
+            m_volumes_list->Check(i, true);
+        }
+    }
+    sizerVolumes->Add(m_volumes_list, wxSizerFlags(1).Expand().Border());
+
+    // passwords
+    wxSizer * const sizerPassword = new wxStaticBoxSizer(wxVERTICAL, this, "Password settings");
+
+    wxSizer * const sizerOldPW = new wxBoxSizer(wxHORIZONTAL);
+    sizerOldPW->Add(new wxStaticText(this, wxID_ANY, "Current password:"));
+    m_oldpass = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(200,22), wxTE_PASSWORD);
+    sizerOldPW->Add(m_oldpass, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
+    sizerPassword->Add(sizerOldPW, wxSizerFlags(1).Expand().Border());
+
+    m_chkbx_use_keychain = new wxCheckBox(this, wxID_ANY, "Use the password saved in Keychain as current password, when available");
+    m_chkbx_use_keychain->SetValue(true);
+    sizerPassword->Add(m_chkbx_use_keychain);
+    sizerPassword->AddSpacer(5);
+
+    wxSizer * const sizerPW1 = new wxBoxSizer(wxHORIZONTAL);
+    sizerPW1->Add(new wxStaticText(this, wxID_ANY, "New password:"));
+    m_pass1 = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(200,22), wxTE_PASSWORD);
+    sizerPW1->Add(m_pass1, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
+    sizerPassword->Add(sizerPW1, wxSizerFlags(1).Expand().Border());
+
+    wxSizer * const sizerPW2 = new wxBoxSizer(wxHORIZONTAL);
+    sizerPW2->Add(new wxStaticText(this, wxID_ANY, "New password again:"));
+    m_pass2 = new wxTextCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(200,22), wxTE_PASSWORD);
+    sizerPW2->Add(m_pass2, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 5).Expand());
+    sizerPassword->Add(sizerPW2, wxSizerFlags(1).Expand().Border());
+
+    sizerMaster->Add(sizerVolumes, wxSizerFlags(1).Expand().Border());
+    sizerMaster->Add(sizerPassword, wxSizerFlags(1).Expand().Border());
+
+    // Add "Apply" and "Cancel"
+    sizerMaster->Add(CreateStdDialogButtonSizer(wxAPPLY | wxCANCEL), wxSizerFlags().Right().Border());
+
+    CentreOnScreen();
+
+    SetSizer(sizerMaster);
+}
+
+
+void frmPasswordDialog::ChangePasswords(wxCommandEvent& WXUNUSED(event))
+{
+    wxString errormsg;
+    wxArrayInt selected;
+    m_volumes_list->GetCheckedItems(selected);
+    bool usekeychain = m_chkbx_use_keychain->GetValue();
+
+    if (selected.IsEmpty())
+    {
+        errormsg << "- Please select at least one volume\n";
+    }
+    if (m_pass1->GetValue().IsEmpty())
+    {
+        errormsg << "- Empty passwords are not allowed\n";
+    }
+    else if (m_pass1->GetValue() != m_pass2->GetValue())
+    {
+        errormsg << "- New passwords do not match\n";
+    }
+    if (m_oldpass->GetValue().IsEmpty() && !usekeychain)
+    {
+        errormsg << "- Please enter the current password\n";
+    }
+
+    if (!errormsg.IsEmpty())
+    {
+        wxString title;
+        title.Printf(wxT("Errors found:"));
+        wxMessageDialog * dlg = new wxMessageDialog(this, errormsg, title, wxOK|wxCENTRE|wxICON_ERROR);
+        dlg->ShowModal();
+        dlg->Destroy();
+        return;
+    }
+
+    // backups go into the app data folder, not into the encrypted folder itself
+    wxStandardPathsBase& stdp = wxStandardPaths::Get();
+    wxString backupdir;
+    backupdir.Printf(wxT("%s/backups"), stdp.GetUserDataDir());
+    wxFileName::Mkdir(backupdir, 0700, wxPATH_MKDIR_FULL);
+    wxString timestamp = wxDateTime::Now().Format(wxT("%Y%m%d-%H%M%S"));
+    wxString encfsctlbin = getEncFSCTLBinPath();
+
+    // collect everything the workers need, on this thread
+    std::vector<WorkItem*> workitems;
+    std::vector<PasswordChangeItem*> items;
+    for (size_t i = 0; i < selected.GetCount(); i++)
+    {
+        wxString volname = m_volumes_list->GetString(selected[i]);
+        DBEntry * thisvol = m_passwordVolumeData[volname];
+        PasswordChangeItem * item = new PasswordChangeItem();
+        item->m_volname = volname;
+        item->m_enc_path = thisvol->getEncPath();
+        item->m_encfsctlbin = encfsctlbin;
+        item->m_backupfile.Printf(wxT("%s/%s-%s.encfs6.xml"), backupdir, volname, timestamp);
+        item->m_pwsaved = thisvol->getPwSavedState();
+        item->m_changed = false;
+        if (usekeychain && item->m_pwsaved)
+        {
+            item->m_oldpw = getKeychainPassword(volname);
+        }
+        else
+        {
+            item->m_oldpw = m_oldpass->GetValue();
+        }
+        item->m_newpw = m_pass1->GetValue();
+        items.push_back(item);
+        workitems.push_back(item);
+    }
+
+    // change the passwords in parallel
+    wxProgressDialog * progress = new wxProgressDialog("Changing passwords",
+                                                       "Changing password of the selected volumes...",
+                                                       items.size(),
+                                                       this,
+                                                       wxPD_APP_MODAL|wxPD_AUTO_HIDE);
+    RunWorkItemsParallel(workitems, MAX_PASSWORD_THREADS, progress);
+    progress->Destroy();
+
+    // commit: update Keychain for all changed volumes that have a saved password
+    // this is all or nothing, if one update fails, all changes get rolled back
+    std::vector<PasswordChangeItem*> keychainupdated;
+    wxString keychainfailure = "";
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        PasswordChangeItem * item = items[i];
+        if (item->m_changed && item->m_pwsaved)
+        {
+            if (setKeychainPassword(item->m_volname, item->m_newpw))
+            {
+                keychainupdated.push_back(item);
+            }
+            else
+            {
+                keychainfailure = item->m_volname;
+                break;
+            }
+        }
+    }
+
+    // every step of the rollback can fail too, whatever could not be undone gets reported
+    bool partialrollback = false;
+    if (!keychainfailure.IsEmpty())
+    {
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            PasswordChangeItem * item = items[i];
+            if (!item->m_changed)
+            {
+                continue;
+            }
+            if (item->restoreConfigFile())
+            {
+                item->m_changed = false;
+                item->m_result.Printf(wxT("rolled back, unable to update Keychain for '%s'"), keychainfailure);
+            }
+            else
+            {
+                // the volume still uses the new password
+                partialrollback = true;
+                item->m_result.Printf(wxT("NOT rolled back, the new password is still active, unable to restore %s"), item->m_backupfile);
+            }
+        }
+        for (size_t i = 0; i < keychainupdated.size(); i++)
+        {
+            PasswordChangeItem * item = keychainupdated[i];
+            if (item->m_changed)
+            {
+                // not rolled back, the Keychain already has the right password
+                continue;
+            }
+            if (!setKeychainPassword(item->m_volname, item->m_oldpw))
+            {
+                partialrollback = true;
+                item->m_result << ", but the Keychain still holds the new password";
+            }
+        }
+    }
+
+    // report
+    int nrchanged = 0;
+    wxString report;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        PasswordChangeItem * item = items[i];
+        if (item->m_changed)
+        {
+            ++nrchanged;
+        }
+        wxString line;
+        line.Printf(wxT("%s: %s\n"), item->m_volname, item->m_result);
+        report << line;
+        item->m_oldpw = "";
+        item->m_newpw = "";
+        delete item;
+    }
+
+    wxString title;
+    if (partialrollback)
+    {
+        title = "Password change could only be partially rolled back";
+        report.Prepend("Some changes could not be undone, check the volumes below before using them.\n\n");
+    }
+    else
+    {
+        title.Printf(wxT("Password changed for %d of %d volume(s)"), nrchanged, (int)selected.GetCount());
+    }
+    bool allchanged = (nrchanged == (int)selected.GetCount() && !partialrollback);
+    long icon = allchanged ? wxICON_INFORMATION : wxICON_ERROR;
+    wxMessageDialog * dlg = new wxMessageDialog(this, report, title, wxOK|wxCENTRE|icon);
+    dlg->ShowModal();
+    dlg->Destroy();
+
+    if (allchanged)
+    {
+        Close(true);
+    }
+}
+
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+void changeVolumePasswords(wxWindow *parent, wxString& selectedvolume, std::map<wxString, DBEntry*> volumedata)
+{
+    wxSize frmPasswordSize;
+    frmPasswordSize.Set(520,520);
+    long framestyle;
+    framestyle = wxDEFAULT_FRAME_STYLE | wxFRAME_EX_METAL;
+
+    wxString strTitle;
+    strTitle.Printf(wxT("Change EncFS password"));
+
+    frmPasswordDialog* dlg = new frmPasswordDialog(parent,
+                                                   strTitle,
+                                                   wxDefaultPosition,
+                                                   frmPasswordSize,
+                                                   framestyle,
+                                                   selectedvolume,
+                                                   volumedata);
+    dlg->Create();
+    dlg->ShowModal();
+    dlg->Destroy();
+}
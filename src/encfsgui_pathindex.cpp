@@ -0,0 +1,399 @@
+/*
+    encFSGui - encfsgui_pathindex.cpp
+    source file contains code to find the volume
+    a file or folder belongs to
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <map>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// PathRadixTree - radix tree over the enc & mount paths of all volumes
+// keys always end with a '/', so a match can only end at a folder boundary
+// ('/data/enc' does not own '/data/encrypted')
+// ----------------------------------------------------------------------------
+
+class PathRadixNode
+{
+public:
+    ~PathRadixNode()
+    {
+        for (std::map<wxUint32, PathRadixNode*>::iterator it = m_children.begin(); it != m_children.end(); it++)
+        {
+            delete it->second;
+        }
+    }
+
+    // part of the key between the parent and this node
+    wxString m_label;
+    // children, by the first character of their label
+    std::map<wxUint32, PathRadixNode*> m_children;
+    // volumes using the key that ends at this node
+    std::vector<VolumePathMatch> m_values;
+};
+
+
+class PathRadixTree
+{
+public:
+    PathRadixTree()
+    {
+        m_root = new PathRadixNode();
+    }
+
+    ~PathRadixTree()
+    {
+        delete m_root;
+    }
+
+    void Insert(const wxString& key, const VolumePathMatch& value)
+    {
+        PathRadixNode * node = m_root;
+        size_t i = 0;
+        while (i < key.Length())
+        {
+            wxUint32 c = key[i].GetValue();
+            std::map<wxUint32, PathRadixNode*>::iterator it = node->m_children.find(c);
+            if (it == node->m_children.end())
+            {
+                PathRadixNode * leaf = new PathRadixNode();
+                leaf->m_label = key.Mid(i);
+                node->m_children[c] = leaf;
+                node = leaf;
+                break;
+            }
+            PathRadixNode * child = it->second;
+            size_t common = getCommonLength(child->m_label, key, i);
+            if (common < child->m_label.Length())
+            {
+                // split the edge, the shared part becomes a node of its own
+                PathRadixNode * middle = new PathRadixNode();
+                middle->m_label = child->m_label.Left(common);
+                child->m_label = child->m_label.Mid(common);
+                middle->m_children[child->m_label[0].GetValue()] = child;
+                it->second = middle;
+                child = middle;
+            }
+            node = child;
+            i += common;
+        }
+        node->m_values.push_back(value);
+    }
+
+    void Remove(const wxString& key, const wxString& volname, bool ismountpath)
+    {
+        // remember the way down, to clean up empty nodes on the way back
+        std::vector<PathRadixNode*> nodes;
+        PathRadixNode * node = m_root;
+        nodes.push_back(node);
+        size_t i = 0;
+        while (i < key.Length())
+        {
+            std::map<wxUint32, PathRadixNode*>::iterator it = node->m_children.find(key[i].GetValue());
+            if (it == node->m_children.end() || key.compare(i, it->second->m_label.Length(), it->second->m_label) != 0)
+            {
+                return;
+            }
+            node = it->second;
+            i += node->m_label.Length();
+            nodes.push_back(node);
+        }
+        for (size_t v = 0; v < node->m_values.size(); v++)
+        {
+            if (node->m_values[v].m_volname == volname && node->m_values[v].m_ismountpath == ismountpath)
+            {
+                node->m_values.erase(node->m_values.begin() + v);
+                break;
+            }
+        }
+
+        for (size_t n = nodes.size() - 1; n > 0; n--)
+        {
+            PathRadixNode * thisnode = nodes[n];
+            PathRadixNode * parent = nodes[n - 1];
+            if (!thisnode->m_values.empty())
+            {
+                break;
+            }
+            if (thisnode->m_children.empty())
+            {
+                parent->m_children.erase(thisnode->m_label[0].GetValue());
+                delete thisnode;
+                continue;
+            }
+            if (thisnode->m_children.size() == 1)
+            {
+                // merge with the only child, so the tree stays compressed
+                PathRadixNode * child = thisnode->m_children.begin()->second;
+                child->m_label = thisnode->m_label + child->m_label;
+                thisnode->m_children.clear();
+                parent->m_children[child->m_label[0].GetValue()] = child;
+                delete thisnode;
+            }
+            break;
+        }
+    }
+
+    // the values of the longest key that is a prefix of key
+    // each character of key gets compared once
+    const std::vector<VolumePathMatch> * FindLongestPrefix(const wxString& key) const
+    {
+        const std::vector<VolumePathMatch> * best = NULL;
+        const PathRadixNode * node = m_root;
+        size_t i = 0;
+        while (i < key.Length())
+        {
+            std::map<wxUint32, PathRadixNode*>::const_iterator it = node->m_children.find(key[i].GetValue());
+            if (it == node->m_children.end() || key.compare(i, it->second->m_label.Length(), it->second->m_label) != 0)
+            {
+                break;
+            }
+            node = it->second;
+            i += node->m_label.Length();
+            if (!node->m_values.empty())
+            {
+                best = &node->m_values;
+            }
+        }
+        return best;
+    }
+
+    // the values of all keys that are a prefix of key, outermost first
+    void FindAllPrefixes(const wxString& key, std::vector<VolumePathMatch>& values) const
+    {
+        const PathRadixNode * node = m_root;
+        size_t i = 0;
+        while (i < key.Length())
+        {
+            std::map<wxUint32, PathRadixNode*>::const_iterator it = node->m_children.find(key[i].GetValue());
+            if (it == node->m_children.end() || key.compare(i, it->second->m_label.Length(), it->second->m_label) != 0)
+            {
+                break;
+            }
+            node = it->second;
+            i += node->m_label.Length();
+            values.insert(values.end(), node->m_values.begin(), node->m_values.end());
+        }
+    }
+
+    // the values of all keys that start with prefix
+    void FindWithPrefix(const wxString& prefix, std::vector<VolumePathMatch>& values) const
+    {
+        const PathRadixNode * node = m_root;
+        size_t i = 0;
+        while (i < prefix.Length())
+        {
+            std::map<wxUint32, PathRadixNode*>::const_iterator it = node->m_children.find(prefix[i].GetValue());
+            if (it == node->m_children.end())
+            {
+                return;
+            }
+            const wxString& label = it->second->m_label;
+            size_t common = getCommonLength(label, prefix, i);
+            if (common < label.Length() && i + common < prefix.Length())
+            {
+                return;
+            }
+            node = it->second;
+            i += common;
+        }
+        collectValues(node, values);
+    }
+
+private:
+    // nr of characters label & key.Mid(start) have in common
+    static size_t getCommonLength(const wxString& label, const wxString& key, size_t start)
+    {
+        size_t common = 0;
+        while (common < label.Length() && start + common < key.Length() && label[common] == key[start + common])
+        {
+            ++common;
+        }
+        return common;
+    }
+
+    static void collectValues(const PathRadixNode * node, std::vector<VolumePathMatch>& values)
+    {
+        values.insert(values.end(), node->m_values.begin(), node->m_values.end());
+        for (std::map<wxUint32, PathRadixNode*>::const_iterator it = node->m_children.begin(); it != node->m_children.end(); it++)
+        {
+            collectValues(it->second, values);
+        }
+    }
+
+    PathRadixNode * m_root;
+};
+
+
+// main thread only
+static PathRadixTree g_pathIndex;
+// volume name -> enc path & mount path, as they are in the index
+static std::map<wxString, std::pair<wxString, wxString> > g_indexedPaths;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static wxString getPathKey(const wxString& path)
+{
+    wxString key = path;
+    while (key.EndsWith("/"))
+    {
+        key.RemoveLast();
+    }
+    key << "/";
+    return key;
+}
+
+
+static void indexPath(const wxString& volname, const wxString& path, bool ismountpath)
+{
+    VolumePathMatch match;
+    match.m_volname = volname;
+    match.m_path = path;
+    match.m_ismountpath = ismountpath;
+    g_pathIndex.Insert(getPathKey(path), match);
+}
+
+
+static wxString describeMatch(const VolumePathMatch& match)
+{
+    wxString desc;
+    desc.Printf(wxT("the %s of volume '%s' (%s)"),
+                match.m_ismountpath ? "mount point" : "encrypted folder",
+                match.m_volname,
+                match.m_path);
+    return desc;
+}
+
+
+// add a line for each volume path that contains path, or is inside it
+static void describeOverlaps(const wxString& path, const wxString& what, const wxString& ignorevolume, wxString& overlaps)
+{
+    wxString key = getPathKey(path);
+    // not just the longest match, the volume being edited may be that one
+    std::vector<VolumePathMatch> owners;
+    g_pathIndex.FindAllPrefixes(key, owners);
+    for (size_t i = 0; i < owners.size(); i++)
+    {
+        if (owners.at(i).m_volname != ignorevolume)
+        {
+            overlaps << "- " << what << " is inside " << describeMatch(owners.at(i)) << "\n";
+        }
+    }
+    std::vector<VolumePathMatch> inside;
+    g_pathIndex.FindWithPrefix(key, inside);
+    for (size_t i = 0; i < inside.size(); i++)
+    {
+        // equal paths were reported above already
+        if (inside.at(i).m_volname != ignorevolume && getPathKey(inside.at(i).m_path) != key)
+        {
+            overlaps << "- " << what << " contains " << describeMatch(inside.at(i)) << "\n";
+        }
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// bring the index in line with the volume model, only changed volumes get touched
+// main thread only
+void updateVolumePathIndex(const std::vector<wxString>& volumes, const std::map<wxString, DBEntry*>& volumedata)
+{
+    std::map<wxString, bool> seen;
+    for (size_t i = 0; i < volumes.size(); i++)
+    {
+        std::map<wxString, DBEntry*>::const_iterator it = volumedata.find(volumes.at(i));
+        if (it == volumedata.end() || !it->second)
+        {
+            continue;
+        }
+        const wxString& volname = it->first;
+        wxString enc_path = it->second->getEncPath();
+        wxString mount_path = it->second->getMountPath();
+        seen[volname] = true;
+
+        std::map<wxString, std::pair<wxString, wxString> >::iterator indexed = g_indexedPaths.find(volname);
+        if (indexed != g_indexedPaths.end())
+        {
+            if (indexed->second.first == enc_path && indexed->second.second == mount_path)
+            {
+                continue;
+            }
+            g_pathIndex.Remove(getPathKey(indexed->second.first), volname, false);
+            g_pathIndex.Remove(getPathKey(indexed->second.second), volname, true);
+        }
+        indexPath(volname, enc_path, false);
+        indexPath(volname, mount_path, true);
+        g_indexedPaths[volname] = std::make_pair(enc_path, mount_path);
+    }
+
+    std::map<wxString, std::pair<wxString, wxString> >::iterator it = g_indexedPaths.begin();
+    while (it != g_indexedPaths.end())
+    {
+        if (seen.find(it->first) != seen.end())
+        {
+            it++;
+            continue;
+        }
+        g_pathIndex.Remove(getPathKey(it->second.first), it->first, false);
+        g_pathIndex.Remove(getPathKey(it->second.second), it->first, true);
+        g_indexedPaths.erase(it++);
+    }
+}
+
+
+// find the volume that owns path: the one with the longest enc or mount path
+// that is path itself or one of its parent folders
+bool findVolumeByPath(const wxString& path, VolumePathMatch& match)
+{
+    const std::vector<VolumePathMatch> * owners = g_pathIndex.FindLongestPrefix(getPathKey(path));
+    if (!owners || owners->empty())
+    {
+        return false;
+    }
+    match = owners->front();
+    return true;
+}
+
+
+// all volume paths inside path (path itself included)
+std::vector<VolumePathMatch> findVolumesInsidePath(const wxString& path)
+{
+    std::vector<VolumePathMatch> inside;
+    g_pathIndex.FindWithPrefix(getPathKey(path), inside);
+    return inside;
+}
+
+
+// describe how the paths of a new or changed volume overlap with the other volumes
+// returns an empty string if they don't
+wxString getVolumePathOverlap(const wxString& enc_path, const wxString& mount_path, const wxString& ignorevolume)
+{
+    wxString overlaps;
+    describeOverlaps(enc_path, "the encrypted folder", ignorevolume, overlaps);
+    describeOverlaps(mount_path, "the mount point", ignorevolume, overlaps);
+    wxString enckey = getPathKey(enc_path);
+    wxString mountkey = getPathKey(mount_path);
+    if (enckey.StartsWith(mountkey) || mountkey.StartsWith(enckey))
+    {
+        overlaps << "- the encrypted folder and the mount point overlap\n";
+    }
+    overlaps << getMountCycleInfo(enc_path, mount_path, ignorevolume);
+    return overlaps;
+}
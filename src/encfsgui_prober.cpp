@@ -0,0 +1,377 @@
+/*
+    encFSGui - encfsgui_prober.cpp
+    source file contains code to notice mounted volumes
+    that stopped responding (stalled network share, sleeping disk, ...)
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/stopwatch.h>
+#include <wx/thread.h>
+#include <wx/timer.h>
+#include <map>
+
+#include <sys/stat.h>
+
+#include "encfsgui.h"
+
+
+// main window, does the unmounting
+extern frmMain * g_frmMain;
+// set by QuitApp, from then on nothing gets started again
+extern bool g_shuttingDown;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int PROBE_INTERVAL_MS = 60000;
+// a probe that takes longer than this is slow
+static const long PROBE_DEGRADED_MS = 500;
+// a probe that didn't come back after this long is hung
+static const int PROBE_TIMEOUT_MS = 5000;
+
+enum
+{
+    ID_TIMER_PROBE = 1,
+    ID_TIMER_PROBE_DEADLINE
+};
+
+
+// the app is shutting down, probes that are still stuck must leave the prober alone
+static wxCriticalSection g_proberLock;
+static bool g_proberStopped = false;
+
+
+class HealthProber;
+
+
+// ----------------------------------------------------------------------------
+// ProbeThread - stats a single folder
+// sacrificial: if the stat never returns, neither does the thread
+// ----------------------------------------------------------------------------
+
+class ProbeThread : public wxThread
+{
+public:
+    ProbeThread(HealthProber * owner, const wxString& volname, const wxString& path) : wxThread(wxTHREAD_DETACHED)
+    {
+        m_owner = owner;
+        m_volname = volname;
+        m_path = path;
+    }
+
+protected:
+    virtual ExitCode Entry() wxOVERRIDE;
+
+private:
+    HealthProber * m_owner;
+    wxString m_volname;
+    wxString m_path;
+};
+
+
+// ----------------------------------------------------------------------------
+// HealthProber - probes the mounted volumes, one probe per volume at a time
+// only runs while volumes are mounted
+// ----------------------------------------------------------------------------
+
+class HealthProber : public wxEvtHandler
+{
+public:
+    HealthProber();
+    virtual ~HealthProber();
+    void Update(const std::map<wxString, DBEntry*>& volumedata);
+    void OnProbeDone(wxString volname, long latency);
+
+    class ProbeState
+    {
+    public:
+        // ms, of the last probe that came back
+        long m_latency;
+        int m_health;
+        // a probe is running since
+        wxLongLong m_started;
+    };
+    std::map<wxString, ProbeState> m_volumes;
+
+private:
+    void StartProbes();
+    void CheckDeadlines();
+    void OnProbeTimer(wxTimerEvent& event);
+    void OnDeadlineTimer(wxTimerEvent& event);
+
+    wxTimer m_probetimer;
+    wxTimer m_deadlinetimer;
+    // volume name -> folder to probe
+    std::map<wxString, wxString> m_paths;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(HealthProber, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_PROBE, HealthProber::OnProbeTimer)
+    EVT_TIMER(ID_TIMER_PROBE_DEADLINE, HealthProber::OnDeadlineTimer)
+wxEND_EVENT_TABLE()
+
+
+HealthProber::HealthProber() : m_probetimer(this, ID_TIMER_PROBE), m_deadlinetimer(this, ID_TIMER_PROBE_DEADLINE)
+{
+}
+
+
+HealthProber::~HealthProber()
+{
+    m_probetimer.Stop();
+    m_deadlinetimer.Stop();
+}
+
+
+// follow mounts & unmounts, newly mounted volumes get probed right away
+void HealthProber::Update(const std::map<wxString, DBEntry*>& volumedata)
+{
+    std::map<wxString, wxString> paths;
+    bool added = false;
+    for (std::map<wxString, DBEntry*>::const_iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        const DBEntry * thisvol = it->second;
+        if (!thisvol->getMountState())
+        {
+            continue;
+        }
+        // encfs counts a stat as activity, probing the volume itself would keep it
+        // from ever going idle - the encrypted folder is where stalls come from anyway
+        paths[it->first] = (thisvol->getIdleTimeout() > 0) ? thisvol->getEncPath() : thisvol->getMountPath();
+        if (m_paths.find(it->first) == m_paths.end())
+        {
+            added = true;
+        }
+    }
+    // a stuck probe keeps its state, so a remount doesn't start a second one
+    std::map<wxString, ProbeState>::iterator it = m_volumes.begin();
+    while (it != m_volumes.end())
+    {
+        if (paths.find(it->first) == paths.end() && it->second.m_started == 0)
+        {
+            m_volumes.erase(it++);
+            continue;
+        }
+        it++;
+    }
+    m_paths = paths;
+
+    if (m_paths.empty())
+    {
+        m_probetimer.Stop();
+        return;
+    }
+    if (added)
+    {
+        StartProbes();
+    }
+    if (!m_probetimer.IsRunning())
+    {
+        m_probetimer.Start(PROBE_INTERVAL_MS);
+    }
+}
+
+
+void HealthProber::StartProbes()
+{
+    wxLongLong now = wxGetLocalTimeMillis();
+    for (std::map<wxString, wxString>::iterator it = m_paths.begin(); it != m_paths.end(); it++)
+    {
+        std::map<wxString, ProbeState>::iterator state = m_volumes.find(it->first);
+        if (state == m_volumes.end())
+        {
+            ProbeState newstate;
+            newstate.m_latency = -1;
+            newstate.m_health = VOLUME_PROBE_UNKNOWN;
+            newstate.m_started = 0;
+            state = m_volumes.insert(std::make_pair(it->first, newstate)).first;
+        }
+        if (state->second.m_started != 0)
+        {
+            // still waiting for the previous one
+            continue;
+        }
+        ProbeThread * thread = new ProbeThread(this, it->first, it->second);
+        if (thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete thread;
+            continue;
+        }
+        state->second.m_started = now;
+    }
+    if (!m_deadlinetimer.IsRunning())
+    {
+        m_deadlinetimer.StartOnce(PROBE_TIMEOUT_MS + 100);
+    }
+}
+
+
+// flag the volumes whose probe is overdue
+void HealthProber::CheckDeadlines()
+{
+    wxLongLong now = wxGetLocalTimeMillis();
+    wxArrayString hung;
+    bool running = false;
+    for (std::map<wxString, ProbeState>::iterator it = m_volumes.begin(); it != m_volumes.end(); it++)
+    {
+        if (it->second.m_started == 0)
+        {
+            continue;
+        }
+        running = true;
+        if (now - it->second.m_started >= PROBE_TIMEOUT_MS && it->second.m_health != VOLUME_PROBE_HUNG)
+        {
+            it->second.m_health = VOLUME_PROBE_HUNG;
+            hung.Add(it->first);
+        }
+    }
+    if (running)
+    {
+        m_deadlinetimer.StartOnce(PROBE_TIMEOUT_MS);
+    }
+    if (hung.IsEmpty() || !g_frmMain)
+    {
+        return;
+    }
+    g_frmMain->SyncList();
+    for (size_t i = 0; i < hung.GetCount(); i++)
+    {
+        if (m_paths.find(hung[i]) != m_paths.end())
+        {
+            // 'Unmount' detaches it
+            wxString volname = hung[i];
+            wxString msg;
+            msg.Printf(wxT("'%s' is not responding, its folders may be unreachable."), volname);
+            showVolumeNotification("Volume not responding", msg, "Unmount", [volname]()
+            {
+                if (g_frmMain)
+                {
+                    g_frmMain->DetachVolume(volname);
+                }
+            });
+        }
+    }
+}
+
+
+void HealthProber::OnProbeDone(wxString volname, long latency)
+{
+    std::map<wxString, ProbeState>::iterator it = m_volumes.find(volname);
+    if (it == m_volumes.end())
+    {
+        return;
+    }
+    if (m_paths.find(volname) == m_paths.end())
+    {
+        // unmounted in the mean time
+        m_volumes.erase(it);
+        return;
+    }
+    int health = (latency >= PROBE_DEGRADED_MS) ? VOLUME_PROBE_DEGRADED : VOLUME_PROBE_OK;
+    bool changed = (it->second.m_health != health || it->second.m_latency != latency);
+    it->second.m_started = 0;
+    it->second.m_latency = latency;
+    it->second.m_health = health;
+    if (changed && g_frmMain)
+    {
+        g_frmMain->SyncList();
+    }
+}
+
+
+void HealthProber::OnProbeTimer(wxTimerEvent& WXUNUSED(event))
+{
+    StartProbes();
+}
+
+
+void HealthProber::OnDeadlineTimer(wxTimerEvent& WXUNUSED(event))
+{
+    CheckDeadlines();
+}
+
+
+wxThread::ExitCode ProbeThread::Entry()
+{
+    wxStopWatch sw;
+    struct stat st;
+    stat(m_path.fn_str(), &st);
+    long latency = sw.Time();
+    // a stat that fails quickly still means the volume answered
+    wxCriticalSectionLocker lock(g_proberLock);
+    if (!g_proberStopped)
+    {
+        m_owner->CallAfter(&HealthProber::OnProbeDone, m_volname, latency);
+    }
+    return (ExitCode)0;
+}
+
+
+static HealthProber * g_healthProber = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// main thread only
+// ----------------------------------------------------------------------------
+
+void updateHealthProber(const std::map<wxString, DBEntry*>& volumedata)
+{
+    if (g_shuttingDown)
+    {
+        return;
+    }
+    if (!g_healthProber)
+    {
+        g_healthProber = new HealthProber();
+    }
+    g_healthProber->Update(volumedata);
+}
+
+
+void stopHealthProber()
+{
+    {
+        wxCriticalSectionLocker lock(g_proberLock);
+        g_proberStopped = true;
+    }
+    delete g_healthProber;
+    g_healthProber = NULL;
+}
+
+
+// VOLUME_PROBE_xxx, latency is the last measured one in ms (-1 = none yet)
+int getVolumeProbeHealth(const wxString& volname, long& latency)
+{
+    latency = -1;
+    if (!g_healthProber)
+    {
+        return VOLUME_PROBE_UNKNOWN;
+    }
+    std::map<wxString, HealthProber::ProbeState>::iterator it = g_healthProber->m_volumes.find(volname);
+    if (it == g_healthProber->m_volumes.end())
+    {
+        return VOLUME_PROBE_UNKNOWN;
+    }
+    latency = it->second.m_latency;
+    return it->second.m_health;
+}
+
+
+bool isVolumeHung(const wxString& volname)
+{
+    long latency;
+    return (getVolumeProbeHealth(volname, latency) == VOLUME_PROBE_HUNG);
+}
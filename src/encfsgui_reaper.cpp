@@ -0,0 +1,537 @@
+/*
+    encFSGui - encfsgui_reaper.cpp
+    source file contains code to clean up after encfs crashes:
+    encfs processes without a mount, and mounts without an encfs process
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/filename.h>
+#include <wx/timer.h>
+#include <map>
+#include <set>
+
+#include <signal.h>
+#include <stdlib.h>
+
+#include "encfsgui.h"
+
+
+// main window, keeps the volume state
+extern frmMain * g_frmMain;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// only /proc and the mount table get read, the volumes themselves are never touched
+static const int REAPER_INTERVAL_MS = 300000;
+// look again this soon when something suspicious showed up
+static const int REAPER_CONFIRM_INTERVAL_MS = 30000;
+// a mount point without encfs process is dead when it stays like that for this long
+static const long REAPER_DEAD_GRACE_SECS = 30;
+// encfs can take a while to derive the key before the mount shows up
+static const long REAPER_ORPHAN_GRACE_SECS = 180;
+// umount can block on a mount that stopped responding, give up after this
+static const long DETACH_TIMEOUT_MS = 10000;
+
+enum
+{
+    ID_TIMER_REAPER = 1
+};
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+// the same mount point can show up as /tmp/x in the encfs arguments
+// and as /private/tmp/x in the mount table, so symlinks get resolved
+// only the parent folder is resolved, a dead mount point itself can't be read
+static wxString getReaperPathKey(const wxString& path)
+{
+    wxString key = path;
+    while (key.Length() > 1 && key.EndsWith("/"))
+    {
+        key.RemoveLast();
+    }
+    int slash = key.Find('/', true);
+    if (slash == wxNOT_FOUND || key.Length() < 2)
+    {
+        return key;
+    }
+    wxString parent = (slash == 0) ? wxString("/") : key.Left(slash);
+    char * resolved = realpath(parent.fn_str(), NULL);
+    if (!resolved)
+    {
+        return key;
+    }
+    wxString resolvedparent(resolved, *wxConvFileName);
+    free(resolved);
+    if (!resolvedparent.EndsWith("/"))
+    {
+        resolvedparent << "/";
+    }
+    return resolvedparent + key.Mid(slash + 1);
+}
+
+
+// the mount points of the encfs mounts in the mount table
+// lines look like "<device> on <mount point> (<fs type>)"
+static std::set<wxString> getEncFSMounts(const wxArrayString& mounttable)
+{
+    std::set<wxString> mounts;
+    for (size_t i = 0; i < mounttable.GetCount(); i++)
+    {
+        const wxString& line = mounttable[i];
+        int on = line.Find(" on ");
+        int type = line.Find(" (", true);
+        if (on == wxNOT_FOUND || type == wxNOT_FOUND || type < on)
+        {
+            continue;
+        }
+        wxString device = line.Left(on);
+        wxString fstype = line.Mid(type + 2);
+        // linux: encfs on /x (fuse.encfs), osx: encfs@macfuse0 on /x (macfuse)
+        if (device == "encfs" || device.StartsWith("encfs@") || fstype.StartsWith("fuse.encfs"))
+        {
+            mounts.insert(getReaperPathKey(line.Mid(on + 4, type - on - 4)));
+        }
+    }
+    return mounts;
+}
+
+
+// the mount point an encfs command line is for
+// encfs [options] rootDir mountPoint [-- fuse options]
+static wxString getEncFSMountArg(const wxArrayString& args)
+{
+    wxString mountpoint;
+    for (size_t i = 1; i < args.GetCount(); i++)
+    {
+        if (args[i] == "--")
+        {
+            break;
+        }
+        if (args[i] == "-o")
+        {
+            // takes a value
+            i++;
+            continue;
+        }
+        if (!args[i].StartsWith("-"))
+        {
+            mountpoint = args[i];
+        }
+    }
+    return mountpoint;
+}
+
+
+// work item to detach one dead mount on a worker thread
+class DetachItem : public WorkItem
+{
+public:
+    wxString m_mount_path;
+    bool m_detached;
+
+    virtual void Run() wxOVERRIDE
+    {
+        m_detached = unmountDeadMount(m_mount_path);
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// Reaper - compares the encfs processes with the mount table
+// something only counts once it stays wrong for a while,
+// mounts & processes that are just starting or stopping look the same
+// ----------------------------------------------------------------------------
+
+class Reaper : public wxEvtHandler
+{
+public:
+    Reaper();
+    virtual ~Reaper();
+    void Start();
+
+    ReaperStats m_stats;
+
+private:
+    void Scan();
+    void OnDeadMountsDetached(std::vector<WorkItem*>&, const std::vector<int>&, const std::vector<wxArrayString>&, long, long, long);
+    void Report(long, long, long, long);
+    void OnReaperTimer(wxTimerEvent& event);
+
+    wxTimer m_reapertimer;
+    // pid -> first seen without a mount
+    std::map<long, long> m_orphans;
+    // mount point -> first seen without an encfs process
+    std::map<wxString, long> m_deadmounts;
+    // reported (and fixed if possible) already, left alone from then on
+    std::set<long> m_handledorphans;
+    std::set<wxString> m_handleddeadmounts;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(Reaper, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_REAPER, Reaper::OnReaperTimer)
+wxEND_EVENT_TABLE()
+
+
+Reaper::Reaper() : m_reapertimer(this, ID_TIMER_REAPER)
+{
+    m_stats.m_orphans = 0;
+    m_stats.m_orphanskilled = 0;
+    m_stats.m_deadmounts = 0;
+    m_stats.m_deadunmounted = 0;
+}
+
+
+Reaper::~Reaper()
+{
+    m_reapertimer.Stop();
+}
+
+
+void Reaper::Start()
+{
+    Scan();
+}
+
+
+void Reaper::Scan()
+{
+    long now = (long)wxGetUTCTime();
+    wxArrayString mounttable = getSystemMountTable();
+    std::set<wxString> mounts = getEncFSMounts(mounttable);
+    std::map<long, wxArrayString> processes = getProcessArguments();
+
+    // processes the app started itself are never orphans,
+    // the supervisor and the mount journal take care of those
+    std::set<long> ownprocesses = getSupervisedProcesses();
+    std::map<wxString, MountJournalEntry> journal = readMountJournal();
+    for (std::map<wxString, MountJournalEntry>::iterator it = journal.begin(); it != journal.end(); it++)
+    {
+        ownprocesses.insert(it->second.m_pid);
+    }
+
+    // the mount points the encfs processes serve (of all users, as far as we can see them)
+    // and the processes of this user that have no mount
+    std::set<wxString> served;
+    wxArrayString relativeserved;
+    std::map<long, long> orphans;
+    for (std::map<long, wxArrayString>::iterator it = processes.begin(); it != processes.end(); it++)
+    {
+        wxArrayString& args = it->second;
+        if (args.IsEmpty() || !args[0].EndsWith("encfs"))
+        {
+            continue;
+        }
+        wxString mountpoint = getEncFSMountArg(args);
+        if (mountpoint.IsEmpty())
+        {
+            continue;
+        }
+        if (!mountpoint.StartsWith("/"))
+        {
+            // relative to the folder encfs was started in, can't tell which mount it is
+            relativeserved.Add(getReaperPathKey(mountpoint));
+            continue;
+        }
+        wxString key = getReaperPathKey(mountpoint);
+        served.insert(key);
+        if (mounts.find(key) == mounts.end() && ownprocesses.find(it->first) == ownprocesses.end() && kill((pid_t)it->first, 0) == 0)
+        {
+            std::map<long, long>::iterator seen = m_orphans.find(it->first);
+            orphans[it->first] = (seen == m_orphans.end()) ? now : seen->second;
+        }
+    }
+    m_orphans = orphans;
+
+    std::map<wxString, long> deadmounts;
+    for (std::set<wxString>::iterator it = mounts.begin(); it != mounts.end(); it++)
+    {
+        bool isserved = (served.find(*it) != served.end());
+        for (size_t i = 0; i < relativeserved.GetCount() && !isserved; i++)
+        {
+            isserved = it->EndsWith("/" + relativeserved[i]);
+        }
+        if (!isserved)
+        {
+            std::map<wxString, long>::iterator seen = m_deadmounts.find(*it);
+            deadmounts[*it] = (seen == m_deadmounts.end()) ? now : seen->second;
+        }
+    }
+    m_deadmounts = deadmounts;
+
+    // act on the ones that stayed wrong long enough, once
+    bool killorphans = getAppSettings()->getKillOrphans();
+    long nrorphans = 0;
+    long nrkilled = 0;
+    for (std::map<long, long>::iterator it = m_orphans.begin(); it != m_orphans.end(); it++)
+    {
+        if (now - it->second < REAPER_ORPHAN_GRACE_SECS || !m_handledorphans.insert(it->first).second)
+        {
+            continue;
+        }
+        m_stats.m_orphans++;
+        nrorphans++;
+        if (killorphans && kill((pid_t)it->first, SIGTERM) == 0)
+        {
+            m_stats.m_orphanskilled++;
+            nrkilled++;
+        }
+    }
+
+    // only the mount points of our own volumes get detached,
+    // the processes of other users may just be invisible to us
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    const std::vector<wxString>& volumes = snapshot->getVolumeNames();
+    long nrdead = 0;
+    std::vector<WorkItem*> detachitems;
+    std::vector<wxArrayString> detachowners;
+    for (std::map<wxString, long>::iterator it = m_deadmounts.begin(); it != m_deadmounts.end(); it++)
+    {
+        if (now - it->second < REAPER_DEAD_GRACE_SECS || !m_handleddeadmounts.insert(it->first).second)
+        {
+            continue;
+        }
+        m_stats.m_deadmounts++;
+        nrdead++;
+        wxArrayString owners;
+        for (size_t i = 0; i < volumes.size(); i++)
+        {
+            const DBEntry * thisvol = snapshot->getVolume(volumes.at(i));
+            if (thisvol && getReaperPathKey(thisvol->getMountPath()) == it->first)
+            {
+                owners.Add(volumes.at(i));
+            }
+        }
+        if (!owners.IsEmpty())
+        {
+            DetachItem * item = new DetachItem();
+            item->m_mount_path = it->first;
+            item->m_detached = false;
+            detachitems.push_back(item);
+            detachowners.push_back(owners);
+        }
+    }
+
+    // forget what went away, pids get reused
+    std::set<long>::iterator handledorphan = m_handledorphans.begin();
+    while (handledorphan != m_handledorphans.end())
+    {
+        if (m_orphans.find(*handledorphan) == m_orphans.end())
+        {
+            m_handledorphans.erase(handledorphan++);
+            continue;
+        }
+        handledorphan++;
+    }
+    std::set<wxString>::iterator handleddead = m_handleddeadmounts.begin();
+    while (handleddead != m_handleddeadmounts.end())
+    {
+        if (m_deadmounts.find(*handleddead) == m_deadmounts.end())
+        {
+            m_handleddeadmounts.erase(handleddead++);
+            continue;
+        }
+        handleddead++;
+    }
+
+    if (detachitems.empty())
+    {
+        Report(nrorphans, nrkilled, nrdead, 0);
+    }
+    else
+    {
+        // umount blocks as long as the dead mount does, keep it off the ui thread
+        // the pool drops the callback when it stops, which happens before the reaper stops
+        RunWorkItemsWithTimeout(detachitems, DETACH_TIMEOUT_MS,
+            [this, detachowners, nrorphans, nrkilled, nrdead](std::vector<WorkItem*>& doneitems, const std::vector<int>& status)
+            {
+                OnDeadMountsDetached(doneitems, status, detachowners, nrorphans, nrkilled, nrdead);
+            });
+    }
+
+    // look again soon while something waits for its grace period to end
+    bool waiting = false;
+    for (std::map<long, long>::iterator it = m_orphans.begin(); it != m_orphans.end() && !waiting; it++)
+    {
+        waiting = (m_handledorphans.find(it->first) == m_handledorphans.end());
+    }
+    for (std::map<wxString, long>::iterator it = m_deadmounts.begin(); it != m_deadmounts.end() && !waiting; it++)
+    {
+        waiting = (m_handleddeadmounts.find(it->first) == m_handleddeadmounts.end());
+    }
+    m_reapertimer.StartOnce(waiting ? REAPER_CONFIRM_INTERVAL_MS : REAPER_INTERVAL_MS);
+}
+
+
+// main thread, once the dead mounts of a scan are detached or timed out
+void Reaper::OnDeadMountsDetached(std::vector<WorkItem*>& items, const std::vector<int>& status, const std::vector<wxArrayString>& owners, long nrorphans, long nrkilled, long nrdead)
+{
+    // the state may have changed while umount ran
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    long nrunmounted = 0;
+    wxArrayString unmountedvolumes;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        if (status.at(i) != WORKITEM_DONE || !static_cast<DetachItem*>(items.at(i))->m_detached)
+        {
+            continue;
+        }
+        m_stats.m_deadunmounted++;
+        nrunmounted++;
+        for (size_t j = 0; j < owners.at(i).GetCount(); j++)
+        {
+            const DBEntry * thisvol = snapshot->getVolume(owners.at(i)[j]);
+            if (thisvol && thisvol->getMountState())
+            {
+                unmountedvolumes.Add(owners.at(i)[j]);
+            }
+        }
+    }
+
+    if (!unmountedvolumes.IsEmpty() && g_frmMain)
+    {
+        // the volumes are gone, only the state needs to follow
+        g_frmMain->OnVolumesIdleUnmounted(unmountedvolumes);
+    }
+    Report(nrorphans, nrkilled, nrdead, nrunmounted);
+}
+
+
+void Reaper::Report(long nrorphans, long nrkilled, long nrdead, long nrunmounted)
+{
+    if (nrorphans == 0 && nrdead == 0)
+    {
+        return;
+    }
+    wxString msg;
+    if (nrorphans > 0)
+    {
+        msg << wxString::Format(wxT("Found %ld encfs process(es) without a mount, stopped %ld.\n"), nrorphans, nrkilled);
+    }
+    if (nrdead > 0)
+    {
+        msg << wxString::Format(wxT("Found %ld dead mount point(s), unmounted %ld.\n"), nrdead, nrunmounted);
+    }
+    msg.Trim();
+    showVolumeNotification("EncFS cleanup", msg);
+}
+
+
+void Reaper::OnReaperTimer(wxTimerEvent& WXUNUSED(event))
+{
+    Scan();
+}
+
+
+static Reaper * g_reaper = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// a dead mount point can't be unmounted the normal way as a user,
+// detach it instead: it disappears right away, even if something still has it open
+bool unmountDeadMount(const wxString& mount_path)
+{
+    wxArrayString args;
+#ifdef __WXOSX__
+    args.Add(getUMountBinPath());
+    args.Add("-f");
+#else
+    static const char * fusermountpaths[] = { "/bin/fusermount3",
+                                              "/usr/bin/fusermount3",
+                                              "/bin/fusermount",
+                                              "/usr/bin/fusermount" };
+    for (size_t i = 0; i < sizeof(fusermountpaths) / sizeof(fusermountpaths[0]) && args.IsEmpty(); i++)
+    {
+        if (wxFileName::FileExists(fusermountpaths[i]))
+        {
+            args.Add(fusermountpaths[i]);
+            args.Add("-u");
+            args.Add("-z");
+        }
+    }
+    if (args.IsEmpty())
+    {
+        args.Add(getUMountBinPath());
+        args.Add("-l");
+    }
+#endif
+    args.Add(mount_path);
+    wxString cmdoutput;
+    RunCMDArgvSync(args, wxEmptyString, cmdoutput);
+    return !IsVolumeSystemMounted(mount_path, getSystemMountTable());
+}
+
+
+// same, on the worker pool so the ui thread never waits for umount
+// done gets called on the main thread, with false if it failed or did not finish in time
+void detachDeadMount(const wxString& mount_path, std::function<void(bool)> done)
+{
+    DetachItem * item = new DetachItem();
+    item->m_mount_path = mount_path;
+    item->m_detached = false;
+    std::vector<WorkItem*> items;
+    items.push_back(item);
+
+    RunWorkItemsWithTimeout(items, DETACH_TIMEOUT_MS,
+        [done](std::vector<WorkItem*>& doneitems, const std::vector<int>& status)
+        {
+            bool detached = (status.at(0) == WORKITEM_DONE) && static_cast<DetachItem*>(doneitems.at(0))->m_detached;
+            if (done)
+            {
+                done(detached);
+            }
+        });
+}
+
+
+void startReaper()
+{
+    if (g_reaper)
+    {
+        return;
+    }
+    g_reaper = new Reaper();
+    g_reaper->Start();
+}
+
+
+// main thread only
+void stopReaper()
+{
+    delete g_reaper;
+    g_reaper = NULL;
+}
+
+
+// what the reaper found & fixed since the app started
+ReaperStats getReaperStats()
+{
+    if (!g_reaper)
+    {
+        ReaperStats stats;
+        stats.m_orphans = 0;
+        stats.m_orphanskilled = 0;
+        stats.m_deadmounts = 0;
+        stats.m_deadunmounted = 0;
+        return stats;
+    }
+    return g_reaper->m_stats;
+}
@@ -18,6 +18,8 @@
 #include <wx/file.h>
 #include <wx/filefn.h> // wxRemoveFile
 #include <wx/stdpaths.h>
+#include <wx/spinctrl.h>
+#include <vector>
 
 #include "encfsgui.h"
 
@@ -33,9 +35,25 @@ enum
     ID_CHECK_STARTATLOGIN,
     ID_CHECK_STARTASICON,
     ID_CHECK_UNMOUNT_ON_QUIT,
-    ID_CHECK_UPDATES
+    ID_CHECK_RESTORESESSION,
+    ID_CHECK_UPDATES,
+    ID_CHECK_KILLORPHANS
 };
 
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+// the config watcher can swap the config object while a dialog is open,
+// so get it again instead of holding on to it
+static void disableStartAtLogin()
+{
+    wxConfigBase *pConfig = wxConfigBase::Get();
+    pConfig->SetPath(wxT("/Config"));
+    pConfig->Write(wxT("startatlogin"), false);
+    flushConfig();
+}
+
 // ----------------------------------------------------------------------------
 // Classes
 // ----------------------------------------------------------------------------
@@ -71,7 +89,10 @@ private:
     wxCheckBox * m_chkbx_unmount_on_quit;
     wxCheckBox * m_chkbx_prompt_on_quit;
     wxCheckBox * m_chkbx_prompt_on_unmount;
+    wxCheckBox * m_chkbx_restore_session;
     wxCheckBox * m_chkbx_check_updates;
+    wxCheckBox * m_chkbx_kill_orphans;
+    wxSpinCtrl * m_maxmounted_field;
 };
 
 
@@ -115,9 +136,6 @@ void frmSettingsDialog::SetCurrentUMountBinPath(wxString &umountbinpath)
 
 void frmSettingsDialog::SelectEncFSBinPath(wxCommandEvent& WXUNUSED(event))
 {
-
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
     wxString currentbin;
     currentbin = getEncFSBinPath();
 
@@ -137,10 +155,8 @@ void frmSettingsDialog::SelectEncFSBinPath(wxCommandEvent& WXUNUSED(event))
 
 void frmSettingsDialog::SelectMountBinPath(wxCommandEvent& WXUNUSED(event))
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
     wxString currentbin;
-    currentbin = pConfig->Read(wxT("mountbinpath"), "/sbin/mount");
+    currentbin = getMountBinPath();
     wxFileDialog openFileDialog(this, _("Select full path to 'mount' executable"), currentbin, "",
                        "All files (*.*)|*.*", wxFD_OPEN|wxFD_FILE_MUST_EXIST);
     if (openFileDialog.ShowModal() == wxID_OK)
@@ -158,10 +174,8 @@ void frmSettingsDialog::SelectMountBinPath(wxCommandEvent& WXUNUSED(event))
 
 void frmSettingsDialog::SelectUMountBinPath(wxCommandEvent& WXUNUSED(event))
 {
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
     wxString currentbin;
-    currentbin = pConfig->Read(wxT("umountbinpath"), "/sbin/umount");
+    currentbin = getUMountBinPath();
     wxFileDialog openFileDialog(this, _("Select full path to 'umount' executable"), currentbin, "",
                        "All files (*.*)|*.*", wxFD_OPEN|wxFD_FILE_MUST_EXIST);
     if (openFileDialog.ShowModal() == wxID_OK)
@@ -180,20 +194,30 @@ void frmSettingsDialog::SelectUMountBinPath(wxCommandEvent& WXUNUSED(event))
 void frmSettingsDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
 {
 
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
-    pConfig->Write(wxT("encfsbinpath"), m_encfsbin_field->GetValue());
-    pConfig->Write(wxT("mountbinpath"), m_mountbin_field->GetValue());
-    pConfig->Write(wxT("umountbinpath"), m_umountbin_field->GetValue());
-    pConfig->Write(wxT("startatlogin"), m_chkbx_startatlogin->GetValue());
-    pConfig->Write(wxT("startasicon"), m_chkbx_startasicon->GetValue());
-    pConfig->Write(wxT("autounmount"), m_chkbx_unmount_on_quit->GetValue());
-    pConfig->Write(wxT("nopromptonquit"), m_chkbx_prompt_on_quit->GetValue());
-    pConfig->Write(wxT("nopromptonunmount"), m_chkbx_prompt_on_unmount->GetValue());
-    pConfig->Write(wxT("checkupdates"), m_chkbx_check_updates->GetValue());
+    // only until the first dialog, the config object can be replaced while one is open
+    {
+        wxConfigBase *pConfig = wxConfigBase::Get();
+        pConfig->SetPath(wxT("/Config"));
+        pConfig->Write(wxT("encfsbinpath"), m_encfsbin_field->GetValue());
+        pConfig->Write(wxT("mountbinpath"), m_mountbin_field->GetValue());
+        pConfig->Write(wxT("umountbinpath"), m_umountbin_field->GetValue());
+        pConfig->Write(wxT("startatlogin"), m_chkbx_startatlogin->GetValue());
+        pConfig->Write(wxT("startasicon"), m_chkbx_startasicon->GetValue());
+        pConfig->Write(wxT("autounmount"), m_chkbx_unmount_on_quit->GetValue());
+        pConfig->Write(wxT("nopromptonquit"), m_chkbx_prompt_on_quit->GetValue());
+        pConfig->Write(wxT("nopromptonunmount"), m_chkbx_prompt_on_unmount->GetValue());
+        pConfig->Write(wxT("restoresession"), m_chkbx_restore_session->GetValue());
+        pConfig->Write(wxT("maxmounted"), (long)m_maxmounted_field->GetValue());
+        pConfig->Write(wxT("checkupdates"), m_chkbx_check_updates->GetValue());
+        pConfig->Write(wxT("killorphans"), m_chkbx_kill_orphans->GetValue());
+    }
     // to do: remove timer to check for updates, if option was deselected
 
-    pConfig->Flush();
+    if (!flushConfig())
+    {
+        // changed by another program, the dialog stays open so the user can apply again
+        return;
+    }
 
     // set app to run at login if needed
     bool autolaunch = m_chkbx_startatlogin->GetValue();
@@ -219,8 +243,7 @@ void frmSettingsDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
             wxMessageDialog * dlg = new wxMessageDialog(this, errormsg, title, wxOK|wxCENTRE|wxICON_ERROR);
             dlg->ShowModal();
             dlg->Destroy();
-            pConfig->Write(wxT("startatlogin"), false);
-            pConfig->Flush();
+            disableStartAtLogin();
         }
         else
         {
@@ -238,8 +261,7 @@ void frmSettingsDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
                 wxMessageDialog * dlg = new wxMessageDialog(this, errormsg, title, wxOK|wxCENTRE|wxICON_ERROR);
                 dlg->ShowModal();
                 dlg->Destroy();
-                pConfig->Write(wxT("startatlogin"), false);
-                pConfig->Flush();
+                disableStartAtLogin();
             }
         }
     }
@@ -249,14 +271,15 @@ void frmSettingsDialog::SaveSettings(wxCommandEvent& WXUNUSED(event))
         wxRemoveFile(launchfile);
     }
 
+    // publish the new settings
+    loadAppSettings();
+
     Close(true);
 }
 
 void frmSettingsDialog::Create()
 {
-
-    wxConfigBase *pConfig = wxConfigBase::Get();
-    pConfig->SetPath(wxT("/Config"));
+    const AppSettings * settings = getAppSettings();
 
     // add controls to the settings page
     // put everything into a master Sizer
@@ -267,7 +290,7 @@ void frmSettingsDialog::Create()
 
     // encfspath
     sizerGlobal->Add(new wxStaticText(this, wxID_ANY, "&Full path to 'encfs' executable:"));
-    m_encfsbin_field = new wxTextCtrl(this, wxID_ANY, getEncFSBinPath());
+    m_encfsbin_field = new wxTextCtrl(this, wxID_ANY, settings->getEncFSBinPath());
     sizerGlobal->Add(m_encfsbin_field, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 10).Expand());
     sizerGlobal->Add(new wxButton( this , ID_BTN_CHOOSE_ENCFS, wxT("Choose 'encfs' executable")));
 
@@ -275,7 +298,7 @@ void frmSettingsDialog::Create()
 
     // mount binary
     sizerGlobal->Add(new wxStaticText(this, wxID_ANY, "&Full path to 'mount' executable:"));    
-    m_mountbin_field = new wxTextCtrl(this, wxID_ANY, pConfig->Read(wxT("mountbinpath"), "/sbin/mount"));
+    m_mountbin_field = new wxTextCtrl(this, wxID_ANY, settings->getMountBinPath());
     sizerGlobal->Add(m_mountbin_field, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 10).Expand());
     sizerGlobal->Add(new wxButton( this , ID_BTN_CHOOSE_MOUNT, wxT("Choose 'mount' executable")));
 
@@ -283,7 +306,7 @@ void frmSettingsDialog::Create()
 
     // umount binary
     sizerGlobal->Add(new wxStaticText(this, wxID_ANY, "&Full path to 'umount' executable:"));   
-    m_umountbin_field = new wxTextCtrl(this, wxID_ANY, pConfig->Read(wxT("umountbinpath"), "/sbin/umount"));
+    m_umountbin_field = new wxTextCtrl(this, wxID_ANY, settings->getUMountBinPath());
     sizerGlobal->Add(m_umountbin_field, wxSizerFlags().Border(wxLEFT|wxBOTTOM|wxRIGHT, 10).Expand());
     sizerGlobal->Add(new wxButton( this , ID_BTN_CHOOSE_UMOUNT, wxT("Choose 'umount' executable")));
 
@@ -291,38 +314,49 @@ void frmSettingsDialog::Create()
     // start at login
     wxSizer * const sizerStartup = new wxStaticBoxSizer(wxVERTICAL, this, "Startup && exit options");
     m_chkbx_startatlogin  = new wxCheckBox(this, ID_CHECK_STARTATLOGIN, "Start encfsgui at login");
-    // 0l = disabled by default
-    // 1l = enabled by default
-    m_chkbx_startatlogin->SetValue(pConfig->Read(wxT("startatlogin"), 0l) != 0);
+    m_chkbx_startatlogin->SetValue(settings->getStartAtLogin());
     sizerStartup->Add(m_chkbx_startatlogin);
 
     m_chkbx_startasicon  = new wxCheckBox(this, ID_CHECK_STARTASICON, "Start encfsgui as icon in taskbar");
-    // 0l = disabled by default
-    // 1l = enabled by default
-    m_chkbx_startasicon->SetValue(pConfig->Read(wxT("startasicon"), 0l) != 0);
+    m_chkbx_startasicon->SetValue(settings->getStartAsIcon());
     sizerStartup->Add(m_chkbx_startasicon);
 
 
     // unmount when exit
     m_chkbx_unmount_on_quit  = new wxCheckBox(this, ID_CHECK_UNMOUNT_ON_QUIT, "Auto unmount volumes when closing app");
-    // 0l = disabled by default
-    // 1l = enabled by default
-    m_chkbx_unmount_on_quit->SetValue(pConfig->Read(wxT("autounmount"), 0l) != 0);
+    m_chkbx_unmount_on_quit->SetValue(settings->getAutoUnmount());
     sizerStartup->Add(m_chkbx_unmount_on_quit);
 
 
     m_chkbx_prompt_on_unmount = new wxCheckBox(this, ID_CHECK_UNMOUNT_ON_QUIT, "Do not prompt for confirmation on unmount");
-    m_chkbx_prompt_on_unmount->SetValue(pConfig->Read(wxT("nopromptonunmount"), 0l) != 0);
+    m_chkbx_prompt_on_unmount->SetValue(settings->getNoPromptOnUnmount());
     sizerStartup->Add(m_chkbx_prompt_on_unmount);
 
     m_chkbx_prompt_on_quit = new wxCheckBox(this, ID_CHECK_UNMOUNT_ON_QUIT, "Do not ask for confirmation on exit");
-    m_chkbx_prompt_on_quit->SetValue(pConfig->Read(wxT("nopromptonquit"), 0l) != 0);
+    m_chkbx_prompt_on_quit->SetValue(settings->getNoPromptOnQuit());
     sizerStartup->Add(m_chkbx_prompt_on_quit);
 
+    // instead of the automount volumes
+    m_chkbx_restore_session = new wxCheckBox(this, ID_CHECK_RESTORESESSION, "At startup, remount the volumes that were mounted at exit");
+    m_chkbx_restore_session->SetValue(settings->getRestoreSession());
+    sizerStartup->Add(m_chkbx_restore_session);
+
     m_chkbx_check_updates = new wxCheckBox(this, ID_CHECK_UPDATES, "Automatically check for updates at startup");
-    m_chkbx_check_updates->SetValue(pConfig->Read(wxT("checkupdates"), 0l) != 0);
+    m_chkbx_check_updates->SetValue(settings->getCheckUpdates());
     sizerStartup->Add(m_chkbx_check_updates);
 
+    // encfs processes of registered volumes that lost their mount
+    m_chkbx_kill_orphans = new wxCheckBox(this, ID_CHECK_KILLORPHANS, "Stop encfs processes that no longer serve a mount");
+    m_chkbx_kill_orphans->SetValue(settings->getKillOrphans());
+    sizerStartup->Add(m_chkbx_kill_orphans);
+
+    // shared hosts may limit the nr of encfs processes per user
+    wxSizer * const sizerMaxMounted = new wxBoxSizer(wxHORIZONTAL);
+    sizerMaxMounted->Add(new wxStaticText(this, wxID_ANY, "Max. nr of mounted volumes (0 = no limit):"));
+    m_maxmounted_field = new wxSpinCtrl(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxSize(70,22), wxSP_ARROW_KEYS, 0, 1000, (int)settings->getMaxMounted());
+    sizerMaxMounted->Add(m_maxmounted_field, wxSizerFlags().Border(wxLEFT, 5));
+    sizerStartup->Add(sizerMaxMounted, wxSizerFlags().Border(wxTOP, 5));
+
 
     // glue together
     sizerTop->Add(sizerGlobal, wxSizerFlags(1).Expand().Border());
@@ -347,7 +381,7 @@ void openSettings(wxWindow *parent)
 {   
     wxSize dlgSettingsSize;
     // make height larger when adding more options
-    dlgSettingsSize.Set(400,510);
+    dlgSettingsSize.Set(400,585);
 
     long style = wxDEFAULT_DIALOG_STYLE;// | wxRESIZE_BORDER;
 
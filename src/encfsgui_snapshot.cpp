@@ -0,0 +1,378 @@
+/*
+    encFSGui - encfsgui_snapshot.cpp
+    source file contains code to save & load a snapshot
+    of the volume list, to keep a journal of the
+    mounts started by this app, and to remember
+    which volumes were mounted at exit
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/filename.h>
+#include <wx/ffile.h>
+#include <wx/stdpaths.h>
+#include <wx/tokenzr.h>
+#include <vector>
+#include <map>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const wxString SNAPSHOT_HEADER = "EncFSGui snapshot 2";
+static const wxString SESSION_HEADER = "EncFSGui session 1";
+
+// volume flags in the snapshot
+enum
+{
+    SNAPSHOT_AUTOMOUNT          = 1,
+    SNAPSHOT_PREVENTAUTOUNMOUNT = 2,
+    SNAPSHOT_PWSAVED            = 4,
+    SNAPSHOT_ALLOWOTHER         = 8,
+    SNAPSHOT_MOUNTASLOCAL       = 16,
+    SNAPSHOT_MOUNTED            = 32,
+    SNAPSHOT_HEALTHY            = 64,
+    SNAPSHOT_LAZYMOUNT          = 128
+};
+
+
+// ----------------------------------------------------------------------------
+// file helpers
+// ----------------------------------------------------------------------------
+
+// full path of a file in the app data folder
+wxString getDataFilePath(const wxString& filename)
+{
+    wxStandardPathsBase& stdp = wxStandardPaths::Get();
+    wxString datadir = stdp.GetUserDataDir();
+    if (!wxFileName::DirExists(datadir))
+    {
+        wxFileName::Mkdir(datadir, 0700, wxPATH_MKDIR_FULL);
+    }
+    wxString filepath;
+    filepath.Printf(wxT("%s/%s"), datadir, filename);
+    return filepath;
+}
+
+// fields are tab separated, so tabs, newlines & backslashes need escaping
+static wxString escapeField(const wxString& field)
+{
+    wxString escaped = field;
+    escaped.Replace("\\", "\\\\");
+    escaped.Replace("\t", "\\t");
+    escaped.Replace("\n", "\\n");
+    return escaped;
+}
+
+static wxString unescapeField(const wxString& field)
+{
+    wxString unescaped;
+    for (size_t i = 0; i < field.Length(); i++)
+    {
+        if (field[i] == '\\' && i + 1 < field.Length())
+        {
+            ++i;
+            if (field[i] == 't')
+            {
+                unescaped << '\t';
+            }
+            else if (field[i] == 'n')
+            {
+                unescaped << '\n';
+            }
+            else
+            {
+                unescaped << field[i];
+            }
+        }
+        else
+        {
+            unescaped << field[i];
+        }
+    }
+    return unescaped;
+}
+
+// split a line on tabs, keeping empty fields
+static wxArrayString splitLine(const wxString& line)
+{
+    wxArrayString fields = wxStringTokenize(line, "\t", wxTOKEN_RET_EMPTY_ALL);
+    for (size_t i = 0; i < fields.GetCount(); i++)
+    {
+        fields[i] = unescapeField(fields[i]);
+    }
+    return fields;
+}
+
+// write to a temp file first and rename it, so a crash never leaves a half written file
+bool writeDataFileAtomic(const wxString& filepath, const wxString& contents)
+{
+    wxString tmpfilepath = filepath + ".tmp";
+    wxFFile tmpfile(tmpfilepath, "w");
+    if (!tmpfile.IsOpened())
+    {
+        return false;
+    }
+    bool written = tmpfile.Write(contents, wxConvUTF8);
+    written = tmpfile.Close() && written;
+    if (!written)
+    {
+        wxRemoveFile(tmpfilepath);
+        return false;
+    }
+    return wxRenameFile(tmpfilepath, filepath, true);
+}
+
+bool readDataFile(const wxString& filepath, wxString& contents)
+{
+    if (!wxFileName::FileExists(filepath))
+    {
+        return false;
+    }
+    wxFFile file(filepath, "r");
+    return (file.IsOpened() && file.ReadAll(&contents, wxConvUTF8));
+}
+
+
+// ----------------------------------------------------------------------------
+// volume snapshot
+// ----------------------------------------------------------------------------
+
+// save the volume list, including last known mount state & health
+bool saveVolumeSnapshot(std::vector<wxString>& volumes, std::map<wxString, DBEntry*>& volumedata)
+{
+    wxString contents;
+    contents << SNAPSHOT_HEADER << "\n";
+    for (size_t i = 0; i < volumes.size(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = volumedata.find(volumes.at(i));
+        if (it == volumedata.end())
+        {
+            continue;
+        }
+        DBEntry * thisvol = it->second;
+        long flags = 0;
+        flags |= thisvol->getAutoMount() ? SNAPSHOT_AUTOMOUNT : 0;
+        flags |= thisvol->getPreventAutoUnmount() ? SNAPSHOT_PREVENTAUTOUNMOUNT : 0;
+        flags |= thisvol->getPwSavedState() ? SNAPSHOT_PWSAVED : 0;
+        flags |= thisvol->getAllowOther() ? SNAPSHOT_ALLOWOTHER : 0;
+        flags |= thisvol->getMountAsLocal() ? SNAPSHOT_MOUNTASLOCAL : 0;
+        flags |= thisvol->getMountState() ? SNAPSHOT_MOUNTED : 0;
+        flags |= thisvol->getHealthState() ? SNAPSHOT_HEALTHY : 0;
+        flags |= thisvol->getLazyMount() ? SNAPSHOT_LAZYMOUNT : 0;
+        wxString line;
+        line.Printf(wxT("%s\t%s\t%s\t%ld\t%s\t%ld\n"),
+                    escapeField(thisvol->getVolName()),
+                    escapeField(thisvol->getEncPath()),
+                    escapeField(thisvol->getMountPath()),
+                    flags,
+                    escapeField(thisvol->getHealthInfo()),
+                    thisvol->getIdleTimeout());
+        contents << line;
+    }
+    return writeDataFileAtomic(getDataFilePath("volumes.snapshot"), contents);
+}
+
+
+// load the volume list from the snapshot
+// returns false if there is no usable snapshot, volumes & volumedata are left untouched
+bool loadVolumeSnapshot(std::vector<wxString>& volumes, std::map<wxString, DBEntry*>& volumedata)
+{
+    wxString contents;
+    if (!readDataFile(getDataFilePath("volumes.snapshot"), contents))
+    {
+        return false;
+    }
+    wxArrayString lines = wxStringTokenize(contents, "\n", wxTOKEN_STRTOK);
+    if (lines.IsEmpty() || lines[0] != SNAPSHOT_HEADER)
+    {
+        return false;
+    }
+
+    std::vector<wxString> snapvolumes;
+    std::map<wxString, DBEntry*> snapvolumedata;
+    for (size_t i = 1; i < lines.GetCount(); i++)
+    {
+        wxArrayString fields = splitLine(lines[i]);
+        long flags;
+        long idletimeout;
+        if (fields.GetCount() != 6 || !fields[3].ToLong(&flags) || !fields[5].ToLong(&idletimeout))
+        {
+            // damaged snapshot, don't trust any of it
+            for (std::map<wxString, DBEntry*>::iterator it = snapvolumedata.begin(); it != snapvolumedata.end(); it++)
+            {
+                delete it->second;
+            }
+            return false;
+        }
+        DBEntry * thisvol = new DBEntry(fields[0],
+                                        fields[1],
+                                        fields[2],
+                                        (flags & SNAPSHOT_AUTOMOUNT) != 0,
+                                        (flags & SNAPSHOT_PREVENTAUTOUNMOUNT) != 0,
+                                        (flags & SNAPSHOT_PWSAVED) != 0,
+                                        (flags & SNAPSHOT_ALLOWOTHER) != 0,
+                                        (flags & SNAPSHOT_MOUNTASLOCAL) != 0);
+        thisvol->setMountState((flags & SNAPSHOT_MOUNTED) != 0);
+        thisvol->setHealth((flags & SNAPSHOT_HEALTHY) != 0, fields[4]);
+        thisvol->setIdleTimeout(idletimeout);
+        thisvol->setLazyMount((flags & SNAPSHOT_LAZYMOUNT) != 0);
+        snapvolumes.push_back(fields[0]);
+        snapvolumedata[fields[0]] = thisvol;
+    }
+
+    volumes = snapvolumes;
+    volumedata = snapvolumedata;
+    return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// mount journal
+// append only, one line per event:
+// M <tab> start time <tab> pid <tab> volume name <tab> mount path
+// U <tab> time <tab> volume name
+// ----------------------------------------------------------------------------
+
+MountJournalEntry::MountJournalEntry()
+{
+    m_pid = 0;
+    m_starttime = 0;
+}
+
+
+static bool appendToMountJournal(const wxString& line)
+{
+    wxFFile journal(getDataFilePath("mounts.journal"), "a");
+    if (!journal.IsOpened())
+    {
+        return false;
+    }
+    bool written = journal.Write(line, wxConvUTF8);
+    return journal.Close() && written;
+}
+
+
+void journalMountStarted(const wxString& volname, long pid, const wxString& mount_path)
+{
+    wxString line;
+    line.Printf(wxT("M\t%ld\t%ld\t%s\t%s\n"), (long)wxGetUTCTime(), pid, escapeField(volname), escapeField(mount_path));
+    appendToMountJournal(line);
+}
+
+
+void journalMountStopped(const wxString& volname)
+{
+    wxString line;
+    line.Printf(wxT("U\t%ld\t%s\n"), (long)wxGetUTCTime(), escapeField(volname));
+    appendToMountJournal(line);
+}
+
+
+// replay the journal, returns the mounts that are still open according to the journal
+std::map<wxString, MountJournalEntry> readMountJournal()
+{
+    std::map<wxString, MountJournalEntry> mounts;
+    wxString contents;
+    if (!readDataFile(getDataFilePath("mounts.journal"), contents))
+    {
+        return mounts;
+    }
+    wxArrayString lines = wxStringTokenize(contents, "\n", wxTOKEN_STRTOK);
+    for (size_t i = 0; i < lines.GetCount(); i++)
+    {
+        wxArrayString fields = splitLine(lines[i]);
+        if (fields.GetCount() == 5 && fields[0] == "M")
+        {
+            MountJournalEntry entry;
+            fields[1].ToLong(&entry.m_starttime);
+            fields[2].ToLong(&entry.m_pid);
+            entry.m_volname = fields[3];
+            entry.m_mount_path = fields[4];
+            mounts[entry.m_volname] = entry;
+        }
+        else if (fields.GetCount() == 3 && fields[0] == "U")
+        {
+            mounts.erase(fields[2]);
+        }
+        // anything else is a partial line from a crash, ignore it
+    }
+    return mounts;
+}
+
+
+// rewrite the journal so it only contains the mounts that are still open
+bool compactMountJournal(std::map<wxString, MountJournalEntry>& mounts)
+{
+    wxString contents;
+    for (std::map<wxString, MountJournalEntry>::iterator it = mounts.begin(); it != mounts.end(); it++)
+    {
+        wxString line;
+        line.Printf(wxT("M\t%ld\t%ld\t%s\t%s\n"),
+                    it->second.m_starttime,
+                    it->second.m_pid,
+                    escapeField(it->second.m_volname),
+                    escapeField(it->second.m_mount_path));
+        contents << line;
+    }
+    return writeDataFileAtomic(getDataFilePath("mounts.journal"), contents);
+}
+
+
+// ----------------------------------------------------------------------------
+// mount session
+// the volumes that were mounted when the app was closed, one per line
+// ----------------------------------------------------------------------------
+
+bool saveMountSession(const wxArrayString& volumes)
+{
+    wxString contents;
+    contents << SESSION_HEADER << "\n";
+    for (size_t i = 0; i < volumes.GetCount(); i++)
+    {
+        contents << escapeField(volumes[i]) << "\n";
+    }
+    return writeDataFileAtomic(getDataFilePath("mounts.session"), contents);
+}
+
+
+// the volumes that were mounted at the end of the previous session
+// the session file only gets written on a clean exit and is removed here,
+// so if it's missing the app never got to quit (crash, kill, power loss)
+// in that case the journal still has the mounts that were open at that time
+wxArrayString takeMountSession()
+{
+    wxArrayString volumes;
+    wxString sessionfile = getDataFilePath("mounts.session");
+    wxString contents;
+    if (readDataFile(sessionfile, contents))
+    {
+        wxArrayString lines = wxStringTokenize(contents, "\n", wxTOKEN_STRTOK);
+        if (!lines.IsEmpty() && lines[0] == SESSION_HEADER)
+        {
+            for (size_t i = 1; i < lines.GetCount(); i++)
+            {
+                volumes.Add(unescapeField(lines[i]));
+            }
+        }
+        wxRemoveFile(sessionfile);
+        return volumes;
+    }
+
+    std::map<wxString, MountJournalEntry> journal = readMountJournal();
+    for (std::map<wxString, MountJournalEntry>::iterator it = journal.begin(); it != journal.end(); it++)
+    {
+        volumes.Add(it->first);
+    }
+    return volumes;
+}
@@ -0,0 +1,416 @@
+/*
+    encFSGui - encfsgui_supervisor.cpp
+    source file contains code to keep an eye on the encfs
+    processes the app started, and to mount a volume again
+    when its encfs process dies
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/thread.h>
+#include <wx/timer.h>
+#include <map>
+#include <set>
+#include <string>
+
+#include <errno.h>
+#include <sys/wait.h>
+
+#include "encfsgui.h"
+
+
+// main window, keeps the volume state
+extern frmMain * g_frmMain;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// the log of a volume gets rotated when it grows beyond this, at the next mount
+static const wxFileOffset MOUNT_LOG_MAX_SIZE = 1024 * 1024;
+
+// wait 2s, 4s, 8s, ... before mounting a crashed volume again
+static const int REMOUNT_MAX_TRIES = 5;
+static const long REMOUNT_FIRST_DELAY_MS = 2000;
+// a volume that stayed up this long starts with a clean slate when it crashes
+static const long REMOUNT_STABLE_SECS = 300;
+
+enum
+{
+    ID_TIMER_REMOUNT = 1
+};
+
+
+// the app is shutting down, the watch threads must leave the main window alone
+static wxCriticalSection g_supervisorLock;
+static bool g_supervisorStopped = false;
+
+// volume name -> supervised encfs process
+// main thread only
+class SupervisedMount
+{
+public:
+    long m_pid;
+    long m_starttime;
+};
+static std::map<wxString, SupervisedMount> g_supervisedMounts;
+
+
+// ----------------------------------------------------------------------------
+// MountProcessThread - waits for one encfs process to exit
+// blocking in waitpid reports the exit right away, without a SIGCHLD handler
+// (which would get in the way of the one wxExecute installs)
+// ----------------------------------------------------------------------------
+
+class MountProcessThread : public wxThread
+{
+public:
+    MountProcessThread(const wxString& volname, long pid) : wxThread(wxTHREAD_DETACHED)
+    {
+        m_volname = volname;
+        m_pid = pid;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        int status = 0;
+        while (waitpid((pid_t)m_pid, &status, 0) < 0)
+        {
+            if (errno != EINTR)
+            {
+                // not our child (anymore), nothing to report
+                return (ExitCode)0;
+            }
+        }
+        MountProcessExit exitinfo;
+        exitinfo.m_volname = m_volname;
+        exitinfo.m_pid = m_pid;
+        exitinfo.m_status = status;
+        wxCriticalSectionLocker lock(g_supervisorLock);
+        if (!g_supervisorStopped && g_frmMain)
+        {
+            g_frmMain->CallAfter(&frmMain::OnMountProcessExited, exitinfo);
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    wxString m_volname;
+    long m_pid;
+};
+
+
+// ----------------------------------------------------------------------------
+// RemountScheduler - mounts crashed volumes again, with a growing delay
+// ----------------------------------------------------------------------------
+
+class RemountScheduler : public wxEvtHandler
+{
+public:
+    RemountScheduler();
+    virtual ~RemountScheduler();
+    long Schedule(const wxString& volname, long uptime);
+    bool Finish(const wxString& volname, bool mounted);
+
+private:
+    void Reschedule();
+    void OnRemountTimer(wxTimerEvent& event);
+
+    class RemountState
+    {
+    public:
+        int m_tries;
+        wxLongLong m_due;
+        bool m_running;
+    };
+
+    wxTimer m_remounttimer;
+    std::map<wxString, RemountState> m_volumes;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(RemountScheduler, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_REMOUNT, RemountScheduler::OnRemountTimer)
+wxEND_EVENT_TABLE()
+
+
+RemountScheduler::RemountScheduler() : m_remounttimer(this, ID_TIMER_REMOUNT)
+{
+}
+
+
+RemountScheduler::~RemountScheduler()
+{
+    m_remounttimer.Stop();
+}
+
+
+// returns the delay in ms, or -1 if the volume crashed too often
+long RemountScheduler::Schedule(const wxString& volname, long uptime)
+{
+    std::map<wxString, RemountState>::iterator it = m_volumes.find(volname);
+    if (it == m_volumes.end())
+    {
+        RemountState state;
+        state.m_tries = 0;
+        state.m_running = false;
+        it = m_volumes.insert(std::make_pair(volname, state)).first;
+    }
+    else if (uptime >= REMOUNT_STABLE_SECS)
+    {
+        it->second.m_tries = 0;
+    }
+    if (it->second.m_tries >= REMOUNT_MAX_TRIES)
+    {
+        m_volumes.erase(it);
+        Reschedule();
+        return -1;
+    }
+    long delay = REMOUNT_FIRST_DELAY_MS << it->second.m_tries;
+    it->second.m_tries++;
+    it->second.m_running = false;
+    it->second.m_due = wxGetLocalTimeMillis() + delay;
+    Reschedule();
+    return delay;
+}
+
+
+// returns true if the mount was one of ours
+bool RemountScheduler::Finish(const wxString& volname, bool mounted)
+{
+    std::map<wxString, RemountState>::iterator it = m_volumes.find(volname);
+    if (it == m_volumes.end() || !it->second.m_running)
+    {
+        return false;
+    }
+    it->second.m_running = false;
+    if (mounted)
+    {
+        // keep the nr of tries, in case it crashes again right away
+        it->second.m_due = 0;
+        return true;
+    }
+    if (Schedule(volname, 0) < 0)
+    {
+        wxString msg;
+        msg.Printf(wxT("Unable to mount '%s' again after %d tries."), volname, REMOUNT_MAX_TRIES);
+        showVolumeNotification("Volume not mounted", msg);
+    }
+    return true;
+}
+
+
+void RemountScheduler::Reschedule()
+{
+    wxLongLong next = 0;
+    for (std::map<wxString, RemountState>::iterator it = m_volumes.begin(); it != m_volumes.end(); it++)
+    {
+        if (!it->second.m_running && it->second.m_due > 0 && (next == 0 || it->second.m_due < next))
+        {
+            next = it->second.m_due;
+        }
+    }
+    if (next == 0)
+    {
+        m_remounttimer.Stop();
+        return;
+    }
+    wxLongLong delay = next - wxGetLocalTimeMillis();
+    m_remounttimer.StartOnce(delay > 0 ? (int)delay.GetValue() : 1);
+}
+
+
+void RemountScheduler::OnRemountTimer(wxTimerEvent& WXUNUSED(event))
+{
+    wxLongLong now = wxGetLocalTimeMillis();
+    wxArrayString due;
+    for (std::map<wxString, RemountState>::iterator it = m_volumes.begin(); it != m_volumes.end(); it++)
+    {
+        if (!it->second.m_running && it->second.m_due > 0 && it->second.m_due <= now)
+        {
+            due.Add(it->first);
+        }
+    }
+    VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+    for (size_t i = 0; i < due.GetCount(); i++)
+    {
+        const DBEntry * thisvol = snapshot->getVolume(due[i]);
+        if (!thisvol || thisvol->getMountState())
+        {
+            // removed, or mounted by hand in the mean time
+            m_volumes.erase(due[i]);
+            continue;
+        }
+        m_volumes[due[i]].m_running = true;
+        if (!g_frmMain || !g_frmMain->StartBackgroundMount(due[i]))
+        {
+            m_volumes.erase(due[i]);
+        }
+    }
+    Reschedule();
+}
+
+
+static RemountScheduler * g_remountScheduler = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// where encfs writes its output for a volume, logstart is where the new output will start
+// rotates the log when it got too big, safe to call from worker threads
+wxString prepareMountLog(const wxString& volname, wxFileOffset& logstart)
+{
+    wxString logfile = getDataFilePath("encfs_" + volname + ".log");
+    logstart = 0;
+    if (!wxFileName::FileExists(logfile))
+    {
+        return logfile;
+    }
+    wxFileOffset logsize = (wxFileOffset)wxFileName::GetSize(logfile).GetValue();
+    if (logsize > MOUNT_LOG_MAX_SIZE)
+    {
+        wxRenameFile(logfile, logfile + ".old", true);
+    }
+    else
+    {
+        logstart = logsize;
+    }
+    return logfile;
+}
+
+
+// what encfs wrote to the log after offset
+wxString readMountLog(const wxString& logfile, wxFileOffset offset)
+{
+    wxFile file;
+    if (!wxFileName::FileExists(logfile) || !file.Open(logfile, wxFile::read))
+    {
+        return wxEmptyString;
+    }
+    std::string contents;
+    if (file.Seek(offset) != wxInvalidOffset)
+    {
+        char buffer[4096];
+        ssize_t nrread;
+        while ((nrread = file.Read(buffer, sizeof(buffer))) > 0)
+        {
+            contents.append(buffer, nrread);
+        }
+    }
+    return wxString::FromUTF8(contents.c_str());
+}
+
+
+// start watching an encfs process the app started
+// main thread only
+void superviseMountProcess(const wxString& volname, long pid)
+{
+    if (pid <= 0)
+    {
+        return;
+    }
+    MountProcessThread * thread = new MountProcessThread(volname, pid);
+    if (thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        return;
+    }
+    SupervisedMount mount;
+    mount.m_pid = pid;
+    mount.m_starttime = (long)wxGetUTCTime();
+    g_supervisedMounts[volname] = mount;
+}
+
+
+// forget about a process that exited
+// returns false if it's not the current process of the volume,
+// uptime is the nr of seconds it ran
+// main thread only
+bool endMountSupervision(const MountProcessExit& exitinfo, long& uptime)
+{
+    std::map<wxString, SupervisedMount>::iterator it = g_supervisedMounts.find(exitinfo.m_volname);
+    if (it == g_supervisedMounts.end() || it->second.m_pid != exitinfo.m_pid)
+    {
+        return false;
+    }
+    uptime = (long)wxGetUTCTime() - it->second.m_starttime;
+    g_supervisedMounts.erase(it);
+    return true;
+}
+
+
+// the pids of the encfs processes being supervised
+// main thread only
+std::set<long> getSupervisedProcesses()
+{
+    std::set<long> pids;
+    for (std::map<wxString, SupervisedMount>::iterator it = g_supervisedMounts.begin(); it != g_supervisedMounts.end(); it++)
+    {
+        pids.insert(it->second.m_pid);
+    }
+    return pids;
+}
+
+
+// encfs died, mount the volume again after a while
+// returns the delay in ms, or -1 if we gave up
+// main thread only
+long scheduleCrashRemount(const wxString& volname, long uptime)
+{
+    if (!g_remountScheduler)
+    {
+        g_remountScheduler = new RemountScheduler();
+    }
+    wxString msg;
+    long delay = g_remountScheduler->Schedule(volname, uptime);
+    if (delay < 0)
+    {
+        msg.Printf(wxT("encfs stopped unexpectedly for '%s', and kept doing so.\nCheck %s for details."), volname, getDataFilePath("encfs_" + volname + ".log"));
+    }
+    else
+    {
+        msg.Printf(wxT("encfs stopped unexpectedly for '%s'.\nMounting it again in %ld seconds."), volname, delay / 1000);
+    }
+    showVolumeNotification("Volume stopped", msg);
+    return delay;
+}
+
+
+// a background mount is done
+// returns true if it was a remount after a crash (failures get retried)
+// main thread only
+bool finishCrashRemount(const wxString& volname, bool mounted)
+{
+    if (!g_remountScheduler)
+    {
+        return false;
+    }
+    return g_remountScheduler->Finish(volname, mounted);
+}
+
+
+// leave the processes alone from now on, they keep the volumes
+// that stay mounted after quitting
+void stopMountSupervision()
+{
+    {
+        wxCriticalSectionLocker lock(g_supervisorLock);
+        g_supervisorStopped = true;
+    }
+    delete g_remountScheduler;
+    g_remountScheduler = NULL;
+    g_supervisedMounts.clear();
+}
@@ -0,0 +1,271 @@
+/*
+    encFSGui - encfsgui_system.cpp
+    source file contains code to read the process
+    table and the mount table, without spawning ps or mount
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <signal.h>
+#include <errno.h>
+
+#ifdef __WXOSX__
+    #include <sys/param.h>
+    #include <sys/ucred.h>
+    #include <sys/mount.h>
+    #include <sys/sysctl.h>
+    #include <libproc.h>
+#else
+    #include <dirent.h>
+    #include <mntent.h>
+    #include <unistd.h>
+    #include <wx/ffile.h>
+    #include <wx/tokenzr.h>
+#endif
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// get the mount table, one line per mount, in the same format as the output of mount
+// "<device> on <mount point> (<fs type>)"
+// safe to call from any thread
+wxArrayString getSystemMountTable()
+{
+    wxArrayString mounttable;
+    wxString line;
+#ifdef __WXOSX__
+    // not getmntinfo, that one returns a buffer shared by all threads
+    int nrmounts = getfsstat(NULL, 0, MNT_NOWAIT);
+    if (nrmounts <= 0)
+    {
+        return mounttable;
+    }
+    // leave some room for mounts added in the meantime
+    std::vector<struct statfs> mounts(nrmounts + 16);
+    nrmounts = getfsstat(&mounts[0], (int)(mounts.size() * sizeof(struct statfs)), MNT_NOWAIT);
+    for (int i = 0; i < nrmounts; i++)
+    {
+        line.Printf(wxT("%s on %s (%s)"),
+                    wxString::FromUTF8(mounts[i].f_mntfromname),
+                    wxString::FromUTF8(mounts[i].f_mntonname),
+                    wxString::FromUTF8(mounts[i].f_fstypename));
+        mounttable.Add(line);
+    }
+#else
+    FILE * mtab = setmntent("/proc/mounts", "r");
+    if (mtab)
+    {
+        struct mntent entry;
+        char buffer[4096];
+        while (getmntent_r(mtab, &entry, buffer, sizeof(buffer)))
+        {
+            line.Printf(wxT("%s on %s (%s)"),
+                        wxString::FromUTF8(entry.mnt_fsname),
+                        wxString::FromUTF8(entry.mnt_dir),
+                        wxString::FromUTF8(entry.mnt_type));
+            mounttable.Add(line);
+        }
+        endmntent(mtab);
+    }
+#endif
+    return mounttable;
+}
+
+
+// get the arguments of all processes we are allowed to see, using pid as key
+std::map<long, wxArrayString> getProcessArguments()
+{
+    std::map<long, wxArrayString> processes;
+#ifdef __WXOSX__
+    int nrpids = proc_listallpids(NULL, 0);
+    if (nrpids <= 0)
+    {
+        return processes;
+    }
+    // leave some room for processes started in the meantime
+    std::vector<pid_t> pids(nrpids + 64);
+    nrpids = proc_listallpids(&pids[0], pids.size() * sizeof(pid_t));
+
+    int argmax = 0;
+    size_t size = sizeof(argmax);
+    int argmaxmib[2] = { CTL_KERN, KERN_ARGMAX };
+    if (sysctl(argmaxmib, 2, &argmax, &size, NULL, 0) != 0 || argmax <= 0)
+    {
+        return processes;
+    }
+    std::vector<char> buffer(argmax);
+
+    for (int i = 0; i < nrpids; i++)
+    {
+        // KERN_PROCARGS2 : argc, exec path, padding, argv[0..argc-1], env
+        int mib[3] = { CTL_KERN, KERN_PROCARGS2, pids[i] };
+        size = argmax;
+        if (sysctl(mib, 3, &buffer[0], &size, NULL, 0) != 0 || size <= sizeof(int))
+        {
+            continue;
+        }
+        int argc;
+        memcpy(&argc, &buffer[0], sizeof(argc));
+        size_t pos = sizeof(argc);
+        // skip exec path and the padding after it
+        while (pos < size && buffer[pos] != '\0')
+        {
+            pos++;
+        }
+        while (pos < size && buffer[pos] == '\0')
+        {
+            pos++;
+        }
+        wxArrayString args;
+        while (pos < size && (int)args.GetCount() < argc)
+        {
+            wxString arg = wxString::FromUTF8(&buffer[pos]);
+            args.Add(arg);
+            pos += strlen(&buffer[pos]) + 1;
+        }
+        processes[(long)pids[i]] = args;
+    }
+#else
+    DIR * procdir = opendir("/proc");
+    if (!procdir)
+    {
+        return processes;
+    }
+    struct dirent * entry;
+    while ((entry = readdir(procdir)) != NULL)
+    {
+        long pid;
+        if (!wxString::FromUTF8(entry->d_name).ToLong(&pid))
+        {
+            continue;
+        }
+        wxString cmdlinefile;
+        cmdlinefile.Printf(wxT("/proc/%ld/cmdline"), pid);
+        wxFFile cmdline(cmdlinefile, "rb");
+        if (!cmdline.IsOpened())
+        {
+            continue;
+        }
+        // arguments are separated by \0
+        std::vector<char> buffer;
+        char chunk[4096];
+        size_t nrread;
+        while ((nrread = cmdline.Read(chunk, sizeof(chunk))) > 0)
+        {
+            buffer.insert(buffer.end(), chunk, chunk + nrread);
+        }
+        buffer.push_back('\0');
+        wxArrayString args;
+        size_t pos = 0;
+        while (pos + 1 < buffer.size())
+        {
+            args.Add(wxString::FromUTF8(&buffer[pos]));
+            pos += strlen(&buffer[pos]) + 1;
+        }
+        processes[pid] = args;
+    }
+    closedir(procdir);
+#endif
+    return processes;
+}
+
+
+// check if a process is still running
+bool isProcessAlive(long pid)
+{
+    if (pid <= 0)
+    {
+        return false;
+    }
+    // EPERM means it exists, but belongs to someone else
+    return (kill((pid_t)pid, 0) == 0 || errno == EPERM);
+}
+
+
+// find the encfs process serving a mount point
+// returns 0 if not found
+long findEncFSProcess(const wxString& mount_path)
+{
+    std::map<long, wxArrayString> processes = getProcessArguments();
+    for (std::map<long, wxArrayString>::iterator it = processes.begin(); it != processes.end(); it++)
+    {
+        wxArrayString& args = it->second;
+        if (args.IsEmpty() || !args[0].EndsWith("encfs"))
+        {
+            continue;
+        }
+        for (size_t i = 1; i < args.GetCount(); i++)
+        {
+            if (args[i] == mount_path)
+            {
+                return it->first;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// cpu time used by a process so far, in ms, -1 if unknown
+// encfs uses a bit of cpu for each request it handles,
+// so this tells if a volume was used, without touching the volume
+long long getProcessCPUTime(long pid)
+{
+    if (pid <= 0)
+    {
+        return -1;
+    }
+#ifdef __WXOSX__
+    struct proc_taskinfo info;
+    if (proc_pidinfo((int)pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != (int)sizeof(info))
+    {
+        return -1;
+    }
+    // ns
+    return (long long)((info.pti_total_user + info.pti_total_system) / 1000000);
+#else
+    wxString statfile;
+    statfile.Printf(wxT("/proc/%ld/stat"), pid);
+    wxFFile stat(statfile, "r");
+    wxString contents;
+    if (!stat.IsOpened() || !stat.ReadAll(&contents))
+    {
+        return -1;
+    }
+    // the process name can contain spaces, the fields start after the last ')'
+    int namepos = contents.Find(')', true);
+    if (namepos == wxNOT_FOUND)
+    {
+        return -1;
+    }
+    // state is field 3, utime & stime are fields 14 & 15
+    wxArrayString fields = wxStringTokenize(contents.Mid(namepos + 1), " ", wxTOKEN_STRTOK);
+    unsigned long long utime;
+    unsigned long long stime;
+    if (fields.GetCount() < 13 || !fields[11].ToULongLong(&utime) || !fields[12].ToULongLong(&stime))
+    {
+        return -1;
+    }
+    long ticks = sysconf(_SC_CLK_TCK);
+    if (ticks <= 0)
+    {
+        ticks = 100;
+    }
+    return (long long)((utime + stime) * 1000 / ticks);
+#endif
+}
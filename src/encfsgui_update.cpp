@@ -0,0 +1,449 @@
+/*
+    encFSGui - encfsgui_update.cpp
+    source file contains code to check for
+    a new version of EncFSGui, in the background
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+#include <wx/tokenzr.h>
+#include <string>
+
+#include <curl/curl.h>
+
+#include "encfsgui.h"
+
+
+// main window, receives the results
+extern frmMain * g_frmMain;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const wxString DEFAULT_UPDATE_URL = "https://github.com/corelan/EncFSGui/raw/master/release/version.txt";
+
+// don't hang forever when offline
+static const long UPDATE_CONNECT_TIMEOUT = 5;       // seconds
+static const long UPDATE_TOTAL_TIMEOUT = 15;        // seconds
+
+// automatic checks: once a day, retry failures after 5 min, 10 min, 20 min, ... up to a day
+static const long UPDATE_INTERVAL = 24 * 60 * 60;
+static const long UPDATE_RETRY_MIN = 5 * 60;
+
+
+// ----------------------------------------------------------------------------
+// update cache
+// kept on disk as key=value lines, so we know what we got last time
+// ----------------------------------------------------------------------------
+
+class UpdateCache
+{
+public:
+    UpdateCache()
+    {
+        m_lastcheck = 0;
+        m_nextcheck = 0;
+        m_failures = 0;
+    }
+
+    void Load(const wxString& cachefile)
+    {
+        wxString contents;
+        if (!readDataFile(cachefile, contents))
+        {
+            return;
+        }
+        wxArrayString lines = wxStringTokenize(contents, "\n", wxTOKEN_STRTOK);
+        for (size_t i = 0; i < lines.GetCount(); i++)
+        {
+            wxString key = lines[i].BeforeFirst('=');
+            wxString value = lines[i].AfterFirst('=');
+            if (key == "version")
+            {
+                m_version = value;
+            }
+            else if (key == "etag")
+            {
+                m_etag = value;
+            }
+            else if (key == "lastmodified")
+            {
+                m_lastmodified = value;
+            }
+            else if (key == "lastcheck")
+            {
+                value.ToLong(&m_lastcheck);
+            }
+            else if (key == "nextcheck")
+            {
+                value.ToLong(&m_nextcheck);
+            }
+            else if (key == "failures")
+            {
+                value.ToLong(&m_failures);
+            }
+        }
+    }
+
+    void Save(const wxString& cachefile)
+    {
+        wxString contents;
+        contents << "version=" << m_version << "\n";
+        contents << "etag=" << m_etag << "\n";
+        contents << "lastmodified=" << m_lastmodified << "\n";
+        contents << "lastcheck=" << m_lastcheck << "\n";
+        contents << "nextcheck=" << m_nextcheck << "\n";
+        contents << "failures=" << m_failures << "\n";
+        writeDataFileAtomic(cachefile, contents);
+    }
+
+    wxString m_version;
+    wxString m_etag;
+    wxString m_lastmodified;
+    long m_lastcheck;
+    long m_nextcheck;
+    long m_failures;
+};
+
+
+// ----------------------------------------------------------------------------
+// curl
+// ----------------------------------------------------------------------------
+
+// one handle for the lifetime of the app, so connections can be reused
+// only used by the update thread, and only one check runs at a time
+static CURL * g_curlHandle = NULL;
+static bool g_updateCheckRunning = false;
+// the app is shutting down, a running check gets aborted and must not report back
+static bool g_updateCheckStopped = false;
+static wxCriticalSection g_updateCheckLock;
+
+
+static bool isUpdateCheckStopped()
+{
+    wxCriticalSectionLocker lock(g_updateCheckLock);
+    return g_updateCheckStopped;
+}
+
+
+// callback function to get curl content
+static size_t getHTTPContent(void* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    size_t data_size = size * nmemb;
+    ((std::string *)userdata)->append((char *)ptr, data_size);
+    return data_size;
+}
+
+// callback function to get the response headers we care about
+static size_t getHTTPHeader(char* buffer, size_t size, size_t nitems, void* userdata)
+{
+    size_t data_size = size * nitems;
+    UpdateCache * response = (UpdateCache *)userdata;
+    wxString header = wxString::FromUTF8(buffer, data_size);
+    wxString name = header.BeforeFirst(':').Trim().Lower();
+    wxString value = header.AfterFirst(':').Trim().Trim(false);
+    if (name == "etag")
+    {
+        response->m_etag = value;
+    }
+    else if (name == "last-modified")
+    {
+        response->m_lastmodified = value;
+    }
+    return data_size;
+}
+
+// callback function to abort a transfer when the app quits
+// a non zero return value makes curl stop with CURLE_ABORTED_BY_CALLBACK
+static int checkHTTPAbort(void* WXUNUSED(clientp), curl_off_t WXUNUSED(dltotal), curl_off_t WXUNUSED(dlnow),
+                          curl_off_t WXUNUSED(ultotal), curl_off_t WXUNUSED(ulnow))
+{
+    return isUpdateCheckStopped() ? 1 : 0;
+}
+
+// a version looks like 1.2.3, anything else is probably an error page
+static bool isVersionString(const wxString& version)
+{
+    if (version.IsEmpty() || version.Length() > 32)
+    {
+        return false;
+    }
+    wxArrayString tokens = wxStringTokenize(version, ".", wxTOKEN_RET_EMPTY_ALL);
+    if (tokens.GetCount() < 3)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < tokens.GetCount(); i++)
+    {
+        if (tokens[i].IsEmpty() || !tokens[i].IsNumber())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// fetch version.txt, using ETag / If-Modified-Since from the cache
+// updates the cache, returns false if no usable answer was received
+static bool fetchLatestVersion(const wxString& url, UpdateCache& cache, wxString& errormsg)
+{
+    if (!g_curlHandle)
+    {
+        g_curlHandle = curl_easy_init();
+        if (!g_curlHandle)
+        {
+            errormsg = "Unable to initialize curl";
+            return false;
+        }
+    }
+    CURL * pCurlHandle = g_curlHandle;
+    std::string body;
+    UpdateCache response;
+    struct curl_slist * headers = NULL;
+
+    if (!cache.m_version.IsEmpty())
+    {
+        wxString header;
+        if (!cache.m_etag.IsEmpty())
+        {
+            header.Printf(wxT("If-None-Match: %s"), cache.m_etag);
+            headers = curl_slist_append(headers, header.utf8_str());
+        }
+        if (!cache.m_lastmodified.IsEmpty())
+        {
+            header.Printf(wxT("If-Modified-Since: %s"), cache.m_lastmodified);
+            headers = curl_slist_append(headers, header.utf8_str());
+        }
+    }
+
+    wxCharBuffer urlbuffer(url.utf8_str());
+    curl_easy_setopt(pCurlHandle, CURLOPT_URL, urlbuffer.data());
+    // force SSL peer verification
+    curl_easy_setopt(pCurlHandle, CURLOPT_SSL_VERIFYPEER, 1L);
+    // force hostname verification
+    curl_easy_setopt(pCurlHandle, CURLOPT_SSL_VERIFYHOST, 2L);
+    // no progress meter, the progress callback is only there to abort on quit
+    curl_easy_setopt(pCurlHandle, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(pCurlHandle, CURLOPT_XFERINFOFUNCTION, checkHTTPAbort);
+    curl_easy_setopt(pCurlHandle, CURLOPT_XFERINFODATA, NULL);
+    // there might be a redirect
+    curl_easy_setopt(pCurlHandle, CURLOPT_FOLLOWLOCATION, 1L);
+    // we're on a thread, don't use signals for the timeouts
+    curl_easy_setopt(pCurlHandle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(pCurlHandle, CURLOPT_CONNECTTIMEOUT, UPDATE_CONNECT_TIMEOUT);
+    curl_easy_setopt(pCurlHandle, CURLOPT_TIMEOUT, UPDATE_TOTAL_TIMEOUT);
+    curl_easy_setopt(pCurlHandle, CURLOPT_HTTPHEADER, headers);
+    // go get the data
+    curl_easy_setopt(pCurlHandle, CURLOPT_WRITEFUNCTION, getHTTPContent);
+    curl_easy_setopt(pCurlHandle, CURLOPT_WRITEDATA, &body);
+    curl_easy_setopt(pCurlHandle, CURLOPT_HEADERFUNCTION, getHTTPHeader);
+    curl_easy_setopt(pCurlHandle, CURLOPT_HEADERDATA, &response);
+
+    CURLcode res = curl_easy_perform(pCurlHandle);
+    long httpcode = 0;
+    curl_easy_getinfo(pCurlHandle, CURLINFO_RESPONSE_CODE, &httpcode);
+    // the header list is freed below, don't leave it behind in the handle
+    curl_easy_setopt(pCurlHandle, CURLOPT_HTTPHEADER, NULL);
+    curl_slist_free_all(headers);
+
+    if (res != CURLE_OK)
+    {
+        errormsg.Printf(wxT("curl_easy_perform() failed: %s"), curl_easy_strerror(res));
+        return false;
+    }
+
+    if (httpcode == 304 && !cache.m_version.IsEmpty())
+    {
+        // not modified, what we have is still the latest
+        return true;
+    }
+    if (httpcode != 200)
+    {
+        errormsg.Printf(wxT("Unexpected HTTP status %ld"), httpcode);
+        return false;
+    }
+
+    wxString latestversion = wxString::FromUTF8(body.c_str());
+    latestversion.Replace(" ","");
+    latestversion.Replace("\r","");
+    latestversion.Replace("\n","");
+    if (!isVersionString(latestversion))
+    {
+        errormsg = "No valid version found in the response";
+        return false;
+    }
+
+    cache.m_version = latestversion;
+    cache.m_etag = response.m_etag;
+    cache.m_lastmodified = response.m_lastmodified;
+    return true;
+}
+
+
+// ----------------------------------------------------------------------------
+// UpdateCheckThread
+// ----------------------------------------------------------------------------
+
+class UpdateCheckThread : public wxThread
+{
+public:
+    UpdateCheckThread(const wxString& url, const wxString& cachefile, bool showIfNoUpdate) : wxThread(wxTHREAD_DETACHED)
+    {
+        m_url = url;
+        m_cachefile = cachefile;
+        m_showIfNoUpdate = showIfNoUpdate;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        UpdateCache cache;
+        cache.Load(m_cachefile);
+        wxString errormsg;
+        long now = (long)wxGetUTCTime();
+        cache.m_lastcheck = now;
+        bool fetched = fetchLatestVersion(m_url, cache, errormsg);
+        if (isUpdateCheckStopped())
+        {
+            // aborted, not a failure worth remembering
+            return (ExitCode)0;
+        }
+        if (fetched)
+        {
+            cache.m_failures = 0;
+            cache.m_nextcheck = now + UPDATE_INTERVAL;
+        }
+        else
+        {
+            // back off: 5 min, 10 min, 20 min, ... up to a day
+            long delay = UPDATE_RETRY_MIN;
+            for (long i = 0; i < cache.m_failures && delay < UPDATE_INTERVAL; i++)
+            {
+                delay *= 2;
+            }
+            if (delay > UPDATE_INTERVAL)
+            {
+                delay = UPDATE_INTERVAL;
+            }
+            cache.m_failures++;
+            cache.m_nextcheck = now + delay;
+            wxLogDebug(errormsg);
+        }
+        cache.Save(m_cachefile);
+
+        {
+            wxCriticalSectionLocker lock(g_updateCheckLock);
+            g_updateCheckRunning = false;
+        }
+
+        // hand the result to the main thread
+        // when a manual check fails, report that instead of what we had cached
+        wxString latestversion = cache.m_version;
+        if (m_showIfNoUpdate && !errormsg.IsEmpty())
+        {
+            latestversion = "";
+        }
+        wxCriticalSectionLocker lock(g_updateCheckLock);
+        if (g_frmMain && !g_updateCheckStopped)
+        {
+            g_frmMain->CallAfter(&frmMain::OnUpdateCheckDone, latestversion, m_showIfNoUpdate);
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    wxString m_url;
+    wxString m_cachefile;
+    bool m_showIfNoUpdate;
+};
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// call once at startup, before any thread uses curl
+// there is no matching cleanup, a check may still be running when the app exits
+void initUpdateChecker()
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+}
+
+
+// start a check in the background, frmMain::OnUpdateCheckDone gets called with the result
+// forced checks always go to the network, others use the cache until the next check is due
+// returns false if a check is already running
+bool startUpdateCheck(bool forced)
+{
+    {
+        wxCriticalSectionLocker lock(g_updateCheckLock);
+        if (g_updateCheckRunning || g_updateCheckStopped)
+        {
+            return false;
+        }
+        g_updateCheckRunning = true;
+    }
+
+    wxString url = getAppSettings()->getUpdateURL();
+    if (url.IsEmpty())
+    {
+        url = DEFAULT_UPDATE_URL;
+    }
+    wxString cachefile = getDataFilePath("update.cache");
+
+    if (!forced)
+    {
+        UpdateCache cache;
+        cache.Load(cachefile);
+        if ((long)wxGetUTCTime() < cache.m_nextcheck)
+        {
+            {
+                wxCriticalSectionLocker lock(g_updateCheckLock);
+                g_updateCheckRunning = false;
+            }
+            if (g_frmMain)
+            {
+                g_frmMain->CallAfter(&frmMain::OnUpdateCheckDone, cache.m_version, false);
+            }
+            return true;
+        }
+    }
+
+    UpdateCheckThread * thread = new UpdateCheckThread(url, cachefile, forced);
+    if (thread->Run() != wxTHREAD_NO_ERROR)
+    {
+        delete thread;
+        wxCriticalSectionLocker lock(g_updateCheckLock);
+        g_updateCheckRunning = false;
+        return false;
+    }
+    return true;
+}
+
+
+// abort a running check, nothing gets reported after this
+// the thread itself may still be winding down when the app exits
+void stopUpdateChecker()
+{
+    wxCriticalSectionLocker lock(g_updateCheckLock);
+    g_updateCheckStopped = true;
+}
+
+
+// latest version we know of, without going to the network
+wxString getCachedLatestVersion()
+{
+    UpdateCache cache;
+    cache.Load(getDataFilePath("update.cache"));
+    return cache.m_version;
+}
@@ -0,0 +1,179 @@
+/*
+    encFSGui - encfsgui_validate.cpp
+    source file contains code to check if the
+    folders of all registered volumes are still usable
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// max time for the checks of one volume, a path on a dead network share
+// would otherwise never come back
+static const long VALIDATION_TIMEOUT_MS = 2000;
+
+
+// ----------------------------------------------------------------------------
+// VolumeValidationItem - check the folders of a single volume
+// runs on a worker thread, only does file system calls
+// ----------------------------------------------------------------------------
+
+class VolumeValidationItem : public WorkItem
+{
+public:
+    wxString m_volname;
+    wxString m_enc_path;
+    wxString m_mount_path;
+    bool m_mounted;
+    bool m_healthy;
+    wxString m_healthinfo;
+
+    virtual void Run() wxOVERRIDE;
+};
+
+
+void VolumeValidationItem::Run()
+{
+    m_healthy = checkVolumeFolders(m_enc_path, m_mount_path, m_mounted, m_healthinfo);
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// check if the encrypted folder & mount point of a volume are usable
+// only does file system calls, safe to run on a worker thread
+bool checkVolumeFolders(const wxString& enc_path, const wxString& mount_path, bool mounted, wxString& info)
+{
+    wxString configfilepath;
+    configfilepath.Printf(wxT("%s/.encfs6.xml"), enc_path);
+    // volumes created by encfs 1.x have a .encfs5 file instead
+    wxString legacyconfigfilepath;
+    legacyconfigfilepath.Printf(wxT("%s/.encfs5"), enc_path);
+    struct stat st;
+
+    if (!isDirectory(enc_path))
+    {
+        info = "Encrypted folder not found";
+        return false;
+    }
+    if (stat(configfilepath.fn_str(), &st) != 0 && stat(legacyconfigfilepath.fn_str(), &st) != 0)
+    {
+        info = ".encfs6.xml not found";
+        return false;
+    }
+    if (!isDirectory(mount_path))
+    {
+        info = "Mount point not found";
+        return false;
+    }
+    if (!mounted && !isDirectoryEmpty(mount_path))
+    {
+        info = "Mount point not empty";
+        return false;
+    }
+    info = "OK";
+    return true;
+}
+
+
+// check all volumes on the worker pool, done gets the results on the main thread
+// a volume whose folders don't answer within the timeout counts as unhealthy
+void validateVolumes(const std::map<wxString, DBEntry*>& volumedata, VolumeHealthFunc done)
+{
+    std::vector<WorkItem*> items;
+    // mount path -> volume name, to find volumes sharing a mount point
+    std::map<wxString, wxString> mountpaths;
+    std::map<wxString, wxString> collisions;
+
+    for (std::map<wxString, DBEntry*>::const_iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        const DBEntry * thisvol = it->second;
+        VolumeValidationItem * item = new VolumeValidationItem();
+        item->m_volname = it->first;
+        item->m_enc_path = thisvol->getEncPath();
+        item->m_mount_path = thisvol->getMountPath();
+        // listing the mount point of a lazy volume would mount it
+        item->m_mounted = thisvol->getMountState() || thisvol->getLazyMount();
+        item->m_healthy = false;
+        items.push_back(item);
+
+        wxString mountpath = item->m_mount_path;
+        while (mountpath.Length() > 1 && mountpath.EndsWith("/"))
+        {
+            mountpath.RemoveLast();
+        }
+        if (mountpaths.find(mountpath) != mountpaths.end())
+        {
+            collisions[it->first] = mountpaths[mountpath];
+            collisions[mountpaths[mountpath]] = it->first;
+        }
+        else
+        {
+            mountpaths[mountpath] = it->first;
+        }
+    }
+
+    // the names & paths, in case an item doesn't come back
+    std::vector<VolumeHealthResult> results;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        VolumeValidationItem * item = (VolumeValidationItem *)items[i];
+        VolumeHealthResult result;
+        result.m_volname = item->m_volname;
+        result.m_enc_path = item->m_enc_path;
+        result.m_mount_path = item->m_mount_path;
+        result.m_healthy = false;
+        results.push_back(result);
+    }
+
+    RunWorkItemsWithTimeout(items, VALIDATION_TIMEOUT_MS,
+        [results, collisions, done](std::vector<WorkItem*>& doneitems, const std::vector<int>& status) mutable
+        {
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                VolumeHealthResult& result = results[i];
+                if (status[i] == WORKITEM_TIMEOUT)
+                {
+                    result.m_healthinfo = "Timeout, folder not reachable";
+                    continue;
+                }
+                if (status[i] == WORKITEM_NOT_RUN)
+                {
+                    result.m_healthinfo = "Unknown, other folders are not responding";
+                    continue;
+                }
+                VolumeValidationItem * item = (VolumeValidationItem *)doneitems[i];
+                std::map<wxString, wxString>::const_iterator collision = collisions.find(result.m_volname);
+                if (item->m_healthy && collision != collisions.end())
+                {
+                    result.m_healthinfo.Printf(wxT("Mount point also used by '%s'"), collision->second);
+                }
+                else
+                {
+                    result.m_healthy = item->m_healthy;
+                    result.m_healthinfo = item->m_healthinfo;
+                }
+            }
+            done(results);
+        });
+}
@@ -0,0 +1,374 @@
+/*
+    encFSGui - encfsgui_volinfo.cpp
+    source file contains code to read the .encfs6.xml
+    config file of encfs volumes, and to cache the results
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/xml/xml.h>
+#include <wx/thread.h>
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// cache
+// ----------------------------------------------------------------------------
+
+// a cache entry stays valid as long as the .encfs6.xml file
+// has the same inode, size and modification time
+class VolumeConfigCacheEntry
+{
+public:
+    ino_t m_inode;
+    off_t m_size;
+    time_t m_mtime;
+    EncFSVolumeConfig m_config;
+};
+
+// a config file on a share that stopped responding must not hold up the startup
+static const long VOLUME_CONFIG_TIMEOUT_MS = 5000;
+
+// cache, using enc_path as key
+static std::map<wxString, VolumeConfigCacheEntry> m_VolumeConfigCache;
+static wxCriticalSection m_VolumeConfigCacheLock;
+
+
+// work item to load the config of one volume on a worker thread
+class VolumeConfigItem : public WorkItem
+{
+public:
+    wxString m_enc_path;
+
+    virtual void Run() wxOVERRIDE
+    {
+        EncFSVolumeConfig cfg;
+        getEncFSVolumeConfig(m_enc_path, cfg);
+    }
+};
+
+
+// ----------------------------------------------------------------------------
+// EncFSVolumeConfig
+// ----------------------------------------------------------------------------
+
+EncFSVolumeConfig::EncFSVolumeConfig()
+{
+    m_valid = false;
+    m_version = 0;
+    m_cipheralgmajor = 0;
+    m_keysize = 0;
+    m_blocksize = 0;
+    m_uniqueiv = false;
+    m_chainednameiv = false;
+    m_externalivchaining = false;
+    m_blockmacbytes = 0;
+    m_blockmacrandbytes = 0;
+    m_allowholes = false;
+    m_saltlen = 0;
+    m_kdfiterations = 0;
+    m_desiredkdfduration = 0;
+}
+
+
+// "ssl/aes" + 256 -> "AES-256"
+wxString EncFSVolumeConfig::getCipherDisplayName()
+{
+    if (!m_valid)
+    {
+        return "?";
+    }
+    wxString cipher = m_cipheralg.AfterLast('/');
+    if (cipher == "aes")
+    {
+        cipher = "AES";
+    }
+    else if (cipher == "blowfish")
+    {
+        cipher = "Blowfish";
+    }
+    wxString returnval;
+    returnval.Printf(wxT("%s-%ld"), cipher, m_keysize);
+    return returnval;
+}
+
+
+// "nameio/block" -> "Block"
+wxString EncFSVolumeConfig::getNameEncodingDisplayName()
+{
+    wxString nameenc = m_namealg.AfterLast('/');
+    if (nameenc.IsEmpty())
+    {
+        return "?";
+    }
+    return nameenc.Left(1).Upper() + nameenc.Mid(1);
+}
+
+
+// same information as encfsctl shows, in a readable format
+wxString EncFSVolumeConfig::getDescription()
+{
+    wxString desc;
+    if (!m_valid)
+    {
+        desc.Printf(wxT("Unable to read the .encfs6.xml config file"));
+        return desc;
+    }
+    wxString line;
+    line.Printf(wxT("Version 6 configuration; created by %s (revision %ld)\n"), m_creator, m_version);
+    desc << line;
+    line.Printf(wxT("Filesystem cipher: \"%s\", version %ld\n"), m_cipheralg, m_cipheralgmajor);
+    desc << line;
+    line.Printf(wxT("Filename encoding: \"%s\"\n"), m_namealg);
+    desc << line;
+    line.Printf(wxT("Key Size: %ld bits\n"), m_keysize);
+    desc << line;
+    line.Printf(wxT("Block Size: %ld bytes"), m_blocksize);
+    desc << line;
+    if (m_blockmacbytes > 0 || m_blockmacrandbytes > 0)
+    {
+        line.Printf(wxT(", including %ld byte MAC header"), m_blockmacbytes + m_blockmacrandbytes);
+        desc << line;
+    }
+    desc << "\n";
+    if (m_uniqueiv)
+    {
+        desc << "Each file contains 8 byte header with unique IV data.\n";
+    }
+    if (m_chainednameiv)
+    {
+        desc << "Filenames encoded using IV chaining mode.\n";
+    }
+    if (m_externalivchaining)
+    {
+        desc << "File data IV is chained to filename IV.\n";
+    }
+    if (m_allowholes)
+    {
+        desc << "File holes passed through to ciphertext.\n";
+    }
+    line.Printf(wxT("Key derivation: PBKDF2, %ld iterations, %ld byte salt"), m_kdfiterations, m_saltlen);
+    desc << line;
+    return desc;
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+static long getXmlNodeLong(wxXmlNode * node)
+{
+    long value = 0;
+    node->GetNodeContent().ToLong(&value);
+    return value;
+}
+
+// <cipherAlg><name>ssl/aes</name><major>3</major>...</cipherAlg>
+static void getXmlInterface(wxXmlNode * node, wxString& name, long& major)
+{
+    wxXmlNode * child = node->GetChildren();
+    while (child)
+    {
+        if (child->GetName() == "name")
+        {
+            name = child->GetNodeContent();
+        }
+        else if (child->GetName() == "major")
+        {
+            major = getXmlNodeLong(child);
+        }
+        child = child->GetNext();
+    }
+}
+
+
+// parse a .encfs6.xml file
+static bool parseEncFSConfigFile(const wxString& configfilepath, EncFSVolumeConfig& cfg)
+{
+    wxXmlDocument doc;
+    if (!doc.Load(configfilepath) || !doc.GetRoot())
+    {
+        return false;
+    }
+
+    // <boost_serialization><cfg>...</cfg></boost_serialization>
+    wxXmlNode * cfgnode = doc.GetRoot()->GetChildren();
+    while (cfgnode && cfgnode->GetName() != "cfg")
+    {
+        cfgnode = cfgnode->GetNext();
+    }
+    if (!cfgnode)
+    {
+        return false;
+    }
+
+    long dummy = 0;
+    wxXmlNode * child = cfgnode->GetChildren();
+    while (child)
+    {
+        wxString name = child->GetName();
+        if (name == "version")
+        {
+            cfg.m_version = getXmlNodeLong(child);
+        }
+        else if (name == "creator")
+        {
+            cfg.m_creator = child->GetNodeContent();
+        }
+        else if (name == "cipherAlg")
+        {
+            getXmlInterface(child, cfg.m_cipheralg, cfg.m_cipheralgmajor);
+        }
+        else if (name == "nameAlg")
+        {
+            getXmlInterface(child, cfg.m_namealg, dummy);
+        }
+        else if (name == "keySize")
+        {
+            cfg.m_keysize = getXmlNodeLong(child);
+        }
+        else if (name == "blockSize")
+        {
+            cfg.m_blocksize = getXmlNodeLong(child);
+        }
+        else if (name == "uniqueIV")
+        {
+            cfg.m_uniqueiv = (getXmlNodeLong(child) != 0);
+        }
+        else if (name == "chainedNameIV")
+        {
+            cfg.m_chainednameiv = (getXmlNodeLong(child) != 0);
+        }
+        else if (name == "externalIVChaining")
+        {
+            cfg.m_externalivchaining = (getXmlNodeLong(child) != 0);
+        }
+        else if (name == "blockMACBytes")
+        {
+            cfg.m_blockmacbytes = getXmlNodeLong(child);
+        }
+        else if (name == "blockMACRandBytes")
+        {
+            cfg.m_blockmacrandbytes = getXmlNodeLong(child);
+        }
+        else if (name == "allowHoles")
+        {
+            cfg.m_allowholes = (getXmlNodeLong(child) != 0);
+        }
+        else if (name == "saltLen")
+        {
+            cfg.m_saltlen = getXmlNodeLong(child);
+        }
+        else if (name == "kdfIterations")
+        {
+            cfg.m_kdfiterations = getXmlNodeLong(child);
+        }
+        else if (name == "desiredKDFDuration")
+        {
+            cfg.m_desiredkdfduration = getXmlNodeLong(child);
+        }
+        child = child->GetNext();
+    }
+
+    cfg.m_valid = (!cfg.m_cipheralg.IsEmpty() && cfg.m_keysize > 0 && cfg.m_kdfiterations > 0);
+    return cfg.m_valid;
+}
+
+
+// get the config of a volume, from cache if .encfs6.xml did not change
+// safe to call from worker threads
+bool getEncFSVolumeConfig(const wxString& enc_path, EncFSVolumeConfig& cfg)
+{
+    wxString configfilepath;
+    configfilepath.Printf(wxT("%s/.encfs6.xml"), enc_path);
+
+    struct stat st;
+    if (stat(configfilepath.fn_str(), &st) != 0)
+    {
+        wxCriticalSectionLocker lock(m_VolumeConfigCacheLock);
+        m_VolumeConfigCache.erase(enc_path);
+        cfg = EncFSVolumeConfig();
+        return false;
+    }
+
+    {
+        wxCriticalSectionLocker lock(m_VolumeConfigCacheLock);
+        std::map<wxString, VolumeConfigCacheEntry>::iterator it = m_VolumeConfigCache.find(enc_path);
+        if (it != m_VolumeConfigCache.end() &&
+            it->second.m_inode == st.st_ino &&
+            it->second.m_size == st.st_size &&
+            it->second.m_mtime == st.st_mtime)
+        {
+            cfg = it->second.m_config;
+            return cfg.m_valid;
+        }
+    }
+
+    // parse outside of the lock, so other volumes can be loaded at the same time
+    VolumeConfigCacheEntry entry;
+    entry.m_inode = st.st_ino;
+    entry.m_size = st.st_size;
+    entry.m_mtime = st.st_mtime;
+    parseEncFSConfigFile(configfilepath, entry.m_config);
+
+    {
+        wxCriticalSectionLocker lock(m_VolumeConfigCacheLock);
+        m_VolumeConfigCache[enc_path] = entry;
+    }
+    cfg = entry.m_config;
+    return cfg.m_valid;
+}
+
+
+// get the config of a volume from cache only, without touching the file system
+// returns false if the volume config has not been loaded yet
+bool getCachedEncFSVolumeConfig(const wxString& enc_path, EncFSVolumeConfig& cfg)
+{
+    wxCriticalSectionLocker lock(m_VolumeConfigCacheLock);
+    std::map<wxString, VolumeConfigCacheEntry>::iterator it = m_VolumeConfigCache.find(enc_path);
+    if (it == m_VolumeConfigCache.end())
+    {
+        cfg = EncFSVolumeConfig();
+        return false;
+    }
+    cfg = it->second.m_config;
+    return cfg.m_valid;
+}
+
+
+// make sure the cache is up to date for all given volumes
+// stale or missing entries get parsed on the worker pool, done runs on the main thread
+// configs that could not be read in time just stay out of the cache
+void loadEncFSVolumeConfigs(const std::vector<wxString>& enc_paths, std::function<void()> done)
+{
+    std::vector<WorkItem*> items;
+    for (size_t i = 0; i < enc_paths.size(); i++)
+    {
+        VolumeConfigItem * item = new VolumeConfigItem();
+        item->m_enc_path = enc_paths.at(i);
+        items.push_back(item);
+    }
+
+    RunWorkItemsWithTimeout(items, VOLUME_CONFIG_TIMEOUT_MS,
+        [done](std::vector<WorkItem*>& WXUNUSED(doneitems), const std::vector<int>& WXUNUSED(status))
+        {
+            if (done)
+            {
+                done();
+            }
+        });
+}
@@ -0,0 +1,763 @@
+/*
+    encFSGui - encfsgui_volumedb.cpp
+    source file contains code to store the volume definitions,
+    either in an SQLite database or in the wxConfig file
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+#include <vector>
+#include <map>
+
+#ifdef ENCFSGUI_USE_SQLITE
+    #include <sqlite3.h>
+#endif
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// VolumeStore - backend interface
+// all functions must be called on the main thread
+// ----------------------------------------------------------------------------
+
+class VolumeStore
+{
+public:
+    virtual ~VolumeStore() {}
+    virtual wxString GetName() = 0;
+    virtual bool LoadAll(std::vector<VolumeRecord>&) = 0;
+    virtual bool Get(const wxString&, VolumeRecord&) = 0;
+    virtual bool Exists(const wxString&) = 0;
+    virtual wxString FindByMountPath(const wxString&) = 0;
+    // insert or replace
+    virtual bool Save(const VolumeRecord&) = 0;
+    virtual bool Rename(const wxString&, const wxString&) = 0;
+    virtual bool Remove(const wxString&) = 0;
+    // batches can be nested, only the outer one commits
+    virtual bool BeginBatch() = 0;
+    virtual bool CommitBatch() = 0;
+    virtual void RollbackBatch() = 0;
+};
+
+
+// ----------------------------------------------------------------------------
+// ConfigVolumeStore - one wxConfig group per volume (/Volumes/<name>)
+// ----------------------------------------------------------------------------
+
+class ConfigVolumeStore : public VolumeStore
+{
+public:
+    // NULL = the global config object
+    ConfigVolumeStore(wxConfigBase * pConfig = NULL)
+    {
+        m_config = pConfig;
+        m_batchdepth = 0;
+    }
+
+    virtual wxString GetName() wxOVERRIDE
+    {
+        return "config file";
+    }
+
+    virtual bool LoadAll(std::vector<VolumeRecord>& records) wxOVERRIDE
+    {
+        wxConfigBase *pConfig = GetConfig();
+        std::vector<wxString> names;
+        pConfig->SetPath(wxT("/Volumes"));
+        wxString volumename;
+        long dummy;
+        bool bCont = pConfig->GetFirstGroup(volumename, dummy);
+        while ( bCont )
+        {
+            names.push_back(volumename);
+            bCont = pConfig->GetNextGroup(volumename, dummy);
+        }
+        records.clear();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            VolumeRecord record;
+            if (Get(names.at(i), record))
+            {
+                records.push_back(record);
+            }
+        }
+        return true;
+    }
+
+    virtual bool Get(const wxString& volname, VolumeRecord& record) wxOVERRIDE
+    {
+        if (!Exists(volname))
+        {
+            return false;
+        }
+        wxConfigBase *pConfig = GetConfig();
+        pConfig->SetPath(GetGroup(volname));
+        record.m_volname = volname;
+        record.m_enc_path = pConfig->Read(wxT("enc_path"), "");
+        record.m_mount_path = pConfig->Read(wxT("mount_path"), "");
+        record.m_automount = pConfig->ReadBool(wxT("automount"), false);
+        record.m_preventautounmount = pConfig->ReadBool(wxT("preventautounmount"), false);
+        record.m_pwsaved = pConfig->ReadBool(wxT("passwordsaved"), false);
+        record.m_allowother = pConfig->ReadBool(wxT("allowother"), false);
+        record.m_mountaslocal = pConfig->ReadBool(wxT("mountaslocal"), false);
+        record.m_idletimeout = pConfig->ReadLong(wxT("idletimeout"), 0l);
+        record.m_lazymount = pConfig->ReadBool(wxT("lazymount"), false);
+        return true;
+    }
+
+    virtual bool Exists(const wxString& volname) wxOVERRIDE
+    {
+        return GetConfig()->HasGroup(GetGroup(volname));
+    }
+
+    // no index in the config file, walk all volumes
+    virtual wxString FindByMountPath(const wxString& mount_path) wxOVERRIDE
+    {
+        std::vector<VolumeRecord> records;
+        LoadAll(records);
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            if (records.at(i).m_mount_path == mount_path)
+            {
+                return records.at(i).m_volname;
+            }
+        }
+        return wxEmptyString;
+    }
+
+    virtual bool Save(const VolumeRecord& record) wxOVERRIDE
+    {
+        wxConfigBase *pConfig = GetConfig();
+        pConfig->SetPath(GetGroup(record.m_volname));
+        pConfig->Write(wxT("enc_path"), record.m_enc_path);
+        pConfig->Write(wxT("mount_path"), record.m_mount_path);
+        pConfig->Write(wxT("automount"), record.m_automount);
+        pConfig->Write(wxT("preventautounmount"), record.m_preventautounmount);
+        pConfig->Write(wxT("passwordsaved"), record.m_pwsaved);
+        pConfig->Write(wxT("allowother"), record.m_allowother);
+        pConfig->Write(wxT("mountaslocal"), record.m_mountaslocal);
+        pConfig->Write(wxT("idletimeout"), record.m_idletimeout);
+        pConfig->Write(wxT("lazymount"), record.m_lazymount);
+        return FlushIfNeeded();
+    }
+
+    virtual bool Rename(const wxString& oldname, const wxString& newname) wxOVERRIDE
+    {
+        wxConfigBase *pConfig = GetConfig();
+        pConfig->SetPath(wxT("/Volumes"));
+        if (!pConfig->RenameGroup(oldname, newname))
+        {
+            return false;
+        }
+        return FlushIfNeeded();
+    }
+
+    virtual bool Remove(const wxString& volname) wxOVERRIDE
+    {
+        if (!GetConfig()->DeleteGroup(GetGroup(volname)))
+        {
+            return false;
+        }
+        return FlushIfNeeded();
+    }
+
+    // the config file can't roll back, a batch only saves on flushes
+    virtual bool BeginBatch() wxOVERRIDE
+    {
+        ++m_batchdepth;
+        return true;
+    }
+
+    virtual bool CommitBatch() wxOVERRIDE
+    {
+        if (m_batchdepth > 0)
+        {
+            --m_batchdepth;
+        }
+        return FlushIfNeeded();
+    }
+
+    virtual void RollbackBatch() wxOVERRIDE
+    {
+        CommitBatch();
+    }
+
+private:
+    wxConfigBase * GetConfig()
+    {
+        return m_config ? m_config : wxConfigBase::Get();
+    }
+
+    wxString GetGroup(const wxString& volname)
+    {
+        wxString group;
+        group.Printf(wxT("/Volumes/%s"), volname);
+        return group;
+    }
+
+    bool FlushIfNeeded()
+    {
+        if (m_batchdepth > 0)
+        {
+            return true;
+        }
+        if (m_config)
+        {
+            return m_config->Flush();
+        }
+        // don't overwrite changes made by someone else
+        return flushConfig();
+    }
+
+    wxConfigBase * m_config;
+    int m_batchdepth;
+};
+
+
+#ifdef ENCFSGUI_USE_SQLITE
+
+// ----------------------------------------------------------------------------
+// SQLiteVolumeStore - volumes table, indexed on name and mount_path
+// ----------------------------------------------------------------------------
+
+// bump when the schema changes, 0 = empty database
+// 2 = idletimeout column
+// 3 = lazymount column
+static const int VOLUMEDB_SCHEMA_VERSION = 3;
+
+class SQLiteVolumeStore : public VolumeStore
+{
+public:
+    SQLiteVolumeStore()
+    {
+        m_db = NULL;
+        m_batchdepth = 0;
+        m_batchfailed = false;
+    }
+
+    virtual ~SQLiteVolumeStore()
+    {
+        for (std::map<const char*, sqlite3_stmt*>::iterator it = m_statements.begin(); it != m_statements.end(); it++)
+        {
+            sqlite3_finalize(it->second);
+        }
+        if (m_db)
+        {
+            sqlite3_close(m_db);
+        }
+    }
+
+    bool Open(const wxString& dbpath);
+
+    virtual wxString GetName() wxOVERRIDE
+    {
+        return "SQLite";
+    }
+
+    virtual bool LoadAll(std::vector<VolumeRecord>& records) wxOVERRIDE
+    {
+        // same order as the config file, which sorts groups case insensitive
+        sqlite3_stmt * stmt = Prepare("SELECT name, enc_path, mount_path, automount, preventautounmount, "
+                                      "passwordsaved, allowother, mountaslocal, idletimeout, lazymount FROM volumes ORDER BY name COLLATE NOCASE");
+        if (!stmt)
+        {
+            return false;
+        }
+        records.clear();
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            VolumeRecord record;
+            ReadRecord(stmt, record);
+            records.push_back(record);
+        }
+        sqlite3_reset(stmt);
+        return (rc == SQLITE_DONE);
+    }
+
+    virtual bool Get(const wxString& volname, VolumeRecord& record) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("SELECT name, enc_path, mount_path, automount, preventautounmount, "
+                                      "passwordsaved, allowother, mountaslocal, idletimeout, lazymount FROM volumes WHERE name = ?");
+        if (!stmt)
+        {
+            return false;
+        }
+        BindText(stmt, 1, volname);
+        bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+        if (found)
+        {
+            ReadRecord(stmt, record);
+        }
+        sqlite3_reset(stmt);
+        return found;
+    }
+
+    virtual bool Exists(const wxString& volname) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("SELECT 1 FROM volumes WHERE name = ?");
+        if (!stmt)
+        {
+            return false;
+        }
+        BindText(stmt, 1, volname);
+        bool found = (sqlite3_step(stmt) == SQLITE_ROW);
+        sqlite3_reset(stmt);
+        return found;
+    }
+
+    virtual wxString FindByMountPath(const wxString& mount_path) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("SELECT name FROM volumes WHERE mount_path = ? LIMIT 1");
+        if (!stmt)
+        {
+            return wxEmptyString;
+        }
+        BindText(stmt, 1, mount_path);
+        wxString volname;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            volname = GetText(stmt, 0);
+        }
+        sqlite3_reset(stmt);
+        return volname;
+    }
+
+    virtual bool Save(const VolumeRecord& record) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("INSERT OR REPLACE INTO volumes (name, enc_path, mount_path, automount, "
+                                      "preventautounmount, passwordsaved, allowother, mountaslocal, idletimeout, lazymount) "
+                                      "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        if (!stmt)
+        {
+            return WriteDone(false);
+        }
+        BindText(stmt, 1, record.m_volname);
+        BindText(stmt, 2, record.m_enc_path);
+        BindText(stmt, 3, record.m_mount_path);
+        sqlite3_bind_int(stmt, 4, record.m_automount ? 1 : 0);
+        sqlite3_bind_int(stmt, 5, record.m_preventautounmount ? 1 : 0);
+        sqlite3_bind_int(stmt, 6, record.m_pwsaved ? 1 : 0);
+        sqlite3_bind_int(stmt, 7, record.m_allowother ? 1 : 0);
+        sqlite3_bind_int(stmt, 8, record.m_mountaslocal ? 1 : 0);
+        sqlite3_bind_int64(stmt, 9, record.m_idletimeout);
+        sqlite3_bind_int(stmt, 10, record.m_lazymount ? 1 : 0);
+        return WriteDone(Step(stmt));
+    }
+
+    virtual bool Rename(const wxString& oldname, const wxString& newname) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("UPDATE volumes SET name = ? WHERE name = ?");
+        if (!stmt)
+        {
+            return WriteDone(false);
+        }
+        BindText(stmt, 1, newname);
+        BindText(stmt, 2, oldname);
+        return WriteDone(Step(stmt) && sqlite3_changes(m_db) == 1);
+    }
+
+    virtual bool Remove(const wxString& volname) wxOVERRIDE
+    {
+        sqlite3_stmt * stmt = Prepare("DELETE FROM volumes WHERE name = ?");
+        if (!stmt)
+        {
+            return WriteDone(false);
+        }
+        BindText(stmt, 1, volname);
+        return WriteDone(Step(stmt));
+    }
+
+    virtual bool BeginBatch() wxOVERRIDE
+    {
+        if (m_batchdepth == 0)
+        {
+            if (!Exec("BEGIN IMMEDIATE"))
+            {
+                return false;
+            }
+            m_batchfailed = false;
+        }
+        ++m_batchdepth;
+        return true;
+    }
+
+    // a failed write anywhere in the batch rolls back all of it
+    virtual bool CommitBatch() wxOVERRIDE
+    {
+        if (m_batchdepth == 0)
+        {
+            return false;
+        }
+        if (--m_batchdepth > 0)
+        {
+            return !m_batchfailed;
+        }
+        bool committed = (!m_batchfailed && Exec("COMMIT"));
+        if (!committed)
+        {
+            Exec("ROLLBACK");
+        }
+        m_batchfailed = false;
+        return committed;
+    }
+
+    virtual void RollbackBatch() wxOVERRIDE
+    {
+        m_batchfailed = true;
+        CommitBatch();
+    }
+
+private:
+    bool Exec(const char * sql)
+    {
+        return (sqlite3_exec(m_db, sql, NULL, NULL, NULL) == SQLITE_OK);
+    }
+
+    // statements are prepared once and reused, sql must be a string literal
+    sqlite3_stmt * Prepare(const char * sql)
+    {
+        std::map<const char*, sqlite3_stmt*>::iterator it = m_statements.find(sql);
+        if (it != m_statements.end())
+        {
+            sqlite3_clear_bindings(it->second);
+            return it->second;
+        }
+        sqlite3_stmt * stmt = NULL;
+        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        {
+            return NULL;
+        }
+        m_statements[sql] = stmt;
+        return stmt;
+    }
+
+    bool Step(sqlite3_stmt * stmt)
+    {
+        bool done = (sqlite3_step(stmt) == SQLITE_DONE);
+        sqlite3_reset(stmt);
+        return done;
+    }
+
+    bool WriteDone(bool ok)
+    {
+        if (!ok && m_batchdepth > 0)
+        {
+            m_batchfailed = true;
+        }
+        return ok;
+    }
+
+    void BindText(sqlite3_stmt * stmt, int index, const wxString& value)
+    {
+        sqlite3_bind_text(stmt, index, value.utf8_str(), -1, SQLITE_TRANSIENT);
+    }
+
+    wxString GetText(sqlite3_stmt * stmt, int column)
+    {
+        const unsigned char * text = sqlite3_column_text(stmt, column);
+        if (!text)
+        {
+            return wxEmptyString;
+        }
+        return wxString::FromUTF8((const char *)text);
+    }
+
+    void ReadRecord(sqlite3_stmt * stmt, VolumeRecord& record)
+    {
+        record.m_volname = GetText(stmt, 0);
+        record.m_enc_path = GetText(stmt, 1);
+        record.m_mount_path = GetText(stmt, 2);
+        record.m_automount = (sqlite3_column_int(stmt, 3) != 0);
+        record.m_preventautounmount = (sqlite3_column_int(stmt, 4) != 0);
+        record.m_pwsaved = (sqlite3_column_int(stmt, 5) != 0);
+        record.m_allowother = (sqlite3_column_int(stmt, 6) != 0);
+        record.m_mountaslocal = (sqlite3_column_int(stmt, 7) != 0);
+        record.m_idletimeout = (long)sqlite3_column_int64(stmt, 8);
+        record.m_lazymount = (sqlite3_column_int(stmt, 9) != 0);
+    }
+
+    int GetSchemaVersion()
+    {
+        int version = -1;
+        sqlite3_stmt * stmt = NULL;
+        if (sqlite3_prepare_v2(m_db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                version = sqlite3_column_int(stmt, 0);
+            }
+            sqlite3_finalize(stmt);
+        }
+        return version;
+    }
+
+    bool Migrate();
+    bool Upgrade(int);
+
+    sqlite3 * m_db;
+    int m_batchdepth;
+    bool m_batchfailed;
+    std::map<const char*, sqlite3_stmt*> m_statements;
+};
+
+
+bool SQLiteVolumeStore::Open(const wxString& dbpath)
+{
+    if (sqlite3_open_v2(dbpath.utf8_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK)
+    {
+        return false;
+    }
+    sqlite3_busy_timeout(m_db, 2000);
+    // WAL: a crash never leaves a half written database behind,
+    // and NORMAL sync is safe in WAL mode
+    Exec("PRAGMA journal_mode=WAL");
+    Exec("PRAGMA synchronous=NORMAL");
+
+    int version = GetSchemaVersion();
+    if (version < 0 || version > VOLUMEDB_SCHEMA_VERSION)
+    {
+        // unreadable, or written by a newer version of the app
+        return false;
+    }
+    if (version == 0)
+    {
+        return Migrate();
+    }
+    if (version < VOLUMEDB_SCHEMA_VERSION)
+    {
+        return Upgrade(version);
+    }
+    return true;
+}
+
+
+// create the schema and copy the volumes from the config file, all or nothing
+// the config file is left alone, an older version of the app can still use it
+bool SQLiteVolumeStore::Migrate()
+{
+    if (!BeginBatch())
+    {
+        return false;
+    }
+    bool ok = Exec("CREATE TABLE IF NOT EXISTS volumes ("
+                   "name TEXT PRIMARY KEY NOT NULL, "
+                   "enc_path TEXT NOT NULL, "
+                   "mount_path TEXT NOT NULL, "
+                   "automount INTEGER NOT NULL DEFAULT 0, "
+                   "preventautounmount INTEGER NOT NULL DEFAULT 0, "
+                   "passwordsaved INTEGER NOT NULL DEFAULT 0, "
+                   "allowother INTEGER NOT NULL DEFAULT 0, "
+                   "mountaslocal INTEGER NOT NULL DEFAULT 0, "
+                   "idletimeout INTEGER NOT NULL DEFAULT 0, "
+                   "lazymount INTEGER NOT NULL DEFAULT 0)");
+    ok = ok && Exec("CREATE INDEX IF NOT EXISTS volumes_mount_path ON volumes (mount_path)");
+
+    if (ok)
+    {
+        ConfigVolumeStore configstore;
+        std::vector<VolumeRecord> records;
+        configstore.LoadAll(records);
+        for (size_t i = 0; i < records.size() && ok; i++)
+        {
+            ok = Save(records.at(i));
+        }
+    }
+
+    if (ok)
+    {
+        wxString pragma;
+        pragma.Printf(wxT("PRAGMA user_version=%d"), VOLUMEDB_SCHEMA_VERSION);
+        ok = Exec(pragma.utf8_str());
+    }
+
+    if (!ok)
+    {
+        RollbackBatch();
+        return false;
+    }
+    return CommitBatch();
+}
+
+
+// bring a database written by an older version of the app up to date
+bool SQLiteVolumeStore::Upgrade(int version)
+{
+    if (!BeginBatch())
+    {
+        return false;
+    }
+    bool ok = true;
+    if (version < 2)
+    {
+        ok = Exec("ALTER TABLE volumes ADD COLUMN idletimeout INTEGER NOT NULL DEFAULT 0");
+    }
+    if (ok && version < 3)
+    {
+        ok = Exec("ALTER TABLE volumes ADD COLUMN lazymount INTEGER NOT NULL DEFAULT 0");
+    }
+    if (ok)
+    {
+        wxString pragma;
+        pragma.Printf(wxT("PRAGMA user_version=%d"), VOLUMEDB_SCHEMA_VERSION);
+        ok = Exec(pragma.utf8_str());
+    }
+    if (!ok)
+    {
+        RollbackBatch();
+        return false;
+    }
+    return CommitBatch();
+}
+
+#endif // ENCFSGUI_USE_SQLITE
+
+
+// ----------------------------------------------------------------------------
+// VolumeRecord
+// ----------------------------------------------------------------------------
+
+VolumeRecord::VolumeRecord()
+{
+    m_automount = false;
+    m_preventautounmount = false;
+    m_pwsaved = false;
+    m_allowother = false;
+    m_mountaslocal = false;
+    m_idletimeout = 0;
+    m_lazymount = false;
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+static VolumeStore * g_volumeStore = NULL;
+
+
+// pick the backend, SQLite if it was compiled in and the database can be opened
+static VolumeStore * getVolumeStore()
+{
+    if (g_volumeStore)
+    {
+        return g_volumeStore;
+    }
+#ifdef ENCFSGUI_USE_SQLITE
+    SQLiteVolumeStore * sqlitestore = new SQLiteVolumeStore();
+    if (sqlitestore->Open(getDataFilePath("volumes.db")))
+    {
+        g_volumeStore = sqlitestore;
+        return g_volumeStore;
+    }
+    delete sqlitestore;
+#endif
+    g_volumeStore = new ConfigVolumeStore();
+    return g_volumeStore;
+}
+
+
+// open the volume database, migrates the config file on first use
+void openVolumeDB()
+{
+    getVolumeStore();
+}
+
+
+void closeVolumeDB()
+{
+    delete g_volumeStore;
+    g_volumeStore = NULL;
+}
+
+
+wxString getVolumeDBName()
+{
+    return getVolumeStore()->GetName();
+}
+
+
+// true if the volumes live in the wxConfig file itself
+bool isVolumeDBConfigFile()
+{
+    return (dynamic_cast<ConfigVolumeStore*>(getVolumeStore()) != NULL);
+}
+
+
+// read the volume definitions from a config object, without touching the active store
+bool readConfigVolumeRecords(wxConfigBase * pConfig, std::vector<VolumeRecord>& records)
+{
+    ConfigVolumeStore configstore(pConfig);
+    return configstore.LoadAll(records);
+}
+
+
+bool loadVolumeRecords(std::vector<VolumeRecord>& records)
+{
+    return getVolumeStore()->LoadAll(records);
+}
+
+
+bool getVolumeRecord(const wxString& volname, VolumeRecord& record)
+{
+    return getVolumeStore()->Get(volname, record);
+}
+
+
+bool saveVolumeRecord(const VolumeRecord& record)
+{
+    return getVolumeStore()->Save(record);
+}
+
+
+bool removeVolumeRecord(const wxString& volname)
+{
+    return getVolumeStore()->Remove(volname);
+}
+
+
+bool doesVolumeExist(wxString & volumename)
+{
+    return getVolumeStore()->Exists(volumename);
+}
+
+
+// returns the name of the volume that uses this mount point, or an empty string
+wxString findVolumeByMountPath(const wxString& mount_path)
+{
+    return getVolumeStore()->FindByMountPath(mount_path);
+}
+
+
+bool renameVolume(wxString& oldname, wxString& newname)
+{
+    return getVolumeStore()->Rename(oldname, newname);
+}
+
+
+// group several writes, so they get saved together or not at all
+bool beginVolumeBatch()
+{
+    return getVolumeStore()->BeginBatch();
+}
+
+
+bool commitVolumeBatch()
+{
+    return getVolumeStore()->CommitBatch();
+}
+
+
+void rollbackVolumeBatch()
+{
+    getVolumeStore()->RollbackBatch();
+}
@@ -0,0 +1,294 @@
+/*
+    encFSGui - encfsgui_volumemodel.cpp
+    source file contains the volume model, and the code to publish
+    read-only snapshots of the volume list, for use on any thread
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <vector>
+#include <map>
+#include <memory>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// current snapshot
+// ----------------------------------------------------------------------------
+
+// only accessed with std::atomic_load/std::atomic_store
+// old snapshots get freed when the last reader lets go of them
+static VolumeSnapshotPtr g_volumeSnapshot;
+// only changed on the main thread
+static long g_volumeSnapshotVersion = 0;
+
+
+// ----------------------------------------------------------------------------
+// DBEntry - one volume, definition & last known state
+// ----------------------------------------------------------------------------
+
+// DBENtry constructor
+DBEntry::DBEntry(wxString volname, 
+                 wxString enc_path, 
+                 wxString mount_path, 
+                 bool automount, 
+                 bool preventautounmount, 
+                 bool pwsaved,
+                 bool allowother,
+                 bool mountaslocal)
+{
+    m_automount = automount;
+    m_volname = volname;
+    m_enc_path = enc_path;
+    m_mount_path = mount_path;
+    m_preventautounmount = preventautounmount;
+    m_pwsaved = pwsaved;
+    m_allowother = allowother;
+    m_mountaslocal = mountaslocal;
+    m_idletimeout = 0;
+    m_lazymount = false;
+    m_healthy = true;
+    m_healthinfo = "";
+    m_mountstate = false;
+    m_mountpid = 0;
+    m_mountstarttime = 0;
+}
+
+
+// same definition & state, snapshots can keep sharing the old copy
+bool DBEntry::isSameAs(const DBEntry& other) const
+{
+    return (m_mountstate == other.m_mountstate &&
+            m_healthy == other.m_healthy &&
+            m_healthinfo == other.m_healthinfo &&
+            m_mountpid == other.m_mountpid &&
+            m_mountstarttime == other.m_mountstarttime &&
+            m_automount == other.m_automount &&
+            m_preventautounmount == other.m_preventautounmount &&
+            m_pwsaved == other.m_pwsaved &&
+            m_allowother == other.m_allowother &&
+            m_mountaslocal == other.m_mountaslocal &&
+            m_idletimeout == other.m_idletimeout &&
+            m_lazymount == other.m_lazymount &&
+            m_volname == other.m_volname &&
+            m_enc_path == other.m_enc_path &&
+            m_mount_path == other.m_mount_path);
+}
+
+
+void DBEntry::setMountState(bool newstate)
+{
+    m_mountstate = newstate;
+}
+
+bool DBEntry::getMountState() const
+{
+    return m_mountstate;
+}
+
+bool DBEntry::getPreventAutoUnmount() const
+{
+    return m_preventautounmount;
+}
+
+bool DBEntry::getPwSavedState() const
+{
+    return m_pwsaved;
+}
+
+wxString DBEntry::getEncPath() const
+{
+    return m_enc_path;
+}
+
+bool DBEntry::getAutoMount() const
+{
+    return m_automount;
+}
+
+wxString DBEntry::getMountPath() const
+{
+    return m_mount_path;
+}
+
+wxString DBEntry::getVolName() const
+{
+    return m_volname;
+}
+
+bool DBEntry::getAllowOther() const
+{
+    return m_allowother;
+}
+
+void DBEntry::setHealth(bool healthy, wxString healthinfo)
+{
+    m_healthy = healthy;
+    m_healthinfo = healthinfo;
+}
+
+// pid of the encfs process & start time, for mounts started by this app
+void DBEntry::setMountOwner(long pid, long starttime)
+{
+    m_mountpid = pid;
+    m_mountstarttime = starttime;
+}
+
+long DBEntry::getMountPID() const
+{
+    return m_mountpid;
+}
+
+long DBEntry::getMountStartTime() const
+{
+    return m_mountstarttime;
+}
+
+bool DBEntry::getMountedByApp() const
+{
+    return (m_mountstarttime > 0);
+}
+
+bool DBEntry::getHealthState() const
+{
+    return m_healthy;
+}
+
+wxString DBEntry::getHealthInfo() const
+{
+    return m_healthinfo;
+}
+
+bool DBEntry::getMountAsLocal() const
+{
+    return m_mountaslocal;
+}
+
+// minutes without activity before encfs unmounts the volume, 0 = never
+void DBEntry::setIdleTimeout(long minutes)
+{
+    m_idletimeout = minutes;
+}
+
+long DBEntry::getIdleTimeout() const
+{
+    return m_idletimeout;
+}
+
+// mount on first access, needs a saved password
+void DBEntry::setLazyMount(bool lazymount)
+{
+    m_lazymount = lazymount;
+}
+
+bool DBEntry::getLazyMount() const
+{
+    return m_lazymount;
+}
+
+
+// ----------------------------------------------------------------------------
+// VolumeSnapshot
+// ----------------------------------------------------------------------------
+
+// the snapshot shares nothing with the live model
+// entries that are the same as in the previous snapshot get shared with it, the rest is copied
+VolumeSnapshot::VolumeSnapshot(const std::vector<wxString>& volumes,
+                               const std::map<wxString, DBEntry*>& volumedata,
+                               long version,
+                               const VolumeSnapshot * previous)
+{
+    m_version = version;
+    m_nrcopied = 0;
+    for (size_t i = 0; i < volumes.size(); i++)
+    {
+        std::map<wxString, DBEntry*>::const_iterator it = volumedata.find(volumes.at(i));
+        if (it == volumedata.end() || !it->second)
+        {
+            continue;
+        }
+        m_volumes.push_back(volumes.at(i));
+        if (previous)
+        {
+            std::map<wxString, DBEntryPtr>::const_iterator previt = previous->m_volumedata.find(volumes.at(i));
+            if (previt != previous->m_volumedata.end() && previt->second->isSameAs(*(it->second)))
+            {
+                m_volumedata.insert(*previt);
+                continue;
+            }
+        }
+        m_volumedata.insert(std::make_pair(volumes.at(i), std::make_shared<const DBEntry>(*(it->second))));
+        ++m_nrcopied;
+    }
+}
+
+const std::vector<wxString>& VolumeSnapshot::getVolumeNames() const
+{
+    return m_volumes;
+}
+
+const DBEntry * VolumeSnapshot::getVolume(const wxString& volname) const
+{
+    std::map<wxString, DBEntryPtr>::const_iterator it = m_volumedata.find(volname);
+    if (it == m_volumedata.end())
+    {
+        return NULL;
+    }
+    return it->second.get();
+}
+
+// increases with each published snapshot
+long VolumeSnapshot::getVersion() const
+{
+    return m_version;
+}
+
+size_t VolumeSnapshot::getNrCopied() const
+{
+    return m_nrcopied;
+}
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// publish the current state of the volume model
+// main thread only, call after each change to the model
+// returns false if nothing changed, the current snapshot then stays in place
+bool publishVolumeSnapshot(const std::vector<wxString>& volumes, const std::map<wxString, DBEntry*>& volumedata)
+{
+    // only the main thread stores, so no need for atomic_load here
+    const VolumeSnapshot * previous = g_volumeSnapshot.get();
+    VolumeSnapshotPtr snapshot = std::make_shared<const VolumeSnapshot>(volumes, volumedata, g_volumeSnapshotVersion + 1, previous);
+    if (previous && snapshot->getNrCopied() == 0 && snapshot->getVolumeNames() == previous->getVolumeNames())
+    {
+        return false;
+    }
+    ++g_volumeSnapshotVersion;
+    std::atomic_store(&g_volumeSnapshot, snapshot);
+    return true;
+}
+
+
+// get the latest published snapshot, safe to call from any thread
+// the snapshot never changes, keep the pointer as long as needed
+// wxString caches conversions, so copy strings before calling mb_str() & co
+VolumeSnapshotPtr getVolumeSnapshot()
+{
+    VolumeSnapshotPtr snapshot = std::atomic_load(&g_volumeSnapshot);
+    if (!snapshot)
+    {
+        // nothing published yet
+        snapshot = std::make_shared<const VolumeSnapshot>(std::vector<wxString>(), std::map<wxString, DBEntry*>(), 0);
+    }
+    return snapshot;
+}
@@ -0,0 +1,380 @@
+/*
+    encFSGui - encfsgui_watch.cpp
+    source file contains code to pick up changes made
+    to the config file by other programs, while the app is running
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+#include <wx/fileconf.h>
+#include <wx/filename.h>
+#include <wx/fswatcher.h>
+#include <wx/timer.h>
+#include <vector>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "encfsgui.h"
+
+
+// main window, gets the volume changes
+extern frmMain * g_frmMain;
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+// editors & config management tools often write a file in several steps,
+// wait for things to settle down before reading it
+static const int CONFIG_RELOAD_DELAY_MS = 500;
+
+enum
+{
+    ID_TIMER_CONFIG_RELOAD = 1
+};
+
+
+// ----------------------------------------------------------------------------
+// config file state
+// ----------------------------------------------------------------------------
+
+// identifies a version of the config file on disk
+class ConfigFileStamp
+{
+public:
+    ConfigFileStamp()
+    {
+        m_exists = false;
+        m_inode = 0;
+        m_size = 0;
+        m_mtime = 0;
+        m_mtimensec = 0;
+    }
+
+    bool operator==(const ConfigFileStamp& other) const
+    {
+        return (m_exists == other.m_exists &&
+                m_inode == other.m_inode &&
+                m_size == other.m_size &&
+                m_mtime == other.m_mtime &&
+                m_mtimensec == other.m_mtimensec);
+    }
+
+    bool operator!=(const ConfigFileStamp& other) const
+    {
+        return !(*this == other);
+    }
+
+    bool m_exists;
+    ino_t m_inode;
+    off_t m_size;
+    time_t m_mtime;
+    long m_mtimensec;
+};
+
+
+// the file as we last read or wrote it
+static ConfigFileStamp g_knownConfigStamp;
+// the volumes in the file as we last read or wrote it
+static std::map<wxString, VolumeRecord> g_knownConfigVolumes;
+
+
+static wxString getConfigFilePath()
+{
+    return wxFileConfig::GetLocalFileName(wxTheApp->GetAppName(), wxCONFIG_USE_LOCAL_FILE);
+}
+
+
+static ConfigFileStamp getConfigFileStamp()
+{
+    ConfigFileStamp stamp;
+    struct stat st;
+    if (stat(getConfigFilePath().fn_str(), &st) == 0)
+    {
+        stamp.m_exists = true;
+        stamp.m_inode = st.st_ino;
+        stamp.m_size = st.st_size;
+#ifdef __WXOSX__
+        stamp.m_mtime = st.st_mtimespec.tv_sec;
+        stamp.m_mtimensec = st.st_mtimespec.tv_nsec;
+#else
+        stamp.m_mtime = st.st_mtim.tv_sec;
+        stamp.m_mtimensec = st.st_mtim.tv_nsec;
+#endif
+    }
+    return stamp;
+}
+
+
+static std::map<wxString, VolumeRecord> getConfigVolumes(wxConfigBase * pConfig)
+{
+    std::map<wxString, VolumeRecord> volumes;
+    std::vector<VolumeRecord> records;
+    readConfigVolumeRecords(pConfig, records);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        volumes[records.at(i).m_volname] = records.at(i);
+    }
+    return volumes;
+}
+
+
+static bool isSameVolumeRecord(const VolumeRecord& a, const VolumeRecord& b)
+{
+    return (a.m_enc_path == b.m_enc_path &&
+            a.m_mount_path == b.m_mount_path &&
+            a.m_automount == b.m_automount &&
+            a.m_preventautounmount == b.m_preventautounmount &&
+            a.m_pwsaved == b.m_pwsaved &&
+            a.m_allowother == b.m_allowother &&
+            a.m_mountaslocal == b.m_mountaslocal &&
+            a.m_idletimeout == b.m_idletimeout &&
+            a.m_lazymount == b.m_lazymount);
+}
+
+
+static VolumeChangeSet diffVolumes(std::map<wxString, VolumeRecord>& oldvolumes, std::map<wxString, VolumeRecord>& newvolumes)
+{
+    VolumeChangeSet changes;
+    for (std::map<wxString, VolumeRecord>::iterator it = newvolumes.begin(); it != newvolumes.end(); it++)
+    {
+        std::map<wxString, VolumeRecord>::iterator oldit = oldvolumes.find(it->first);
+        if (oldit == oldvolumes.end())
+        {
+            changes.m_added.push_back(it->second);
+        }
+        else if (!isSameVolumeRecord(oldit->second, it->second))
+        {
+            changes.m_modified.push_back(it->second);
+        }
+    }
+    for (std::map<wxString, VolumeRecord>::iterator it = oldvolumes.begin(); it != oldvolumes.end(); it++)
+    {
+        if (newvolumes.find(it->first) == newvolumes.end())
+        {
+            changes.m_removed.push_back(it->first);
+        }
+    }
+    return changes;
+}
+
+
+// remember the current file, so our own writes don't look like external changes
+static void rememberConfigFile()
+{
+    g_knownConfigStamp = getConfigFileStamp();
+    g_knownConfigVolumes = getConfigVolumes(wxConfigBase::Get());
+}
+
+
+// ----------------------------------------------------------------------------
+// ConfigWatcher - watches the folder of the config file
+// tools often replace the file instead of writing to it, so the folder
+// is watched and events for other files are ignored
+// ----------------------------------------------------------------------------
+
+class ConfigWatcher : public wxEvtHandler
+{
+public:
+    ConfigWatcher();
+    virtual ~ConfigWatcher();
+    bool Start();
+
+private:
+    void OnFileSystemEvent(wxFileSystemWatcherEvent& event);
+    void OnReloadTimer(wxTimerEvent& event);
+
+    wxFileSystemWatcher * m_watcher;
+    wxTimer m_reloadtimer;
+    wxFileName m_configfile;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(ConfigWatcher, wxEvtHandler)
+    EVT_FSWATCHER(wxID_ANY, ConfigWatcher::OnFileSystemEvent)
+    EVT_TIMER(ID_TIMER_CONFIG_RELOAD, ConfigWatcher::OnReloadTimer)
+wxEND_EVENT_TABLE()
+
+
+ConfigWatcher::ConfigWatcher() : m_reloadtimer(this, ID_TIMER_CONFIG_RELOAD)
+{
+    m_watcher = NULL;
+    m_configfile = wxFileName(getConfigFilePath());
+}
+
+
+ConfigWatcher::~ConfigWatcher()
+{
+    m_reloadtimer.Stop();
+    delete m_watcher;
+}
+
+
+// needs a running event loop
+bool ConfigWatcher::Start()
+{
+    m_watcher = new wxFileSystemWatcher();
+    m_watcher->SetOwner(this);
+    wxFileName configdir = wxFileName::DirName(m_configfile.GetPath());
+    return m_watcher->Add(configdir, wxFSW_EVENT_CREATE | wxFSW_EVENT_DELETE | wxFSW_EVENT_RENAME | wxFSW_EVENT_MODIFY);
+}
+
+
+void ConfigWatcher::OnFileSystemEvent(wxFileSystemWatcherEvent& event)
+{
+    if (event.GetPath().GetFullName() != m_configfile.GetFullName() &&
+        event.GetNewPath().GetFullName() != m_configfile.GetFullName())
+    {
+        return;
+    }
+    // restart the delay on each event
+    m_reloadtimer.StartOnce(CONFIG_RELOAD_DELAY_MS);
+}
+
+
+void ConfigWatcher::OnReloadTimer(wxTimerEvent& WXUNUSED(event))
+{
+    checkConfigFile();
+}
+
+
+static ConfigWatcher * g_configWatcher = NULL;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+void startConfigWatcher()
+{
+    if (g_configWatcher)
+    {
+        return;
+    }
+    rememberConfigFile();
+    g_configWatcher = new ConfigWatcher();
+    if (!g_configWatcher->Start())
+    {
+        // no live reload, writes are still checked for conflicts
+        delete g_configWatcher;
+        g_configWatcher = NULL;
+    }
+}
+
+
+// call before the global config object gets deleted
+void stopConfigWatcher()
+{
+    delete g_configWatcher;
+    g_configWatcher = NULL;
+    // wxFileConfig saves when deleted, which would undo changes we didn't pick up yet
+    if (g_knownConfigStamp.m_exists && getConfigFileStamp() != g_knownConfigStamp)
+    {
+        wxFileConfig * fileconfig = dynamic_cast<wxFileConfig*>(wxConfigBase::Get(false));
+        if (fileconfig)
+        {
+            fileconfig->DisableAutoSave();
+        }
+    }
+}
+
+
+// reload the config file if someone else changed it, and apply the differences
+// main thread only
+void checkConfigFile()
+{
+    ConfigFileStamp stamp = getConfigFileStamp();
+    if (stamp == g_knownConfigStamp || !stamp.m_exists)
+    {
+        // our own write, or the file is being replaced and will show up again
+        return;
+    }
+
+    // only parse the config file itself
+    wxFileConfig * newconfig = new wxFileConfig(wxTheApp->GetAppName(),
+                                                wxEmptyString,
+                                                getConfigFilePath(),
+                                                wxEmptyString,
+                                                wxCONFIG_USE_LOCAL_FILE);
+    std::map<wxString, VolumeRecord> newvolumes = getConfigVolumes(newconfig);
+    VolumeChangeSet changes = diffVolumes(g_knownConfigVolumes, newvolumes);
+
+    // swap in the new config, the old one must not save over the new file
+    wxConfigBase * oldconfig = wxConfigBase::Set(newconfig);
+    wxFileConfig * oldfileconfig = dynamic_cast<wxFileConfig*>(oldconfig);
+    if (oldfileconfig)
+    {
+        oldfileconfig->DisableAutoSave();
+    }
+    delete oldconfig;
+
+    g_knownConfigStamp = stamp;
+    g_knownConfigVolumes = newvolumes;
+
+    // settings may have changed as well
+    loadAppSettings();
+
+    if (changes.IsEmpty())
+    {
+        return;
+    }
+
+    // with the SQLite store, the config file is a way to provision volumes
+    // copy the changes over, the volumes that were not touched stay as they are
+    if (!isVolumeDBConfigFile())
+    {
+        beginVolumeBatch();
+        for (size_t i = 0; i < changes.m_added.size(); i++)
+        {
+            saveVolumeRecord(changes.m_added.at(i));
+        }
+        for (size_t i = 0; i < changes.m_modified.size(); i++)
+        {
+            saveVolumeRecord(changes.m_modified.at(i));
+        }
+        for (size_t i = 0; i < changes.m_removed.size(); i++)
+        {
+            removeVolumeRecord(changes.m_removed.at(i));
+        }
+        commitVolumeBatch();
+    }
+
+    if (g_frmMain)
+    {
+        g_frmMain->ApplyVolumeChanges(changes);
+    }
+}
+
+
+// save the global config, unless another program changed the file since we read it
+// in that case their version gets loaded, and our unsaved changes are dropped
+bool flushConfig()
+{
+    if (g_knownConfigStamp.m_exists && getConfigFileStamp() != g_knownConfigStamp)
+    {
+        wxString title = "Config file changed";
+        wxString errormsg = "The config file was changed by another program.\n"
+                            "Your last change was not saved, the changes made by the other program have been loaded instead.\n"
+                            "Please check and try again.";
+        wxMessageDialog * dlg = new wxMessageDialog(NULL, errormsg, title, wxOK|wxCENTRE|wxICON_WARNING);
+        dlg->ShowModal();
+        dlg->Destroy();
+        checkConfigFile();
+        return false;
+    }
+    bool flushed = wxConfigBase::Get()->Flush();
+    rememberConfigFile();
+    return flushed;
+}
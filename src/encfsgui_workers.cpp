@@ -0,0 +1,543 @@
+/*
+    encFSGui - encfsgui_workers.cpp
+    source file contains code to run work items
+    on a small pool of worker threads
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+#include <wx/progdlg.h>
+#include <wx/timer.h>
+#include <vector>
+#include <deque>
+
+#include "encfsgui.h"
+
+
+// ----------------------------------------------------------------------------
+// worker thread, keeps picking the next work item until all of them are done
+// ----------------------------------------------------------------------------
+
+class WorkerThread : public wxThread
+{
+public:
+    WorkerThread(std::vector<WorkItem*> * items,
+                 size_t * nextitem,
+                 size_t * itemsdone,
+                 wxCriticalSection * itemlock) : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_items = items;
+        m_nextitem = nextitem;
+        m_itemsdone = itemsdone;
+        m_itemlock = itemlock;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        while (true)
+        {
+            size_t index;
+            {
+                wxCriticalSectionLocker lock(*m_itemlock);
+                if (*m_nextitem >= m_items->size())
+                {
+                    break;
+                }
+                index = (*m_nextitem)++;
+            }
+            (*m_items)[index]->Run();
+            {
+                wxCriticalSectionLocker lock(*m_itemlock);
+                ++(*m_itemsdone);
+            }
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    std::vector<WorkItem*> * m_items;
+    size_t * m_nextitem;
+    size_t * m_itemsdone;
+    wxCriticalSection * m_itemlock;
+};
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+// run all work items, using at most maxthreads threads (0 = one per cpu)
+// returns when all items are done
+// if a progress dialog is provided, it gets updated with the nr of items done
+void RunWorkItemsParallel(std::vector<WorkItem*>& items, unsigned int maxthreads, wxProgressDialog * progress)
+{
+    if (items.empty())
+    {
+        return;
+    }
+
+    if (maxthreads == 0)
+    {
+        int nrcpus = wxThread::GetCPUCount();
+        maxthreads = (nrcpus > 0) ? nrcpus : 4;
+    }
+    if (maxthreads > items.size())
+    {
+        maxthreads = items.size();
+    }
+
+    size_t nextitem = 0;
+    size_t itemsdone = 0;
+    wxCriticalSection itemlock;
+    std::vector<WorkerThread*> threads;
+
+    for (unsigned int i = 0; i < maxthreads; i++)
+    {
+        WorkerThread * thread = new WorkerThread(&items, &nextitem, &itemsdone, &itemlock);
+        if (thread->Run() == wxTHREAD_NO_ERROR)
+        {
+            threads.push_back(thread);
+        }
+        else
+        {
+            delete thread;
+        }
+    }
+
+    if (threads.empty())
+    {
+        // no threads available, just do the work ourselves
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            items[i]->Run();
+        }
+        return;
+    }
+
+    if (progress)
+    {
+        // keep the progress dialog alive while the workers are busy
+        bool busy = true;
+        while (busy)
+        {
+            size_t done;
+            {
+                wxCriticalSectionLocker lock(itemlock);
+                done = itemsdone;
+            }
+            busy = (done < items.size());
+            progress->Update(done);
+            if (busy)
+            {
+                wxMilliSleep(50);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->Wait();
+        delete threads[i];
+    }
+}
+
+
+// ----------------------------------------------------------------------------
+// work items with a deadline
+// a thread stuck in the kernel (e.g. stat on a dead network share) can't be
+// cancelled: a small fixed pool of workers takes the items from a queue, an item
+// that runs past its own deadline gets reported as timed out and its worker is
+// written off until the call returns
+// ----------------------------------------------------------------------------
+
+static const unsigned int TIMED_WORKERS = 6;
+// how often the deadlines get checked
+static const int TIMED_WORK_CHECK_MS = 100;
+
+enum
+{
+    ID_TIMER_TIMED_WORK = 1
+};
+
+enum
+{
+    TIMED_ITEM_QUEUED = 0,
+    TIMED_ITEM_RUNNING,
+    TIMED_ITEM_DONE,
+    // the worker still runs it, and deletes it when it gets back
+    TIMED_ITEM_ABANDONED,
+    TIMED_ITEM_NOT_RUN
+};
+
+
+class TimedWorkPool;
+
+
+// one item, shared between the pool and the worker that runs it
+class TimedWorkState
+{
+public:
+    WorkItem * m_item;
+    int m_status;
+    wxLongLong m_started;
+    long m_timeoutms;
+};
+
+
+// the items of one RunWorkItemsWithTimeout call
+class TimedWorkBatch
+{
+public:
+    std::vector<TimedWorkState*> m_states;
+    WorkItemsDoneFunc m_done;
+};
+
+
+// everything below is protected by g_timedWorkLock
+static wxMutex g_timedWorkLock;
+static wxCondition g_timedWorkReady(g_timedWorkLock);
+static std::deque<TimedWorkState*> g_timedWorkQueue;
+static bool g_timedWorkStopped = false;
+static unsigned int g_nrTimedWorkers = 0;
+// workers running an abandoned item
+static unsigned int g_nrStuckWorkers = 0;
+
+
+// ----------------------------------------------------------------------------
+// TimedWorkerThread - runs queued items until the pool stops
+// detached: a worker stuck in the kernel can't be joined, and would keep
+// the app from exiting if wx had to wait for it
+// ----------------------------------------------------------------------------
+
+class TimedWorkerThread : public wxThread
+{
+public:
+    TimedWorkerThread(TimedWorkPool * pool) : wxThread(wxTHREAD_DETACHED)
+    {
+        m_pool = pool;
+    }
+
+    virtual ExitCode Entry() wxOVERRIDE;
+
+private:
+    TimedWorkPool * m_pool;
+};
+
+
+// ----------------------------------------------------------------------------
+// TimedWorkPool - hands out the items, and watches the deadlines
+// main thread only, the workers only talk to it through CallAfter
+// ----------------------------------------------------------------------------
+
+class TimedWorkPool : public wxEvtHandler
+{
+public:
+    TimedWorkPool();
+    virtual ~TimedWorkPool();
+    void Start();
+    void AddBatch(TimedWorkBatch * batch);
+    void OnItemDone();
+
+private:
+    void CheckBatches();
+    void OnCheckTimer(wxTimerEvent& event);
+
+    wxTimer m_checktimer;
+    std::vector<TimedWorkBatch*> m_batches;
+
+    wxDECLARE_EVENT_TABLE();
+};
+
+wxBEGIN_EVENT_TABLE(TimedWorkPool, wxEvtHandler)
+    EVT_TIMER(ID_TIMER_TIMED_WORK, TimedWorkPool::OnCheckTimer)
+wxEND_EVENT_TABLE()
+
+
+TimedWorkPool::TimedWorkPool() : m_checktimer(this, ID_TIMER_TIMED_WORK)
+{
+}
+
+
+// batches that didn't finish yet never get their callback
+// items that are still running belong to their worker
+TimedWorkPool::~TimedWorkPool()
+{
+    m_checktimer.Stop();
+    wxMutexLocker lock(g_timedWorkLock);
+    for (size_t b = 0; b < m_batches.size(); b++)
+    {
+        std::vector<TimedWorkState*>& states = m_batches[b]->m_states;
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            if (states[i]->m_status != TIMED_ITEM_RUNNING && states[i]->m_status != TIMED_ITEM_ABANDONED)
+            {
+                delete states[i]->m_item;
+                delete states[i];
+            }
+            else
+            {
+                states[i]->m_status = TIMED_ITEM_ABANDONED;
+            }
+        }
+        delete m_batches[b];
+    }
+}
+
+
+void TimedWorkPool::Start()
+{
+    for (unsigned int i = 0; i < TIMED_WORKERS; i++)
+    {
+        TimedWorkerThread * thread = new TimedWorkerThread(this);
+        if (thread->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete thread;
+            continue;
+        }
+        wxMutexLocker lock(g_timedWorkLock);
+        g_nrTimedWorkers++;
+    }
+}
+
+
+void TimedWorkPool::AddBatch(TimedWorkBatch * batch)
+{
+    {
+        wxMutexLocker lock(g_timedWorkLock);
+        for (size_t i = 0; i < batch->m_states.size(); i++)
+        {
+            g_timedWorkQueue.push_back(batch->m_states[i]);
+        }
+        g_timedWorkReady.Broadcast();
+    }
+    m_batches.push_back(batch);
+    // no workers at all: report right away, through the event loop like the rest
+    CallAfter(&TimedWorkPool::OnItemDone);
+    if (!m_checktimer.IsRunning())
+    {
+        m_checktimer.Start(TIMED_WORK_CHECK_MS);
+    }
+}
+
+
+void TimedWorkPool::OnItemDone()
+{
+    CheckBatches();
+}
+
+
+void TimedWorkPool::OnCheckTimer(wxTimerEvent& WXUNUSED(event))
+{
+    CheckBatches();
+}
+
+
+// give up on items past their deadline, and report the batches that are complete
+void TimedWorkPool::CheckBatches()
+{
+    std::vector<TimedWorkBatch*> complete;
+    {
+        wxMutexLocker lock(g_timedWorkLock);
+        wxLongLong now = wxGetLocalTimeMillis();
+        for (size_t b = 0; b < m_batches.size(); b++)
+        {
+            std::vector<TimedWorkState*>& states = m_batches[b]->m_states;
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                if (states[i]->m_status == TIMED_ITEM_RUNNING && now - states[i]->m_started >= states[i]->m_timeoutms)
+                {
+                    states[i]->m_status = TIMED_ITEM_ABANDONED;
+                    g_nrStuckWorkers++;
+                }
+            }
+        }
+        // nobody left to pick up the queued items
+        if (g_nrStuckWorkers >= g_nrTimedWorkers)
+        {
+            for (size_t i = 0; i < g_timedWorkQueue.size(); i++)
+            {
+                g_timedWorkQueue[i]->m_status = TIMED_ITEM_NOT_RUN;
+            }
+            g_timedWorkQueue.clear();
+        }
+        std::vector<TimedWorkBatch*>::iterator it = m_batches.begin();
+        while (it != m_batches.end())
+        {
+            bool busy = false;
+            std::vector<TimedWorkState*>& states = (*it)->m_states;
+            for (size_t i = 0; i < states.size() && !busy; i++)
+            {
+                busy = (states[i]->m_status == TIMED_ITEM_QUEUED || states[i]->m_status == TIMED_ITEM_RUNNING);
+            }
+            if (busy)
+            {
+                it++;
+                continue;
+            }
+            // abandoned states belong to their worker from now on, forget about them
+            for (size_t i = 0; i < states.size(); i++)
+            {
+                if (states[i]->m_status == TIMED_ITEM_ABANDONED)
+                {
+                    states[i] = NULL;
+                }
+            }
+            complete.push_back(*it);
+            it = m_batches.erase(it);
+        }
+    }
+    if (m_batches.empty())
+    {
+        m_checktimer.Stop();
+    }
+
+    // the workers are done with the remaining states, no lock needed
+    for (size_t b = 0; b < complete.size(); b++)
+    {
+        TimedWorkBatch * batch = complete[b];
+        std::vector<WorkItem*> items;
+        std::vector<int> results;
+        for (size_t i = 0; i < batch->m_states.size(); i++)
+        {
+            TimedWorkState * state = batch->m_states[i];
+            if (!state)
+            {
+                items.push_back(NULL);
+                results.push_back(WORKITEM_TIMEOUT);
+                continue;
+            }
+            items.push_back(state->m_item);
+            results.push_back((state->m_status == TIMED_ITEM_DONE) ? WORKITEM_DONE : WORKITEM_NOT_RUN);
+        }
+        if (batch->m_done)
+        {
+            batch->m_done(items, results);
+        }
+        for (size_t i = 0; i < batch->m_states.size(); i++)
+        {
+            if (batch->m_states[i])
+            {
+                delete batch->m_states[i]->m_item;
+                delete batch->m_states[i];
+            }
+        }
+        delete batch;
+    }
+}
+
+
+wxThread::ExitCode TimedWorkerThread::Entry()
+{
+    while (true)
+    {
+        TimedWorkState * state;
+        {
+            wxMutexLocker lock(g_timedWorkLock);
+            while (!g_timedWorkStopped && g_timedWorkQueue.empty())
+            {
+                g_timedWorkReady.Wait();
+            }
+            if (g_timedWorkStopped)
+            {
+                break;
+            }
+            state = g_timedWorkQueue.front();
+            g_timedWorkQueue.pop_front();
+            state->m_status = TIMED_ITEM_RUNNING;
+            state->m_started = wxGetLocalTimeMillis();
+        }
+
+        state->m_item->Run();
+
+        wxMutexLocker lock(g_timedWorkLock);
+        if (state->m_status == TIMED_ITEM_ABANDONED)
+        {
+            // the batch got reported without this item, and we're usable again
+            if (!g_timedWorkStopped)
+            {
+                g_nrStuckWorkers--;
+            }
+            delete state->m_item;
+            delete state;
+            continue;
+        }
+        state->m_status = TIMED_ITEM_DONE;
+        if (!g_timedWorkStopped)
+        {
+            m_pool->CallAfter(&TimedWorkPool::OnItemDone);
+        }
+    }
+
+    wxMutexLocker lock(g_timedWorkLock);
+    g_nrTimedWorkers--;
+    return (ExitCode)0;
+}
+
+
+static TimedWorkPool * g_timedWorkPool = NULL;
+
+
+// run the items on the worker pool, each item gets at most timeoutms once it starts
+// returns right away, done gets called on the main thread when all items are
+// finished, timed out (WORKITEM_TIMEOUT, the item is NULL) or could not be
+// started because all workers are stuck (WORKITEM_NOT_RUN)
+// the items belong to the pool, and get deleted after done returns
+// main thread only
+void RunWorkItemsWithTimeout(std::vector<WorkItem*>& items, long timeoutms, WorkItemsDoneFunc done)
+{
+    if (g_timedWorkStopped)
+    {
+        // shutting down, nobody is waiting for the results anymore
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            delete items[i];
+        }
+        items.clear();
+        return;
+    }
+    if (!g_timedWorkPool)
+    {
+        g_timedWorkPool = new TimedWorkPool();
+        g_timedWorkPool->Start();
+    }
+    TimedWorkBatch * batch = new TimedWorkBatch();
+    batch->m_done = done;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        TimedWorkState * state = new TimedWorkState();
+        state->m_item = items[i];
+        state->m_status = TIMED_ITEM_QUEUED;
+        state->m_started = 0;
+        state->m_timeoutms = timeoutms;
+        batch->m_states.push_back(state);
+    }
+    items.clear();
+    g_timedWorkPool->AddBatch(batch);
+}
+
+
+// pending callbacks are dropped, stuck workers are left behind
+void stopTimedWorkers()
+{
+    {
+        wxMutexLocker lock(g_timedWorkLock);
+        g_timedWorkStopped = true;
+        g_timedWorkReady.Broadcast();
+        // queued items never started, nobody else refers to them
+        for (size_t i = 0; i < g_timedWorkQueue.size(); i++)
+        {
+            g_timedWorkQueue[i]->m_status = TIMED_ITEM_NOT_RUN;
+        }
+        g_timedWorkQueue.clear();
+    }
+    delete g_timedWorkPool;
+    g_timedWorkPool = NULL;
+}
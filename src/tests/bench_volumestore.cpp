@@ -0,0 +1,167 @@
+/*
+    encFSGui - tests/bench_volumestore.cpp
+    add/rename/lookup timings of the SQLite volume database
+    against the config file backend
+
+    usage: ENCFSGUI_BENCH_VOLUMES=<number, default 100000> bench_volumestore [name of a test]
+
+    the stores are internal to encfsgui_volumedb.cpp,
+    so this binary compiles that file in instead of linking it
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+#include <wx/fileconf.h>
+#include <wx/stopwatch.h>
+
+#include "../encfsgui_volumedb.cpp"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const long BENCH_DEFAULT_NR_VOLUMES = 100000;
+// one in ten volumes gets renamed
+static const long BENCH_RENAME_EVERY = 10;
+// the config file walks all volumes for each of these
+static const long BENCH_NR_MOUNTPATH_LOOKUPS = 100;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static long getBenchNrVolumes()
+{
+    long nrvolumes = BENCH_DEFAULT_NR_VOLUMES;
+    wxString value;
+    if (wxGetEnv("ENCFSGUI_BENCH_VOLUMES", &value))
+    {
+        value.ToLong(&nrvolumes);
+    }
+    return (nrvolumes > 0) ? nrvolumes : BENCH_DEFAULT_NR_VOLUMES;
+}
+
+
+static wxString getBenchVolumeName(long i)
+{
+    wxString volname;
+    volname.Printf(wxT("volume%06ld"), i);
+    return volname;
+}
+
+
+static VolumeRecord makeBenchRecord(long i)
+{
+    VolumeRecord record;
+    record.m_volname = getBenchVolumeName(i);
+    record.m_enc_path.Printf(wxT("/data/encrypted/%s"), record.m_volname);
+    record.m_mount_path.Printf(wxT("/Volumes/%s"), record.m_volname);
+    record.m_automount = (i % 2) == 0;
+    record.m_pwsaved = (i % 3) == 0;
+    record.m_idletimeout = i % 60;
+    return record;
+}
+
+
+static void benchVolumeStore(VolumeStore * store, long nrvolumes)
+{
+    wxString storename = store->GetName();
+    wxStopWatch sw;
+
+    CHECK(store->BeginBatch());
+    bool saved = true;
+    for (long i = 0; i < nrvolumes; i++)
+    {
+        saved = store->Save(makeBenchRecord(i)) && saved;
+    }
+    CHECK(store->CommitBatch());
+    CHECK(saved);
+    reportTestTiming(wxString::Format(wxT("%s: add %ld"), storename, nrvolumes), sw.Time());
+
+    sw.Start();
+    CHECK(store->BeginBatch());
+    bool renamed = true;
+    long nrrenames = 0;
+    for (long i = 0; i < nrvolumes; i += BENCH_RENAME_EVERY)
+    {
+        renamed = store->Rename(getBenchVolumeName(i), getBenchVolumeName(i) + "-renamed") && renamed;
+        ++nrrenames;
+    }
+    CHECK(store->CommitBatch());
+    CHECK(renamed);
+    reportTestTiming(wxString::Format(wxT("%s: rename %ld"), storename, nrrenames), sw.Time());
+
+    sw.Start();
+    long nrfound = 0;
+    for (long i = 0; i < nrvolumes; i++)
+    {
+        if (store->Exists(getBenchVolumeName(i)))
+        {
+            ++nrfound;
+        }
+    }
+    reportTestTiming(wxString::Format(wxT("%s: exists %ld"), storename, nrvolumes), sw.Time());
+    CHECK_EQUAL(nrvolumes - nrrenames, nrfound);
+
+    sw.Start();
+    long nrread = 0;
+    VolumeRecord record;
+    for (long i = 1; i < nrvolumes; i += BENCH_RENAME_EVERY)
+    {
+        if (store->Get(getBenchVolumeName(i), record) && record.m_volname == getBenchVolumeName(i))
+        {
+            ++nrread;
+        }
+    }
+    reportTestTiming(wxString::Format(wxT("%s: get %ld"), storename, nrread), sw.Time());
+
+    sw.Start();
+    long nrlookups = 0;
+    long nrmatches = 0;
+    long step = wxMax(1l, nrvolumes / BENCH_NR_MOUNTPATH_LOOKUPS);
+    for (long i = 1; i < nrvolumes; i += step)
+    {
+        ++nrlookups;
+        // renames keep the mount path
+        wxString volname = store->FindByMountPath(makeBenchRecord(i).m_mount_path);
+        if (volname == getBenchVolumeName(i) || volname == getBenchVolumeName(i) + "-renamed")
+        {
+            ++nrmatches;
+        }
+    }
+    reportTestTiming(wxString::Format(wxT("%s: find by mount path %ld"), storename, nrlookups), sw.Time());
+    CHECK_EQUAL(nrlookups, nrmatches);
+}
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+#ifdef ENCFSGUI_USE_SQLITE
+ENCFSGUI_TEST(BenchSQLiteVolumeStore)
+{
+    wxString dbpath;
+    dbpath.Printf(wxT("%s/bench.db"), getTestDataDir());
+    SQLiteVolumeStore * store = new SQLiteVolumeStore();
+    CHECK(store->Open(dbpath));
+    benchVolumeStore(store, getBenchNrVolumes());
+    delete store;
+}
+#endif
+
+
+ENCFSGUI_TEST(BenchConfigVolumeStore)
+{
+    wxString configfile;
+    configfile.Printf(wxT("%s/bench.cfg"), getTestDataDir());
+    wxFileConfig * pConfig = new wxFileConfig(wxTheApp->GetAppName(), wxEmptyString, configfile, wxEmptyString, wxCONFIG_USE_LOCAL_FILE);
+    ConfigVolumeStore * store = new ConfigVolumeStore(pConfig);
+    benchVolumeStore(store, getBenchNrVolumes());
+    delete store;
+    delete pConfig;
+}
@@ -0,0 +1,211 @@
+/*
+    encFSGui - tests/stress_snapshot.cpp
+    volume snapshots published on the main thread while other threads
+    read them, meant to be built with -fsanitize=thread
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+#include <wx/stopwatch.h>
+#include <vector>
+#include <map>
+#include <stdio.h>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int STRESS_NR_READERS = 8;
+static const int STRESS_NR_VOLUMES = 200;
+static const int STRESS_NR_PUBLISHES = 2000;
+
+
+// ----------------------------------------------------------------------------
+// SnapshotReader - reads every field of every volume of the latest snapshot
+// ----------------------------------------------------------------------------
+
+class SnapshotReader : public wxThread
+{
+public:
+    SnapshotReader() : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_stopped = false;
+        m_nrreads = 0;
+        m_nrbad = 0;
+        m_lastversion = 0;
+        m_nrbackwards = 0;
+    }
+
+    void Stop()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        m_stopped = true;
+    }
+
+    long GetNrReads() { return m_nrreads; }
+    long GetNrBad() { return m_nrbad; }
+    long GetNrBackwards() { return m_nrbackwards; }
+
+protected:
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        while (!IsStopped())
+        {
+            VolumeSnapshotPtr snapshot = getVolumeSnapshot();
+            // published versions only go up
+            if (snapshot->getVersion() < m_lastversion)
+            {
+                ++m_nrbackwards;
+            }
+            m_lastversion = snapshot->getVersion();
+            const std::vector<wxString>& volumes = snapshot->getVolumeNames();
+            for (size_t i = 0; i < volumes.size(); i++)
+            {
+                const DBEntry * thisvol = snapshot->getVolume(volumes.at(i));
+                if (!thisvol || !IsConsistent(thisvol, volumes.at(i)))
+                {
+                    ++m_nrbad;
+                }
+            }
+            ++m_nrreads;
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    bool IsStopped()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        return m_stopped;
+    }
+
+    // the writer keeps the paths in line with the name and the
+    // mount state in line with the idle timeout, a torn entry breaks that
+    static bool IsConsistent(const DBEntry * thisvol, const wxString& volname)
+    {
+        if (thisvol->getVolName() != volname)
+        {
+            return false;
+        }
+        if (!thisvol->getEncPath().EndsWith(volname) || !thisvol->getMountPath().EndsWith(volname))
+        {
+            return false;
+        }
+        long idletimeout = thisvol->getIdleTimeout();
+        if (thisvol->getMountState() != ((idletimeout % 2) == 1))
+        {
+            return false;
+        }
+        if (thisvol->getMountState() && thisvol->getMountPID() != idletimeout)
+        {
+            return false;
+        }
+        wxString healthinfo = thisvol->getHealthInfo();
+        return (thisvol->getHealthState() == healthinfo.IsEmpty());
+    }
+
+    wxCriticalSection m_lock;
+    bool m_stopped;
+    long m_nrreads;
+    long m_nrbad;
+    long m_lastversion;
+    long m_nrbackwards;
+};
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(StressVolumeSnapshot)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    for (int i = 0; i < STRESS_NR_VOLUMES; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%03d"), i);
+        volumes.push_back(volname);
+        volumedata[volname] = new DBEntry(volname, "/data/encrypted/" + volname, "/Volumes/" + volname, false, false, false, false, false);
+    }
+    publishVolumeSnapshot(volumes, volumedata);
+
+    std::vector<SnapshotReader*> readers;
+    for (int i = 0; i < STRESS_NR_READERS; i++)
+    {
+        SnapshotReader * reader = new SnapshotReader();
+        if (reader->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete reader;
+            continue;
+        }
+        readers.push_back(reader);
+    }
+    CHECK_EQUAL((size_t)STRESS_NR_READERS, readers.size());
+
+    // this thread plays the main thread: change the live model, publish
+    wxStopWatch sw;
+    int nrpublished = 0;
+    for (int round = 1; round <= STRESS_NR_PUBLISHES; round++)
+    {
+        // a few volumes per round, so most entries get shared
+        for (int i = round % 7; i < STRESS_NR_VOLUMES; i += 7)
+        {
+            DBEntry * thisvol = volumedata[volumes.at(i)];
+            thisvol->setIdleTimeout(round);
+            thisvol->setMountState((round % 2) == 1);
+            thisvol->setMountOwner((round % 2) == 1 ? round : 0, 0);
+            thisvol->setHealth((round % 3) != 0, (round % 3) != 0 ? wxString() : wxString::Format(wxT("check %d failed"), round));
+        }
+        // volumes come and go as well
+        if ((round % 50) == 0)
+        {
+            wxString volname = volumes.back();
+            volumes.pop_back();
+            volumes.insert(volumes.begin(), volname);
+        }
+        if (publishVolumeSnapshot(volumes, volumedata))
+        {
+            ++nrpublished;
+        }
+    }
+    reportTestTiming(wxString::Format(wxT("publish %d snapshots"), nrpublished), sw.Time());
+    CHECK_EQUAL(STRESS_NR_PUBLISHES, nrpublished);
+
+    long nrreads = 0;
+    long nrbad = 0;
+    long nrbackwards = 0;
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        readers.at(i)->Stop();
+        readers.at(i)->Wait();
+        nrreads += readers.at(i)->GetNrReads();
+        nrbad += readers.at(i)->GetNrBad();
+        nrbackwards += readers.at(i)->GetNrBackwards();
+        delete readers.at(i);
+    }
+    printf("    %ld snapshot reads\n", nrreads);
+    CHECK(nrreads > 0);
+    CHECK_EQUAL(0l, nrbad);
+    CHECK_EQUAL(0l, nrbackwards);
+
+    // nothing changed, nothing to publish
+    CHECK(!publishVolumeSnapshot(volumes, volumedata));
+
+    for (std::map<wxString, DBEntry*>::iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        delete it->second;
+    }
+}
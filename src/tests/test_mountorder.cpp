@@ -0,0 +1,128 @@
+/*
+    encFSGui - tests/test_mountorder.cpp
+    mount order of volumes that live inside other volumes
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/stopwatch.h>
+#include <vector>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int MOUNTORDER_NR_VOLUMES = 5000;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static void addRecord(std::vector<VolumeRecord>& records, const wxString& volname, const wxString& enc_path, const wxString& mount_path)
+{
+    VolumeRecord record;
+    record.m_volname = volname;
+    record.m_enc_path = enc_path;
+    record.m_mount_path = mount_path;
+    records.push_back(record);
+}
+
+
+// level of a volume, -1 if it wasn't placed
+static int getLevel(const std::vector<wxArrayString>& levels, const wxString& volname)
+{
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        if (levels.at(i).Index(volname) != wxNOT_FOUND)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(MountOrderNested)
+{
+    std::vector<VolumeRecord> records;
+    // stored inside outer, mounted inside middle
+    addRecord(records, "inner", "/Volumes/outer/inner.enc", "/Volumes/middle/inner");
+    addRecord(records, "middle", "/Volumes/outer/middle.enc", "/Volumes/middle");
+    addRecord(records, "outer", "/data/outer.enc", "/Volumes/outer");
+    // a common prefix is not a parent folder
+    addRecord(records, "sibling", "/Volumes/outerx/sibling.enc", "/Volumes/sibling");
+
+    wxArrayString cycle;
+    std::vector<wxArrayString> levels = getMountLevels(records, cycle);
+    CHECK(cycle.IsEmpty());
+    CHECK_EQUAL(0, getLevel(levels, "outer"));
+    CHECK_EQUAL(0, getLevel(levels, "sibling"));
+    CHECK_EQUAL(1, getLevel(levels, "middle"));
+    CHECK_EQUAL(2, getLevel(levels, "inner"));
+}
+
+
+ENCFSGUI_TEST(MountOrderCycle)
+{
+    std::vector<VolumeRecord> records;
+    addRecord(records, "a", "/Volumes/b/a.enc", "/Volumes/a");
+    addRecord(records, "b", "/Volumes/a/b.enc", "/Volumes/b");
+    addRecord(records, "c", "/Volumes/a/c.enc", "/Volumes/c");
+    addRecord(records, "d", "/data/d.enc", "/Volumes/d");
+
+    wxArrayString cycle;
+    std::vector<wxArrayString> levels = getMountLevels(records, cycle);
+    CHECK_EQUAL((size_t)3, cycle.GetCount());
+    CHECK(cycle.Index("c") != wxNOT_FOUND);
+    CHECK_EQUAL(0, getLevel(levels, "d"));
+    CHECK_EQUAL(-1, getLevel(levels, "a"));
+}
+
+
+ENCFSGUI_TEST(MountOrderTiming)
+{
+    // chains of 10, each volume stored inside the one before it
+    std::vector<VolumeRecord> records;
+    for (int i = 0; i < MOUNTORDER_NR_VOLUMES; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%05d"), i);
+        wxString enc_path;
+        if ((i % 10) == 0)
+        {
+            enc_path.Printf(wxT("/data/%s.enc"), volname);
+        }
+        else
+        {
+            enc_path.Printf(wxT("/Volumes/volume%05d/%s.enc"), i - 1, volname);
+        }
+        addRecord(records, volname, enc_path, "/Volumes/" + volname);
+    }
+
+    wxStopWatch sw;
+    wxArrayString cycle;
+    std::vector<wxArrayString> levels = getMountLevels(records, cycle);
+    reportTestTiming(wxString::Format(wxT("mount order of %d volumes"), MOUNTORDER_NR_VOLUMES), sw.Time());
+    CHECK(cycle.IsEmpty());
+    CHECK_EQUAL((size_t)10, levels.size());
+    if (levels.size() == 10)
+    {
+        CHECK_EQUAL((size_t)(MOUNTORDER_NR_VOLUMES / 10), levels.at(9).GetCount());
+    }
+}
@@ -0,0 +1,141 @@
+/*
+    encFSGui - tests/test_mounttable.cpp
+    system mount table & process helpers, also when
+    several threads read them at the same time
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/thread.h>
+#include <wx/regex.h>
+#include <vector>
+#include <map>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int MOUNTTABLE_NR_THREADS = 8;
+static const int MOUNTTABLE_NR_READS = 200;
+
+
+// ----------------------------------------------------------------------------
+// MountTableReader - reads the mount table over and over
+// ----------------------------------------------------------------------------
+
+class MountTableReader : public wxThread
+{
+public:
+    MountTableReader() : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_nrbad = 0;
+    }
+
+    // tables that didn't have the root file system in them
+    int GetNrBad()
+    {
+        return m_nrbad;
+    }
+
+protected:
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        for (int i = 0; i < MOUNTTABLE_NR_READS; i++)
+        {
+            if (!hasRootMount(getSystemMountTable()))
+            {
+                ++m_nrbad;
+            }
+        }
+        return (ExitCode)0;
+    }
+
+public:
+    static bool hasRootMount(const wxArrayString& mounttable)
+    {
+        for (size_t i = 0; i < mounttable.GetCount(); i++)
+        {
+            if (mounttable[i].Contains(" on / ("))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    int m_nrbad;
+};
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(MountTableFormat)
+{
+    wxArrayString mounttable = getSystemMountTable();
+    CHECK(!mounttable.IsEmpty());
+    CHECK(MountTableReader::hasRootMount(mounttable));
+    // "<device> on <mount point> (<type>)", the way mount(8) prints it
+    wxRegEx lineformat("^.+ on /.* \\([^()]+\\)$");
+    size_t nrbad = 0;
+    for (size_t i = 0; i < mounttable.GetCount(); i++)
+    {
+        if (!lineformat.Matches(mounttable[i]))
+        {
+            ++nrbad;
+        }
+    }
+    CHECK_EQUAL((size_t)0, nrbad);
+}
+
+
+ENCFSGUI_TEST(MountTableFromThreads)
+{
+    std::vector<MountTableReader*> readers;
+    for (int i = 0; i < MOUNTTABLE_NR_THREADS; i++)
+    {
+        MountTableReader * reader = new MountTableReader();
+        if (reader->Run() != wxTHREAD_NO_ERROR)
+        {
+            delete reader;
+            continue;
+        }
+        readers.push_back(reader);
+    }
+    CHECK_EQUAL((size_t)MOUNTTABLE_NR_THREADS, readers.size());
+    int nrbad = 0;
+    for (size_t i = 0; i < readers.size(); i++)
+    {
+        readers.at(i)->Wait();
+        nrbad += readers.at(i)->GetNrBad();
+        delete readers.at(i);
+    }
+    CHECK_EQUAL(0, nrbad);
+}
+
+
+ENCFSGUI_TEST(ProcessHelpers)
+{
+    long mypid = (long)wxGetProcessId();
+    CHECK(isProcessAlive(mypid));
+    CHECK(!isProcessAlive(0));
+    CHECK(!isProcessAlive(-1));
+    CHECK(getProcessCPUTime(mypid) >= 0);
+    CHECK(getProcessCPUTime(0) < 0);
+
+    std::map<long, wxArrayString> processes = getProcessArguments();
+    CHECK(processes.find(mypid) != processes.end());
+}
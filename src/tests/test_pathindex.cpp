@@ -0,0 +1,183 @@
+/*
+    encFSGui - tests/test_pathindex.cpp
+    radix path index: which volume owns a path,
+    and which volumes live inside a folder
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/stopwatch.h>
+#include <vector>
+#include <map>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int PATHINDEX_NR_VOLUMES = 10000;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static void addVolume(const wxString& volname, const wxString& enc_path, const wxString& mount_path, std::vector<wxString>& volumes, std::map<wxString, DBEntry*>& volumedata)
+{
+    volumes.push_back(volname);
+    volumedata[volname] = new DBEntry(volname, enc_path, mount_path, false, false, false, false, false);
+}
+
+
+static void freeVolumes(std::vector<wxString>& volumes, std::map<wxString, DBEntry*>& volumedata)
+{
+    for (std::map<wxString, DBEntry*>::iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        delete it->second;
+    }
+    volumedata.clear();
+    volumes.clear();
+    // leave an empty index for the next test
+    updateVolumePathIndex(volumes, volumedata);
+}
+
+
+static wxString findOwner(const wxString& path)
+{
+    VolumePathMatch match;
+    if (!findVolumeByPath(path, match))
+    {
+        return wxEmptyString;
+    }
+    return match.m_volname;
+}
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(PathIndexFolderBoundary)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    addVolume("short", "/data/enc", "/Volumes/short", volumes, volumedata);
+    addVolume("long", "/data/encrypted", "/Volumes/long", volumes, volumedata);
+    updateVolumePathIndex(volumes, volumedata);
+
+    CHECK_EQUAL(wxString("short"), findOwner("/data/enc"));
+    CHECK_EQUAL(wxString("short"), findOwner("/data/enc/"));
+    CHECK_EQUAL(wxString("short"), findOwner("/data/enc/sub/file.txt"));
+    CHECK_EQUAL(wxString("long"), findOwner("/data/encrypted/file.txt"));
+    // a common prefix is not a parent folder
+    CHECK_EQUAL(wxString(""), findOwner("/data/encr"));
+    CHECK_EQUAL(wxString(""), findOwner("/data"));
+
+    VolumePathMatch match;
+    CHECK(findVolumeByPath("/Volumes/long/docs", match));
+    CHECK(match.m_ismountpath);
+    CHECK_EQUAL(wxString("/Volumes/long"), match.m_path);
+
+    freeVolumes(volumes, volumedata);
+}
+
+
+ENCFSGUI_TEST(PathIndexLongestPrefix)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    addVolume("outer", "/data/outer", "/Volumes/outer", volumes, volumedata);
+    // nested: stored inside the mount point of another volume
+    addVolume("inner", "/Volumes/outer/inner", "/Volumes/inner", volumes, volumedata);
+    updateVolumePathIndex(volumes, volumedata);
+
+    CHECK_EQUAL(wxString("outer"), findOwner("/Volumes/outer/other"));
+    CHECK_EQUAL(wxString("inner"), findOwner("/Volumes/outer/inner/file"));
+
+    std::vector<VolumePathMatch> inside = findVolumesInsidePath("/Volumes");
+    CHECK_EQUAL((size_t)3, inside.size());
+    inside = findVolumesInsidePath("/Volumes/outer");
+    CHECK_EQUAL((size_t)2, inside.size());
+    inside = findVolumesInsidePath("/Volumes/inner");
+    CHECK_EQUAL((size_t)1, inside.size());
+
+    CHECK(getVolumePathOverlap("/Volumes/outer/x", "/Volumes/x", "").Contains("outer"));
+    CHECK(getVolumePathOverlap("/Volumes/outer/inner", "/Volumes/inner", "inner").Contains("outer"));
+    // the longest match is the volume being edited, the outer one still counts
+    CHECK(getVolumePathOverlap("/Volumes/outer/inner/x", "/Volumes/x", "inner").Contains("outer"));
+    CHECK(getVolumePathOverlap("/elsewhere/enc", "/elsewhere/mnt", "").IsEmpty());
+
+    freeVolumes(volumes, volumedata);
+}
+
+
+ENCFSGUI_TEST(PathIndexFollowsChanges)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    addVolume("one", "/data/one", "/Volumes/one", volumes, volumedata);
+    addVolume("two", "/data/two", "/Volumes/two", volumes, volumedata);
+    updateVolumePathIndex(volumes, volumedata);
+    CHECK_EQUAL(wxString("one"), findOwner("/data/one/x"));
+
+    // path change: the old path is gone, the new one is there
+    delete volumedata["one"];
+    volumedata["one"] = new DBEntry("one", "/data/moved", "/Volumes/one", false, false, false, false, false);
+    updateVolumePathIndex(volumes, volumedata);
+    CHECK_EQUAL(wxString(""), findOwner("/data/one/x"));
+    CHECK_EQUAL(wxString("one"), findOwner("/data/moved/x"));
+
+    // removal
+    delete volumedata["two"];
+    volumedata.erase("two");
+    volumes.pop_back();
+    updateVolumePathIndex(volumes, volumedata);
+    CHECK_EQUAL(wxString(""), findOwner("/data/two"));
+    CHECK_EQUAL(wxString(""), findOwner("/Volumes/two"));
+    CHECK_EQUAL(wxString("one"), findOwner("/Volumes/one"));
+
+    freeVolumes(volumes, volumedata);
+    CHECK_EQUAL(wxString(""), findOwner("/Volumes/one"));
+}
+
+
+ENCFSGUI_TEST(PathIndexLookupTiming)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    for (int i = 0; i < PATHINDEX_NR_VOLUMES; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%05d"), i);
+        addVolume(volname, wxString::Format(wxT("/data/encrypted/%s"), volname), wxString::Format(wxT("/Volumes/%s"), volname), volumes, volumedata);
+    }
+    wxStopWatch sw;
+    updateVolumePathIndex(volumes, volumedata);
+    reportTestTiming(wxString::Format(wxT("index %d volumes"), PATHINDEX_NR_VOLUMES), sw.Time());
+
+    sw.Start();
+    int nrfound = 0;
+    for (int i = 0; i < PATHINDEX_NR_VOLUMES; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%05d"), i);
+        if (findOwner(wxString::Format(wxT("/Volumes/%s/some/file"), volname)) == volname)
+        {
+            ++nrfound;
+        }
+    }
+    reportTestTiming(wxString::Format(wxT("%d lookups"), PATHINDEX_NR_VOLUMES), sw.Time());
+    CHECK_EQUAL(PATHINDEX_NR_VOLUMES, nrfound);
+
+    freeVolumes(volumes, volumedata);
+}
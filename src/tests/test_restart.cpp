@@ -0,0 +1,202 @@
+/*
+    encFSGui - tests/test_restart.cpp
+    restart with 5k volumes: the volume snapshot and the
+    mount journal must bring back what was there before
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/ffile.h>
+#include <wx/stopwatch.h>
+#include <vector>
+#include <map>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+static const int RESTART_NR_VOLUMES = 5000;
+// generous, a warm start has to feel instant, not just be correct
+static const long RESTART_MAX_LOAD_MS = 2000;
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static void makeVolumes(int nrvolumes, std::vector<wxString>& volumes, std::map<wxString, DBEntry*>& volumedata)
+{
+    for (int i = 0; i < nrvolumes; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%05d"), i);
+        wxString enc_path;
+        enc_path.Printf(wxT("/data/encrypted/%s"), volname);
+        wxString mount_path;
+        mount_path.Printf(wxT("/Volumes/%s"), volname);
+        DBEntry * thisvol = new DBEntry(volname, enc_path, mount_path, (i % 2) == 0, (i % 3) == 0, (i % 5) == 0, (i % 7) == 0, (i % 11) == 0);
+        thisvol->setMountState((i % 4) == 0);
+        thisvol->setIdleTimeout((i % 13) * 60);
+        thisvol->setLazyMount((i % 17) == 0);
+        if ((i % 19) == 0)
+        {
+            // fields are tab separated, make sure escaping works
+            thisvol->setHealth(false, "Folder\tmissing\nsecond line \\ backslash");
+        }
+        volumes.push_back(volname);
+        volumedata[volname] = thisvol;
+    }
+}
+
+
+static void freeVolumes(std::map<wxString, DBEntry*>& volumedata)
+{
+    for (std::map<wxString, DBEntry*>::iterator it = volumedata.begin(); it != volumedata.end(); it++)
+    {
+        delete it->second;
+    }
+    volumedata.clear();
+}
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(RestartFromSnapshot)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    makeVolumes(RESTART_NR_VOLUMES, volumes, volumedata);
+
+    wxStopWatch sw;
+    CHECK(saveVolumeSnapshot(volumes, volumedata));
+    reportTestTiming(wxString::Format(wxT("save %d volumes"), RESTART_NR_VOLUMES), sw.Time());
+
+    // the next run starts with nothing
+    std::vector<wxString> loadedvolumes;
+    std::map<wxString, DBEntry*> loadedvolumedata;
+    sw.Start();
+    CHECK(loadVolumeSnapshot(loadedvolumes, loadedvolumedata));
+    long loadtime = sw.Time();
+    reportTestTiming(wxString::Format(wxT("load %d volumes"), RESTART_NR_VOLUMES), loadtime);
+    CHECK(loadtime < RESTART_MAX_LOAD_MS);
+
+    CHECK_EQUAL(volumes.size(), loadedvolumes.size());
+    CHECK(volumes == loadedvolumes);
+    size_t nrdifferent = 0;
+    for (size_t i = 0; i < volumes.size(); i++)
+    {
+        std::map<wxString, DBEntry*>::iterator it = loadedvolumedata.find(volumes.at(i));
+        if (it == loadedvolumedata.end() || !it->second->isSameAs(*volumedata[volumes.at(i)]))
+        {
+            ++nrdifferent;
+        }
+    }
+    CHECK_EQUAL((size_t)0, nrdifferent);
+
+    freeVolumes(volumedata);
+    freeVolumes(loadedvolumedata);
+}
+
+
+ENCFSGUI_TEST(DamagedSnapshotIsIgnored)
+{
+    std::vector<wxString> volumes;
+    std::map<wxString, DBEntry*> volumedata;
+    makeVolumes(10, volumes, volumedata);
+    CHECK(saveVolumeSnapshot(volumes, volumedata));
+
+    // cut off in the middle of a line
+    wxString contents;
+    CHECK(readDataFile(getDataFilePath("volumes.snapshot"), contents));
+    contents.Truncate(contents.Length() - 5);
+    CHECK(writeDataFileAtomic(getDataFilePath("volumes.snapshot"), contents));
+
+    std::vector<wxString> loadedvolumes;
+    std::map<wxString, DBEntry*> loadedvolumedata;
+    CHECK(!loadVolumeSnapshot(loadedvolumes, loadedvolumedata));
+    CHECK(loadedvolumes.empty());
+    CHECK(loadedvolumedata.empty());
+
+    freeVolumes(volumedata);
+}
+
+
+ENCFSGUI_TEST(RestartFromJournal)
+{
+    wxRemoveFile(getDataFilePath("mounts.journal"));
+
+    wxStopWatch sw;
+    for (int i = 0; i < RESTART_NR_VOLUMES; i++)
+    {
+        wxString volname;
+        volname.Printf(wxT("volume%05d"), i);
+        journalMountStarted(volname, 10000 + i, wxString::Format(wxT("/Volumes/%s"), volname));
+    }
+    // every other volume got unmounted again
+    for (int i = 0; i < RESTART_NR_VOLUMES; i += 2)
+    {
+        journalMountStopped(wxString::Format(wxT("volume%05d"), i));
+    }
+    reportTestTiming(wxString::Format(wxT("journal %d mounts"), RESTART_NR_VOLUMES + RESTART_NR_VOLUMES / 2), sw.Time());
+
+    // a crash while writing leaves half a line behind
+    {
+        wxFFile journal(getDataFilePath("mounts.journal"), "a");
+        CHECK(journal.IsOpened());
+        journal.Write(wxT("M\t12345\t999\tvolume99"));
+    }
+
+    sw.Start();
+    std::map<wxString, MountJournalEntry> mounts = readMountJournal();
+    reportTestTiming("replay journal", sw.Time());
+    CHECK_EQUAL((size_t)(RESTART_NR_VOLUMES / 2), mounts.size());
+    CHECK(mounts.find("volume00000") == mounts.end());
+    std::map<wxString, MountJournalEntry>::iterator it = mounts.find("volume00001");
+    CHECK(it != mounts.end());
+    if (it != mounts.end())
+    {
+        CHECK_EQUAL(10001, it->second.m_pid);
+        CHECK_EQUAL(wxString("/Volumes/volume00001"), it->second.m_mount_path);
+    }
+    CHECK(mounts.find("volume99") == mounts.end());
+
+    // compacting keeps the open mounts and nothing else
+    CHECK(compactMountJournal(mounts));
+    std::map<wxString, MountJournalEntry> compacted = readMountJournal();
+    CHECK_EQUAL(mounts.size(), compacted.size());
+    wxString contents;
+    CHECK(readDataFile(getDataFilePath("mounts.journal"), contents));
+    CHECK_EQUAL((int)mounts.size(), contents.Freq('\n'));
+}
+
+
+ENCFSGUI_TEST(SessionIsTakenOnce)
+{
+    wxArrayString mounted;
+    mounted.Add("volume00001");
+    mounted.Add("volume\twith tab");
+    CHECK(saveMountSession(mounted));
+
+    wxArrayString restored = takeMountSession();
+    CHECK_EQUAL((size_t)2, restored.GetCount());
+    if (restored.GetCount() == 2)
+    {
+        CHECK_EQUAL(mounted[0], restored[0]);
+        CHECK_EQUAL(mounted[1], restored[1]);
+    }
+    // the file is gone after the first read
+    CHECK(!wxFileExists(getDataFilePath("mounts.session")));
+}
@@ -0,0 +1,539 @@
+/*
+    encFSGui - tests/test_update.cpp
+    update check against a local stand-in for the release server,
+    serving version.txt with delays and errors
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+#include <wx/thread.h>
+#include <wx/tokenzr.h>
+#include <wx/stopwatch.h>
+#include <map>
+#include <string>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// constants
+// ----------------------------------------------------------------------------
+
+enum
+{
+    SERVE_VERSION,      // 200 with version.txt, 304 if the ETag matches
+    SERVE_ERROR,        // 500
+    SERVE_GARBAGE,      // 200 with an html page, like a captive portal
+    SERVE_SLOW,         // version.txt, after a delay shorter than the timeouts
+    SERVE_HANG          // read the request, never answer
+};
+
+static const char * SERVED_VERSION = "9.8.7";
+static const char * SERVED_ETAG = "\"v987\"";
+static const long SERVE_SLOW_MS = 2000;
+// longer than the total timeout of a check
+static const long UPDATE_WAIT_MS = 30000;
+// curl checks the abort flag at least once per second
+static const long UPDATE_ABORT_MAX_MS = 3000;
+
+
+// ----------------------------------------------------------------------------
+// VersionServer - minimal HTTP server on 127.0.0.1, one connection at a time
+// ----------------------------------------------------------------------------
+
+class VersionServer : public wxThread
+{
+public:
+    VersionServer() : wxThread(wxTHREAD_JOINABLE)
+    {
+        m_listenfd = -1;
+        m_port = 0;
+        m_mode = SERVE_VERSION;
+        m_nrrequests = 0;
+        m_stopped = false;
+        m_connectionclosed = false;
+    }
+
+    bool Start()
+    {
+        m_listenfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenfd < 0)
+        {
+            return false;
+        }
+        int reuse = 1;
+        setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        // port 0, let the system pick a free one
+        addr.sin_port = 0;
+        socklen_t addrlen = sizeof(addr);
+        if (bind(m_listenfd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+            listen(m_listenfd, 4) != 0 ||
+            getsockname(m_listenfd, (struct sockaddr *)&addr, &addrlen) != 0)
+        {
+            close(m_listenfd);
+            m_listenfd = -1;
+            return false;
+        }
+        m_port = ntohs(addr.sin_port);
+        return (Run() == wxTHREAD_NO_ERROR);
+    }
+
+    void Stop()
+    {
+        {
+            wxCriticalSectionLocker lock(m_lock);
+            m_stopped = true;
+        }
+        Wait();
+        close(m_listenfd);
+    }
+
+    wxString GetURL()
+    {
+        return wxString::Format(wxT("http://127.0.0.1:%d/version.txt"), m_port);
+    }
+
+    void SetMode(int mode)
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        m_mode = mode;
+        m_connectionclosed = false;
+    }
+
+    int GetNrRequests()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        return m_nrrequests;
+    }
+
+    std::string GetLastRequest()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        return m_lastrequest;
+    }
+
+    // the client went away while a SERVE_HANG request was waiting
+    bool IsConnectionClosed()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        return m_connectionclosed;
+    }
+
+protected:
+    virtual ExitCode Entry() wxOVERRIDE
+    {
+        while (!IsStopped())
+        {
+            if (!WaitReadable(m_listenfd, 100))
+            {
+                continue;
+            }
+            int clientfd = accept(m_listenfd, NULL, NULL);
+            if (clientfd < 0)
+            {
+                continue;
+            }
+            Serve(clientfd);
+            close(clientfd);
+        }
+        return (ExitCode)0;
+    }
+
+private:
+    bool IsStopped()
+    {
+        wxCriticalSectionLocker lock(m_lock);
+        return m_stopped;
+    }
+
+    static bool WaitReadable(int fd, int timeoutms)
+    {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        return (poll(&pfd, 1, timeoutms) > 0);
+    }
+
+    void Serve(int clientfd)
+    {
+        // the request of a check is small, read up to the empty line
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && !IsStopped())
+        {
+            if (!WaitReadable(clientfd, 100))
+            {
+                continue;
+            }
+            ssize_t nrread = recv(clientfd, buffer, sizeof(buffer), 0);
+            if (nrread <= 0)
+            {
+                return;
+            }
+            request.append(buffer, nrread);
+        }
+        int mode;
+        {
+            wxCriticalSectionLocker lock(m_lock);
+            ++m_nrrequests;
+            m_lastrequest = request;
+            mode = m_mode;
+        }
+
+        std::string response;
+        switch (mode)
+        {
+            case SERVE_ERROR:
+                response = Response("500 Internal Server Error", "", "oops\n");
+                break;
+            case SERVE_GARBAGE:
+                response = Response("200 OK", "", "<html><body>Please log in</body></html>\n");
+                break;
+            case SERVE_SLOW:
+                wxMilliSleep(SERVE_SLOW_MS);
+                response = Response("200 OK", SERVED_ETAG, std::string(SERVED_VERSION) + "\n");
+                break;
+            case SERVE_HANG:
+                // wait until the client gives up
+                while (!IsStopped())
+                {
+                    if (WaitReadable(clientfd, 100) && recv(clientfd, buffer, sizeof(buffer), 0) <= 0)
+                    {
+                        wxCriticalSectionLocker lock(m_lock);
+                        m_connectionclosed = true;
+                        break;
+                    }
+                }
+                return;
+            default:
+                if (request.find(std::string("If-None-Match: ") + SERVED_ETAG) != std::string::npos)
+                {
+                    response = Response("304 Not Modified", SERVED_ETAG, "");
+                }
+                else
+                {
+                    response = Response("200 OK", SERVED_ETAG, std::string(SERVED_VERSION) + "\n");
+                }
+                break;
+        }
+        send(clientfd, response.c_str(), response.size(), 0);
+    }
+
+    static std::string Response(const std::string& status, const std::string& etag, const std::string& body)
+    {
+        char length[32];
+        snprintf(length, sizeof(length), "%lu", (unsigned long)body.size());
+        std::string response = "HTTP/1.1 " + status + "\r\n";
+        if (!etag.empty())
+        {
+            response += "ETag: " + etag + "\r\n";
+        }
+        response += "Content-Type: text/plain\r\n";
+        response += std::string("Content-Length: ") + length + "\r\n";
+        response += "Connection: close\r\n\r\n";
+        return response + body;
+    }
+
+    int m_listenfd;
+    int m_port;
+    wxCriticalSection m_lock;
+    int m_mode;
+    int m_nrrequests;
+    std::string m_lastrequest;
+    bool m_stopped;
+    bool m_connectionclosed;
+};
+
+
+// ----------------------------------------------------------------------------
+// local helpers
+// ----------------------------------------------------------------------------
+
+static VersionServer * g_versionServer = NULL;
+
+
+static VersionServer * getVersionServer()
+{
+    if (!g_versionServer)
+    {
+        initUpdateChecker();
+        g_versionServer = new VersionServer();
+        if (!g_versionServer->Start())
+        {
+            delete g_versionServer;
+            g_versionServer = NULL;
+            return NULL;
+        }
+        wxConfigBase * pConfig = wxConfigBase::Get();
+        pConfig->SetPath(wxT("/Config"));
+        pConfig->Write(wxT("updateurl"), g_versionServer->GetURL());
+        pConfig->Flush();
+        loadAppSettings();
+    }
+    return g_versionServer;
+}
+
+
+static void stopVersionServer()
+{
+    if (g_versionServer)
+    {
+        g_versionServer->Stop();
+        delete g_versionServer;
+        g_versionServer = NULL;
+    }
+}
+
+
+// same key=value lines the update checker writes
+static void writeUpdateCache(const wxString& version, const wxString& etag, long nextcheck, long failures)
+{
+    wxString contents;
+    contents << "version=" << version << "\n";
+    contents << "etag=" << etag << "\n";
+    contents << "lastmodified=\n";
+    contents << "lastcheck=0\n";
+    contents << "nextcheck=" << nextcheck << "\n";
+    contents << "failures=" << failures << "\n";
+    writeDataFileAtomic(getDataFilePath("update.cache"), contents);
+}
+
+
+static std::map<wxString, wxString> readUpdateCache()
+{
+    std::map<wxString, wxString> cache;
+    wxString contents;
+    readDataFile(getDataFilePath("update.cache"), contents);
+    wxArrayString lines = wxStringTokenize(contents, "\n", wxTOKEN_STRTOK);
+    for (size_t i = 0; i < lines.GetCount(); i++)
+    {
+        cache[lines[i].BeforeFirst('=')] = lines[i].AfterFirst('=');
+    }
+    return cache;
+}
+
+
+// start a forced check and wait until it wrote the cache
+// the previous check may still be clearing its running flag
+static bool runUpdateCheck()
+{
+    wxStopWatch sw;
+    while (!startUpdateCheck(true))
+    {
+        if (sw.Time() > UPDATE_WAIT_MS)
+        {
+            return false;
+        }
+        wxMilliSleep(50);
+    }
+    while (readUpdateCache()["lastcheck"] == "0")
+    {
+        if (sw.Time() > UPDATE_WAIT_MS)
+        {
+            return false;
+        }
+        wxMilliSleep(50);
+    }
+    return true;
+}
+
+
+static long readCacheLong(std::map<wxString, wxString>& cache, const wxString& key)
+{
+    long value = -1;
+    cache[key].ToLong(&value);
+    return value;
+}
+
+
+// ----------------------------------------------------------------------------
+// tests
+// ----------------------------------------------------------------------------
+
+ENCFSGUI_TEST(UpdateCheckFetchesVersion)
+{
+    VersionServer * server = getVersionServer();
+    CHECK(server != NULL);
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_VERSION);
+    writeUpdateCache("", "", 0, 0);
+    long now = (long)wxGetUTCTime();
+    CHECK(runUpdateCheck());
+
+    std::map<wxString, wxString> cache = readUpdateCache();
+    CHECK_EQUAL(wxString(SERVED_VERSION), cache["version"]);
+    CHECK_EQUAL(wxString(SERVED_ETAG), cache["etag"]);
+    CHECK_EQUAL(0, readCacheLong(cache, "failures"));
+    // next one a day later
+    CHECK(readCacheLong(cache, "nextcheck") >= now + 24 * 60 * 60);
+    CHECK_EQUAL(wxString(SERVED_VERSION), getCachedLatestVersion());
+}
+
+
+ENCFSGUI_TEST(UpdateCheckSendsETag)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_VERSION);
+    writeUpdateCache(SERVED_VERSION, SERVED_ETAG, 0, 0);
+    CHECK(runUpdateCheck());
+
+    CHECK(server->GetLastRequest().find(std::string("If-None-Match: ") + SERVED_ETAG) != std::string::npos);
+    // 304, what we had is still the latest
+    std::map<wxString, wxString> cache = readUpdateCache();
+    CHECK_EQUAL(wxString(SERVED_VERSION), cache["version"]);
+    CHECK_EQUAL(0, readCacheLong(cache, "failures"));
+}
+
+
+ENCFSGUI_TEST(UpdateCheckBacksOffOnErrors)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_ERROR);
+    writeUpdateCache("1.0.0", "", 0, 0);
+    long now = (long)wxGetUTCTime();
+    CHECK(runUpdateCheck());
+    std::map<wxString, wxString> cache = readUpdateCache();
+    // the last good answer is kept
+    CHECK_EQUAL(wxString("1.0.0"), cache["version"]);
+    CHECK_EQUAL(1, readCacheLong(cache, "failures"));
+    long delay = readCacheLong(cache, "nextcheck") - now;
+    CHECK(delay >= 5 * 60 && delay <= 5 * 60 + 5);
+
+    // 5 min, 10 min, 20 min, 40 min
+    writeUpdateCache("1.0.0", "", 0, 3);
+    now = (long)wxGetUTCTime();
+    CHECK(runUpdateCheck());
+    cache = readUpdateCache();
+    CHECK_EQUAL(4, readCacheLong(cache, "failures"));
+    delay = readCacheLong(cache, "nextcheck") - now;
+    CHECK(delay >= 40 * 60 && delay <= 40 * 60 + 5);
+
+    // never longer than a day
+    writeUpdateCache("1.0.0", "", 0, 30);
+    now = (long)wxGetUTCTime();
+    CHECK(runUpdateCheck());
+    cache = readUpdateCache();
+    delay = readCacheLong(cache, "nextcheck") - now;
+    CHECK(delay >= 24 * 60 * 60 && delay <= 24 * 60 * 60 + 5);
+}
+
+
+ENCFSGUI_TEST(UpdateCheckRejectsGarbage)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_GARBAGE);
+    writeUpdateCache("1.0.0", "", 0, 0);
+    CHECK(runUpdateCheck());
+    std::map<wxString, wxString> cache = readUpdateCache();
+    CHECK_EQUAL(wxString("1.0.0"), cache["version"]);
+    CHECK_EQUAL(1, readCacheLong(cache, "failures"));
+}
+
+
+ENCFSGUI_TEST(UpdateCheckWaitsForSlowServer)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_SLOW);
+    writeUpdateCache("", "", 0, 0);
+    wxStopWatch sw;
+    CHECK(runUpdateCheck());
+    reportTestTiming("slow server", sw.Time());
+    CHECK(sw.Time() >= SERVE_SLOW_MS);
+    std::map<wxString, wxString> cache = readUpdateCache();
+    CHECK_EQUAL(wxString(SERVED_VERSION), cache["version"]);
+}
+
+
+ENCFSGUI_TEST(UpdateCheckUsesCacheUntilDue)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_VERSION);
+    int nrrequests = server->GetNrRequests();
+    writeUpdateCache("1.2.3", "", (long)wxGetUTCTime() + 60 * 60, 0);
+    CHECK(startUpdateCheck(false));
+    wxMilliSleep(500);
+    CHECK_EQUAL(nrrequests, server->GetNrRequests());
+    CHECK_EQUAL(wxString("1.2.3"), getCachedLatestVersion());
+}
+
+
+// last one, the update checker can't be used after it was stopped
+ENCFSGUI_TEST(UpdateCheckAbortsOnQuit)
+{
+    VersionServer * server = getVersionServer();
+    if (!server)
+    {
+        return;
+    }
+    server->SetMode(SERVE_HANG);
+    int nrrequests = server->GetNrRequests();
+    writeUpdateCache("1.0.0", "", 0, 0);
+    CHECK(startUpdateCheck(true));
+    wxStopWatch sw;
+    while (server->GetNrRequests() == nrrequests && sw.Time() < UPDATE_WAIT_MS)
+    {
+        wxMilliSleep(20);
+    }
+
+    stopUpdateChecker();
+    sw.Start();
+    while (!server->IsConnectionClosed() && sw.Time() < UPDATE_WAIT_MS)
+    {
+        wxMilliSleep(20);
+    }
+    reportTestTiming("abort", sw.Time());
+    CHECK(server->IsConnectionClosed());
+    CHECK(sw.Time() < UPDATE_ABORT_MAX_MS);
+    // an aborted check doesn't count as a failure
+    wxMilliSleep(200);
+    std::map<wxString, wxString> cache = readUpdateCache();
+    CHECK_EQUAL(wxString("0"), cache["lastcheck"]);
+    CHECK(!startUpdateCheck(true));
+
+    stopVersionServer();
+}
@@ -0,0 +1,136 @@
+/*
+    encFSGui - tests/testmain.cpp
+    source file contains the test runner
+    each run gets an app data folder of its own, removed when done
+
+    usage: <test binary> [name of a test]
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/init.h>
+#include <wx/config.h>
+#include <wx/fileconf.h>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+#include <vector>
+#include <stdio.h>
+
+#include "../encfsgui.h"
+#include "testmain.h"
+
+
+// ----------------------------------------------------------------------------
+// registered tests
+// ----------------------------------------------------------------------------
+
+class RegisteredTest
+{
+public:
+    const char * m_name;
+    TestFunc m_func;
+};
+
+// filled in before main runs, so it has to be created on first use
+static std::vector<RegisteredTest>& getRegisteredTests()
+{
+    static std::vector<RegisteredTest> tests;
+    return tests;
+}
+
+static int g_nrFailures = 0;
+
+
+// ----------------------------------------------------------------------------
+// helper functions
+// ----------------------------------------------------------------------------
+
+bool registerTest(const char * name, TestFunc func)
+{
+    RegisteredTest test;
+    test.m_name = name;
+    test.m_func = func;
+    getRegisteredTests().push_back(test);
+    return true;
+}
+
+
+void reportTestFailure(const char * file, int line, const wxString& msg)
+{
+    ++g_nrFailures;
+    printf("    FAILED %s:%d: %s\n", file, line, (const char *)msg.utf8_str());
+}
+
+
+// timings go to the output, so benchmark runs can be compared
+void reportTestTiming(const wxString& what, long ms)
+{
+    printf("    %s: %ld ms\n", (const char *)what.utf8_str(), ms);
+}
+
+
+// the app data folder of this run, getDataFilePath() puts its files here
+wxString getTestDataDir()
+{
+    return wxStandardPaths::Get().GetUserDataDir();
+}
+
+
+// ----------------------------------------------------------------------------
+// main
+// ----------------------------------------------------------------------------
+
+int main(int argc, char ** argv)
+{
+    // no wxApp, only what the non GUI parts need
+    wxInitializer initializer(argc, argv);
+    if (!initializer.IsOk())
+    {
+        printf("Unable to initialize wxWidgets\n");
+        return 2;
+    }
+    wxTheApp->SetAppName(wxString::Format(wxT("encfsgui-tests-%lu"), wxGetProcessId()));
+    wxString datadir = getTestDataDir();
+    wxFileName::Mkdir(datadir, 0700, wxPATH_MKDIR_FULL);
+    // never touch the config of the real app
+    wxString configfile;
+    configfile.Printf(wxT("%s/encfsgui.cfg"), datadir);
+    wxConfigBase::Set(new wxFileConfig(wxTheApp->GetAppName(), wxEmptyString, configfile, wxEmptyString, wxCONFIG_USE_LOCAL_FILE));
+    // like OnInit, before any test can ask for them
+    loadAppSettings();
+
+    wxString only = (argc > 1) ? wxString::FromUTF8(argv[1]) : wxString();
+    int nrrun = 0;
+    std::vector<RegisteredTest>& tests = getRegisteredTests();
+    for (size_t i = 0; i < tests.size(); i++)
+    {
+        if (!only.IsEmpty() && only != tests.at(i).m_name)
+        {
+            continue;
+        }
+        printf("[ RUN  ] %s\n", tests.at(i).m_name);
+        fflush(stdout);
+        int failures = g_nrFailures;
+        tests.at(i).m_func();
+        printf("[ %s ] %s\n", (g_nrFailures == failures) ? " OK " : "FAIL", tests.at(i).m_name);
+        fflush(stdout);
+        ++nrrun;
+    }
+
+    delete wxConfigBase::Set((wxConfigBase *) NULL);
+    wxFileName::Rmdir(datadir, wxPATH_RMDIR_RECURSIVE);
+
+    printf("%d test(s) run, %d check(s) failed\n", nrrun, g_nrFailures);
+    if (nrrun == 0)
+    {
+        return 2;
+    }
+    return (g_nrFailures == 0) ? 0 : 1;
+}
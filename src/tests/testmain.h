@@ -0,0 +1,56 @@
+/*
+    encFSGui - tests/testmain.h
+    header file for the tests of the parts of EncFSGui
+    that don't need the GUI
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+#ifndef ENCFSGUI_TESTMAIN_H
+#define ENCFSGUI_TESTMAIN_H
+
+#include <wx/string.h>
+
+
+typedef void (*TestFunc)();
+
+// ----------------------------------------------------------------------------
+// function declarations
+// ----------------------------------------------------------------------------
+
+// tests/testmain.cpp
+bool registerTest(const char *, TestFunc);
+void reportTestFailure(const char *, int, const wxString&);
+void reportTestTiming(const wxString&, long);
+wxString getTestDataDir();
+
+
+// a test is a function without arguments, registered before main runs
+#define ENCFSGUI_TEST(name) \
+    static void name(); \
+    static bool name##_registered = registerTest(#name, name); \
+    static void name()
+
+// a failed check is reported, the test keeps running
+#define CHECK(cond) \
+    do \
+    { \
+        if (!(cond)) \
+        { \
+            reportTestFailure(__FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+    do \
+    { \
+        if (!((expected) == (actual))) \
+        { \
+            wxString checkmsg; \
+            checkmsg << #expected << " == " << #actual << " (got '" << (actual) << "', expected '" << (expected) << "')"; \
+            reportTestFailure(__FILE__, __LINE__, checkmsg); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,35 @@
+/*
+    encFSGui - tests/teststubs.cpp
+    source file contains stand-ins for the GUI side
+    the tested parts call into (main window, config watcher)
+
+    written by Peter Van Eeckhoutte
+
+*/
+
+// For compilers that support precompilation, includes "wx/wx.h".
+#include <wx/wxprec.h>
+#ifndef WX_PRECOMP
+    #include <wx/wx.h>
+#endif
+
+#include <wx/config.h>
+
+#include "../encfsgui.h"
+
+
+// there is no main window, nothing gets reported to it
+frmMain * g_frmMain = NULL;
+
+
+// never called, g_frmMain stays NULL
+void frmMain::OnUpdateCheckDone(wxString WXUNUSED(latestversion), bool WXUNUSED(showIfNoUpdate))
+{
+}
+
+
+// nobody else writes the test config, no need to check for outside changes
+bool flushConfig()
+{
+    return wxConfigBase::Get()->Flush();
+}